@@ -1,114 +1,252 @@
 /* audio.hpp
  * Contains functions to help load audio into an audio buffer
- * Currently supports .wav audio files
+ * Currently supports PCM .wav audio files. The file is mapped and its RIFF chunks are walked to find the format
+ * and the samples, which go straight from the mapping into the buffer. Buffers are shared by every source that
+ * plays the same file, and the files of a scene can be read ahead of time by the job system's workers
  * Has a source class which holds a source and can play audio from a buffer
  */
 
 #ifndef ASSIGNMENT_AUDIO_HPP
 #define ASSIGNMENT_AUDIO_HPP
 
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include "util/jobSystem.hpp"
+#include "util/mappedFile.hpp"
+
 namespace audio
 {
-// Precondition:	"file" is a .wav audio file
-// Postcondition:	returns buffer with audio data for "file"
-GLuint loadAudio(const char *file)
+// Format of the samples of a .wav file and where they are in it
+struct WavInfo
+{
+	ALenum format;
+	ALuint frequency;
+	ALsizei frameSize;			  // bytes in one sample of every channel
+	const unsigned char *samples; // first sample, inside the data the file was parsed from
+	std::uint32_t dataSize;		  // bytes of samples, a whole number of frames
+};
+
+// Precondition:	p has at least 2 bytes
+// Postcondition:	returns the little endian 16 bit value at p
+inline std::uint16_t readU16(const unsigned char *p)
+{
+	return (std::uint16_t)(p[0] | (p[1] << 8));
+}
+
+// Precondition:	p has at least 4 bytes
+// Postcondition:	returns the little endian 32 bit value at p
+inline std::uint32_t readU32(const unsigned char *p)
+{
+	return (std::uint32_t)p[0] | ((std::uint32_t)p[1] << 8) | ((std::uint32_t)p[2] << 16) | ((std::uint32_t)p[3] << 24);
+}
+
+// Precondition:	data is the size bytes of "file"
+// Postcondition:	walks the RIFF chunks of the file and returns true with info filled in if it has 8 or 16 bit mono or
+//					stereo PCM samples, otherwise prints why not and returns false. Nothing is copied, info.samples
+//					points into data
+bool parseWav(const char *file, const unsigned char *data, size_t size, WavInfo &info)
 {
-	// Open the file
-	FILE *fp = NULL;
-	fp = fopen(file, "rb");
-
-	// Declare variables for dealing with .wav data
-	char type[4];
-	DWORD size, chunkSize;
-	short formatType, channels;
-	DWORD sampleRate, avgBytesPerSec;
-	short bytesPerSample, bitsPerSample;
-	DWORD dataSize;
-
-	// Reading header "RIFF"
-	fread(type, sizeof(char), 4, fp);
-	if (type[0] != 'R' || type[1] != 'I' || type[2] != 'F' || type[3] != 'F')
-		std::cout << "OpenAL Error: No RIFF" << std::endl;
-
-	// Read header "WAVE"
-	fread(&size, sizeof(DWORD), 1, fp);
-	fread(type, sizeof(char), 4, fp);
-	if (type[0] != 'W' || type[1] != 'A' || type[2] != 'V' || type[3] != 'E')
-		std::cout << "OpenAL Error: Not a WAVE file" << std::endl;
-
-	// Read "fmt "
-	fread(type, sizeof(char), 4, fp);
-	if (type[0] != 'f' || type[1] != 'm' || type[2] != 't' || type[3] != ' ')
-		std::cout << "OpenAL Error: Not a fmt" << std::endl;
-
-	// Set variables based on info in the .wav file
-	fread(&chunkSize, sizeof(DWORD), 1, fp);
-	fread(&formatType, sizeof(short), 1, fp);
-	fread(&channels, sizeof(short), 1, fp);
-	fread(&sampleRate, sizeof(DWORD), 1, fp);
-	fread(&avgBytesPerSec, sizeof(DWORD), 1, fp);
-	fread(&bytesPerSample, sizeof(short), 1, fp);
-	fread(&bitsPerSample, sizeof(short), 1, fp);
-
-	// Find the data header
-	bool looking = true;
-	fread(type, sizeof(char), 1, fp);
-	while (looking)
-	{
-		if (type[0] == 'd')
+	info = WavInfo();
+	if (size < 12 || memcmp(data, "RIFF", 4) != 0 || memcmp(data + 8, "WAVE", 4) != 0)
+	{
+		std::cout << "OpenAL Error: " << file << " is not a WAVE file" << std::endl;
+		return false;
+	}
+
+	// The RIFF size can be wrong in files that were written as a stream, the file size is trusted over it
+	size_t end = std::min(size, (size_t)readU32(data + 4) + 8);
+	if (end < 12)
+	{
+		end = size;
+	}
+
+	std::uint16_t formatTag = 0, channels = 0, blockAlign = 0, bitsPerSample = 0;
+	std::uint32_t sampleRate = 0;
+	bool foundFormat = false;
+	size_t position = 12;
+	while (position + 8 <= end && info.samples == nullptr)
+	{
+		const unsigned char *chunk = data + position;
+		size_t chunkSize = readU32(chunk + 4);
+		size_t body = position + 8;
+		if (chunkSize > end - body)
+		{
+			chunkSize = end - body; // a truncated file plays the samples it has
+		}
+
+		if (memcmp(chunk, "fmt ", 4) == 0 && chunkSize >= 16)
 		{
-			fread(type, sizeof(char), 1, fp);
-			if (type[0] == 'a')
+			formatTag = readU16(chunk + 8);
+			channels = readU16(chunk + 10);
+			sampleRate = readU32(chunk + 12);
+			blockAlign = readU16(chunk + 20);
+			bitsPerSample = readU16(chunk + 22);
+			// WAVE_FORMAT_EXTENSIBLE keeps the real format in the first two bytes of its sub format GUID
+			if (formatTag == 0xFFFE && chunkSize >= 40)
 			{
-				fread(type, sizeof(char), 1, fp);
-				if (type[0] == 't')
-				{
-					fread(type, sizeof(char), 1, fp);
-					if (type[0] == 'a')
-					{
-						looking = false;
-					}
-				}
+				formatTag = readU16(chunk + 32);
 			}
+			foundFormat = true;
 		}
-		else
+		else if (memcmp(chunk, "data", 4) == 0 && foundFormat)
 		{
-			fread(type, sizeof(char), 1, fp);
+			info.samples = data + body;
+			info.dataSize = (std::uint32_t)chunkSize;
 		}
-	}
 
-	// Read data
-	fread(&dataSize, sizeof(DWORD), 1, fp);
-	unsigned char *buf = new unsigned char[dataSize];
-	fread(buf, sizeof(BYTE), dataSize, fp);
-
-	// Determine format of the audio file
-	ALuint frequency = sampleRate;
-	ALenum format = 0;
+		// Chunks are padded to an even number of bytes
+		position = body + chunkSize + (chunkSize & 1);
+	}
 
-	if (bitsPerSample == 8)
+	if (!foundFormat || info.samples == nullptr)
 	{
-		if (channels == 1)
-			format = AL_FORMAT_MONO8;
-		else if (channels == 2)
-			format = AL_FORMAT_STEREO8;
+		std::cout << "OpenAL Error: " << file << " has no " << (foundFormat ? "data" : "fmt ") << " chunk" << std::endl;
+		return false;
+	}
+	if (formatTag == 1 && blockAlign == channels * bitsPerSample / 8)
+	{
+		if (bitsPerSample == 8)
+		{
+			if (channels == 1)
+				info.format = AL_FORMAT_MONO8;
+			else if (channels == 2)
+				info.format = AL_FORMAT_STEREO8;
+		}
+		else if (bitsPerSample == 16)
+		{
+			if (channels == 1)
+				info.format = AL_FORMAT_MONO16;
+			else if (channels == 2)
+				info.format = AL_FORMAT_STEREO16;
+		}
 	}
-	else if (bitsPerSample == 16)
+	if (info.format == 0)
 	{
-		if (channels == 1)
-			format = AL_FORMAT_MONO16;
-		else if (channels == 2)
-			format = AL_FORMAT_STEREO16;
+		std::cout << "OpenAL Error: " << file << " is not 8 or 16 bit mono or stereo PCM" << std::endl;
+		return false;
 	}
 
-	// Create the buffer and return it
+	info.frequency = sampleRate;
+	info.frameSize = blockAlign;
+	info.dataSize -= info.dataSize % blockAlign;
+	return true;
+}
+
+// Precondition:	info was parsed from a file that is still mapped
+// Postcondition:	returns a new buffer holding the samples of info
+GLuint createBuffer(const WavInfo &info)
+{
 	GLuint buffer;
 	alGenBuffers(1, &buffer);
-	alBufferData(buffer, format, buf, dataSize, frequency);
-
+	alBufferData(buffer, info.format, info.samples, (ALsizei)info.dataSize, info.frequency);
 	return buffer;
 }
 
+// A buffer shared by the sources playing the same file
+struct CachedBuffer
+{
+	GLuint buffer;
+	int references; // loadAudio calls that haven't been released
+};
+
+// Buffers of the files that are loaded or preloaded, by path
+std::map<std::string, CachedBuffer> &bufferCache()
+{
+	static std::map<std::string, CachedBuffer> buffers;
+	return buffers;
+}
+
+// A .wav file mapped and parsed by a worker, waiting for its buffer to be made on the main thread
+struct MappedWav
+{
+	utility::file::MappedFile file;
+	WavInfo info;
+	bool valid;
+};
+
+// Precondition:	"file" is a .wav audio file
+// Postcondition:	"file" is mapped, parsed and its samples paged in by one of the job system's workers, then put in a
+//					buffer on the main thread that loadAudio returns for it
+void preload(utility::jobs::JobSystem &jobs, const char *file)
+{
+	std::string path(file);
+	if (bufferCache().count(path) != 0)
+	{
+		return;
+	}
+	std::shared_ptr<MappedWav> wav = std::make_shared<MappedWav>();
+	jobs.submit(
+		[wav, path]() {
+			wav->valid = wav->file.open(path.c_str()) && parseWav(path.c_str(), wav->file.data(), wav->file.size(), wav->info);
+			if (wav->valid)
+			{
+				// Touch every page so the main thread's copy into the buffer doesn't wait on the disk
+				volatile unsigned char sum = 0;
+				for (std::uint32_t i = 0; i < wav->info.dataSize; i += 4096)
+				{
+					sum += wav->info.samples[i];
+				}
+			}
+		},
+		[wav, path]() {
+			if (wav->valid && bufferCache().count(path) == 0)
+			{
+				CachedBuffer cached = { createBuffer(wav->info), 0 };
+				bufferCache()[path] = cached;
+			}
+		});
+}
+
+// Precondition:	"file" is a .wav audio file
+// Postcondition:	returns buffer with audio data for "file", or 0 if it can't be read. The buffer is shared with every
+//					other caller for "file" and is kept until each of them has called releaseAudio
+GLuint loadAudio(const char *file)
+{
+	std::map<std::string, CachedBuffer>::iterator cached = bufferCache().find(file);
+	if (cached != bufferCache().end())
+	{
+		cached->second.references++;
+		return cached->second.buffer;
+	}
+
+	utility::file::MappedFile mapped;
+	if (!mapped.open(file))
+	{
+		std::cout << "OpenAL Error: Can't open " << file << std::endl;
+		return 0;
+	}
+	WavInfo info;
+	if (!parseWav(file, mapped.data(), mapped.size(), info))
+	{
+		return 0;
+	}
+	CachedBuffer buffer = { createBuffer(info), 1 };
+	bufferCache()[file] = buffer;
+	return buffer.buffer;
+}
+
+// Precondition:	buffer was returned by loadAudio and no source is playing it
+// Postcondition:	the reference from loadAudio is dropped, the buffer is deleted once nothing references it
+void releaseAudio(GLuint buffer)
+{
+	for (std::map<std::string, CachedBuffer>::iterator it = bufferCache().begin(); it != bufferCache().end(); ++it)
+	{
+		if (it->second.buffer == buffer)
+		{
+			if (--it->second.references <= 0)
+			{
+				alDeleteBuffers(1, &it->second.buffer);
+				bufferCache().erase(it);
+			}
+			return;
+		}
+	}
+}
+
 // Precondition:	cameraPos is the camera's position
 // Postcondition:	listener is set to camera's position
 void setListener(glm::vec3 cameraPos)
@@ -0,0 +1,271 @@
+/* sourcePool.hpp
+ * A fixed pool of OpenAL sources shared by every sound emitter in the scene. Emitters are cheap: they hold a
+ * position, a buffer and a priority, and cost nothing in the mixer while they are virtual. Once a frame update
+ * ranks the playing emitters by how loud they would be at the listener, binds the POOL_SOURCES loudest to real
+ * sources and moves the sources, so the mixer cost is the same however many emitters are playing. A virtual
+ * emitter keeps its place in the sound, so it comes back in time when it gets close enough to be heard.
+ */
+
+#ifndef ASSIGNMENT_SOURCE_POOL_HPP
+#define ASSIGNMENT_SOURCE_POOL_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <vector>
+#include "audio/audio.hpp"
+
+namespace audio
+{
+const int POOL_SOURCES = 16; // real sources, the rest of the device's sources are left for streams
+
+class SourcePool
+{
+public:
+	// Voices playing in the last update
+	struct Stats
+	{
+		int realVoices;	   // playing on a source
+		int virtualVoices; // playing but too quiet to get a source
+	};
+
+	SourcePool() {}
+
+	// Precondition:	None
+	// Postcondition:	Returns a new emitter at position, which is silent until play is called. Emitters with a
+	//					higher priority win a source over louder ones with a lower priority
+	int addEmitter(glm::vec3 position, float priority = 1.0f)
+	{
+		Emitter emitter;
+		emitter.position = position;
+		emitter.priority = priority;
+		int id;
+		if (freeEmitters.empty())
+		{
+			id = (int)emitters.size();
+			emitters.push_back(emitter);
+		}
+		else
+		{
+			id = freeEmitters.back();
+			freeEmitters.pop_back();
+			emitters[id] = emitter;
+		}
+		return id;
+	}
+
+	// Precondition:	emitter was returned by addEmitter
+	// Postcondition:	The emitter stops and its id may be reused
+	void removeEmitter(int emitter)
+	{
+		stop(emitter);
+		freeEmitters.push_back(emitter);
+	}
+
+	// Precondition:	emitter was returned by addEmitter and buffer holds audio. Reference distance is the radius the
+	//					sound is played at full volume at
+	// Postcondition:	The emitter plays buffer from the beginning, on a source if it is loud enough at the next update
+	void play(int emitter, GLuint buffer, bool loop, float referenceDistance, float volume = 1.0f)
+	{
+		stop(emitter);
+		Emitter &e = emitters[emitter];
+		e.buffer = buffer;
+		e.looping = loop;
+		e.referenceDistance = std::max(referenceDistance, 0.0001f);
+		e.volume = volume;
+		e.start = Clock::now();
+		e.playing = buffer != 0;
+
+		// Length of the sound, so a virtual emitter knows where it is up to and when it has finished
+		ALint size = 0, frequency = 0, channels = 0, bits = 0;
+		alGetBufferi(buffer, AL_SIZE, &size);
+		alGetBufferi(buffer, AL_FREQUENCY, &frequency);
+		alGetBufferi(buffer, AL_CHANNELS, &channels);
+		alGetBufferi(buffer, AL_BITS, &bits);
+		int bytesPerSecond = frequency * channels * bits / 8;
+		e.length = bytesPerSecond > 0 ? (float)size / bytesPerSecond : 0.0f;
+	}
+
+	// Precondition:	emitter was returned by addEmitter
+	// Postcondition:	The emitter is silent and gives up its source
+	void stop(int emitter)
+	{
+		Emitter &e = emitters[emitter];
+		if (e.source >= 0)
+		{
+			release(e);
+		}
+		e.playing = false;
+	}
+
+	// Precondition:	emitter was returned by addEmitter
+	// Postcondition:	The emitter is moved to position, its source follows at the next update
+	void setPosition(int emitter, glm::vec3 position)
+	{
+		emitters[emitter].position = position;
+	}
+
+	// Precondition:	Called once a frame on the thread that owns the OpenAL context, listener is the listener's
+	//					position
+	// Postcondition:	The loudest playing emitters are on sources at their positions, finished sounds are stopped
+	void update(glm::vec3 listener)
+	{
+		if (sources.empty())
+		{
+			sources.resize(POOL_SOURCES);
+			alGenSources(POOL_SOURCES, &sources[0]);
+			for (int i = 0; i < POOL_SOURCES; i++)
+			{
+				freeSources.push_back(i);
+			}
+		}
+
+		// Rank the playing emitters, dropping the ones that have finished
+		Clock::time_point now = Clock::now();
+		ranked.clear();
+		for (size_t i = 0; i < emitters.size(); i++)
+		{
+			Emitter &e = emitters[i];
+			if (!e.playing)
+			{
+				continue;
+			}
+			e.elapsed = std::chrono::duration<float>(now - e.start).count();
+			if (!e.looping && e.elapsed >= e.length)
+			{
+				stop((int)i);
+				continue;
+			}
+			ranked.push_back(Ranked(audibility(e, listener), (int)i));
+		}
+		size_t realCount = std::min(ranked.size(), (size_t)POOL_SOURCES);
+		std::nth_element(ranked.begin(), ranked.begin() + realCount, ranked.end(),
+						 [](const Ranked &a, const Ranked &b) { return a.first > b.first; });
+
+		// Emitters that fell out of the loudest give their sources back before the new ones take them
+		for (size_t r = realCount; r < ranked.size(); r++)
+		{
+			Emitter &e = emitters[ranked[r].second];
+			if (e.source >= 0)
+			{
+				release(e);
+			}
+		}
+		for (size_t r = 0; r < realCount; r++)
+		{
+			Emitter &e = emitters[ranked[r].second];
+			if (e.source < 0)
+			{
+				bind(e);
+			}
+			GLuint source = sources[e.source];
+			alSource3f(source, AL_POSITION, e.position.x, e.position.y, e.position.z);
+		}
+
+		stats.realVoices = (int)realCount;
+		stats.virtualVoices = (int)(ranked.size() - realCount);
+	}
+
+	// Precondition:	None
+	// Postcondition:	Returns the number of real and virtual voices in the last update
+	Stats getStats() const
+	{
+		return stats;
+	}
+
+	// Precondition:	None
+	// Postcondition:	Every emitter is stopped and the sources are deleted
+	void cleanup()
+	{
+		for (size_t i = 0; i < emitters.size(); i++)
+		{
+			emitters[i].playing = false;
+			emitters[i].source = -1;
+		}
+		if (!sources.empty())
+		{
+			alSourceStopv(POOL_SOURCES, &sources[0]);
+			alDeleteSources(POOL_SOURCES, &sources[0]);
+		}
+		sources.clear();
+		freeSources.clear();
+	}
+
+private:
+	typedef std::chrono::steady_clock Clock;
+	typedef std::pair<float, int> Ranked; // audibility and emitter
+
+	struct Emitter
+	{
+		glm::vec3 position = glm::vec3(0.0f);
+		float priority = 1.0f;
+		GLuint buffer = 0;
+		bool looping = false;
+		bool playing = false;
+		float referenceDistance = 1.0f;
+		float volume = 1.0f;
+		float length = 0.0f;  // seconds in the buffer
+		float elapsed = 0.0f; // seconds since play, at the last update
+		Clock::time_point start;
+		int source = -1; // index into sources, -1 while virtual
+	};
+
+	std::vector<Emitter> emitters;
+	std::vector<int> freeEmitters;
+	std::vector<GLuint> sources; // created at the first update, once the context exists
+	std::vector<int> freeSources;
+	std::vector<Ranked> ranked;	 // kept between updates so ranking doesn't allocate
+	Stats stats = { 0, 0 };
+
+	// The sources can't be shared, so the pool is not copyable
+	SourcePool(const SourcePool &);
+	SourcePool &operator=(const SourcePool &);
+
+	// Precondition:	None
+	// Postcondition:	Returns the square of how loud e would be at listener with OpenAL's default inverse distance
+	//					clamped model, scaled by its priority. It ranks emitters the same way without a square root
+	static float audibility(const Emitter &e, glm::vec3 listener)
+	{
+		glm::vec3 offset = e.position - listener;
+		float loudness = e.priority * e.volume * e.referenceDistance;
+		float distance2 = std::max(glm::dot(offset, offset), e.referenceDistance * e.referenceDistance);
+		return loudness * loudness / distance2;
+	}
+
+	// Precondition:	e is playing and a source is free
+	// Postcondition:	e plays on a source from where it is up to
+	void bind(Emitter &e)
+	{
+		e.source = freeSources.back();
+		freeSources.pop_back();
+		GLuint source = sources[e.source];
+		alSourcei(source, AL_BUFFER, e.buffer);
+		alSourcei(source, AL_LOOPING, e.looping ? AL_TRUE : AL_FALSE);
+		alSourcef(source, AL_REFERENCE_DISTANCE, e.referenceDistance);
+		alSourcef(source, AL_GAIN, e.volume);
+		alSourcef(source, AL_SEC_OFFSET, e.length > 0.0f ? std::fmod(e.elapsed, e.length) : 0.0f);
+		alSourcePlay(source);
+	}
+
+	// Precondition:	e is on a source
+	// Postcondition:	The source is stopped and free, e is virtual
+	void release(Emitter &e)
+	{
+		GLuint source = sources[e.source];
+		alSourceStop(source);
+		alSourcei(source, AL_BUFFER, 0);
+		freeSources.push_back(e.source);
+		e.source = -1;
+	}
+};
+
+// Precondition:	None
+// Postcondition:	Returns the pool every model's sound plays through
+inline SourcePool &sourcePool()
+{
+	static SourcePool pool;
+	return pool;
+}
+} // namespace audio
+
+#endif
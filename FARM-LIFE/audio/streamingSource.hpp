@@ -0,0 +1,297 @@
+/* streamingSource.hpp
+ * A source for long music and ambience tracks that doesn't hold the whole track in memory. The .wav file's chunks
+ * are found with parseWav, then the file is kept open and its samples are read a chunk at a time into a small ring of buffers queued on the source. A background thread takes the
+ * buffers the source has finished with off the queue, fills them with the next chunk and queues them again, going
+ * back to the start of the samples when the track loops. Each stream holds STREAM_BUFFER_COUNT buffers of
+ * STREAM_BUFFER_BYTES however long the track is.
+ */
+
+#ifndef ASSIGNMENT_STREAMING_SOURCE_HPP
+#define ASSIGNMENT_STREAMING_SOURCE_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "audio/audio.hpp"
+
+namespace audio
+{
+const int STREAM_BUFFER_COUNT = 4;		  // buffers queued on a streaming source
+const ALsizei STREAM_BUFFER_BYTES = 65536; // size of the chunk read into each buffer, about 0.4 s of 44.1 kHz stereo
+const int STREAM_POLL_MS = 50;			  // how often the streaming thread refills the queue
+
+// StreamingSource plays a .wav file from a ring of buffers that a background thread keeps filled
+class StreamingSource
+{
+public:
+	// Precondition:	"file" is a .wav audio file
+	// Postcondition:	The source and its buffers are created and the streaming thread is started, nothing plays
+	//					until play is called
+	StreamingSource(const char *file)
+	{
+		alGenSources(1, &sourceid);
+		alSourcef(sourceid, AL_GAIN, 1);
+		alSourcef(sourceid, AL_PITCH, 1);
+		alSource3f(sourceid, AL_POSITION, 0, 0, 0);
+		alGenBuffers(STREAM_BUFFER_COUNT, buffers);
+
+		// The mapping is only used to find the samples, reading them through fp keeps just one chunk resident
+		info = WavInfo();
+		fp = NULL;
+		dataOffset = 0;
+		utility::file::MappedFile mapped;
+		if (!mapped.open(file))
+		{
+			std::cout << "OpenAL Error: Can't open " << file << std::endl;
+		}
+		else if (parseWav(file, mapped.data(), mapped.size(), info))
+		{
+			dataOffset = (long)(info.samples - mapped.data());
+			info.samples = nullptr;
+			fp = fopen(file, "rb");
+		}
+		if (fp == NULL)
+		{
+			info.dataSize = 0;
+		}
+
+		// Read whole frames so a chunk never ends part way through a sample
+		ALsizei frameSize = std::max(info.frameSize, (ALsizei)1);
+		chunk.resize(STREAM_BUFFER_BYTES - STREAM_BUFFER_BYTES % frameSize);
+		remaining = 0;
+		looping = false;
+		playing = false;
+		stopping = false;
+		std::cout << "Streaming " << file << ": " << residentBytes() / 1024 << " KB buffered of "
+				  << info.dataSize / 1024 << " KB" << std::endl;
+
+		worker = std::thread(&StreamingSource::stream, this);
+	}
+
+	// Destructor, cleans up if cleanup hasn't been called
+	~StreamingSource()
+	{
+		cleanup();
+	}
+
+	// Precondition:	None
+	// Postcondition:	The streaming thread is stopped, the source and buffers are deleted and the file is closed
+	void cleanup()
+	{
+		if (!worker.joinable())
+		{
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		condition.notify_one();
+		worker.join();
+
+		alSourceStop(sourceid);
+		alSourcei(sourceid, AL_BUFFER, 0);
+		alDeleteSources(1, &sourceid);
+		alDeleteBuffers(STREAM_BUFFER_COUNT, buffers);
+		if (fp != NULL)
+		{
+			fclose(fp);
+			fp = NULL;
+		}
+	}
+
+	// Precondition:	None
+	// Postcondition:	Plays the track from the beginning
+	void play()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		alSourceStop(sourceid);
+		alSourcei(sourceid, AL_BUFFER, 0);
+		rewind();
+
+		// Fill the whole ring before starting so the source has time in hand
+		int queued = 0;
+		while (queued < STREAM_BUFFER_COUNT && fill(buffers[queued]))
+		{
+			queued++;
+		}
+		if (queued == 0)
+		{
+			return;
+		}
+		alSourceQueueBuffers(sourceid, queued, buffers);
+		alSourcePlay(sourceid);
+		playing = true;
+	}
+
+	// Sets the volume of the sound to volume
+	void setVolume(float volume)
+	{
+		alSourcef(sourceid, AL_GAIN, volume);
+	}
+
+	// Sets the source position
+	void setPosition(glm::vec3 position)
+	{
+		alSource3f(sourceid, AL_POSITION, position.x, position.y, position.z);
+	}
+
+	// Sets whether to loop the sound or not
+	// The source itself never loops, the streaming thread goes back to the start of the file instead
+	void setLooping(bool loop)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		looping = loop;
+	}
+
+	// Returns whether or not the sound is playing
+	bool isPlaying()
+	{
+		int isPlaying;
+		alGetSourcei(sourceid, AL_SOURCE_STATE, &isPlaying);
+		return isPlaying == AL_PLAYING;
+	}
+
+	// Sets the radius where the sound will be played at full volume at
+	void setReferenceDistance(float distance)
+	{
+		alSourcef(sourceid, AL_REFERENCE_DISTANCE, distance);
+	}
+
+	// Pauses the sound, if continued it will play from where it was when paused
+	void pause()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		alSourcePause(sourceid);
+	}
+
+	// Continues playing the sound after being paused
+	void continuePlaying()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (playing)
+		{
+			alSourcePlay(sourceid);
+		}
+	}
+
+	// Stops the sound. Will play from the beginning if played again.
+	void stop()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		playing = false;
+		alSourceStop(sourceid);
+	}
+
+	// Precondition:	None
+	// Postcondition:	Returns the bytes of samples the stream holds at once, in its buffers and its chunk
+	size_t residentBytes() const
+	{
+		return (STREAM_BUFFER_COUNT + 1) * chunk.size();
+	}
+
+private:
+	GLuint sourceid;					// id of the source
+	GLuint buffers[STREAM_BUFFER_COUNT]; // ring of buffers queued on the source
+	std::thread worker;
+
+	// Shared with the streaming thread, guarded by mutex
+	std::mutex mutex;
+	std::condition_variable condition;	// signalled when the source is destroyed
+	FILE *fp;							// the open .wav file, at the next chunk to play
+	WavInfo info;
+	long dataOffset;					// where the samples start in the file
+	std::uint32_t remaining;			// bytes of samples left after the file position
+	std::vector<unsigned char> chunk;	// samples on their way from the file to a buffer
+	bool looping;
+	bool playing;						// play was called and stop hasn't been since
+	bool stopping;
+
+	// The source and the streaming thread can't be shared, so a StreamingSource is not copyable
+	StreamingSource(const StreamingSource &);
+	StreamingSource &operator=(const StreamingSource &);
+
+	// Precondition:	mutex is held
+	// Postcondition:	The next chunk to read is the start of the samples
+	void rewind()
+	{
+		if (fp == NULL)
+		{
+			return;
+		}
+		fseek(fp, dataOffset, SEEK_SET);
+		remaining = info.dataSize;
+	}
+
+	// Precondition:	mutex is held and buffer isn't queued on the source
+	// Postcondition:	buffer holds the next chunk of the track, going back to the start if it is looping. Returns
+	//					false if the track has ended
+	bool fill(GLuint buffer)
+	{
+		if (remaining == 0 && looping)
+		{
+			rewind();
+		}
+		if (fp == NULL || remaining == 0)
+		{
+			return false;
+		}
+		size_t bytes = fread(chunk.data(), 1, std::min((size_t)remaining, chunk.size()), fp);
+		if (bytes == 0)
+		{
+			remaining = 0; // the file is shorter than its header says
+			return false;
+		}
+		remaining -= (std::uint32_t)bytes;
+		alBufferData(buffer, info.format, chunk.data(), (ALsizei)bytes, info.frequency);
+		return true;
+	}
+
+	// Streaming thread, refills the buffers the source has played until the source is destroyed
+	void stream()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		while (!stopping)
+		{
+			if (playing)
+			{
+				// Refill the buffers that have been played and put them back on the end of the queue
+				ALint processed = 0;
+				alGetSourcei(sourceid, AL_BUFFERS_PROCESSED, &processed);
+				while (processed-- > 0)
+				{
+					ALuint buffer;
+					alSourceUnqueueBuffers(sourceid, 1, &buffer);
+					if (fill(buffer))
+					{
+						alSourceQueueBuffers(sourceid, 1, &buffer);
+					}
+				}
+
+				// The source stops if it plays every queued buffer before they are refilled, start it again, or
+				// finish once the track has ended and the queue is empty
+				ALint state, queued;
+				alGetSourcei(sourceid, AL_SOURCE_STATE, &state);
+				alGetSourcei(sourceid, AL_BUFFERS_QUEUED, &queued);
+				if (state == AL_STOPPED)
+				{
+					if (queued > 0)
+					{
+						alSourcePlay(sourceid);
+					}
+					else
+					{
+						playing = false;
+					}
+				}
+			}
+			condition.wait_for(lock, std::chrono::milliseconds(STREAM_POLL_MS));
+		}
+	}
+};
+} // namespace audio
+
+#endif
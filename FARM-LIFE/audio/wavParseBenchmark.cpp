@@ -0,0 +1,262 @@
+/* wavParseBenchmark.cpp
+ * Benchmark of reading .wav files. It writes files like the game's sounds to the working directory and loads each
+ * the way readWav used to (fread the header, scan byte by byte for "data", fread the samples) and the way loadAudio
+ * does now (map the file, walk its RIFF chunks with parseWav, copy the samples once like alBufferData), then times
+ * parseWav on its own. parseWav is also checked on the files the old reader got wrong: a LIST chunk holding the word
+ * "data" before the samples, and a streamed file whose sizes were never filled in.
+ */
+
+#include "util/benchmarkPrelude.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include "audio/audio.hpp"
+
+namespace
+{
+	const int RUNS = 7;
+	const int PARSES = 100000;
+
+	// A .wav file to write and the samples parseWav should find in it
+	struct TestFile
+	{
+		std::string path;
+		std::vector<unsigned char> bytes;
+		size_t dataOffset;
+		std::uint32_t dataSize;
+		bool timed; // the old reader can read it
+	};
+
+	// Precondition:	bytes has at least 4 bytes from offset
+	// Postcondition:	the little endian 32 bit value is written at offset
+	void writeU32(std::vector<unsigned char> &bytes, size_t offset, std::uint32_t value)
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			bytes[offset + i] = (unsigned char)(value >> (8 * i));
+		}
+	}
+
+	// Precondition:	None
+	// Postcondition:	returns a PCM .wav file of seconds of noise. extensible writes a 40 byte fmt chunk, extra is put
+	//					between the fmt and data chunks, and streamed leaves the RIFF and data sizes at 0xFFFFFFFF
+	TestFile makeWav(const std::string &path, int channels, int bits, std::uint32_t rate, float seconds, bool extensible,
+					 const std::vector<unsigned char> &extra, bool streamed, std::mt19937 &random)
+	{
+		const std::uint16_t blockAlign = (std::uint16_t)(channels * bits / 8);
+		const std::uint32_t dataSize = (std::uint32_t)(rate * seconds) * blockAlign;
+		const unsigned char header[] = { 'R', 'I', 'F', 'F', 0, 0, 0, 0, 'W', 'A', 'V', 'E', 'f', 'm', 't', ' ' };
+		TestFile wav;
+		wav.path = path;
+		wav.bytes.assign(header, header + sizeof(header));
+
+		std::vector<unsigned char> format(extensible ? 40 : 16, 0);
+		format[0] = extensible ? 0xFE : 1;
+		format[1] = extensible ? 0xFF : 0;
+		format[2] = (unsigned char)channels;
+		writeU32(format, 4, rate);
+		writeU32(format, 8, rate * blockAlign);
+		format[12] = (unsigned char)blockAlign;
+		format[14] = (unsigned char)bits;
+		if (extensible)
+		{
+			format[16] = 22; // size of the extension
+			format[18] = (unsigned char)bits;
+			format[24] = 1;	 // KSDATAFORMAT_SUBTYPE_PCM
+		}
+		wav.bytes.resize(wav.bytes.size() + 4);
+		writeU32(wav.bytes, wav.bytes.size() - 4, (std::uint32_t)format.size());
+		wav.bytes.insert(wav.bytes.end(), format.begin(), format.end());
+		wav.bytes.insert(wav.bytes.end(), extra.begin(), extra.end());
+
+		const unsigned char dataHeader[] = { 'd', 'a', 't', 'a', 0, 0, 0, 0 };
+		wav.bytes.insert(wav.bytes.end(), dataHeader, dataHeader + sizeof(dataHeader));
+		writeU32(wav.bytes, wav.bytes.size() - 4, streamed ? 0xFFFFFFFF : dataSize);
+		wav.dataOffset = wav.bytes.size();
+		wav.dataSize = dataSize;
+		wav.bytes.resize(wav.bytes.size() + dataSize);
+		for (size_t i = wav.dataOffset; i < wav.bytes.size(); i++)
+		{
+			wav.bytes[i] = (unsigned char)random();
+		}
+		writeU32(wav.bytes, 4, streamed ? 0xFFFFFFFF : (std::uint32_t)(wav.bytes.size() - 8));
+		wav.timed = extra.empty() && !streamed;
+		return wav;
+	}
+
+	// Precondition:	"file" is a .wav audio file
+	// Postcondition:	samples holds the samples of "file" read the way readWav did before parseWav, returns false if
+	//					there was no "data" in it
+	bool oldReadWav(const char *file, std::vector<unsigned char> &samples)
+	{
+		FILE *fp = fopen(file, "rb");
+		if (fp == NULL)
+		{
+			return false;
+		}
+		char type[4];
+		std::uint32_t size, chunkSize, sampleRate, avgBytesPerSec, dataSize;
+		short formatType, channels, bytesPerSample, bitsPerSample;
+		fread(type, sizeof(char), 4, fp);
+		fread(&size, sizeof(std::uint32_t), 1, fp);
+		fread(type, sizeof(char), 4, fp);
+		fread(type, sizeof(char), 4, fp);
+		fread(&chunkSize, sizeof(std::uint32_t), 1, fp);
+		fread(&formatType, sizeof(short), 1, fp);
+		fread(&channels, sizeof(short), 1, fp);
+		fread(&sampleRate, sizeof(std::uint32_t), 1, fp);
+		fread(&avgBytesPerSec, sizeof(std::uint32_t), 1, fp);
+		fread(&bytesPerSample, sizeof(short), 1, fp);
+		fread(&bitsPerSample, sizeof(short), 1, fp);
+
+		// Find the data header a byte at a time
+		bool looking = true;
+		fread(type, sizeof(char), 1, fp);
+		while (looking && !feof(fp))
+		{
+			if (type[0] == 'd')
+			{
+				fread(type, sizeof(char), 1, fp);
+				if (type[0] == 'a')
+				{
+					fread(type, sizeof(char), 1, fp);
+					if (type[0] == 't')
+					{
+						fread(type, sizeof(char), 1, fp);
+						if (type[0] == 'a')
+						{
+							looking = false;
+						}
+					}
+				}
+			}
+			else
+			{
+				fread(type, sizeof(char), 1, fp);
+			}
+		}
+		if (!looking)
+		{
+			fread(&dataSize, sizeof(std::uint32_t), 1, fp);
+			samples.resize(dataSize);
+			samples.resize(fread(samples.data(), 1, dataSize, fp));
+		}
+		fclose(fp);
+		return !looking;
+	}
+
+	// Returns the best time of load over every timed file in milliseconds, or a negative time if one failed
+	template <typename Load>
+	double timeLoads(const std::vector<TestFile> &files, Load load)
+	{
+		double best = 1e30;
+		for (int run = 0; run < RUNS; run++)
+		{
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			for (const TestFile &file : files)
+			{
+				if (file.timed && !load(file))
+				{
+					return -1.0;
+				}
+			}
+			std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+			best = std::min(best, elapsed.count());
+		}
+		return best;
+	}
+}
+
+int main()
+{
+	std::mt19937 random(1);
+	std::vector<unsigned char> none;
+	const unsigned char listChunk[] = { 'L', 'I', 'S', 'T', 26, 0, 0, 0, 'I', 'N', 'F', 'O', 'I', 'S', 'F', 'T', 14, 0, 0, 0,
+										'L', 'a', 'v', 'f', ' ', 'd', 'a', 't', 'a', ' ', '5', '8', '.', 0 };
+	std::vector<unsigned char> list(listChunk, listChunk + sizeof(listChunk));
+	std::vector<TestFile> files;
+	for (int i = 0; i < 8; i++)
+	{
+		files.push_back(makeWav("wavParseBenchmark-clip" + std::to_string(i) + ".wav", 1, 16, 22050, 1.5f, false, none, false, random));
+	}
+	files.push_back(makeWav("wavParseBenchmark-music.wav", 2, 16, 44100, 60.0f, false, none, false, random));
+	files.push_back(makeWav("wavParseBenchmark-extensible.wav", 2, 16, 44100, 2.0f, true, none, false, random));
+	files.push_back(makeWav("wavParseBenchmark-list.wav", 2, 16, 44100, 2.0f, false, list, false, random));
+	files.push_back(makeWav("wavParseBenchmark-streamed.wav", 1, 8, 11025, 2.0f, false, none, true, random));
+
+	size_t timedBytes = 0;
+	std::uint32_t largest = 0;
+	for (const TestFile &file : files)
+	{
+		std::ofstream out(file.path.c_str(), std::ios::binary | std::ios::trunc);
+		out.write((const char *)file.bytes.data(), file.bytes.size());
+		timedBytes += file.timed ? file.bytes.size() : 0;
+		largest = std::max(largest, file.dataSize);
+	}
+
+	// parseWav must find the samples of every file
+	bool correct = true;
+	for (const TestFile &file : files)
+	{
+		audio::WavInfo info;
+		if (!audio::parseWav(file.path.c_str(), file.bytes.data(), file.bytes.size(), info) ||
+			info.samples != file.bytes.data() + file.dataOffset || info.dataSize != file.dataSize)
+		{
+			std::printf("parseWav got %s wrong\n", file.path.c_str());
+			correct = false;
+		}
+	}
+
+	// Copy the samples where the buffer would be made so they are really read
+	std::vector<unsigned char> buffer(largest);
+	double before = timeLoads(files, [&buffer](const TestFile &file) {
+		std::vector<unsigned char> samples;
+		if (!oldReadWav(file.path.c_str(), samples))
+		{
+			return false;
+		}
+		memcpy(buffer.data(), samples.data(), samples.size());
+		return true;
+	});
+	double after = timeLoads(files, [&buffer](const TestFile &file) {
+		utility::file::MappedFile mapped;
+		audio::WavInfo info;
+		if (!mapped.open(file.path.c_str()) || !audio::parseWav(file.path.c_str(), mapped.data(), mapped.size(), info))
+		{
+			return false;
+		}
+		memcpy(buffer.data(), info.samples, info.dataSize);
+		return true;
+	});
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	volatile std::uint32_t checksum = 0;
+	for (int i = 0; i < PARSES; i++)
+	{
+		const TestFile &file = files[i % files.size()];
+		audio::WavInfo info;
+		audio::parseWav(file.path.c_str(), file.bytes.data(), file.bytes.size(), info);
+		checksum = checksum + info.dataSize;
+	}
+	std::chrono::duration<double, std::nano> parse = std::chrono::steady_clock::now() - start;
+
+	for (const TestFile &file : files)
+	{
+		std::remove(file.path.c_str());
+	}
+	if (before < 0.0 || after < 0.0)
+	{
+		std::printf("a file failed to load\n");
+		return 1;
+	}
+	std::printf("fread and scan:      %7.2f ms for %.1f MB (%.2f GB/s)\n", before, timedBytes / 1e6, timedBytes / before / 1e6);
+	std::printf("map and parseWav:    %7.2f ms for %.1f MB (%.2f GB/s)\n", after, timedBytes / 1e6, timedBytes / after / 1e6);
+	std::printf("parseWav in memory:  %7.1f ns per file\n", parse.count() / PARSES);
+	return correct ? 0 : 1;
+}
@@ -10,103 +10,261 @@
 
 namespace lights
 {
+	// Number of point lights, must match NR_POINT_LIGHTS in the shaders
+	const int NR_POINT_LIGHTS = 4;
 
-	class light
+	// Uniform buffer binding point of the Lights block, shared by every shader that is lit
+	const GLuint LIGHTS_BINDING = 0;
+
+	// Directional (sun) light parameters, these depend only on the time of day
+	struct DirectionalLight
 	{
-	public:
-		light(GLuint shader)
-		{
-			this->shader = shader;
-		};
+		glm::vec3 direction;
+		glm::vec3 ambient;
+		glm::vec3 diffuse;
+		glm::vec3 specular;
+	};
+
+	// Point light parameters
+	struct PointLight
+	{
+		glm::vec3 position;
+		float constant;
+		float linear;
+		float quadratic;
+		glm::vec3 ambient;
+		glm::vec3 diffuse;
+		glm::vec3 specular;
+	};
+
+	// Spot light (torch) parameters, it follows the camera so the position and direction are set for each render pass
+	struct SpotLight
+	{
+		float cutOff;
+		float outerCutOff;
+		float constant;
+		float linear;
+		float quadratic;
+		glm::vec3 ambient;
+		glm::vec3 diffuse;
+		glm::vec3 specular;
+	};
 
-		GLuint setup(glm::vec3 CamPos, glm::vec3 Forward)
+	// The set of lights that are shared by every draw in a frame
+	struct LightSet
+	{
+		DirectionalLight dirLight;
+		PointLight pointLights[NR_POINT_LIGHTS];
+		SpotLight spotLight;
+	};
+
+	///<summary>
+	/// Calculate the lights for the current frame, time is the program time in seconds (glfwGetTime).
+	/// This only needs to happen once per frame, the result is shared by every render pass.
+	///</summary>
+	inline LightSet computeLightSet(double programTime)
+	{
+		LightSet lightSet;
+
+		// directional light, the sun does a full loop every 240 seconds
+		glm::vec3 lightDirection(0.0f, 0.0f, 0.1f);
+		float time = -programTime / 240;
+		time = (time - floor(time)) * 2 * M_PI;
+		lightDirection.x = cos(time);
+		lightDirection.y = sin(time);
+		float diffuse = (1 - (lightDirection.y / 0.05f)) * 0.6f;
+		float specular = (1 - (lightDirection.y / 0.05f)) * 0.2f;
+		float ambient = (1 - (lightDirection.y / 0.05f)) * 0.05f;
+
+		lightSet.dirLight.direction = lightDirection;
+
+		if (lightDirection.y > 0.05) {
+			lightSet.dirLight.ambient = glm::vec3(0.005f);
+			lightSet.dirLight.diffuse = glm::vec3(0.0f);
+			lightSet.dirLight.specular = glm::vec3(0.01f);
+		}
+		else if (lightDirection.y < 0.05 && lightDirection.y > 0) {
+			lightSet.dirLight.ambient = glm::vec3(ambient);
+			lightSet.dirLight.diffuse = glm::vec3(diffuse);
+			lightSet.dirLight.specular = glm::vec3(specular);
+		}
+		else {
+			lightSet.dirLight.ambient = glm::vec3(0.05f);
+			lightSet.dirLight.diffuse = glm::vec3(0.6f);
+			lightSet.dirLight.specular = glm::vec3(0.2f);
+		}
+
+		// point lights, one on each street light
+		const glm::vec3 pointLightPositions[NR_POINT_LIGHTS] = {
+			glm::vec3(1.0f, -9.83f, 2.0f),
+			glm::vec3(50.0f, 3.57f, 80.0f),
+			glm::vec3(70.0f, 1.9f, 145.0f),
+			glm::vec3(10.0f, 0.63f, 50.0f)
+		};
+		for (int i = 0; i < NR_POINT_LIGHTS; i++)
 		{
+			PointLight& pointLight = lightSet.pointLights[i];
+			pointLight.position = pointLightPositions[i];
+			pointLight.ambient = glm::vec3(0.1f);
+			pointLight.diffuse = glm::vec3(0.8f);
+			pointLight.specular = glm::vec3(1.0f);
+			pointLight.constant = 1.0f;
+			pointLight.linear = 0.09f;
+			pointLight.quadratic = 0.032f;
+		}
+
+		// spotLight If we want one?
+		lightSet.spotLight.ambient = glm::vec3(0.0f);
+		lightSet.spotLight.diffuse = glm::vec3(1.0f);
+		lightSet.spotLight.specular = glm::vec3(0.0f);
+		lightSet.spotLight.constant = 1.0f;
+		lightSet.spotLight.linear = 0.09f;
+		lightSet.spotLight.quadratic = 0.032f;
+		lightSet.spotLight.cutOff = glm::cos(glm::radians(12.5f));
+		lightSet.spotLight.outerCutOff = glm::cos(glm::radians(15.0f));
 
-			/*
-			Here we set all the uniforms for the 6 lights we have. We have to set them manually
-			*/
+		return lightSet;
+	}
+
+	///<summary>
+	/// Uniform buffer holding the lights for a render pass, laid out to match the std140 Lights block
+	/// declared in the model, terrain, grass and water fragment shaders:
+	///
+	///		layout (std140) uniform Lights {
+	///			vec3 viewPos;
+	///			DirLight dirLight;
+	///			PointLight pointLights[NR_POINT_LIGHTS];
+	///			SpotLight spotLight;
+	///		};
+	///
+	/// The buffer is written once per pass and read by every lit draw, so the cost of setting up the
+	/// lights doesn't depend on how many meshes are drawn.
+	///</summary>
+	class LightBuffer
+	{
+	public:
+		// Precondition:	An OpenGL context exists
+		// Postcondition:	The uniform buffer is created and bound to LIGHTS_BINDING
+		LightBuffer()
+		{
+			glGenBuffers(1, &ubo);
+			glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+			glBufferData(GL_UNIFORM_BUFFER, sizeof(Std140Lights), NULL, GL_DYNAMIC_DRAW);
+			glBindBuffer(GL_UNIFORM_BUFFER, 0);
+			glBindBufferBase(GL_UNIFORM_BUFFER, LIGHTS_BINDING, ubo);
+		}
 
-			glUniform3f(glGetUniformLocation(shader, "viewPos"), CamPos.x, CamPos.y, CamPos.z);
+		// Precondition:	shader is a linked shader program
+		// Postcondition:	The shader's Lights block (if it has one) reads from LIGHTS_BINDING
+		static void bindShader(GLuint shader)
+		{
+			GLuint blockIndex = glGetUniformBlockIndex(shader, "Lights");
+			if (blockIndex != GL_INVALID_INDEX)
+			{
+				glUniformBlockBinding(shader, blockIndex, LIGHTS_BINDING);
+			}
+		}
 
+		// Precondition:	lightSet has been computed for this frame, CamPos and Forward are the camera of the render pass
+		// Postcondition:	The uniform buffer holds the lights for the render pass
+		void update(const LightSet& lightSet, glm::vec3 CamPos, glm::vec3 Forward)
+		{
+			Std140Lights lights;
+			lights.viewPos = CamPos;
 
 			// directional light
+			lights.dirLight.direction = lightSet.dirLight.direction;
+			lights.dirLight.ambient = lightSet.dirLight.ambient;
+			lights.dirLight.diffuse = lightSet.dirLight.diffuse;
+			lights.dirLight.specular = lightSet.dirLight.specular;
 
-			glm::vec3 lightDirection(0.0f, 0.0f, 0.1f);
-			float time = -glfwGetTime() / 240;
-			time = (time - floor(time)) * 2 * M_PI;
-			lightDirection.x = cos(time);
-			lightDirection.y = sin(time);
-			float diffuse = (1 - (lightDirection.y / 0.05f)) * 0.6f;
-			float specular = (1 - (lightDirection.y / 0.05f)) * 0.2f;
-			float ambient = (1 - (lightDirection.y / 0.05f)) * 0.05f;
-
-			glUniform3f(glGetUniformLocation(shader, "dirLight.direction"), lightDirection.x, lightDirection.y, lightDirection.z);
-
-			if (lightDirection.y > 0.05) {
-				glUniform3f(glGetUniformLocation(shader, "dirLight.ambient"), 0.005f, 0.005f, 0.005f);
-				glUniform3f(glGetUniformLocation(shader, "dirLight.diffuse"), 0.0f, 0.0f, 0.0f);
-				glUniform3f(glGetUniformLocation(shader, "dirLight.specular"), 0.01f, 0.01f, 0.01f);
-			}
-			else if (lightDirection.y < 0.05 && lightDirection.y>0) {
-				//std::cout << " " << diffuse << " ";
-				glUniform3f(glGetUniformLocation(shader, "dirLight.ambient"), ambient, ambient, ambient);
-				glUniform3f(glGetUniformLocation(shader, "dirLight.diffuse"), diffuse, diffuse, diffuse);
-				glUniform3f(glGetUniformLocation(shader, "dirLight.specular"), specular, specular, specular);
-			}
-			else if (lightDirection.y < 0) {
-				glUniform3f(glGetUniformLocation(shader, "dirLight.ambient"), 0.05f, 0.05f, 0.05f);
-				glUniform3f(glGetUniformLocation(shader, "dirLight.diffuse"), 0.6f, 0.6f, 0.6f);
-				glUniform3f(glGetUniformLocation(shader, "dirLight.specular"), 0.2f, 0.2f, 0.2f);
+			// point lights
+			for (int i = 0; i < NR_POINT_LIGHTS; i++)
+			{
+				const PointLight& pointLight = lightSet.pointLights[i];
+				lights.pointLights[i].position = pointLight.position;
+				lights.pointLights[i].constant = pointLight.constant;
+				lights.pointLights[i].linear = pointLight.linear;
+				lights.pointLights[i].quadratic = pointLight.quadratic;
+				lights.pointLights[i].ambient = pointLight.ambient;
+				lights.pointLights[i].diffuse = pointLight.diffuse;
+				lights.pointLights[i].specular = pointLight.specular;
 			}
 
+			// spot light on the camera
+			const SpotLight& spotLight = lightSet.spotLight;
+			lights.spotLight.position = CamPos;
+			lights.spotLight.direction = Forward;
+			lights.spotLight.cutOff = spotLight.cutOff;
+			lights.spotLight.outerCutOff = spotLight.outerCutOff;
+			lights.spotLight.constant = spotLight.constant;
+			lights.spotLight.linear = spotLight.linear;
+			lights.spotLight.quadratic = spotLight.quadratic;
+			lights.spotLight.ambient = spotLight.ambient;
+			lights.spotLight.diffuse = spotLight.diffuse;
+			lights.spotLight.specular = spotLight.specular;
 
-			// point light 1
-			glUniform3f(glGetUniformLocation(shader, "pointLights[0].position"), 1.0f, -9.83f, 2.0f);
-			glUniform3f(glGetUniformLocation(shader, "pointLights[0].ambient"), 0.1f, 0.1f, 0.1f);
-			glUniform3f(glGetUniformLocation(shader, "pointLights[0].diffuse"), 0.8f, 0.8f, 0.8f);
-			glUniform3f(glGetUniformLocation(shader, "pointLights[0].specular"), 1.0f, 1.0f, 1.0f);
-			glUniform1f(glGetUniformLocation(shader, "pointLights[0].constant"), 1.0f);
-			glUniform1f(glGetUniformLocation(shader, "pointLights[0].linear"), 0.09);
-			glUniform1f(glGetUniformLocation(shader, "pointLights[0].quadratic"), 0.032);
-			// point light 2
-			glUniform3f(glGetUniformLocation(shader, "pointLights[1].position"), 50.0f, 3.57f, 80.0f);
-			glUniform3f(glGetUniformLocation(shader, "pointLights[1].ambient"), 0.1f, 0.1f, 0.1f);
-			glUniform3f(glGetUniformLocation(shader, "pointLights[1].diffuse"), 0.8f, 0.8f, 0.8f);
-			glUniform3f(glGetUniformLocation(shader, "pointLights[1].specular"), 1.0f, 1.0f, 1.0f);
-			glUniform1f(glGetUniformLocation(shader, "pointLights[1].constant"), 1.0f);
-			glUniform1f(glGetUniformLocation(shader, "pointLights[1].linear"), 0.09);
-			glUniform1f(glGetUniformLocation(shader, "pointLights[1].quadratic"), 0.032);
-
-			// point light 3
-			glUniform3f(glGetUniformLocation(shader, "pointLights[2].position"), 70.0f, 1.9f, 145.0f);
-			glUniform3f(glGetUniformLocation(shader, "pointLights[2].ambient"), 0.1f, 0.1f, 0.1f);
-			glUniform3f(glGetUniformLocation(shader, "pointLights[2].diffuse"), 0.8f, 0.8f, 0.8f);
-			glUniform3f(glGetUniformLocation(shader, "pointLights[2].specular"), 1.0f, 1.0f, 1.0f);
-			glUniform1f(glGetUniformLocation(shader, "pointLights[2].constant"), 1.0f);
-			glUniform1f(glGetUniformLocation(shader, "pointLights[2].linear"), 0.09);
-			glUniform1f(glGetUniformLocation(shader, "pointLights[2].quadratic"), 0.032);
-			// point light 4
-			glUniform3f(glGetUniformLocation(shader, "pointLights[3].position"), 10.0f, 0.63f, 50.0f);
-			glUniform3f(glGetUniformLocation(shader, "pointLights[3].ambient"), 0.1f, 0.1f, 0.1f);
-			glUniform3f(glGetUniformLocation(shader, "pointLights[3].diffuse"), 0.8f, 0.8f, 0.8f);
-			glUniform3f(glGetUniformLocation(shader, "pointLights[3].specular"), 1.0f, 1.0f, 1.0f);
-			glUniform1f(glGetUniformLocation(shader, "pointLights[3].constant"), 1.0f);
-			glUniform1f(glGetUniformLocation(shader, "pointLights[3].linear"), 0.09);
-			glUniform1f(glGetUniformLocation(shader, "pointLights[3].quadratic"), 0.032);
-			// spotLight If we want one?
-			glUniform3f(glGetUniformLocation(shader, "spotLight.position"), CamPos.x, CamPos.y, CamPos.z);
-			glUniform3f(glGetUniformLocation(shader, "spotLight.direction"), Forward.x, Forward.y, Forward.z);
-			glUniform3f(glGetUniformLocation(shader, "spotLight.diffuse"), 1.0f, 1.0f, 1.0f);
-			glUniform1f(glGetUniformLocation(shader, "spotLight.constant"), 1.0f);
-			glUniform1f(glGetUniformLocation(shader, "spotLight.linear"), 0.09);
-			glUniform1f(glGetUniformLocation(shader, "spotLight.quadratic"), 0.032);
-			glUniform1f(glGetUniformLocation(shader, "spotLight.cutOff"), glm::cos(glm::radians(12.5f)));
-			glUniform1f(glGetUniformLocation(shader, "spotLight.outerCutOff"), glm::cos(glm::radians(15.0f)));
-			return shader;
-		};
+			glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+			glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Std140Lights), &lights);
+			glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		}
+
+		// Precondition:	The uniform buffer exists
+		// Postcondition:	The uniform buffer is deleted
+		void cleanup()
+		{
+			glDeleteBuffers(1, &ubo);
+		}
 
 	private:
-		GLuint shader;
+		GLuint ubo;		// uniform buffer object
+
+		// std140 rules: vec3 and structs are aligned to 16 bytes, a float may fill the space after a vec3
+		struct Std140DirLight
+		{
+			glm::vec3 direction;	float pad0;
+			glm::vec3 ambient;		float pad1;
+			glm::vec3 diffuse;		float pad2;
+			glm::vec3 specular;		float pad3;
+		};
+
+		struct Std140PointLight
+		{
+			glm::vec3 position;
+			float constant;
+			float linear;
+			float quadratic;		float pad0[2];
+			glm::vec3 ambient;		float pad1;
+			glm::vec3 diffuse;		float pad2;
+			glm::vec3 specular;		float pad3;
+		};
+
+		struct Std140SpotLight
+		{
+			glm::vec3 position;		float pad0;
+			glm::vec3 direction;
+			float cutOff;
+			float outerCutOff;
+			float constant;
+			float linear;
+			float quadratic;
+			glm::vec3 ambient;		float pad1;
+			glm::vec3 diffuse;		float pad2;
+			glm::vec3 specular;		float pad3;
+		};
+
+		struct Std140Lights
+		{
+			glm::vec3 viewPos;		float pad0;
+			Std140DirLight dirLight;
+			Std140PointLight pointLights[NR_POINT_LIGHTS];
+			Std140SpotLight spotLight;
+		};
+
+		static_assert(sizeof(Std140DirLight) == 64, "DirLight must match the std140 layout");
+		static_assert(sizeof(Std140PointLight) == 80, "PointLight must match the std140 layout");
+		static_assert(sizeof(Std140SpotLight) == 96, "SpotLight must match the std140 layout");
+		static_assert(sizeof(Std140Lights) == 496, "Lights must match the std140 layout");
 	};
 
 } // namespace lights
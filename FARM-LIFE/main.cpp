@@ -27,15 +27,23 @@
 // Include project files
 #include "util/mainUtil.hpp"
 #include "util/camera.hpp"
+#include "util/frame.hpp"
+#include "util/allocationCounter.hpp"
+#include "util/jobSystem.hpp"
 #include "lights/lights.hpp"
 #include "audio/audio.hpp"
+#include "audio/sourcePool.hpp"
+#include "audio/streamingSource.hpp"
 #include "terrain/terrain.hpp"
 #include "models/model.hpp"
+#include "models/hitBoxGrid.hpp"
+#include "models/modelBatch.hpp"
 #include "models/paddock/paddock.hpp"
 #include "skybox/skybox.hpp"
 #include "water/water.hpp"
 #include "water/WaterFrameBuffers.hpp"
 #include "trees/tree.hpp"
+#include "util/scene.hpp"
 
 // Initial width and height of the window
 GLuint SCREEN_WIDTH = 1200;
@@ -45,52 +53,45 @@ GLuint SCREEN_HEIGHT = 800;
 static constexpr float NEAR_PLANE = 0.1f;
 static constexpr float FAR_PLANE = 1000.0f;
 
+// Seconds of each loading screen frame spent uploading what the workers have loaded
+static constexpr double LOADING_UPLOAD_BUDGET = 0.008;
+
 std::vector<model::Model*> models;	// vector of all models to render
 std::vector<model::Model*> SLmodels;
-std::vector<model::HitBox> hitBoxes; // vector of all hitboxes in the scene for collision detections
+model::HitBoxGrid hitBoxes; // grid of all hitboxes in the scene for collision detections
 std::vector<model::Paddock*> paddocks;  // vector of all paddocks for use with moveable gates
 std::vector<model::Model*> lostCat;
+int lostCatHitBox;	// handle of the lost cat's hitbox in the grid
+int lostCatTrigger;	// handle of the area around the lost cat that finds it
 static int debounceCounter = 0;		 // simple counter to debounce keyboard inputs
+static bool screenSpaceWater = false; // water reflects and refracts the main pass instead of drawing its own passes
 
 //Amount cat has been caught
 int catCaught = 0;
 
-void foundTheCat(utility::camera::Camera& camera, float terrainHeight, terrain::Terrain terra) {
+// The area around the cat that the camera has to reach to find it, the height of the camera doesn't matter
+model::HitBox catTrigger(model::Model* cat)
+{
+	model::HitBox trigger;
+	trigger.origin = cat->getPosition();
+	trigger.size = glm::vec3(6.0f, 1000.0f, 6.0f);
+	return trigger;
+}
+
+void foundTheCat(utility::camera::Camera& camera, float terrainHeight, terrain::Terrain& terra) {
 	model::Model* cat = lostCat[0];
-	float lxCoord, lyCoord, lzCoord;
-	float sxCoord, syCoord, szCoord;
-	//xCoord = cat->getPosition().x - camera.get_position().x;
-	//yCoord = cat->getPosition().y - camera.get_position().y;
-	//zCoord = cat->getPosition().z - camera.get_position().z;
-
-	if (cat->getPosition().x > camera.get_position().x) {
-		lxCoord = cat->getPosition().x;
-		sxCoord = camera.get_position().x;
-	}
-	else {
-		lxCoord = camera.get_position().x;
-		sxCoord = cat->getPosition().x;
-	}
-	/*
-	if (cat->getPosition().y > camera.get_position().y) {
-		lyCoord = cat->getPosition().y;
-		syCoord = camera.get_position().y;
-	}
-	else {
-		lyCoord = camera.get_position().y;
-		syCoord = cat->getPosition().y;
-	}
-	*/
-	if (cat->getPosition().z > camera.get_position().z) {
-		lzCoord = cat->getPosition().z;
-		szCoord = camera.get_position().z;
-	}
-	else {
-		lzCoord = camera.get_position().z;
-		szCoord = cat->getPosition().z;
-	}
 
-	if ((lxCoord - sxCoord) < 6.0f && (lzCoord - szCoord) < 6.0f) { // (lzCoord - szCoord) < 3.0f
+	// The cat is found when the camera is inside its trigger area
+	bool found = false;
+	hitBoxes.Query(camera.get_position(), glm::vec3(0.0f), [&found](int handle, const model::HitBoxGrid::Entry&)
+	{
+		if (handle == lostCatTrigger)
+		{
+			found = true;
+		}
+	});
+
+	if (found) {
 		catCaught++;
 		float xCoordNew, yCoordNew, zCoordNew;
 		float modelHeightInWorld;
@@ -107,16 +108,20 @@ void foundTheCat(utility::camera::Camera& camera, float terrainHeight, terrain::
 			yCoordNew = randY - 250;
 
 			std::cout << " " << randY << std::endl;
-			modelHeightInWorld = cat->GetModelTerrainHeight(terra, xCoordNew, yCoordNew, 500.0f, 500.0f, -20.0f);
+			modelHeightInWorld = cat->GetModelTerrainHeight(terra.getHeightfield(), xCoordNew, yCoordNew);
 
 			cat->ShiftTo(glm::vec3(xCoordNew, modelHeightInWorld, yCoordNew));
 		}
 		else {
 			xCoordNew = 78;
 			yCoordNew = 158;
-			modelHeightInWorld = cat->GetModelTerrainHeight(terra, xCoordNew, yCoordNew, 500.0f, 500.0f, -20.0f);
+			modelHeightInWorld = cat->GetModelTerrainHeight(terra.getHeightfield(), xCoordNew, yCoordNew);
 			cat->ShiftTo(glm::vec3(xCoordNew, modelHeightInWorld, yCoordNew));
 		}
+		// Move the cat's hitboxes with it
+		hitBoxes.Update(lostCatHitBox, cat->hitBox, cat);
+		hitBoxes.Update(lostCatTrigger, catTrigger(cat), cat);
+
 		//This let's us know where the cat is for easier finding
 		std::cout << " New Position of Cat: " << xCoordNew << " " << modelHeightInWorld << " " << yCoordNew << " " << std::endl;
 
@@ -128,43 +133,31 @@ void foundTheCat(utility::camera::Camera& camera, float terrainHeight, terrain::
 
 void checkPaddockGates(utility::camera::Camera& camera)
 {
-	for (model::Paddock* paddock : paddocks)
+	// Find the gate triggers around the camera, the gate is toggled after the query since it changes the grid
+	model::Paddock* gatePaddock = nullptr;
+	glm::vec3 position = camera.get_position();
+	hitBoxes.Query(position, glm::vec3(0.0f), [&gatePaddock, position](int, const model::HitBoxGrid::Entry& entry)
 	{
-		model::Model* gate = paddock->GetGate();
-
-		bool xCheck, yCheck, zCheck;
-		float xBound, yBound, zBound;
-		if (paddock->GateOpenStatus())
-		{
-			// Gate is currently open
-			xBound = 2 * gate->hitBox.size.z;
-			yBound = 2 * gate->hitBox.size.y;
-			zBound = 3 * gate->hitBox.size.z;
-		}
-		else
+		if (gatePaddock != nullptr || entry.solid) return;
+		for (model::Paddock* paddock : paddocks)
 		{
-			// Gate is currently closed
-			xBound = gate->hitBox.size.x;
-			yBound = 2 * gate->hitBox.size.y;
-			zBound = 2 * gate->hitBox.size.x;
+			if (paddock->GetGate() == entry.owner && paddock->InGateRange(position))
+			{
+				gatePaddock = paddock;
+				break;
+			}
 		}
+	});
 
-		// Check each axis for sufficient distance between the model hitbox and the camera hitbox
-		xCheck = abs(camera.get_position().x - gate->position.x) < xBound;
-		if (!xCheck) continue;
-		yCheck = abs(camera.get_position().y - gate->position.y) < yBound;
-		if (!yCheck) continue;
-		zCheck = abs(camera.get_position().z - gate->position.z) < zBound;
-		if (!zCheck) continue;
-
-		// Open/Close Gate
-		paddock->ToggleGate(models);
-		// Correct gate has been toggled
-		break;
+	// Open/Close Gate
+	if (gatePaddock != nullptr)
+	{
+		gatePaddock->ToggleGate(models, hitBoxes);
 	}
 }
 
-void process_input(GLFWwindow* window, const float& delta_time, utility::camera::Camera& camera, float terrainHeight, terrain::Terrain terra)
+void process_input(GLFWwindow* window, const float& delta_time, utility::camera::Camera& camera, float terrainHeight, terrain::Terrain& terra,
+				   const model::RenderQueue& renderQueue)
 {
 	// Movement sensitivity is updated base on the delta_time and not framerate, gravity accelleration is also based on delta_time
 	camera.set_movement_sensitivity(30.0f * delta_time);
@@ -226,8 +219,9 @@ void process_input(GLFWwindow* window, const float& delta_time, utility::camera:
 		else if (glfwGetKey(window, GLFW_KEY_ENTER) == GLFW_PRESS)
 		{
 			std::cout << "Model Hitbox: " << std::endl;
-			std::cout << hitBoxes[0].origin.x << " " << hitBoxes[0].origin.y << " " << hitBoxes[0].origin.z << std::endl;
-			std::cout << hitBoxes[0].size.x << " " << hitBoxes[0].size.y << " " << hitBoxes[0].size.z << std::endl;
+			const model::HitBox& modelHitBox = hitBoxes.Get(0).hitBox;
+			std::cout << modelHitBox.origin.x << " " << modelHitBox.origin.y << " " << modelHitBox.origin.z << std::endl;
+			std::cout << modelHitBox.size.x << " " << modelHitBox.size.y << " " << modelHitBox.size.z << std::endl;
 
 			model::HitBox cameraHitBox = camera.getHitBox();
 
@@ -235,6 +229,41 @@ void process_input(GLFWwindow* window, const float& delta_time, utility::camera:
 			std::cout << cameraHitBox.origin.x << " " << cameraHitBox.origin.y << " " << cameraHitBox.origin.z << std::endl;
 			std::cout << cameraHitBox.size.x << " " << cameraHitBox.size.y << " " << cameraHitBox.size.z << std::endl;
 		}
+		else if (glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS)
+		{
+			// Report how much of the terrain the frustum culling skipped in each pass
+			const char* passNames[] = { "Reflection", "Refraction", "Main" };
+			for (int pass = 0; pass < 3; pass++)
+			{
+				terrain::Terrain::ChunkStats stats = terra.getChunkStats((utility::frame::Pass)pass);
+				std::cout << passNames[pass] << " terrain chunks drawn: " << stats.drawn << " culled: " << stats.culled
+					<< " triangles: " << stats.triangles << " grass blades: " << stats.blades << std::endl;
+			}
+			// Report the state changes the sorted model draws needed in each pass
+			for (int pass = 0; pass < 3; pass++)
+			{
+				model::RenderQueue::Stats stats = renderQueue.GetStats((utility::frame::Pass)pass);
+				std::cout << passNames[pass] << " model draws: " << stats.packets << " program changes: " << stats.programChanges
+					<< " texture changes: " << stats.textureChanges << " vertex array changes: " << stats.vaoChanges
+					<< " vertices: " << stats.vertices << std::endl;
+			}
+			// Report how many of the playing sounds had a source
+			audio::SourcePool::Stats voices = audio::sourcePool().getStats();
+			std::cout << "Voices real: " << voices.realVoices << " virtual: " << voices.virtualVoices << std::endl;
+		}
+		else if (glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS)
+		{
+			// Switch terrain and model level of detail on and off to compare the triangle counts and image
+			terra.toggleLevelOfDetail();
+			model::ModelBatch::LevelOfDetail() = !model::ModelBatch::LevelOfDetail();
+			std::cout << "Model level of detail: " << (model::ModelBatch::LevelOfDetail() ? "on" : "off") << std::endl;
+		}
+		else if (glfwGetKey(window, GLFW_KEY_V) == GLFW_PRESS)
+		{
+			// Switch the water between its own reflection and refraction passes and screen space reflections
+			screenSpaceWater = !screenSpaceWater;
+			std::cout << "Screen space water: " << (screenSpaceWater ? "on" : "off") << std::endl;
+		}
 	}
 	// debounce inputs
 	if (debounceCounter == 5)
@@ -247,47 +276,17 @@ void process_input(GLFWwindow* window, const float& delta_time, utility::camera:
 	}
 }
 
-void render(terrain::Terrain terra, utility::camera::Camera camera, std::vector<model::Model*> models, skybox::Skybox skybox, GLuint modelShader, glm::vec4 clippingPlane, std::vector<model::Model*> SLmodels, GLuint streetLightShader)
-{
-	// get the camera transforms and position
-	glm::mat4 Hvw = camera.get_view_transform();
-	glm::mat4 Hcv = camera.get_clip_transform();
-	glm::mat4 Hwm = glm::mat4(1.0f);
-	glm::vec3 CamPos = camera.get_position();
-	// Clear color buffer
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-	// NOTE: Draw all other objects before the skybox
-
-	// Draw the models
-	glDepthFunc(GL_LESS);
-	glm::vec3 Forward = camera.get_view_direction();
-	for (int i = 0; i < models.size(); i++)
-	{
-		models[i]->Draw(modelShader, Hvw, Hcv, Hwm, clippingPlane, CamPos, Forward);
-	}
-
-	// Draw the Street Orbs
-	for (int i = 0; i < SLmodels.size(); i++)
-	{
-		SLmodels[i]->Draw(streetLightShader, Hvw, Hcv, Hwm, clippingPlane, CamPos, Forward);
-	}
-
-	// Render skybox last, disable clipping for skybox
-	glDisable(GL_CLIP_DISTANCE0);
-	glm::mat4 skybox_Hvw = glm::mat4(glm::mat3(camera.get_view_transform())); // remove translation from the view matrix. Keeps the skybox centered on camera.
-	skybox.render(skybox_Hvw, Hcv);
-	glEnable(GL_CLIP_DISTANCE0);
-
-	//-------------
-	// DRAW TERRAIN
-	//-------------
-	terra.draw(Hvw, Hcv, clippingPlane, camera.get_position(), glm::vec3(0.0, 50, 0.0), glm::vec3(1.0, 1.0, 1.0),
-		glfwGetTime(), Forward);
-}
+// The loading screen's quad, shader and image
+struct LoadingScreen {
+	GLuint vao;
+	GLuint shader;
+	GLuint texture;
+	GLint progress;	// uniform locations
+	GLint time;
+};
 
 // Loads a loading screen for FARM-LIFE: GAME OF THE YEAR EDITION
-void addLoadingScreen()
+LoadingScreen addLoadingScreen()
 {
 	// Create and bind vertex array object
 	GLuint vao1;
@@ -348,6 +347,51 @@ void addLoadingScreen()
 	glEnableVertexAttribArray(texAttrib);
 	glVertexAttribPointer(texAttrib, 2, GL_FLOAT, GL_FALSE,
 		4 * sizeof(float), (void*)(2 * sizeof(float)));
+	SOIL_free_image_data(image);
+
+	LoadingScreen screen = { vao1, shader1, tex1, glGetUniformLocation(shader1, "progress"), glGetUniformLocation(shader1, "time") };
+	return screen;
+}
+
+// Draws the loading screen with a bar showing progress, from 0 to 1, animated by time
+void drawLoadingScreen(const LoadingScreen& screen, float progress, float time)
+{
+	// Uploads in between frames bind their own arrays and textures, so everything is bound again
+	glUseProgram(screen.shader);
+	glUniform1f(screen.progress, progress);
+	glUniform1f(screen.time, time);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, screen.texture);
+	glBindVertexArray(screen.vao);
+	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+	glBindVertexArray(0);
+}
+
+// Starts reading and decoding the files of the scene on the job system's workers: models, textures and sounds.
+// Creating the scene afterwards finds them already loaded and only uploads what is left.
+void preloadScene(utility::jobs::JobSystem& jobs)
+{
+	const char* modelFiles[] = {
+		"models/StreetLight/StreetLightMetallicOrb.obj", "models/StreetLight/StreetLightPost.obj", "models/barn/barn.obj",
+		"models/tree/tree0/tree0.obj", "models/tree/tree1/tree1.obj", "models/tree/tree2/tree2.obj", "models/tree/tree3/tree3.obj",
+		"models/bucket/bucket.obj", "models/bucket/bucket2.obj", "models/fence/fence.obj", "models/fence/fence2.obj",
+		"models/trough/watertrough.obj", "models/cat/cat.obj", "models/giraffe/giraffe-split.obj", "models/pig/pig.obj"
+	};
+	for (const char* file : modelFiles)
+	{
+		model::ModelAsset::Preload(jobs, file);
+	}
+
+	terrain::Terrain::prefetchTextures(jobs);
+	water::Water::prefetchTextures(jobs);
+	skybox::Skybox::prefetchTextures(jobs);
+
+	// The music and ambience are streamed while they play, only the short clips are read ahead
+	const char* audioFiles[] = { "audio/cat-purring.wav" };
+	for (const char* file : audioFiles)
+	{
+		audio::preload(jobs, file);
+	}
 }
 
 int main(void)
@@ -462,20 +506,39 @@ int main(void)
 	//--------------------------------------------------------
 
 	// Draw screen while waiting for the main program to load
-	addLoadingScreen();
-	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+	const double loadingStart = glfwGetTime();
+	LoadingScreen loadingScreen = addLoadingScreen();
+#ifndef FARMLIFE_SERIAL_LOADING
+	{
+		// The workers read and decode the files while the loading screen animates, their uploads are spread over its frames
+		utility::jobs::JobSystem jobs;
+		preloadScene(jobs);
+		bool loaded = false;
+		while (!loaded)
+		{
+			loaded = jobs.drainMainThread(LOADING_UPLOAD_BUDGET);
+			glClear(GL_COLOR_BUFFER_BIT);
+			drawLoadingScreen(loadingScreen, jobs.progress(), glfwGetTime() - loadingStart);
+			glfwSwapBuffers(window);
+			glfwPollEvents();
+		}
+		std::cout << "Scene files loaded in " << glfwGetTime() - loadingStart << " s on " << jobs.workerCount() << " workers" << std::endl;
+	}
+#endif
+	// Whatever is left is created on this thread, the full bar stays up until it is done
+	glClear(GL_COLOR_BUFFER_BIT);
+	drawLoadingScreen(loadingScreen, 1.0f, glfwGetTime() - loadingStart);
 	glfwSwapBuffers(window);
 
 	//---------------------
 	// SET BACKGROUND MUSIC
 	//---------------------
 	audio::setListener(camera.get_position());
-	audio::Source camSource = audio::Source();
+	audio::StreamingSource camSource("audio/bensound-acousticbreeze.wav");
 	camSource.setLooping(true);
 	camSource.setPosition(camera.get_position());
 	camSource.setVolume(0.07);
-	GLuint mainMusic = audio::loadAudio("audio/bensound-acousticbreeze.wav");
-	camSource.play(mainMusic);
+	camSource.play();
 
 	// Enable depth test
 	glEnable(GL_DEPTH_TEST);
@@ -489,17 +552,19 @@ int main(void)
 	float terraScale = 1.0;
 	int terraMaxHeight = 30;
 	float terraYOffset = -20.0f; // the terrain is offset in the y by terraYOffset
+	int terraStreamRadius = 0;	 // tiles of terrain streamed in around the camera, 0 keeps the single height map
 	// Create main terrain
-	terrain::Terrain terra = terrain::Terrain(tresX, tresY, terraScale, terraMaxHeight, terraYOffset, terraMaxHeight / 2.5);
+	terrain::Terrain terra = terrain::Terrain(tresX, terraScale, terraMaxHeight, terraYOffset, terraMaxHeight / 2.5, terraStreamRadius);
 	// Create water frame buffers for reflection and refraction
-	water::WaterFrameBuffers fbos = water::WaterFrameBuffers();
+	int framebufferWidth, framebufferHeight;
+	glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+	water::WaterFrameBuffers fbos = water::WaterFrameBuffers(framebufferWidth, framebufferHeight);
 	// Create water
-	water::Water water = water::Water(tresX, tresY, terraScale, terraMaxHeight / 2.5, fbos);
+	water::Water water = water::Water(tresX, tresY, terraScale, terraMaxHeight / 2.5);
 	water.playSound("audio/river.wav");
 
-	// Set up the camera offset, terrain is from (-500,-500) to (500,500) in the world, camera range is (0,0) to (1000,1000)
-	int cameraOffsetX = tresX / 2;
-	int cameraOffsetY = tresY / 2;
+	// Heights of the terrain in world coordinates, terrain is from (-500,-500) to (500,500) in the world
+	const terrain::Heightfield &heightfield = terra.getHeightfield();
 	//Enable lighting
 
 	glEnable(GL_LIGHTING);
@@ -525,35 +590,35 @@ int main(void)
 	model::Model* streetLightOrb1 = new model::Model("models/StreetLight/StreetLightMetallicOrb.obj");
 	modelXCoord = 1;
 	modelYCoord = 2;
-	modelHeightInWorld = terra.getHeightAt(modelXCoord + cameraOffsetX, modelYCoord + cameraOffsetY) + terraYOffset + (streetLightOrb1->hitBox.size.y) - 1;
+	modelHeightInWorld = heightfield.sampleHeight(modelXCoord, modelYCoord) + (streetLightOrb1->hitBox.size.y) - 1;
 	streetLightOrb1->MoveTo(glm::vec3(modelXCoord, modelHeightInWorld, modelYCoord));
 	SLmodels.push_back(streetLightOrb1);
-	hitBoxes.push_back(streetLightOrb1->hitBox);
+	hitBoxes.Insert(streetLightOrb1->hitBox, streetLightOrb1);
 	//Light number 2
 	model::Model* streetLightOrb2 = new model::Model("models/StreetLight/StreetLightMetallicOrb.obj");
 	modelXCoord = 50;
 	modelYCoord = 80;
-	modelHeightInWorld = terra.getHeightAt(modelXCoord + cameraOffsetX, modelYCoord + cameraOffsetY) + terraYOffset + (streetLightOrb2->hitBox.size.y) - 1;
+	modelHeightInWorld = heightfield.sampleHeight(modelXCoord, modelYCoord) + (streetLightOrb2->hitBox.size.y) - 1;
 	streetLightOrb2->MoveTo(glm::vec3(modelXCoord, modelHeightInWorld, modelYCoord));
 	SLmodels.push_back(streetLightOrb2);
-	hitBoxes.push_back(streetLightOrb2->hitBox);
+	hitBoxes.Insert(streetLightOrb2->hitBox, streetLightOrb2);
 	//Light number 3
 	model::Model* streetLightOrb3 = new model::Model("models/StreetLight/StreetLightMetallicOrb.obj");
 	modelXCoord = 70;
 	modelYCoord = 145;
-	modelHeightInWorld = terra.getHeightAt(modelXCoord + cameraOffsetX, modelYCoord + cameraOffsetY) + terraYOffset + (streetLightOrb3->hitBox.size.y) - 1;
+	modelHeightInWorld = heightfield.sampleHeight(modelXCoord, modelYCoord) + (streetLightOrb3->hitBox.size.y) - 1;
 	//std::cout << "Light height: " << modelHeightInWorld - 3<<" ";
 	streetLightOrb3->MoveTo(glm::vec3(modelXCoord, modelHeightInWorld, modelYCoord));
 	SLmodels.push_back(streetLightOrb3);
-	hitBoxes.push_back(streetLightOrb3->hitBox);
+	hitBoxes.Insert(streetLightOrb3->hitBox, streetLightOrb3);
 	//Light number 4
 	model::Model* streetLightOrb4 = new model::Model("models/StreetLight/StreetLightMetallicOrb.obj");
 	modelXCoord = 10;
 	modelYCoord = 50;
-	modelHeightInWorld = terra.getHeightAt(modelXCoord + cameraOffsetX, modelYCoord + cameraOffsetY) + terraYOffset + (streetLightOrb4->hitBox.size.y) - 1;
+	modelHeightInWorld = heightfield.sampleHeight(modelXCoord, modelYCoord) + (streetLightOrb4->hitBox.size.y) - 1;
 	streetLightOrb4->MoveTo(glm::vec3(modelXCoord, modelHeightInWorld, modelYCoord));
 	SLmodels.push_back(streetLightOrb4);
-	hitBoxes.push_back(streetLightOrb4->hitBox);
+	hitBoxes.Insert(streetLightOrb4->hitBox, streetLightOrb4);
 	//**********************************************Street lights Orbs********************************************************************************
 
 	//**********************************************Street light Posts********************************************************************************
@@ -561,38 +626,38 @@ int main(void)
 	model::Model* streetLightPost1 = new model::Model("models/StreetLight/StreetLightPost.obj");
 	modelXCoord = 1;
 	modelYCoord = 2;
-	modelHeightInWorld = terra.getHeightAt(modelXCoord + cameraOffsetX, modelYCoord + cameraOffsetY) + terraYOffset + (streetLightPost1->hitBox.size.y) - 3;
+	modelHeightInWorld = heightfield.sampleHeight(modelXCoord, modelYCoord) + (streetLightPost1->hitBox.size.y) - 3;
 	//std::cout << " " << modelHeightInWorld << " "; //1.3
 	streetLightPost1->MoveTo(glm::vec3(modelXCoord, modelHeightInWorld, modelYCoord));
 	models.push_back(streetLightPost1);
-	hitBoxes.push_back(streetLightPost1->hitBox);
+	hitBoxes.Insert(streetLightPost1->hitBox, streetLightPost1);
 	//Light number 2
 	model::Model* streetLightPost2 = new model::Model("models/StreetLight/StreetLightPost.obj");
 	modelXCoord = 50;
 	modelYCoord = 80;
-	modelHeightInWorld = terra.getHeightAt(modelXCoord + cameraOffsetX, modelYCoord + cameraOffsetY) + terraYOffset + (streetLightPost2->hitBox.size.y) - 3;
+	modelHeightInWorld = heightfield.sampleHeight(modelXCoord, modelYCoord) + (streetLightPost2->hitBox.size.y) - 3;
 	//std::cout << " " << modelHeightInWorld << " "; //1.3
 	streetLightPost2->MoveTo(glm::vec3(modelXCoord, modelHeightInWorld, modelYCoord));
 	models.push_back(streetLightPost2);
-	hitBoxes.push_back(streetLightPost2->hitBox);
+	hitBoxes.Insert(streetLightPost2->hitBox, streetLightPost2);
 	//Light number 3
 	model::Model* streetLightPost3 = new model::Model("models/StreetLight/StreetLightPost.obj");
 	modelXCoord = 70;
 	modelYCoord = 145;
-	modelHeightInWorld = terra.getHeightAt(modelXCoord + cameraOffsetX, modelYCoord + cameraOffsetY) + terraYOffset + (streetLightPost3->hitBox.size.y) - 3;
+	modelHeightInWorld = heightfield.sampleHeight(modelXCoord, modelYCoord) + (streetLightPost3->hitBox.size.y) - 3;
 	//std::cout << " " << modelHeightInWorld << " "; //1.3
 	streetLightPost3->MoveTo(glm::vec3(modelXCoord, modelHeightInWorld, modelYCoord));
 	models.push_back(streetLightPost3);
-	hitBoxes.push_back(streetLightPost3->hitBox);
+	hitBoxes.Insert(streetLightPost3->hitBox, streetLightPost3);
 	//Light number 4
 	model::Model* streetLightPost4 = new model::Model("models/StreetLight/StreetLightPost.obj");
 	modelXCoord = 10;
 	modelYCoord = 50;
-	modelHeightInWorld = terra.getHeightAt(modelXCoord + cameraOffsetX, modelYCoord + cameraOffsetY) + terraYOffset + (streetLightPost4->hitBox.size.y) - 3;
+	modelHeightInWorld = heightfield.sampleHeight(modelXCoord, modelYCoord) + (streetLightPost4->hitBox.size.y) - 3;
 	//std::cout << " " << modelHeightInWorld << " "; //1.3
 	streetLightPost4->MoveTo(glm::vec3(modelXCoord, modelHeightInWorld, modelYCoord));
 	models.push_back(streetLightPost4);
-	hitBoxes.push_back(streetLightPost4->hitBox);
+	hitBoxes.Insert(streetLightPost4->hitBox, streetLightPost4);
 	//**********************************************Street lights Posts********************************************************************************
 
 
@@ -600,136 +665,137 @@ int main(void)
 
 	model::Model* barn = new model::Model("models/barn/barn.obj");
 	modelXCoord = 82, modelYCoord = 110;
-	modelHeightInWorld = barn->GetModelTerrainHeight(terra, modelXCoord, modelYCoord, cameraOffsetX, cameraOffsetY, terraYOffset) - 4.0f;
+	modelHeightInWorld = barn->GetModelTerrainHeight(heightfield, modelXCoord, modelYCoord) - 4.0f;
 	barn->MoveTo(glm::vec3(modelXCoord, modelHeightInWorld, modelYCoord));
 	models.push_back(barn);
-	hitBoxes.push_back(barn->hitBox);
+	hitBoxes.Insert(barn->hitBox, barn);
 
-	tree::Tree tree = tree::Tree("trees/placemap.bmp", terra);
+	tree::Tree tree = tree::Tree("trees/placemap.bmp", heightfield);
 	for (int i = 0; i < 30; i++)
 	{
 		models.push_back(tree.placeTree(i));
-		hitBoxes.push_back(tree.placeTree(i)->hitBox);
+		hitBoxes.Insert(tree.placeTree(i)->hitBox, tree.placeTree(i));
 	};
 
 	model::Model* bucket = new model::Model("models/bucket/bucket.obj");
 	modelXCoord = 89, modelYCoord = 118;
-	modelHeightInWorld = bucket->GetModelTerrainHeight(terra, modelXCoord, modelYCoord, cameraOffsetX, cameraOffsetY, terraYOffset);
+	modelHeightInWorld = bucket->GetModelTerrainHeight(heightfield, modelXCoord, modelYCoord);
 	bucket->MoveTo(glm::vec3(modelXCoord, modelHeightInWorld, modelYCoord));
 	models.push_back(bucket);
-	hitBoxes.push_back(bucket->hitBox);
+	hitBoxes.Insert(bucket->hitBox, bucket);
 
 	/* Cat Paddock */
 	model::Paddock* paddock2 = new model::Paddock(4, 3);
 	paddockXCoord = 70, paddockYCoord = 140;
-	paddock2->MovePaddock(glm::vec2(paddockXCoord, paddockYCoord), terra, cameraOffsetX, cameraOffsetY, terraYOffset);
+	paddock2->MovePaddock(glm::vec2(paddockXCoord, paddockYCoord), heightfield);
 	paddocks.push_back(paddock2);
 	paddock2->PushModels(models);
 	paddock2->PushHitBoxes(hitBoxes);
 
 	model::Model* trough = new model::Model("models/trough/watertrough.obj");
 	modelXCoord = 101, modelYCoord = 148;
-	modelHeightInWorld = trough->GetModelTerrainHeight(terra, modelXCoord, modelYCoord, cameraOffsetX, cameraOffsetY, terraYOffset) + 0.5f;
+	modelHeightInWorld = trough->GetModelTerrainHeight(heightfield, modelXCoord, modelYCoord) + 0.5f;
 	trough->MoveTo(glm::vec3(modelXCoord, modelHeightInWorld, modelYCoord));
 	models.push_back(trough);
-	hitBoxes.push_back(trough->hitBox);
+	hitBoxes.Insert(trough->hitBox, trough);
 
 	model::Model* bucket2 = new model::Model("models/bucket/bucket2.obj");
 	modelXCoord = 67, modelYCoord = 144;
-	modelHeightInWorld = bucket2->GetModelTerrainHeight(terra, modelXCoord, modelYCoord, cameraOffsetX, cameraOffsetY, terraYOffset);
+	modelHeightInWorld = bucket2->GetModelTerrainHeight(heightfield, modelXCoord, modelYCoord);
 	bucket2->MoveTo(glm::vec3(modelXCoord, modelHeightInWorld, modelYCoord));
 	models.push_back(bucket2);
-	hitBoxes.push_back(bucket2->hitBox);
+	hitBoxes.Insert(bucket2->hitBox, bucket2);
 
 	/* Paddock animals START */
 	model::Model* cat = new model::Model("models/cat/cat.obj");
 	modelXCoord = 85, modelYCoord = 145;
-	modelHeightInWorld = cat->GetModelTerrainHeight(terra, modelXCoord, modelYCoord, cameraOffsetX, cameraOffsetY, terraYOffset) - 1.0f;
+	modelHeightInWorld = cat->GetModelTerrainHeight(heightfield, modelXCoord, modelYCoord) - 1.0f;
 	cat->MoveTo(glm::vec3(modelXCoord, modelHeightInWorld, modelYCoord));
 	models.push_back(cat);
-	hitBoxes.push_back(cat->hitBox);
+	hitBoxes.Insert(cat->hitBox, cat);
 
 	model::Model* cat2 = new model::Model("models/cat/cat.obj");
 	modelXCoord = 75, modelYCoord = 160;
-	modelHeightInWorld = cat2->GetModelTerrainHeight(terra, modelXCoord, modelYCoord, cameraOffsetX, cameraOffsetY, terraYOffset) - 1.0f;
+	modelHeightInWorld = cat2->GetModelTerrainHeight(heightfield, modelXCoord, modelYCoord) - 1.0f;
 	cat2->MoveTo(glm::vec3(modelXCoord, modelHeightInWorld, modelYCoord));
 	models.push_back(cat2);
-	hitBoxes.push_back(cat2->hitBox);
+	hitBoxes.Insert(cat2->hitBox, cat2);
 	/* Paddock animals END */
 
 	/*Lost cat START*/
 	lostCat;
 	model::Model* cat3 = new model::Model("models/cat/cat.obj");
 	modelXCoord = 200, modelYCoord = 360;
-	modelHeightInWorld = cat3->GetModelTerrainHeight(terra, modelXCoord, modelYCoord, cameraOffsetX, cameraOffsetY, terraYOffset) - 1.0f;
+	modelHeightInWorld = cat3->GetModelTerrainHeight(heightfield, modelXCoord, modelYCoord) - 1.0f;
 	cat3->MoveTo(glm::vec3(modelXCoord, modelHeightInWorld, modelYCoord));
 	models.push_back(cat3);
 	lostCat.push_back(cat3);
-	hitBoxes.push_back(cat3->hitBox);
+	lostCatHitBox = hitBoxes.Insert(cat3->hitBox, cat3);
+	lostCatTrigger = hitBoxes.Insert(catTrigger(cat3), cat3, false);
 	/*Lost cat END*/
 
 	/* Giraffe Paddock */
 	model::Paddock* paddock = new model::Paddock(5, 7);
 	paddockXCoord = 5, paddockYCoord = 120;
-	paddock->MovePaddock(glm::vec2(paddockXCoord, paddockYCoord), terra, cameraOffsetX, cameraOffsetY, terraYOffset);
+	paddock->MovePaddock(glm::vec2(paddockXCoord, paddockYCoord), heightfield);
 	paddocks.push_back(paddock);
 	paddock->PushModels(models);
 	paddock->PushHitBoxes(hitBoxes);
 
 	model::Model* bucket3 = new model::Model("models/bucket/bucket2.obj");
 	modelXCoord = 20, modelYCoord = 118;
-	modelHeightInWorld = bucket3->GetModelTerrainHeight(terra, modelXCoord, modelYCoord, cameraOffsetX, cameraOffsetY, terraYOffset);
+	modelHeightInWorld = bucket3->GetModelTerrainHeight(heightfield, modelXCoord, modelYCoord);
 	bucket3->MoveTo(glm::vec3(modelXCoord, modelHeightInWorld, modelYCoord));
 	models.push_back(bucket3);
-	hitBoxes.push_back(bucket3->hitBox);
+	hitBoxes.Insert(bucket3->hitBox, bucket3);
 
 
 
 	model::Model* bucket4 = new model::Model("models/bucket/bucket2.obj");
 	modelXCoord = 23, modelYCoord = 118;
-	modelHeightInWorld = bucket4->GetModelTerrainHeight(terra, modelXCoord, modelYCoord, cameraOffsetX, cameraOffsetY, terraYOffset);
+	modelHeightInWorld = bucket4->GetModelTerrainHeight(heightfield, modelXCoord, modelYCoord);
 	bucket4->MoveTo(glm::vec3(modelXCoord, modelHeightInWorld, modelYCoord));
 	models.push_back(bucket4);
-	hitBoxes.push_back(bucket4->hitBox);
+	hitBoxes.Insert(bucket4->hitBox, bucket4);
 
 	model::Model* trough2 = new model::Model("models/trough/watertrough.obj");
 	modelXCoord = 44, modelYCoord = 132;
-	modelHeightInWorld = trough2->GetModelTerrainHeight(terra, modelXCoord, modelYCoord, cameraOffsetX, cameraOffsetY, terraYOffset) + 0.5f;
+	modelHeightInWorld = trough2->GetModelTerrainHeight(heightfield, modelXCoord, modelYCoord) + 0.5f;
 	trough2->MoveTo(glm::vec3(modelXCoord, modelHeightInWorld, modelYCoord));
 	models.push_back(trough2);
-	hitBoxes.push_back(trough2->hitBox);
+	hitBoxes.Insert(trough2->hitBox, trough2);
 
 	/* Paddock animals START */
 	model::Model* giraffe = new model::Model("models/giraffe/giraffe-split.obj");
 	modelXCoord = 35, modelYCoord = 130;
-	modelHeightInWorld = giraffe->GetModelTerrainHeight(terra, modelXCoord, modelYCoord, cameraOffsetX, cameraOffsetY, terraYOffset) + 0.5f;
+	modelHeightInWorld = giraffe->GetModelTerrainHeight(heightfield, modelXCoord, modelYCoord) + 0.5f;
 	giraffe->MoveTo(glm::vec3(modelXCoord, modelHeightInWorld, modelYCoord));
 	giraffe->SetRotationAnimationLoop("Head_Plane.001", -0.5f, 0.5f, 0.01f, glm::vec3(0.0f, 1.0f, 0.0f));
 	models.push_back(giraffe);
-	hitBoxes.push_back(giraffe->hitBox);
+	hitBoxes.Insert(giraffe->hitBox, giraffe);
 
 
 
 	model::Model* giraffe2 = new model::Model("models/giraffe/giraffe-split.obj");
 	modelXCoord = 15, modelYCoord = 150;
-	modelHeightInWorld = giraffe->GetModelTerrainHeight(terra, modelXCoord, modelYCoord, cameraOffsetX, cameraOffsetY, terraYOffset) + 0.5f;
+	modelHeightInWorld = giraffe->GetModelTerrainHeight(heightfield, modelXCoord, modelYCoord) + 0.5f;
 	giraffe2->MoveTo(glm::vec3(modelXCoord, modelHeightInWorld, modelYCoord));
 	giraffe2->SetRotationAnimationLoop("Head_Plane.001", -0.5f, 0.5f, 0.01f, glm::vec3(0.0f, 1.0f, 0.0f));
 	models.push_back(giraffe2);
-	hitBoxes.push_back(giraffe2->hitBox);
+	hitBoxes.Insert(giraffe2->hitBox, giraffe2);
 
 	model::Model* giraffe3 = new model::Model("models/giraffe/giraffe-split.obj");
 	modelXCoord = 20, modelYCoord = 170;
-	modelHeightInWorld = giraffe->GetModelTerrainHeight(terra, modelXCoord, modelYCoord, cameraOffsetX, cameraOffsetY, terraYOffset) + 0.5f;
+	modelHeightInWorld = giraffe->GetModelTerrainHeight(heightfield, modelXCoord, modelYCoord) + 0.5f;
 	giraffe3->MoveTo(glm::vec3(modelXCoord, modelHeightInWorld, modelYCoord));
 	giraffe3->SetRotationAnimationLoop("Head_Plane.001", -0.5f, 0.5f, 0.01f, glm::vec3(0.0f, 1.0f, 0.0f));
 	models.push_back(giraffe3);
-	hitBoxes.push_back(giraffe3->hitBox);
+	hitBoxes.Insert(giraffe3->hitBox, giraffe3);
 	/* Paddock animals END */
 
 	model::Paddock* paddock3 = new model::Paddock(1, 1);
 	paddockXCoord = 110, paddockYCoord = 110;
-	paddock3->MovePaddock(glm::vec2(paddockXCoord, paddockYCoord), terra, cameraOffsetX, cameraOffsetY, terraYOffset);
+	paddock3->MovePaddock(glm::vec2(paddockXCoord, paddockYCoord), heightfield);
 	paddocks.push_back(paddock3);
 	paddock3->PushModels(models);
 	paddock3->PushHitBoxes(hitBoxes);
@@ -737,7 +803,7 @@ int main(void)
 
 	model::Paddock* paddock4 = new model::Paddock(4, 5);
 	paddockXCoord = 70, paddockYCoord = 180;
-	paddock4->MovePaddock(glm::vec2(paddockXCoord, paddockYCoord), terra, cameraOffsetX, cameraOffsetY, terraYOffset);
+	paddock4->MovePaddock(glm::vec2(paddockXCoord, paddockYCoord), heightfield);
 	paddocks.push_back(paddock4);
 	paddock4->PushModels(models);
 	paddock4->PushHitBoxes(hitBoxes);
@@ -745,26 +811,26 @@ int main(void)
 	model::Model* pig1 = new model::Model("models/pig/pig.obj");
 	modelXCoord = 80;
 	modelYCoord = 190;
-	modelHeightInWorld = pig1->GetModelTerrainHeight(terra, modelXCoord, modelYCoord, cameraOffsetX, cameraOffsetY, terraYOffset) - 2;
+	modelHeightInWorld = pig1->GetModelTerrainHeight(heightfield, modelXCoord, modelYCoord) - 2;
 	pig1->MoveTo(glm::vec3(modelXCoord, modelHeightInWorld, modelYCoord));
 	models.push_back(pig1);
-	hitBoxes.push_back(pig1->hitBox);
+	hitBoxes.Insert(pig1->hitBox, pig1);
 
 	model::Model* pig2 = new model::Model("models/pig/pig.obj");
 	modelXCoord = 85;
 	modelYCoord = 185;
-	modelHeightInWorld = pig2->GetModelTerrainHeight(terra, modelXCoord, modelYCoord, cameraOffsetX, cameraOffsetY, terraYOffset) - 2;
+	modelHeightInWorld = pig2->GetModelTerrainHeight(heightfield, modelXCoord, modelYCoord) - 2;
 	pig2->MoveTo(glm::vec3(modelXCoord, modelHeightInWorld, modelYCoord));
 	models.push_back(pig2);
-	hitBoxes.push_back(pig2->hitBox);
+	hitBoxes.Insert(pig2->hitBox, pig2);
 
 	model::Model* pig3 = new model::Model("models/pig/pig.obj");
 	modelXCoord = 90;
 	modelYCoord = 210;
-	modelHeightInWorld = pig3->GetModelTerrainHeight(terra, modelXCoord, modelYCoord, cameraOffsetX, cameraOffsetY, terraYOffset) - 2;
+	modelHeightInWorld = pig3->GetModelTerrainHeight(heightfield, modelXCoord, modelYCoord) - 2;
 	pig3->MoveTo(glm::vec3(modelXCoord, modelHeightInWorld, modelYCoord));
 	models.push_back(pig3);
-	hitBoxes.push_back(pig3->hitBox);
+	hitBoxes.Insert(pig3->hitBox, pig3);
 
 	//--------------
 	// CREATE SKYBOX
@@ -772,6 +838,18 @@ int main(void)
 	skybox::Skybox skybox = skybox::Skybox();
 	skybox.getInt();
 
+	// Models loaded from the same file share their meshes and textures
+	std::cout << "Loaded " << model::ModelAsset::LoadedCount() << " unique models for " << models.size() + SLmodels.size() << " model instances" << std::endl;
+	std::cout << "Scene loaded in " << glfwGetTime() - loadingStart << " s" << std::endl;
+	std::cout << "Textures: " << utility::texture::uploaded().size() << " using " << utility::texture::residentBytes() / (1024 * 1024)
+		<< " MB of video memory" << std::endl;
+
+	model::ModelBatch modelBatch;
+	model::ModelBatch streetLightBatch;
+	model::RenderQueue renderQueue;
+	lights::LightBuffer lightBuffer;
+	Scene scene = { terra, skybox, models, SLmodels, lightBuffer, model::ModelShader(modelShader), model::ModelShader(streetLightShader), modelBatch, streetLightBatch, renderQueue };
+
 	// Init before the main loop
 	float last_frame = glfwGetTime();
 	float current_frame = 0.0f;
@@ -788,84 +866,133 @@ int main(void)
 	{
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 		audio::setListener(camera.get_position());
+		audio::sourcePool().update(camera.get_position());
 		camSource.setPosition(camera.get_position());
 		/* PROCESS INPUT */
 		current_frame = glfwGetTime();
 		delta_time = current_frame - last_frame;
 		last_frame = current_frame;
 
-		// find the current rough terrain height at the camera position
-		int cameraX = (int)camera.get_position().x + cameraOffsetX;
-		int cameraY = (int)camera.get_position().z + cameraOffsetY;
-		float terrainHeight = terra.getHeightAt(cameraX, cameraY) + terraYOffset + 5.0f; // using the offset down 20.0f units and adding some height for the camera
-		process_input(window, delta_time, camera, terrainHeight, terra);
+		// find the terrain height at the camera position
+		float terrainHeight = terra.sampleHeight(camera.get_position().x, camera.get_position().z) + 5.0f; // adding some height for the camera
+		process_input(window, delta_time, camera, terrainHeight, terra, renderQueue);
+
+		// Step the model animations once, every pass draws them as they are this frame
+		for (model::Model* model : models)
+		{
+			model->Animate();
+		}
+		for (model::Model* model : SLmodels)
+		{
+			model->Animate();
+		}
 
-		glm::mat4 Hvw = camera.get_view_transform(); //view
-		glm::mat4 Hcv = camera.get_clip_transform(); //projection
+		// Lights and time are shared by every pass this frame
+		const float frameTime = glfwGetTime();
+		const lights::LightSet lightSet = lights::computeLightSet(frameTime);
+		using utility::frame::Pass;
 
+#ifdef FARMLIFE_COUNT_ALLOCATIONS
+		const std::size_t allocationsBefore = utility::allocation::count();
+#endif
 
 		//------------------------------------------
 		// RENDER REFLECTION AND REFRACTION TEXTURES
 		//------------------------------------------
+		// The water targets follow the window size and shrink when frames take too long
+		glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+		fbos.update(framebufferWidth, framebufferHeight, delta_time);
+
+		// The last reflection is reused while the camera is still, it is redrawn every few frames
+		const bool drawReflection = fbos.reflectionDue(camera.get_view_transform());
+
+		// Screen space water has no passes of its own, the water is drawn from the main pass
 		// If camera is above the water, do reflection and refraction as you would expect
-		if (camera.get_position().y > water.getHeight() - 0.5)
+		if (!screenSpaceWater && camera.get_position().y > water.getHeight() - 0.5)
 		{
 			// Allow clipping
 			glEnable(GL_CLIP_DISTANCE0);
 
-			// Bind the reflection frame buffer
-			fbos.bindReflectionFrameBuffer();
+			if (drawReflection)
+			{
+				// Bind the reflection frame buffer
+				fbos.bindReflectionFrameBuffer();
 
-			// Move the camera
-			float distance = 2 * (camera.get_position().y - water.getHeight());
-			camera.move_y_position(-distance);
-			camera.invert_pitch();
+				// Move the camera
+				float distance = 2 * (camera.get_position().y - water.getHeight());
+				camera.move_y_position(-distance);
+				camera.invert_pitch();
 
-			// Render the scene
-			render(terra, camera, models, skybox, modelShader, glm::vec4(0, 1, 0, -water.getHeight()), SLmodels, streetLightShader);
+				// Render the scene
+				render(scene, makeFrameContext(camera, glm::vec4(0, 1, 0, -water.getHeight()), frameTime, Pass::REFLECTION, lightSet));
 
-			// Move the camera back
-			camera.move_y_position(distance);
-			camera.invert_pitch();
+				// Move the camera back
+				camera.move_y_position(distance);
+				camera.invert_pitch();
+			}
 
 			// Bind the refraction frame buffer
 			fbos.bindRefractionFrameBuffer();
 
 			// Render the scene
-			render(terra, camera, models, skybox, modelShader, glm::vec4(0, -1, 0, water.getHeight()), SLmodels, streetLightShader);
+			render(scene, makeFrameContext(camera, glm::vec4(0, -1, 0, water.getHeight()), frameTime, Pass::REFRACTION, lightSet));
 		}
 		// If the camera is below the water, dont need reflection only refraction
-		else
+		else if (!screenSpaceWater)
 		{
 			// Allow clipping
 			glEnable(GL_CLIP_DISTANCE0);
 
-			// Bind the reflection frame buffer
-			fbos.bindReflectionFrameBuffer();
+			if (drawReflection)
+			{
+				// Bind the reflection frame buffer
+				fbos.bindReflectionFrameBuffer();
 
-			// Render the scene, don't bother changing since this is refraction
-			render(terra, camera, models, skybox, modelShader, glm::vec4(0, 1, 0, -water.getHeight()), SLmodels, streetLightShader);
+				// Render the scene, don't bother changing since this is refraction
+				render(scene, makeFrameContext(camera, glm::vec4(0, 1, 0, -water.getHeight()), frameTime, Pass::REFLECTION, lightSet));
+			}
 
 			// Bind the refraction frame buffer
 			fbos.bindRefractionFrameBuffer();
 			// Render the scene
-			render(terra, camera, models, skybox, modelShader, glm::vec4(0, -1, 0, -water.getHeight()), SLmodels, streetLightShader);
+			render(scene, makeFrameContext(camera, glm::vec4(0, -1, 0, -water.getHeight()), frameTime, Pass::REFRACTION, lightSet));
 		}
 
 		// Unbind the frame buffer before rendering the scene
-		fbos.unbindCurrentFrameBuffer(SCREEN_WIDTH, SCREEN_HEIGHT);
+		fbos.unbindCurrentFrameBuffer(framebufferWidth, framebufferHeight);
 
 		//-----------------
 		// RENDER THE SCENE
 		//-----------------
-		// Render terrain, skybox and models
-		render(terra, camera, models, skybox, modelShader, glm::vec4(0, 0, 0, 0), SLmodels, streetLightShader);
+		// Render terrain, skybox and models. Screen space water needs the scene as textures, so it is drawn off
+		// screen and copied across
+		const utility::frame::FrameContext mainFrame = makeFrameContext(camera, glm::vec4(0, 0, 0, 0), frameTime, Pass::MAIN, lightSet);
+		if (screenSpaceWater)
+		{
+			fbos.bindSceneFrameBuffer();
+			render(scene, mainFrame);
+			fbos.presentScene();
+		}
+		else
+		{
+			render(scene, mainFrame);
+		}
 		// TODO: Send in a light when lights are done
 		// Render water
 		glEnable(GL_CLIP_DISTANCE0);
-		water.draw(camera.get_view_transform(), camera.get_clip_transform(), camera.get_position(),
-			glfwGetTime(), glm::vec3(0.0, 50, 0.0), glm::vec3(1.0, 1.0, 1.0), (camera.get_position().y > water.getHeight() - 0.5), camera.get_view_direction());
+		water.draw(mainFrame, glm::vec3(0.0, 50, 0.0), glm::vec3(1.0, 1.0, 1.0), (camera.get_position().y > water.getHeight() - 0.5),
+				   fbos, screenSpaceWater);
 		glDisable(GL_CLIP_DISTANCE0);
+
+#ifdef FARMLIFE_COUNT_ALLOCATIONS
+		// The render path should never touch the heap, report any frame that does
+		const std::size_t frameAllocations = utility::allocation::count() - allocationsBefore;
+		if (frameAllocations != 0)
+		{
+			std::cout << "Render allocations this frame: " << frameAllocations << std::endl;
+		}
+#endif
+
 		//Swap buffers
 		glfwSwapBuffers(window);
 		//Get and organize events, like keyboard and mouse input, window resizing, etc...
@@ -876,9 +1003,11 @@ int main(void)
 
 	// Cleanup (delete buffers etc)
 	terra.cleanup();
+	water.cleanup();
+	lightBuffer.cleanup();
 	fbos.cleanup();
 	camSource.cleanup();
-	alDeleteBuffers(1, &mainMusic);
+	audio::sourcePool().cleanup();
 
 	// Terminate OpenAL
 	alcDestroyContext(context);
@@ -0,0 +1,197 @@
+/**
+ * Uniform grid over the hitboxes in the scene, used for collision and gameplay queries.
+ * The world is split into square cells on the X-Z plane, each cell lists the hitboxes that overlap it.
+ * A query only tests the hitboxes in the cells under the query box, so its cost depends on how crowded
+ * that part of the world is rather than on the total number of hitboxes in the scene.
+ */
+
+#ifndef A1_HITBOX_GRID_HPP
+#define A1_HITBOX_GRID_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "models/model.hpp"
+
+namespace model
+{
+	class HitBoxGrid
+	{
+	public:
+		// A hitbox stored in the grid
+		struct Entry {
+			HitBox hitBox;
+			Model* owner;	// model the hitbox belongs to, may be null
+			bool solid;		// solid hitboxes block the camera, others are only found by queries (gates, triggers)
+		};
+
+		// Precondition:	cellSize is the width of a grid cell in world units, a little larger than a typical hitbox works best
+		// Postcondition:	An empty grid is created
+		HitBoxGrid(float cellSize = 8.0f)
+		{
+			this->cellSize = cellSize;
+			this->queryStamp = 0;
+		}
+
+		///<summary>
+		/// Add a hitbox to the grid, returns a handle that stays valid for the life of the grid.
+		///</summary>
+		int Insert(const HitBox& hitBox, Model* owner = nullptr, bool solid = true)
+		{
+			Entry entry;
+			entry.hitBox = hitBox;
+			entry.owner = owner;
+			entry.solid = solid;
+			entries.push_back(entry);
+			visited.push_back(0);
+
+			int handle = (int)entries.size() - 1;
+			addToCells(handle);
+			return handle;
+		}
+
+		///<summary>
+		/// Move the hitbox with the given handle, used when a model moves or a gate is swapped.
+		///</summary>
+		void Update(int handle, const HitBox& hitBox, Model* owner)
+		{
+			removeFromCells(handle);
+			entries[handle].hitBox = hitBox;
+			entries[handle].owner = owner;
+			addToCells(handle);
+		}
+
+		///<summary>
+		/// Get the entry with the given handle
+		///</summary>
+		const Entry& Get(int handle) const
+		{
+			return entries[handle];
+		}
+
+		///<summary>
+		/// Number of hitboxes in the grid
+		///</summary>
+		size_t Size() const
+		{
+			return entries.size();
+		}
+
+		///<summary>
+		/// Call visit(handle, entry) once for every hitbox overlapping the box at origin with half extents size.
+		/// The grid must not be changed from inside visit.
+		///</summary>
+		template <typename Visitor>
+		void Query(glm::vec3 origin, glm::vec3 size, Visitor visit) const
+		{
+			// Stamp the hitboxes as they are tested so a hitbox spanning several cells is only visited once
+			queryStamp++;
+			int minX, minZ, maxX, maxZ;
+			cellRange(origin, size, minX, minZ, maxX, maxZ);
+			for (int x = minX; x <= maxX; x++)
+			{
+				for (int z = minZ; z <= maxZ; z++)
+				{
+					std::unordered_map<std::int64_t, std::vector<int>>::const_iterator cell = cells.find(cellKey(x, z));
+					if (cell == cells.end())
+					{
+						continue;
+					}
+
+					for (int handle : cell->second)
+					{
+						if (visited[handle] == queryStamp)
+						{
+							continue;
+						}
+						visited[handle] = queryStamp;
+
+						if (overlaps(entries[handle].hitBox, origin, size))
+						{
+							visit(handle, entries[handle]);
+						}
+					}
+				}
+			}
+		}
+
+		///<summary>
+		/// Returns true if the box at origin with half extents size overlaps any solid hitbox
+		///</summary>
+		bool Collides(glm::vec3 origin, glm::vec3 size) const
+		{
+			bool collision = false;
+			Query(origin, size, [&collision](int, const Entry& entry)
+			{
+				if (entry.solid)
+				{
+					collision = true;
+				}
+			});
+			return collision;
+		}
+
+	private:
+		float cellSize;
+		std::vector<Entry> entries;
+		std::unordered_map<std::int64_t, std::vector<int>> cells;	// cell key to the handles of hitboxes overlapping the cell
+
+		// Query stamp of each entry, lets a query skip hitboxes it has already tested
+		mutable std::vector<unsigned int> visited;
+		mutable unsigned int queryStamp;
+
+		// Check each axis for overlap between the two boxes
+		static bool overlaps(const HitBox& hitBox, glm::vec3 origin, glm::vec3 size)
+		{
+			bool xCheck = std::abs(origin.x - hitBox.origin.x) < size.x + hitBox.size.x;
+			bool yCheck = std::abs(origin.y - hitBox.origin.y) < size.y + hitBox.size.y;
+			bool zCheck = std::abs(origin.z - hitBox.origin.z) < size.z + hitBox.size.z;
+			return xCheck && yCheck && zCheck;
+		}
+
+		static std::int64_t cellKey(int x, int z)
+		{
+			return ((std::int64_t)x << 32) | (std::uint32_t)z;
+		}
+
+		// Find the range of cells covered by a box on the X-Z plane
+		void cellRange(glm::vec3 origin, glm::vec3 size, int& minX, int& minZ, int& maxX, int& maxZ) const
+		{
+			minX = (int)std::floor((origin.x - size.x) / cellSize);
+			minZ = (int)std::floor((origin.z - size.z) / cellSize);
+			maxX = (int)std::floor((origin.x + size.x) / cellSize);
+			maxZ = (int)std::floor((origin.z + size.z) / cellSize);
+		}
+
+		void addToCells(int handle)
+		{
+			int minX, minZ, maxX, maxZ;
+			cellRange(entries[handle].hitBox.origin, entries[handle].hitBox.size, minX, minZ, maxX, maxZ);
+			for (int x = minX; x <= maxX; x++)
+			{
+				for (int z = minZ; z <= maxZ; z++)
+				{
+					cells[cellKey(x, z)].push_back(handle);
+				}
+			}
+		}
+
+		void removeFromCells(int handle)
+		{
+			int minX, minZ, maxX, maxZ;
+			cellRange(entries[handle].hitBox.origin, entries[handle].hitBox.size, minX, minZ, maxX, maxZ);
+			for (int x = minX; x <= maxX; x++)
+			{
+				for (int z = minZ; z <= maxZ; z++)
+				{
+					std::vector<int>& cell = cells[cellKey(x, z)];
+					cell.erase(std::remove(cell.begin(), cell.end(), handle), cell.end());
+				}
+			}
+		}
+	};
+}
+
+#endif // A1_HITBOX_GRID_HPP
@@ -0,0 +1,109 @@
+/**
+ * Micro-benchmark of HitBoxGrid. Hitboxes are spread over a square that grows with their number, so the density
+ * around a query stays the same, and camera sized boxes are tested against them with the grid and with a linear scan
+ * of every hitbox. The grid is timed at random points, and along a walk like the camera's where each query is close
+ * to the last. Its cost per query should stay flat from 100 to 100,000 hitboxes while the scan grows with the count.
+ */
+
+#include "util/benchmarkPrelude.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "models/hitBoxGrid.hpp"
+
+namespace
+{
+	const int QUERIES = 200000;
+	const float AREA_PER_BOX = 64.0f;	// one hitbox per 8 x 8 units, about one per grid cell
+	const glm::vec3 CAMERA_SIZE(0.5f, 1.0f, 0.5f);
+	const float WALK_STEP = 0.25f;		// distance the camera moves between queries
+
+	// The check the camera used before the grid, every hitbox is tested
+	bool linearCollides(const std::vector<model::HitBox>& hitBoxes, glm::vec3 origin, glm::vec3 size)
+	{
+		for (const model::HitBox& hitBox : hitBoxes)
+		{
+			if (std::abs(origin.x - hitBox.origin.x) < size.x + hitBox.size.x &&
+				std::abs(origin.y - hitBox.origin.y) < size.y + hitBox.size.y &&
+				std::abs(origin.z - hitBox.origin.z) < size.z + hitBox.size.z)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Returns the average time of a query in nanoseconds, hits counts the queries that found a solid hitbox
+	template <typename Collides>
+	double timeQueries(const std::vector<glm::vec3>& queries, Collides collides, int& hits)
+	{
+		hits = 0;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (const glm::vec3& origin : queries)
+		{
+			hits += collides(origin) ? 1 : 0;
+		}
+		std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+		return elapsed.count() / queries.size();
+	}
+}
+
+int main()
+{
+	const int counts[] = { 100, 1000, 10000, 100000 };
+	std::mt19937 random(1);
+	std::printf("%8s %18s %16s %16s\n", "hitboxes", "grid walk ns/query", "grid ns/query", "scan ns/query");
+	for (int count : counts)
+	{
+		// Spread the hitboxes at a constant density
+		const float side = std::sqrt(count * AREA_PER_BOX);
+		std::uniform_real_distribution<float> position(0.0f, side);
+		std::uniform_real_distribution<float> extent(0.5f, 3.0f);
+		model::HitBoxGrid grid;
+		std::vector<model::HitBox> hitBoxes;
+		for (int i = 0; i < count; i++)
+		{
+			model::HitBox hitBox;
+			hitBox.origin = glm::vec3(position(random), 0.0f, position(random));
+			hitBox.size = glm::vec3(extent(random), 2.0f, extent(random));
+			grid.Insert(hitBox);
+			hitBoxes.push_back(hitBox);
+		}
+
+		std::vector<glm::vec3> queries;
+		for (int i = 0; i < QUERIES; i++)
+		{
+			queries.push_back(glm::vec3(position(random), 1.0f, position(random)));
+		}
+
+		// The walk turns a little each step and wraps around the edges of the square
+		std::vector<glm::vec3> walk;
+		std::uniform_real_distribution<float> turn(-0.3f, 0.3f);
+		glm::vec3 camera(side / 2.0f, 1.0f, side / 2.0f);
+		float heading = 0.0f;
+		for (int i = 0; i < QUERIES; i++)
+		{
+			heading += turn(random);
+			camera.x = std::fmod(camera.x + WALK_STEP * std::cos(heading) + side, side);
+			camera.z = std::fmod(camera.z + WALK_STEP * std::sin(heading) + side, side);
+			walk.push_back(camera);
+		}
+
+		// The scan is slow at the larger counts, so it is timed over fewer queries
+		std::vector<glm::vec3> scanQueries(queries.begin(), queries.begin() + std::min(QUERIES, 20000000 / count));
+		int walkHits, gridHits, scanHits, checkHits;
+		double walkTime = timeQueries(walk, [&grid](glm::vec3 origin) { return grid.Collides(origin, CAMERA_SIZE); }, walkHits);
+		double gridTime = timeQueries(queries, [&grid](glm::vec3 origin) { return grid.Collides(origin, CAMERA_SIZE); }, gridHits);
+		double scanTime = timeQueries(scanQueries, [&hitBoxes](glm::vec3 origin) { return linearCollides(hitBoxes, origin, CAMERA_SIZE); }, scanHits);
+		timeQueries(scanQueries, [&grid](glm::vec3 origin) { return grid.Collides(origin, CAMERA_SIZE); }, checkHits);
+		std::printf("%8d %18.0f %16.0f %16.0f%s\n", count, walkTime, gridTime, scanTime, checkHits == scanHits ? "" : "  MISMATCH");
+		if (checkHits != scanHits)
+		{
+			return 1;
+		}
+	}
+	return 0;
+}
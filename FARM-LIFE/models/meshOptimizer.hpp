@@ -0,0 +1,370 @@
+/**
+ * Optimises the triangles of a model mesh when it is loaded (and baked), so drawing it does less work on the GPU.
+ * Identical vertices are welded together, triangles are reordered to reuse the post-transform vertex cache
+ * (Forsyth's linear-speed vertex cache optimisation), runs of triangles that start a fresh cache are sorted
+ * outside-in to cut overdraw, and the vertices are renumbered in the order the triangles first use them so
+ * vertex fetches walk forwards through memory. The average cache miss ratio (ACMR) of the mesh is measured
+ * before and after with a FIFO cache like the hardware's.
+ */
+
+#ifndef A1_MESH_OPTIMIZER_HPP
+#define A1_MESH_OPTIMIZER_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include "models/vertexFormat.hpp"
+
+namespace model {
+	namespace optimize {
+		const int FIFO_CACHE_SIZE = 16;		// post-transform cache the ACMR and cluster boundaries are measured with
+		const int SCORE_CACHE_SIZE = 32;	// LRU cache the vertex scores are calculated for
+
+		///<summary>
+		/// Average number of vertices transformed per triangle by a FIFO cache of FIFO_CACHE_SIZE entries,
+		/// between 0.5 (best possible for a large grid) and 3 (no reuse at all).
+		///</summary>
+		inline float ACMR(const std::vector<GLuint>& indices, size_t vertexCount)
+		{
+			if (indices.size() < 3)
+			{
+				return 0.0f;
+			}
+			// A vertex is in the cache if it was transformed within the last FIFO_CACHE_SIZE misses
+			std::vector<size_t> missedAt(vertexCount, 0);
+			size_t misses = 0;
+			for (GLuint index : indices)
+			{
+				if (missedAt[index] == 0 || misses - missedAt[index] >= (size_t)FIFO_CACHE_SIZE)
+				{
+					misses++;
+					missedAt[index] = misses;
+				}
+			}
+			return (float)misses / (indices.size() / 3);
+		}
+
+		///<summary>
+		/// Merge vertices with exactly the same attributes and point the indices at the survivors.
+		/// Negative zeros are made positive first, so attributes that are equal in value are welded.
+		///</summary>
+		inline void WeldVertices(std::vector<Vertex>& vertices, std::vector<GLuint>& indices)
+		{
+			// Vertices are hashed and compared on their bytes, where -0.0f and 0.0f differ
+			for (Vertex& vertex : vertices)
+			{
+				float* values = (float*)&vertex;
+				for (size_t i = 0; i < sizeof(Vertex) / sizeof(float); i++)
+				{
+					if (values[i] == 0.0f)
+					{
+						values[i] = 0.0f;
+					}
+				}
+			}
+
+			// Open addressing table of the vertices kept so far, hashed on their bytes
+			size_t tableSize = 1;
+			while (tableSize < vertices.size() * 2)
+			{
+				tableSize *= 2;
+			}
+			const GLuint EMPTY = 0xFFFFFFFF;
+			std::vector<GLuint> table(tableSize, EMPTY);
+			auto hash = [](const Vertex& vertex) {
+				const unsigned char* bytes = (const unsigned char*)&vertex;
+				size_t value = 2166136261u;
+				for (size_t i = 0; i < sizeof(Vertex); i++)
+				{
+					value = (value ^ bytes[i]) * 16777619u;
+				}
+				return value;
+			};
+
+			std::vector<GLuint> remap(vertices.size());
+			std::vector<Vertex> welded;
+			welded.reserve(vertices.size());
+			for (size_t i = 0; i < vertices.size(); i++)
+			{
+				size_t slot = hash(vertices[i]) & (tableSize - 1);
+				while (table[slot] != EMPTY && memcmp(&welded[table[slot]], &vertices[i], sizeof(Vertex)) != 0)
+				{
+					slot = (slot + 1) & (tableSize - 1);
+				}
+				if (table[slot] == EMPTY)
+				{
+					table[slot] = (GLuint)welded.size();
+					welded.push_back(vertices[i]);
+				}
+				remap[i] = table[slot];
+			}
+			for (GLuint& index : indices)
+			{
+				index = remap[index];
+			}
+			vertices.swap(welded);
+		}
+
+		// Forsyth's score for a vertex at cachePosition (-1 if it isn't cached) that has activeTriangles left to draw
+		inline float VertexScore(int cachePosition, int activeTriangles)
+		{
+			if (activeTriangles == 0)
+			{
+				return -1.0f;
+			}
+			float score = 0.0f;
+			if (cachePosition >= 0 && cachePosition < 3)
+			{
+				// The vertices of the last triangle score the same, so strips aren't favoured over fans
+				score = 0.75f;
+			}
+			else if (cachePosition >= 3)
+			{
+				score = std::pow(1.0f - (float)(cachePosition - 3) / (SCORE_CACHE_SIZE - 3), 1.5f);
+			}
+			// Vertices with few triangles left are finished off first so they don't become stragglers
+			return score + 2.0f * std::pow((float)activeTriangles, -0.5f);
+		}
+
+		///<summary>
+		/// Reorder the triangles so each one reuses as many recently transformed vertices as possible.
+		/// Tom Forsyth, "Linear-Speed Vertex Cache Optimisation", 2006.
+		///</summary>
+		inline void OptimizeVertexCache(std::vector<GLuint>& indices, size_t vertexCount)
+		{
+			const size_t triangleCount = indices.size() / 3;
+			if (triangleCount == 0)
+			{
+				return;
+			}
+
+			// Triangles of each vertex, the first activeTriangles of each list are still to be drawn
+			std::vector<GLuint> adjacencyOffset(vertexCount + 1, 0);
+			for (GLuint index : indices)
+			{
+				adjacencyOffset[index + 1]++;
+			}
+			for (size_t v = 0; v < vertexCount; v++)
+			{
+				adjacencyOffset[v + 1] += adjacencyOffset[v];
+			}
+			std::vector<GLuint> adjacency(indices.size());
+			std::vector<int> activeTriangles(vertexCount, 0);
+			for (size_t i = 0; i < indices.size(); i++)
+			{
+				GLuint v = indices[i];
+				adjacency[adjacencyOffset[v] + activeTriangles[v]++] = (GLuint)(i / 3);
+			}
+
+			std::vector<int> cachePosition(vertexCount, -1);
+			std::vector<float> vertexScore(vertexCount);
+			for (size_t v = 0; v < vertexCount; v++)
+			{
+				vertexScore[v] = VertexScore(-1, activeTriangles[v]);
+			}
+			std::vector<float> triangleScore(triangleCount);
+			std::vector<bool> emitted(triangleCount, false);
+			for (size_t t = 0; t < triangleCount; t++)
+			{
+				triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+			}
+
+			std::vector<GLuint> ordered;
+			ordered.reserve(indices.size());
+			std::vector<GLuint> cache;
+			std::vector<GLuint> nextCache;
+			size_t cursor = 0;		// triangles before this have all been emitted, for when the cache has nothing left
+			long best = -1;
+			while (ordered.size() < indices.size())
+			{
+				if (best == -1)
+				{
+					while (emitted[cursor])
+					{
+						cursor++;
+					}
+					best = (long)cursor;
+				}
+
+				// Emit the triangle and take it off its vertices' lists
+				emitted[best] = true;
+				nextCache.clear();
+				for (int corner = 0; corner < 3; corner++)
+				{
+					GLuint v = indices[best * 3 + corner];
+					ordered.push_back(v);
+					nextCache.push_back(v);
+					GLuint* list = &adjacency[adjacencyOffset[v]];
+					GLuint* end = list + activeTriangles[v];
+					std::swap(*std::find(list, end, (GLuint)best), *(end - 1));
+					activeTriangles[v]--;
+				}
+
+				// Move its vertices to the front of the cache, vertices pushed past the end are dropped
+				for (GLuint v : cache)
+				{
+					if (v != nextCache[0] && v != nextCache[1] && v != nextCache[2])
+					{
+						nextCache.push_back(v);
+					}
+				}
+				cache.swap(nextCache);
+				for (size_t i = 0; i < cache.size(); i++)
+				{
+					cachePosition[cache[i]] = i < (size_t)SCORE_CACHE_SIZE ? (int)i : -1;
+				}
+
+				// Rescore the cached vertices and their triangles, the best of those is drawn next
+				best = -1;
+				float bestScore = -1.0f;
+				for (GLuint v : cache)
+				{
+					vertexScore[v] = VertexScore(cachePosition[v], activeTriangles[v]);
+				}
+				for (GLuint v : cache)
+				{
+					for (int a = 0; a < activeTriangles[v]; a++)
+					{
+						GLuint t = adjacency[adjacencyOffset[v] + a];
+						triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+						if (triangleScore[t] > bestScore)
+						{
+							bestScore = triangleScore[t];
+							best = t;
+						}
+					}
+				}
+				if (cache.size() > (size_t)SCORE_CACHE_SIZE)
+				{
+					cache.resize(SCORE_CACHE_SIZE);
+				}
+			}
+			indices.swap(ordered);
+		}
+
+		///<summary>
+		/// Sort the runs of triangles that start with a cold cache so those facing out from the middle of the mesh
+		/// are drawn first and hide the ones behind them. The runs keep their own order so the cache use is unchanged.
+		/// Based on Sander, Nehab and Barczak, "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw", 2007.
+		///</summary>
+		inline void OptimizeOverdraw(std::vector<GLuint>& indices, const std::vector<Vertex>& vertices)
+		{
+			const size_t triangleCount = indices.size() / 3;
+
+			// A run starts at every triangle whose three vertices all miss the cache
+			std::vector<size_t> runStart;
+			std::vector<size_t> missedAt(vertices.size(), 0);
+			size_t misses = 0;
+			for (size_t t = 0; t < triangleCount; t++)
+			{
+				int triangleMisses = 0;
+				for (int corner = 0; corner < 3; corner++)
+				{
+					GLuint index = indices[t * 3 + corner];
+					if (missedAt[index] == 0 || misses - missedAt[index] >= (size_t)FIFO_CACHE_SIZE)
+					{
+						misses++;
+						missedAt[index] = misses;
+						triangleMisses++;
+					}
+				}
+				if (triangleMisses == 3)
+				{
+					runStart.push_back(t);
+				}
+			}
+			if (runStart.size() < 2)
+			{
+				return;
+			}
+			runStart.push_back(triangleCount);
+
+			// Area weighted centre and normal of each run, and the centre of the whole mesh
+			struct Run {
+				size_t first;
+				size_t last;
+				float outwards;		// how far the run faces away from the centre of the mesh
+			};
+			std::vector<Run> runs(runStart.size() - 1);
+			std::vector<glm::vec3> runCentre(runs.size());
+			std::vector<glm::vec3> runNormal(runs.size());
+			glm::vec3 meshCentre(0.0f);
+			float meshArea = 0.0f;
+			for (size_t r = 0; r < runs.size(); r++)
+			{
+				runs[r].first = runStart[r];
+				runs[r].last = runStart[r + 1];
+				glm::vec3 centre(0.0f);
+				glm::vec3 normal(0.0f);
+				float area = 0.0f;
+				for (size_t t = runs[r].first; t < runs[r].last; t++)
+				{
+					const glm::vec3& a = vertices[indices[t * 3]].Position;
+					const glm::vec3& b = vertices[indices[t * 3 + 1]].Position;
+					const glm::vec3& c = vertices[indices[t * 3 + 2]].Position;
+					glm::vec3 cross = glm::cross(b - a, c - a);
+					float triangleArea = glm::length(cross);
+					centre += (a + b + c) / 3.0f * triangleArea;
+					normal += cross;
+					area += triangleArea;
+				}
+				runCentre[r] = area > 0.0f ? centre / area : centre;
+				runNormal[r] = glm::length(normal) > 0.0f ? glm::normalize(normal) : normal;
+				meshCentre += centre;
+				meshArea += area;
+			}
+			if (meshArea > 0.0f)
+			{
+				meshCentre /= meshArea;
+			}
+			for (size_t r = 0; r < runs.size(); r++)
+			{
+				runs[r].outwards = glm::dot(runCentre[r] - meshCentre, runNormal[r]);
+			}
+
+			std::stable_sort(runs.begin(), runs.end(), [](const Run& a, const Run& b) { return a.outwards > b.outwards; });
+			std::vector<GLuint> sorted;
+			sorted.reserve(indices.size());
+			for (const Run& run : runs)
+			{
+				sorted.insert(sorted.end(), indices.begin() + run.first * 3, indices.begin() + run.last * 3);
+			}
+			indices.swap(sorted);
+		}
+
+		///<summary>
+		/// Renumber the vertices in the order the indices first use them, dropping any that are never used.
+		///</summary>
+		inline void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<GLuint>& indices)
+		{
+			const GLuint UNUSED = 0xFFFFFFFF;
+			std::vector<GLuint> remap(vertices.size(), UNUSED);
+			std::vector<Vertex> ordered;
+			ordered.reserve(vertices.size());
+			for (GLuint& index : indices)
+			{
+				if (remap[index] == UNUSED)
+				{
+					remap[index] = (GLuint)ordered.size();
+					ordered.push_back(vertices[index]);
+				}
+				index = remap[index];
+			}
+			vertices.swap(ordered);
+		}
+
+		///<summary>
+		/// Run every optimisation on a mesh.
+		///</summary>
+		inline void OptimizeMesh(std::vector<Vertex>& vertices, std::vector<GLuint>& indices)
+		{
+			WeldVertices(vertices, indices);
+			OptimizeVertexCache(indices, vertices.size());
+			OptimizeOverdraw(indices, vertices);
+			OptimizeVertexFetch(vertices, indices);
+		}
+	}
+}
+
+#endif // A1_MESH_OPTIMIZER_HPP
@@ -0,0 +1,392 @@
+/**
+ * Builds simplified versions of a model mesh for drawing it far away, by quadric edge collapse (Garland and
+ * Heckbert, "Surface Simplification Using Quadric Error Metrics", 1997). A simplified mesh is a new index list
+ * over the original vertices, so every level of detail shares one vertex buffer.
+ * Collapses join vertices by position, so the copies of a vertex on a texture or normal seam move together and
+ * the mesh doesn't tear. Each collapse moves one vertex onto a neighbour, picking the neighbour's copy with the
+ * closest normal and texture coordinates. Open borders can only collapse along themselves, and a collapse is
+ * skipped if it would flip a triangle over.
+ */
+
+#ifndef A1_MESH_SIMPLIFIER_HPP
+#define A1_MESH_SIMPLIFIER_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include "models/vertexFormat.hpp"
+
+namespace model {
+	namespace optimize {
+		// Symmetric 4x4 matrix summing squared distances to planes, with the total weight of the planes
+		struct Quadric {
+			float a00 = 0, a01 = 0, a02 = 0, a03 = 0;
+			float a11 = 0, a12 = 0, a13 = 0;
+			float a22 = 0, a23 = 0;
+			float a33 = 0;
+			float weight = 0;
+
+			// Add the plane through point with unit normal, weighted
+			void addPlane(const glm::vec3& normal, const glm::vec3& point, float planeWeight)
+			{
+				float d = -glm::dot(normal, point);
+				a00 += planeWeight * normal.x * normal.x; a01 += planeWeight * normal.x * normal.y;
+				a02 += planeWeight * normal.x * normal.z; a03 += planeWeight * normal.x * d;
+				a11 += planeWeight * normal.y * normal.y; a12 += planeWeight * normal.y * normal.z;
+				a13 += planeWeight * normal.y * d;
+				a22 += planeWeight * normal.z * normal.z; a23 += planeWeight * normal.z * d;
+				a33 += planeWeight * d * d;
+				weight += planeWeight;
+			}
+
+			void add(const Quadric& other)
+			{
+				a00 += other.a00; a01 += other.a01; a02 += other.a02; a03 += other.a03;
+				a11 += other.a11; a12 += other.a12; a13 += other.a13;
+				a22 += other.a22; a23 += other.a23;
+				a33 += other.a33;
+				weight += other.weight;
+			}
+
+			// Weighted sum of squared distances from p to the planes
+			float error(const glm::vec3& p) const
+			{
+				float value = a00 * p.x * p.x + 2 * a01 * p.x * p.y + 2 * a02 * p.x * p.z + 2 * a03 * p.x
+					+ a11 * p.y * p.y + 2 * a12 * p.y * p.z + 2 * a13 * p.y
+					+ a22 * p.z * p.z + 2 * a23 * p.z
+					+ a33;
+				return value > 0.0f ? value : 0.0f;
+			}
+		};
+
+		const float BORDER_WEIGHT = 10.0f;	// how much more an open border resists moving than a surface
+
+		///<summary>
+		/// Returns indices of a simplified mesh over the same vertices with at most targetIndexCount indices, unless
+		/// reaching it would move the surface further than maxError. error is set to the furthest the surface moved.
+		///</summary>
+		inline std::vector<GLuint> Simplify(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices,
+											size_t targetIndexCount, float maxError, float& error)
+		{
+			error = 0.0f;
+			const size_t vertexCount = vertices.size();
+
+			// Vertices with the same position share a point, the point's copies are listed together
+			std::vector<GLuint> point(vertexCount);
+			std::vector<GLuint> firstOfPoint;
+			{
+				size_t tableSize = 1;
+				while (tableSize < vertexCount * 2)
+				{
+					tableSize *= 2;
+				}
+				std::vector<GLuint> table(tableSize, 0xFFFFFFFF);
+				for (size_t v = 0; v < vertexCount; v++)
+				{
+					const glm::vec3& position = vertices[v].Position;
+					size_t hash = 2166136261u;
+					const unsigned char* bytes = (const unsigned char*)&position;
+					for (size_t i = 0; i < sizeof(position); i++)
+					{
+						hash = (hash ^ bytes[i]) * 16777619u;
+					}
+					size_t slot = hash & (tableSize - 1);
+					while (table[slot] != 0xFFFFFFFF && memcmp(&vertices[firstOfPoint[table[slot]]].Position, &position, sizeof(position)) != 0)
+					{
+						slot = (slot + 1) & (tableSize - 1);
+					}
+					if (table[slot] == 0xFFFFFFFF)
+					{
+						table[slot] = (GLuint)firstOfPoint.size();
+						firstOfPoint.push_back((GLuint)v);
+					}
+					point[v] = table[slot];
+				}
+			}
+			const size_t pointCount = firstOfPoint.size();
+			std::vector<GLuint> copiesOffset(pointCount + 1, 0);
+			for (size_t v = 0; v < vertexCount; v++)
+			{
+				copiesOffset[point[v] + 1]++;
+			}
+			for (size_t p = 0; p < pointCount; p++)
+			{
+				copiesOffset[p + 1] += copiesOffset[p];
+			}
+			std::vector<GLuint> copies(vertexCount);
+			{
+				std::vector<GLuint> filled(pointCount, 0);
+				for (size_t v = 0; v < vertexCount; v++)
+				{
+					copies[copiesOffset[point[v]] + filled[point[v]]++] = (GLuint)v;
+				}
+			}
+
+			// Each vertex follows the collapses it has been part of to the vertex that replaced it
+			std::vector<GLuint> collapsedTo(vertexCount);
+			for (size_t v = 0; v < vertexCount; v++)
+			{
+				collapsedTo[v] = (GLuint)v;
+			}
+			auto resolve = [&collapsedTo](GLuint v) {
+				GLuint root = v;
+				while (collapsedTo[root] != root)
+				{
+					root = collapsedTo[root];
+				}
+				while (collapsedTo[v] != root)
+				{
+					GLuint next = collapsedTo[v];
+					collapsedTo[v] = root;
+					v = next;
+				}
+				return root;
+			};
+			auto position = [&vertices, &firstOfPoint](GLuint p) -> const glm::vec3& {
+				return vertices[firstOfPoint[p]].Position;
+			};
+
+			// Triangles in points, with the degenerate ones dropped
+			std::vector<GLuint> triangles;
+			auto gatherTriangles = [&]() {
+				triangles.clear();
+				for (size_t i = 0; i + 2 < indices.size(); i += 3)
+				{
+					GLuint a = point[resolve(indices[i])];
+					GLuint b = point[resolve(indices[i + 1])];
+					GLuint c = point[resolve(indices[i + 2])];
+					if (a != b && b != c && a != c)
+					{
+						triangles.push_back(a);
+						triangles.push_back(b);
+						triangles.push_back(c);
+					}
+				}
+			};
+			gatherTriangles();
+
+			// Planes of the triangles around each point, and of the open borders
+			std::vector<Quadric> quadrics(pointCount);
+			std::vector<std::pair<GLuint, GLuint>> edges;	// every directed edge, sorted to find the borders
+			for (size_t t = 0; t < triangles.size(); t += 3)
+			{
+				const glm::vec3& a = position(triangles[t]);
+				const glm::vec3& b = position(triangles[t + 1]);
+				const glm::vec3& c = position(triangles[t + 2]);
+				glm::vec3 cross = glm::cross(b - a, c - a);
+				float area = glm::length(cross) * 0.5f;
+				if (area <= 0.0f)
+				{
+					continue;
+				}
+				glm::vec3 normal = cross / (2.0f * area);
+				for (int corner = 0; corner < 3; corner++)
+				{
+					quadrics[triangles[t + corner]].addPlane(normal, a, area);
+					edges.push_back(std::make_pair(triangles[t + corner], triangles[t + (corner + 1) % 3]));
+				}
+			}
+			std::sort(edges.begin(), edges.end());
+			std::vector<bool> border(pointCount, false);
+			std::vector<std::pair<GLuint, GLuint>> borderEdges;
+			for (size_t t = 0; t < triangles.size(); t += 3)
+			{
+				for (int corner = 0; corner < 3; corner++)
+				{
+					GLuint from = triangles[t + corner];
+					GLuint to = triangles[t + (corner + 1) % 3];
+					if (std::binary_search(edges.begin(), edges.end(), std::make_pair(to, from)))
+					{
+						continue;
+					}
+					// Nothing on the other side, a plane standing up along the edge keeps the border in place
+					const glm::vec3& a = position(from);
+					const glm::vec3& b = position(to);
+					glm::vec3 faceNormal = glm::cross(position(triangles[t + 1]) - position(triangles[t]),
+													  position(triangles[t + 2]) - position(triangles[t]));
+					glm::vec3 side = glm::cross(faceNormal, b - a);
+					float length = glm::length(b - a);
+					if (glm::length(side) > 0.0f)
+					{
+						side = glm::normalize(side);
+						quadrics[from].addPlane(side, a, length * length * BORDER_WEIGHT);
+						quadrics[to].addPlane(side, a, length * length * BORDER_WEIGHT);
+					}
+					border[from] = true;
+					border[to] = true;
+					borderEdges.push_back(std::make_pair(std::min(from, to), std::max(from, to)));
+				}
+			}
+			std::sort(borderEdges.begin(), borderEdges.end());
+
+			// Collapse the cheapest edges in passes, each point takes part in at most one collapse a pass
+			struct Collapse {
+				GLuint from;
+				GLuint to;
+				float cost;
+			};
+			std::vector<Collapse> collapses;
+			std::vector<GLuint> triangleOffset;
+			std::vector<GLuint> pointTriangles;
+			std::vector<bool> touched(pointCount);
+			const float maxCost = maxError * maxError;
+			while (triangles.size() > targetIndexCount)
+			{
+				// Triangles around each point
+				triangleOffset.assign(pointCount + 1, 0);
+				for (GLuint p : triangles)
+				{
+					triangleOffset[p + 1]++;
+				}
+				for (size_t p = 0; p < pointCount; p++)
+				{
+					triangleOffset[p + 1] += triangleOffset[p];
+				}
+				pointTriangles.resize(triangles.size());
+				{
+					std::vector<GLuint> filled(pointCount, 0);
+					for (size_t i = 0; i < triangles.size(); i++)
+					{
+						pointTriangles[triangleOffset[triangles[i]] + filled[triangles[i]]++] = (GLuint)(i / 3);
+					}
+				}
+
+				// Cost of moving either end of each edge onto the other
+				collapses.clear();
+				for (size_t t = 0; t < triangles.size(); t += 3)
+				{
+					for (int corner = 0; corner < 3; corner++)
+					{
+						GLuint a = triangles[t + corner];
+						GLuint b = triangles[t + (corner + 1) % 3];
+						bool borderEdge = std::binary_search(borderEdges.begin(), borderEdges.end(), std::make_pair(std::min(a, b), std::max(a, b)));
+						for (int direction = 0; direction < 2; direction++)
+						{
+							GLuint from = direction == 0 ? a : b;
+							GLuint to = direction == 0 ? b : a;
+							if (border[from] && !borderEdge)
+							{
+								continue;	// a border point would pull the border inwards
+							}
+							Quadric merged = quadrics[from];
+							merged.add(quadrics[to]);
+							Collapse collapse = { from, to, merged.weight > 0.0f ? merged.error(position(to)) / merged.weight : 0.0f };
+							collapses.push_back(collapse);
+						}
+					}
+				}
+				std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) { return x.cost < y.cost; });
+
+				std::fill(touched.begin(), touched.end(), false);
+				size_t removed = 0;
+				size_t wanted = (triangles.size() - targetIndexCount) / 3;
+				bool collapsed = false;
+				for (const Collapse& collapse : collapses)
+				{
+					if (collapse.cost > maxCost || removed >= wanted)
+					{
+						break;
+					}
+					if (touched[collapse.from] || touched[collapse.to])
+					{
+						continue;
+					}
+
+					// Triangles around from that don't contain to must keep facing the same way once from moves
+					bool flips = false;
+					size_t shared = 0;
+					for (GLuint i = triangleOffset[collapse.from]; i < triangleOffset[collapse.from + 1] && !flips; i++)
+					{
+						const GLuint* triangle = &triangles[pointTriangles[i] * 3];
+						if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to)
+						{
+							shared++;
+							continue;
+						}
+						glm::vec3 corners[3];
+						glm::vec3 moved[3];
+						for (int corner = 0; corner < 3; corner++)
+						{
+							corners[corner] = position(triangle[corner]);
+							moved[corner] = triangle[corner] == collapse.from ? position(collapse.to) : corners[corner];
+						}
+						glm::vec3 before = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+						glm::vec3 after = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+						flips = glm::dot(before, after) <= 0.0f;
+					}
+					if (flips)
+					{
+						continue;
+					}
+
+					// Move every copy of from onto the copy of to that looks most like it
+					for (GLuint c = copiesOffset[collapse.from]; c < copiesOffset[collapse.from + 1]; c++)
+					{
+						GLuint copy = copies[c];
+						if (resolve(copy) != copy)
+						{
+							continue;
+						}
+						GLuint best = copy;
+						float bestDifference = 0.0f;
+						for (GLuint d = copiesOffset[collapse.to]; d < copiesOffset[collapse.to + 1]; d++)
+						{
+							GLuint candidate = copies[d];
+							if (resolve(candidate) != candidate)
+							{
+								continue;
+							}
+							glm::vec3 normalDifference = vertices[candidate].Normal - vertices[copy].Normal;
+							glm::vec2 texCoordDifference = vertices[candidate].TexCoords - vertices[copy].TexCoords;
+							float difference = glm::dot(normalDifference, normalDifference) + glm::dot(texCoordDifference, texCoordDifference);
+							if (best == copy || difference < bestDifference)
+							{
+								best = candidate;
+								bestDifference = difference;
+							}
+						}
+						collapsedTo[copy] = best;
+					}
+					quadrics[collapse.to].add(quadrics[collapse.from]);
+					error = std::max(error, collapse.cost);
+
+					// The neighbourhood has changed, leave it until the next pass
+					for (GLuint i = triangleOffset[collapse.from]; i < triangleOffset[collapse.from + 1]; i++)
+					{
+						const GLuint* triangle = &triangles[pointTriangles[i] * 3];
+						touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = true;
+					}
+					touched[collapse.to] = true;
+					removed += shared;
+					collapsed = true;
+				}
+				if (!collapsed)
+				{
+					break;
+				}
+				gatherTriangles();
+			}
+			error = std::sqrt(error);
+
+			// The simplified triangles in vertices
+			std::vector<GLuint> simplified;
+			simplified.reserve(triangles.size());
+			for (size_t i = 0; i + 2 < indices.size(); i += 3)
+			{
+				GLuint a = resolve(indices[i]);
+				GLuint b = resolve(indices[i + 1]);
+				GLuint c = resolve(indices[i + 2]);
+				if (point[a] != point[b] && point[b] != point[c] && point[a] != point[c])
+				{
+					simplified.push_back(a);
+					simplified.push_back(b);
+					simplified.push_back(c);
+				}
+			}
+			return simplified;
+		}
+	}
+}
+
+#endif // A1_MESH_SIMPLIFIER_HPP
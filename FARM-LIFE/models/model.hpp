@@ -1,26 +1,35 @@
 #include <assimp/Importer.hpp>
 #include <assimp/postprocess.h>
 #include <assimp/scene.h>
+#include <map>
+#include <memory>
 #include "../audio/audio.hpp"
+#include "../audio/sourcePool.hpp"
 #include "../terrain/terrain.hpp"
 #include "lights/lights.hpp"
+#include "models/meshOptimizer.hpp"
+#include "models/meshSimplifier.hpp"
+#include "models/modelBake.hpp"
+#include "models/vertexFormat.hpp"
+#include "util/frame.hpp"
+#include "util/textureCache.hpp"
+#include "util/jobSystem.hpp"
 
 #ifndef A1_MODEL_HPP
 #define A1_MODEL_HPP
 
 namespace model {
-	GLuint TextureFromFile(const char* path, const std::string& directory);
-
-	// Data structure for the vertex attributes of a model
-	struct Vertex {
-		glm::vec3 Position;
-		glm::vec3 Normal;
-		glm::vec2 TexCoords;	// Texture coordinates
-		// tangent
-		glm::vec3 Tangent;
-		// bitangent
-		glm::vec3 Bitangent;
-	};
+	GLuint TextureFromFile(const char* path, const std::string& directory, const std::string& type);
+
+	///<summary>
+	/// How the texture of a sampler type is stored. Normal and height maps are kept exact, the rest are compressed.
+	///</summary>
+	inline utility::texture::Options TextureOptions(const std::string& type)
+	{
+		bool data = type == "texture_normal" || type == "texture_height";
+		utility::texture::Options options = { data ? utility::texture::DATA : utility::texture::COLOUR, true, SOIL_LOAD_AUTO };
+		return options;
+	}
 
 	// Data structure for the texture of a model
 	struct Texture {
@@ -43,14 +52,181 @@ namespace model {
 		glm::vec3 size;
 	};
 
+	// Texture types of the "material.<type><number>" samplers. Every sampler has a fixed texture unit: a block of
+	// units for each type, and the texture's number within the block. The shaders set their samplers to these units
+	// once and each mesh works out the units of its textures once, so drawing a mesh only binds its textures.
+	static const char* const SAMPLER_TYPES[] = { "texture_diffuse", "texture_specular", "texture_normal", "texture_height" };
+	static const int SAMPLER_TYPE_COUNT = 4;
+	static const int SAMPLERS_PER_TYPE = 4;	// 16 units in all, as many as OpenGL 3.3 promises a fragment shader
+
+	///<summary>
+	/// Returns the texture unit of the sampler for the number'th texture (from 1) of type, or -1 if there is no such sampler.
+	///</summary>
+	inline int SamplerUnit(const std::string& type, unsigned int number)
+	{
+		for (int t = 0; t < SAMPLER_TYPE_COUNT; t++)
+		{
+			if (type == SAMPLER_TYPES[t] && number >= 1 && number <= (unsigned int)SAMPLERS_PER_TYPE)
+			{
+				return t * SAMPLERS_PER_TYPE + number - 1;
+			}
+		}
+		return -1;
+	}
+
+	///<summary>
+	/// Returns the sampler unit of each texture, -1 if no sampler reads it. Textures of a type are numbered from 1 in the
+	/// order they were loaded, so the first diffuse texture is material.texture_diffuse1.
+	/// Source: learnopengl.com
+	///</summary>
+	inline std::vector<int> TextureUnits(const std::vector<Texture>& textures)
+	{
+		unsigned int numbers[SAMPLER_TYPE_COUNT] = { 0, 0, 0, 0 };	// textures of each type so far
+		std::vector<int> units(textures.size(), -1);
+		for (unsigned int i = 0; i < textures.size(); i++)
+		{
+			for (int t = 0; t < SAMPLER_TYPE_COUNT; t++)
+			{
+				if (textures[i].type == SAMPLER_TYPES[t])
+				{
+					units[i] = SamplerUnit(textures[i].type, ++numbers[t]);
+				}
+			}
+		}
+		return units;
+	}
+
+	///<summary>
+	/// Bind each texture to its unit from TextureUnits. The samplers were set to the units when the shader was created,
+	/// so nothing else needs to change between meshes.
+	///</summary>
+	inline void BindTextureUnits(const std::vector<Texture>& textures, const std::vector<int>& units)
+	{
+		for (unsigned int i = 0; i < textures.size(); i++)
+		{
+			if (units[i] != -1)
+			{
+				glActiveTexture(GL_TEXTURE0 + units[i]);
+				glBindTexture(GL_TEXTURE_2D, textures[i].id);
+			}
+		}
+	}
+
+	///<summary>
+	/// A shader program used to draw models, with the locations of its per pass uniforms looked up once after linking.
+	/// The material samplers are set to their fixed texture units here, they never change after.
+	///</summary>
+	struct ModelShader {
+		GLuint program;
+		GLint view;
+		GLint projection;
+		GLint clippingPlane;
+		GLint shininess;
+
+		ModelShader(GLuint program)
+		{
+			this->program = program;
+			view = glGetUniformLocation(program, "view");
+			projection = glGetUniformLocation(program, "projection");
+			clippingPlane = glGetUniformLocation(program, "clippingPlane");
+			shininess = glGetUniformLocation(program, "material.shininess");
+
+			// Lit shaders read the lights from the shared uniform buffer
+			lights::LightBuffer::bindShader(program);
+
+			// Samplers the shader doesn't declare have no location and are skipped
+			glUseProgram(program);
+			char uniformName[64];
+			for (int t = 0; t < SAMPLER_TYPE_COUNT; t++)
+			{
+				for (int number = 1; number <= SAMPLERS_PER_TYPE; number++)
+				{
+					snprintf(uniformName, sizeof(uniformName), "material.%s%d", SAMPLER_TYPES[t], number);
+					GLint location = glGetUniformLocation(program, uniformName);
+					if (location != -1)
+					{
+						glUniform1i(location, SamplerUnit(SAMPLER_TYPES[t], number));
+					}
+				}
+			}
+			glUseProgram(0);
+		}
+
+		///<summary>
+		/// Use the shader and set the uniforms that are shared by every mesh drawn in the render pass.
+		///</summary>
+		void Use(const utility::frame::FrameContext& frame) const
+		{
+			glUseProgram(program);
+			// Set material properties
+			glUniform1f(shininess, 5.0f);
+			// apply view transformations from the camera
+			glUniformMatrix4fv(view, 1, GL_FALSE, &frame.view[0][0]);
+			glUniformMatrix4fv(projection, 1, GL_FALSE, &frame.projection[0][0]);
+			// Add the clipping plane to the shader to clip parts of the scene if needed
+			glUniform4fv(clippingPlane, 1, &frame.clippingPlane[0]);
+		}
+	};
+
+	// Rotation animation state for one mesh of a model instance. Meshes are shared between
+	// instances of the same model, so the animation is stored with the instance instead.
+	struct MeshAnimation {
+		float maxRotation = 0.0f;
+		float minRotation = 0.0f;
+		float currentRotation = 0.0f;
+		float angleOfRotation = 0.0f;	// default is no rotation
+		glm::vec3 axisOfRotation = glm::vec3(0.0f, 1.0f, 0.0f);
+
+		///<summary>Set a rotation transform loop for the mesh, takes a minimum angle, maximum angle,
+		///			an incremental angle between frames and an axis of rotation usually about the Y axis.
+		///</summary>
+		void SetRotationTransformLoop(float minRotation, float maxRotation, float angle, glm::vec3 axis)
+		{
+			this->angleOfRotation = angle;
+			this->axisOfRotation = axis;
+			this->minRotation = minRotation;
+			this->maxRotation = maxRotation;
+		}
+
+		///<summary>Step the rotation by one increment, reversing direction at the minimum and maximum angles.
+		///</summary>
+		void Advance()
+		{
+			// Rotation animation bounds
+			if (currentRotation > maxRotation)
+			{
+				angleOfRotation = -angleOfRotation;
+			}
+			else if (currentRotation < minRotation)
+			{
+				angleOfRotation = -angleOfRotation;
+			}
+
+			currentRotation += angleOfRotation;
+		}
+	};
+
+	// Rotation increments a model's animations take each frame. The scene used to be drawn three times a frame, each
+	// draw stepping the animations, so the angles given to SetRotationTransformLoop were tuned for three steps
+	const int ANIMATION_STEPS_PER_FRAME = 3;
+
+	// Per instance data of an instanced draw
+	struct Instance {
+		glm::mat4 transform;	// model transform
+		float fade;				// dithered cross-fade between two levels of detail, 0 draws every pixel (see model.frag)
+	};
+
 	///<summary>Model mesh attributes and functions</summary
 	class Mesh
 	{
 	public:
 		// Mesh information
-		std::vector<Vertex> vertices;
-		std::vector<GLuint> indices;
+		GLsizei vertexCount;
+		GLsizei indexCount;
+		GLenum indexType;				// GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+		std::vector<MeshLod> lods;		// levels of detail in the index buffer, the full mesh first and coarser after
 		std::vector<Texture> textures;		// need multiple textures for certain meshes, should keep all in memory rather than loading
+		std::vector<int> textureUnits;		// texture unit of each texture's sampler, -1 if no sampler reads it
 		std::string meshName;
 		
 		// Mesh local minimum and maximum vertices values, can be useful for transforms (find center of mesh for a transform)
@@ -58,136 +234,106 @@ namespace model {
 		glm::vec3 maxVertices;
 		glm::vec3 centerOfMesh;
 
-		// Animation transform values
-		float maxRotation;
-		float minRotation;
-		float currentRotation;
-		float angleOfRotation;
-		glm::vec3 axisOfRotation;
-
 		GLuint VAO;
+		VertexLayout layout;	// how the vertices are packed in the vertex buffer
 
 		// Public functions
 
-		// Constructor
-		Mesh(std::vector<Vertex> vertices, std::vector<GLuint> indices, std::vector<Texture> textures, std::string meshName, glm::vec3 minVertices, glm::vec3 maxVertices)
+		// Constructor, the vertex and index data are uploaded and not kept on the CPU
+		Mesh(const MeshData& data, std::vector<Texture> textures)
 		{
 			// Initialize input parameters
-			this->vertices = vertices;
-			this->indices = indices;
+			this->vertexCount = data.vertexCount;
+			this->indexCount = data.indexCount;
+			this->indexType = data.indexType();
 			this->textures = textures;
-			this->minVertices = minVertices;
-			this->maxVertices = maxVertices;
-			this->meshName = meshName;
-
-			// Initialize the default rotation transform (no rotation)
-			this->maxRotation = 0.0f;
-			this->minRotation = 0.0f;
-			this->currentRotation = 0.0f;
-			this->angleOfRotation = 0.0f;
-			this->axisOfRotation = glm::vec3(0.0f, 1.0f, 0.0f);
+			this->minVertices = data.minVertices;
+			this->maxVertices = data.maxVertices;
+			this->meshName = data.name;
+			this->layout = data.layout;
+			this->lods = data.lods;
+			if (lods.empty())
+			{
+				MeshLod full = { 0, indexCount, 0.0f };
+				lods.push_back(full);
+			}
 
 			// Find center of the mesh
 			this->centerOfMesh = glm::vec3(((minVertices.x + maxVertices.x) / 2.0f), ((minVertices.y + maxVertices.y) / 2.0f), ((minVertices.z + maxVertices.z) / 2.0f));
 			
 			// Initialize the mesh buffer objects/arrays
-			initializeMesh();
+			initializeMesh(data);
+			textureUnits = TextureUnits(textures);
 		}
 
 		///<summary>
-		/// Render the mesh in opengl window.
-		/// The mesh may have any number of diffuse and specular textures. We must loop over each texture and bind it to our
-		/// mesh shader appropriately.
-		/// Source: learnopengl.com
+		/// Returns the model transform for one instance of the mesh at position, with the instance's
+		/// rotation animation applied about the center of the mesh.
 		///</summary>
-		void Draw(GLuint shader, glm::mat4 view, glm::mat4 projection, glm::mat4 model, glm::vec3 position, glm::vec4 clippingPlane, glm::vec3 CamPos, glm::vec3 Forward)
-		{
-			unsigned int diffuseNr = 1;	// number to assign to diffuse texture
-			unsigned int specularNr = 1;	// number to assign to specular texture
-			unsigned int normalNr = 1;
-			unsigned int heightNr = 1;
-			for (unsigned int i = 0; i < this->textures.size(); i++)
-			{
-				glActiveTexture(GL_TEXTURE0 + i); // activate proper texture unit before binding
-				// retrieve texture number (using our counters initialized above)
-				std::string number;
-				std::string name = textures[i].type;
-				std::string mater = "material.";
-				if (name == "texture_diffuse")
-					number = std::to_string(diffuseNr++);
-				else if (name == "texture_specular")
-					number = std::to_string(specularNr++);
-				else if (name == "texture_normal")
-					number = std::to_string(normalNr++); // transfer unsigned int to stream
-				else if (name == "texture_height")
-					number = std::to_string(heightNr++); // transfer unsigned int to stream
-
-				// Set the shader sampler to the current texture and bind it
-				glUniform1i(glGetUniformLocation(shader, (mater + name + number).c_str()), i); //needs to be material.2DSampler *********Error here I think
-				glBindTexture(GL_TEXTURE_2D, textures[i].id);
-				//std::cout << " " << mater << name << number << " "; //--Indicates we only have diffuse maps for our models
-			}
-			
-			//******************************************************************************************************************************************
-			
-			lights::light lighting(shader);
-			shader = lighting.setup(CamPos, Forward);
-			// Set material properties
-			
-			glUniform1f(glGetUniformLocation(shader, "material.shininess"), 5.0f);
-
-
-			//*******************************************************************************************
-			// draw mesh - apply view transformations from the camera
-			glBindVertexArray(VAO);
-			glUniformMatrix4fv(glGetUniformLocation(shader, "view"), 1, GL_FALSE, &view[0][0]);
-			glUniformMatrix4fv(glGetUniformLocation(shader, "projection"), 1, GL_FALSE, &projection[0][0]);
-
-
+		glm::mat4 Transform(glm::vec3 position, const MeshAnimation& animation) const
+		{
 			// Apply the movement transform to the model
-			model = glm::translate(model, position);
+			glm::mat4 model = glm::translate(glm::mat4(1.0f), position);
 
-			// Rotation animation bounds
-			if (currentRotation > maxRotation)
-			{
-				angleOfRotation = -angleOfRotation;
-			}
-			else if (currentRotation < minRotation)
-			{
-				angleOfRotation = -angleOfRotation;
-			}
-				
 			// Apply rotation transform
-			currentRotation += angleOfRotation;
 			model = glm::translate(model, centerOfMesh);
-			model = glm::rotate(model, currentRotation, axisOfRotation);
+			model = glm::rotate(model, animation.currentRotation, animation.axisOfRotation);
 			model = glm::translate(model, -centerOfMesh);
+			return model;
+		}
 
-			glUniformMatrix4fv(glGetUniformLocation(shader, "model"), 1, GL_FALSE, &model[0][0]);
-			// Add the clipping plane to the shader to clip parts of the scene if needed
-			glUniform4f(glGetUniformLocation(shader, "clippingPlane"), clippingPlane[0], clippingPlane[1], clippingPlane[2], clippingPlane[3]);
-			// Draw the model
-			glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+		///<summary>
+		/// Bind each texture to the unit of its sampler, the units were worked out when the mesh was loaded.
+		///</summary>
+		void BindTextures() const
+		{
+			BindTextureUnits(textures, textureUnits);
+		}
 
-			// cleanup
-			glBindVertexArray(0);
-			glActiveTexture(GL_TEXTURE0);
+		///<summary>
+		/// Returns true if other binds the same textures in the same order, drawing it after this mesh needs no texture binds.
+		///</summary>
+		bool SameTextures(const Mesh& other) const
+		{
+			if (textures.size() != other.textures.size())
+			{
+				return false;
+			}
+			for (unsigned int i = 0; i < textures.size(); i++)
+			{
+				if (textures[i].id != other.textures[i].id || textureUnits[i] != other.textureUnits[i])
+				{
+					return false;
+				}
+			}
+			return true;
 		}
 
-		///<summary>Set a rotation transform loop for the mesh, takes a minimum angle, maximum angle,
-		///			an incremental angle between frames and an axis of rotation usually about the Y axis.
+		///<summary>
+		/// Upload the instance data and draw count instances of level of detail lod. The mesh's textures and VAO must already be bound.
 		///</summary>
-		void SetRotationTransformLoop(float minRotation, float maxRotation, float angle, glm::vec3 axis)
+		void DrawInstances(const Instance* instances, GLsizei count, int lod)
 		{
-			this->angleOfRotation = angle;
-			this->axisOfRotation = axis;
-			this->minRotation = minRotation;
-			this->maxRotation = maxRotation;
+			// Upload the instance data, the buffer is orphaned each draw so the driver doesn't wait on the previous pass
+			glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+			if (count > instanceCapacity)
+			{
+				instanceCapacity = count;
+			}
+			glBufferData(GL_ARRAY_BUFFER, instanceCapacity * sizeof(Instance), NULL, GL_STREAM_DRAW);
+			glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(Instance), instances);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+			// Draw every instance of the model
+			const GLsizei indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+			glDrawElementsInstanced(GL_TRIANGLES, lods[lod].indexCount, indexType, (void*)((intptr_t)lods[lod].firstIndex * indexSize), count);
 		}
 
 	private:
 		// Private render data
 		GLuint VBO, EBO;
+		GLuint instanceVBO;			// per instance model transforms and fades
+		GLsizei instanceCapacity = 1;	// number of instances the instance buffer holds
 
 		// Private functions
 
@@ -195,7 +341,7 @@ namespace model {
 		/// Creates all of the buffer objects and arrays for the model. (no need for a big block in main.cpp)
 		/// Source: Learnopengl.com
 		///</summary>
-		void initializeMesh()
+		void initializeMesh(const MeshData& data)
 		{
 			// create buffers/arrays
 			glGenVertexArrays(1, &VAO);
@@ -203,213 +349,304 @@ namespace model {
 			glGenBuffers(1, &EBO);
 
 			glBindVertexArray(VAO);
-			// load data into vertex buffers
+			// load data into vertex buffers, already packed to the mesh's layout
 			glBindBuffer(GL_ARRAY_BUFFER, VBO);
-			glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+			glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)vertexCount * layout.stride, data.vertices(), GL_STATIC_DRAW);
 			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-			glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), &indices[0], GL_STATIC_DRAW);
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)indexCount * data.indexSize, data.indices(), GL_STATIC_DRAW);
 
 			// set the vertex attribute pointers
-			// vertex Positions
-			glEnableVertexAttribArray(0);
-			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-			// vertex normals
-			glEnableVertexAttribArray(1);
-			glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-			// vertex texture coords
-			glEnableVertexAttribArray(2);
-			glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-			// vertex tangent
-			glEnableVertexAttribArray(3);
-			glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-			// vertex bitangent
-			glEnableVertexAttribArray(4);
-			glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+			SetVertexAttributes(layout);
+
+			// instance model transforms, a mat4 takes up four attribute locations (5 - 8) that step once per instance
+			glGenBuffers(1, &instanceVBO);
+			glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+			glBufferData(GL_ARRAY_BUFFER, instanceCapacity * sizeof(Instance), NULL, GL_STREAM_DRAW);
+			for (GLuint column = 0; column < 4; column++)
+			{
+				glEnableVertexAttribArray(5 + column);
+				glVertexAttribPointer(5 + column, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)(column * sizeof(glm::vec4)));
+				glVertexAttribDivisor(5 + column, 1);
+			}
+			// instance level of detail fade (9)
+			glEnableVertexAttribArray(9);
+			glVertexAttribPointer(9, 1, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)sizeof(glm::mat4));
+			glVertexAttribDivisor(9, 1);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
 			// cleanup
 			glBindVertexArray(0);
 		}
+
 	};
 
-	class Model {
+	///<summary>
+	/// The shared part of a model: meshes (with their GPU buffers) and textures loaded from one file.
+	/// Assets are cached by path, every Model created from the same file shares a single asset so the
+	/// file is only parsed and uploaded to the GPU once.
+	///</summary>
+	class ModelAsset {
 	public:
-		// Public model data
-		//Texture texture;
 		std::vector<Texture> loadedTextures;
 		std::vector<Mesh> meshes;
 		std::string directory;
-		glm::vec3 position = glm::vec3(0, 0, 0);
-		HitBox hitBox;
-		std::vector<std::string> nodeNames;
+		HitBox hitBox;		// hitbox of the model in its own coordinates
 
-		// Public functions
-
-		// Constructor
-		Model(std::string const& path)
-			: uid(newUID++)
+		///<summary>
+		/// Returns the asset for the model file at path, the file is only loaded the first time it is requested.
+		///</summary>
+		static std::shared_ptr<ModelAsset> Load(std::string const& path)
 		{
-			// Load the model using ASSIMP library with the path to the model
-			loadModel(path);
-			// Initialise the source
-			sound = audio::Source();
+			std::map<std::string, std::shared_ptr<ModelAsset>>& loaded = cache();
+			std::map<std::string, std::shared_ptr<ModelAsset>>::iterator it = loaded.find(path);
+			if (it != loaded.end())
+			{
+				return it->second;
+			}
+
+			std::shared_ptr<ModelAsset> asset(new ModelAsset(path));
+			loaded[path] = asset;
+			return asset;
 		}
 
-		int GetUid()
+		///<summary>
+		/// Start loading the model file at path with the job system. The bake is read (or the file imported and baked)
+		/// and the textures decoded on a worker, then the meshes and textures are uploaded on the main thread.
+		/// Load returns the same asset, it must not be used until the job system has finished the job.
+		///</summary>
+		static void Preload(utility::jobs::JobSystem& jobs, std::string const& path)
 		{
-			return uid;
+			std::map<std::string, std::shared_ptr<ModelAsset>>& loaded = cache();
+			if (loaded.find(path) != loaded.end())
+			{
+				return;
+			}
+
+			std::shared_ptr<ModelAsset> asset(new ModelAsset());
+			loaded[path] = asset;
+			jobs.submit([asset, path]() { asset->prepare(path); }, [asset, path]() { asset->upload(path); });
 		}
 
-		// Precondition:	file is an audio file in wav format. Reference distance is the
-		//					radius the sound is played at full volume at
-		// Postcondition:	sound is played from the source on this model
-		void playSound(const char* file, bool loop, float reference_distance) {
-			GLuint buffer = audio::loadAudio(file);
-			sound.play(buffer);
-			sound.setLooping(loop);
-			sound.setReferenceDistance(reference_distance);
+		///<summary>
+		/// Vertex format that meshes are packed into when they are loaded, change it before loading any models.
+		///</summary>
+		static VertexFormat& Format()
+		{
+			static VertexFormat format;
+			return format;
 		}
 
 		///<summary>
-		/// Draw the model to the open gl window.
-		/// Simply loop over the meshes in our vector and call the draw function of each.
+		/// Whether meshes are welded and reordered for the vertex cache, overdraw and vertex fetches when they
+		/// are loaded with ASSIMP. Change it before loading any models, baked models are rebuilt to match.
 		///</summary>
-		void Draw(GLuint shader, glm::mat4 view, glm::mat4 projection, glm::mat4 model, glm::vec4 clippingPlane, glm::vec3 CamPos, glm::vec3 Forward)
+		static bool& Optimize()
 		{
-			// Draw the model using it's shader
-			glUseProgram(shader);	// use the shader before drawing all the meshes.
-			for (unsigned int i = 0; i < meshes.size(); i++)
-			{
-				meshes[i].Draw(shader, view, projection, model, position, clippingPlane, CamPos, Forward);
-			}
+			static bool optimize = true;
+			return optimize;
+		}
 
-			// Update the sound source position
-			sound.setPosition(position);
+		///<summary>
+		/// How many simplified levels of detail are built for each mesh when it is loaded with ASSIMP, each with about
+		/// half the triangles of the one before. Change it before loading any models, baked models are rebuilt to match.
+		///</summary>
+		static int& LodLevels()
+		{
+			static int levels = 3;
+			return levels;
 		}
 
 		///<summary>
-		/// Move the model to a new position (x,y,z)
+		/// Number of unique model files that have been loaded
 		///</summary>
-		void MoveTo(glm::vec3 coordinates) 
+		static size_t LoadedCount()
 		{
-			position = position + coordinates;
-			hitBox.origin = hitBox.origin + coordinates;
+			return cache().size();
 		}
-		void ShiftTo(glm::vec3 coordinates)
+
+	private:
+		glm::vec3 maxVertices;	// keeps a record of the models overall max(x,y,z) coordinates
+		glm::vec3 minVertices;	// as above for the minimum vertices
+		bool verticesSet = false;	// flag that enables the vertices to be initialized on first loop over the mesh
+		static constexpr float LOD_MAX_ERROR = 0.05f;	// furthest a level of detail may move the surface, as a fraction of the mesh's size
+		size_t optimizedTriangles = 0;	// triangles and cache misses of the meshes optimised, for the ACMR report
+		float missesBefore = 0.0f;
+		float missesAfter = 0.0f;
+		bool prepared = false;			// the meshes were read or imported
+		bake::Reader reader;			// bake the prepared meshes point into, open until they are uploaded
+		std::vector<MeshData> preparedMeshes;
+
+		// Load the model from its bake, or with ASSIMP library if it hasn't been baked
+		ModelAsset(std::string const& path)
 		{
-			position = coordinates;
-			hitBox.origin = coordinates;
+			loadModel(path);
 		}
 
-		glm::vec3 getPosition()
+		// An asset that is loaded by the job system
+		ModelAsset() {}
+
+		// Process wide cache of every asset loaded, keyed by path
+		static std::map<std::string, std::shared_ptr<ModelAsset>>& cache()
 		{
-			return position ;
-			
+			static std::map<std::string, std::shared_ptr<ModelAsset>> loaded;
+			return loaded;
 		}
 
 		///<summary>
-		/// Returns the appropriate terrain height to snap the model to
+		/// Load a model from the bake next to it, the meshes are uploaded straight from the mapped file.
+		/// If there is no current bake the model is loaded using assimp library and baked for next time.
 		///</summary>
-		float GetModelTerrainHeight(terrain::Terrain& terra
-							   , int modelXCoord, int modelYCoord
-							   , int cameraOffsetX, int cameraOffsetY
-			                   , float terraYOffset)
+		void loadModel(std::string const& path)
 		{
-			return terra.getHeightAt(modelXCoord + cameraOffsetX, modelYCoord + cameraOffsetY) + terraYOffset + this->hitBox.size.y;
+			prepare(path);
+			upload(path);
 		}
 
 		///<summary>
-		/// Sets a Rotation animation loop on a specific mesh in the model, takes a meshName (corresponding to a value in the model.obj file -> blender mesh layer name)
-		/// takes a minimum/maximum rotation angle (before the loop reverses), takes an incrementing angle, and an axis to rotate about.
+		/// Everything loading a model needs before OpenGL: read the meshes from the bake, or import and bake them,
+		/// and decode their textures. Doesn't touch the GPU, so the job system runs it on a worker.
 		///</summary>
-		void SetRotationAnimationLoop(std::string meshName, float minRotation, float maxRotation, float angleOfRotation, glm::vec3 axisOfRotation) 
+		void prepare(std::string const& path)
 		{
-			for (int i = 0; i < meshes.size(); i++) 
+			// retrieve the directory path of the filepath
+			directory = path.substr(0, path.find_last_of('/'));
+
+			std::string bakePath = path + ".bake";
+			if (bake::IsCurrent(bakePath, path) && reader.Open(bakePath, Format(), Optimize(), LodLevels()))
 			{
-				if (meshName.compare(meshes[i].meshName) == 0)
+				minVertices = reader.MinVertices();
+				maxVertices = reader.MaxVertices();
+				for (uint32_t i = 0; i < reader.MeshCount(); i++)
 				{
-					meshes[i].SetRotationTransformLoop(minRotation, maxRotation, angleOfRotation, axisOfRotation);
+					preparedMeshes.push_back(reader.Mesh(i, Format()));
 				}
 			}
-		}
-
-		///<summary>
-		/// Overload equals operator
-		///</summary>
-		bool Model::operator==(Model& obj2)
-		{
-			if (this->GetUid() == obj2.GetUid())
-				return true;
 			else
-				return false;
-		}
-
-	private:
-		// Private model data
+			{
+				Assimp::Importer importer;
+				// read file via ASSIMP
+				const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+				// check for errors
+				if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
+				{
+					std::cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << std::endl;
+					return;
+				}
 
-		// Increment unique identifers
-		static int newUID;
+				// process ASSIMP's root node recursively
+				processNode(scene->mRootNode, scene, preparedMeshes);
 
-		// Unique identifier for model
-		const int uid;
+				if (!bake::Write(bakePath, Format(), Optimize(), LodLevels(), minVertices, maxVertices, preparedMeshes))
+				{
+					std::cout << "Could not write the baked model " << bakePath << std::endl;
+				}
+				if (optimizedTriangles > 0)
+				{
+					std::cout << "Model " << path << ": ACMR " << missesBefore / optimizedTriangles << " before optimising, "
+						<< missesAfter / optimizedTriangles << " after" << std::endl;
+				}
+			}
 
-		glm::vec3 maxVertices;	// keeps a record of the models overall max(x,y,z) coordinates
-		glm::vec3 minVertices;	// as above for the minimum vertices
-		bool verticesSet = false;	// flag that enables the vertices to be initialized on first loop over the mesh
-		audio::Source sound;
-		aiNode rootNode;		// stores the root node of the model
+			// Read each texture from its cache, or build it, uploading it is all that is left for the main thread
+			for (const MeshData& data : preparedMeshes)
+			{
+				for (const TextureRef& ref : data.textures)
+				{
+					utility::texture::store(directory + '/' + ref.path, TextureOptions(ref.type));
+				}
+			}
+			prepared = true;
+		}
 
 		///<summary>
-		/// Load a model using assimp library.
+		/// Upload the prepared meshes and their textures, then release the bake. Runs on the main thread.
 		///</summary>
-		void loadModel(std::string const& path)
+		void upload(std::string const& path)
 		{
-			Assimp::Importer importer;
-			// read file via ASSIMP
-			const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
-			// check for errors
-			if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
+			if (!prepared)
 			{
-				std::cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << std::endl;
 				return;
 			}
-			// retrieve the directory path of the filepath
-			directory = path.substr(0, path.find_last_of('/'));
-
-			// process ASSIMP's root node recursively
-			processNode(scene->mRootNode, scene);
+			for (const MeshData& data : preparedMeshes)
+			{
+				addMesh(data);
+			}
+			preparedMeshes.clear();
+			reader.Close();
 
 			// initialize the models hitbox, origin is the minimum vertex in each axis
 			hitBox.origin = glm::vec3((maxVertices.x + minVertices.x) / 2,
 				(maxVertices.y + minVertices.y) / 2, (maxVertices.z + minVertices.z) / 2);
 			hitBox.size = (maxVertices - minVertices) / glm::vec3(2, 2, 2);	// size is just the max - min
+
+			// Report what packing the vertices saved, every vertex fetched by a draw is that much smaller too
+			size_t vertexCount = 0;
+			size_t packedBytes = 0;
+			std::vector<size_t> lodTriangles;
+			for (const Mesh& mesh : meshes)
+			{
+				vertexCount += mesh.vertexCount;
+				packedBytes += (size_t)mesh.vertexCount * mesh.layout.stride;
+				for (size_t l = 0; l < mesh.lods.size(); l++)
+				{
+					lodTriangles.resize(std::max(lodTriangles.size(), l + 1), 0);
+					lodTriangles[l] += mesh.lods[l].indexCount / 3;
+				}
+			}
+			if (vertexCount > 0)
+			{
+				std::cout << "Model " << path << ": " << vertexCount << " vertices, " << packedBytes / 1024 << " KB of vertex buffers ("
+					<< vertexCount * sizeof(Vertex) / 1024 << " KB unpacked, " << (float)packedBytes / vertexCount << " bytes per vertex)" << std::endl;
+				std::cout << "Model " << path << ": triangles per level of detail";
+				for (size_t triangles : lodTriangles)
+				{
+					std::cout << " " << triangles;	// meshes that couldn't be simplified further count towards their own coarsest level only
+				}
+				std::cout << std::endl;
+			}
 		}
 
 		///<summary>
 		/// Recursive function to process all children nodes of a model.
 		/// Source: learnopengl.com
 		///</summary>
-		void processNode(aiNode* node, const aiScene* scene)
+		void processNode(aiNode* node, const aiScene* scene, std::vector<MeshData>& meshData)
 		{
 			//std::cout << "Process Node: " << node->mName.C_Str() << std::endl;
 			// process each mesh located at the current node
 			for (unsigned int i = 0; i < node->mNumMeshes; i++)
 			{
 				aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-				Mesh madeMesh = processMesh(mesh, scene, node->mName.C_Str());
-				meshes.push_back(madeMesh);
+				meshData.push_back(processMesh(mesh, scene, node->mName.C_Str()));
 			}
 			// after processing meshes, check for children nodes of thc current node, recursively process the children.
 			for (unsigned int i = 0; i < node->mNumChildren; i++)
 			{
-				processNode(node->mChildren[i], scene);
+				processNode(node->mChildren[i], scene, meshData);
+			}
+		}
+
+		///<summary>
+		/// Create a mesh from its data and load the textures it uses.
+		///</summary>
+		void addMesh(const MeshData& data)
+		{
+			std::vector<Texture> textures;
+			for (const TextureRef& ref : data.textures)
+			{
+				textures.push_back(loadTexture(ref));
 			}
+			meshes.push_back(Mesh(data, textures));
 		}
 
-		Mesh processMesh(aiMesh* mesh, const aiScene* scene, std::string meshName)
+		///<summary>
+		/// Copy a mesh out of ASSIMP, packing its vertices for the GPU.
+		///</summary>
+		MeshData processMesh(aiMesh* mesh, const aiScene* scene, std::string meshName)
 		{
 			// data to fill
 			std::vector<Vertex> vertices;
 			std::vector<GLuint> indices;
-			std::vector<Texture> textures;
+			std::vector<TextureRef> textures;
 			glm::vec3 localMinVertices = glm::vec3(0.0f, 0.0f, 0.0f);	//used to keep track of each meshes local miniumum/maximum vertices for local center calculation in transforms.
 			glm::vec3 localMaxVertices = glm::vec3(0.0f, 0.0f, 0.0f);
 
@@ -441,6 +678,18 @@ namespace model {
 				}
 				else
 					vertex.TexCoords = glm::vec2(0.0f, 0.0f);
+
+				// tangent frame, calculated by ASSIMP for meshes with texture coordinates
+				if (mesh->mTangents && mesh->mBitangents)
+				{
+					vertex.Tangent = glm::vec3(mesh->mTangents[i].x, mesh->mTangents[i].y, mesh->mTangents[i].z);
+					vertex.Bitangent = glm::vec3(mesh->mBitangents[i].x, mesh->mBitangents[i].y, mesh->mBitangents[i].z);
+				}
+				else
+				{
+					vertex.Tangent = glm::vec3(0.0f, 0.0f, 0.0f);
+					vertex.Bitangent = glm::vec3(0.0f, 0.0f, 0.0f);
+				}
 				vertices.push_back(vertex);
 
 				// find the global min and max vertices for the hitbox
@@ -522,57 +771,133 @@ namespace model {
 			aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
 
 			// 1. diffuse maps
-			std::vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-			textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
+			materialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse", textures);
 			// 2. specular maps
-			std::vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-			textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+			materialTextures(material, aiTextureType_SPECULAR, "texture_specular", textures);
 			// 3. normal maps
-			std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
-			textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
+			size_t texturesBeforeNormals = textures.size();
+			materialTextures(material, aiTextureType_HEIGHT, "texture_normal", textures);
+			bool hasNormalMap = textures.size() > texturesBeforeNormals;
 			// 4. height maps
-			std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
-			textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
+			materialTextures(material, aiTextureType_AMBIENT, "texture_height", textures);
 
 			// TODO: load a simple material color, rather than textures.
 
 			// Sample found at at: https://www.lighthouse3d.com/cg-topics/code-samples/importing-3d-models-with-assimp/
 
-			// return a mesh object created from the extracted mesh data
-			return Mesh(vertices, indices, textures, meshName, localMinVertices, localMaxVertices);
+			// Weld and reorder the triangles, ASSIMP gives every corner of every face its own vertex
+			if (Optimize() && indices.size() >= 3)
+			{
+				size_t triangles = indices.size() / 3;
+				missesBefore += optimize::ACMR(indices, vertices.size()) * triangles;
+				optimize::OptimizeMesh(vertices, indices);
+				missesAfter += optimize::ACMR(indices, vertices.size()) * triangles;
+				optimizedTriangles += triangles;
+			}
+
+			// return the mesh data extracted, with the vertices packed the way they are uploaded (and baked)
+			MeshData data;
+			data.lods = simplifyMesh(vertices, indices);
+			data.name = meshName;
+			data.layout = MakeVertexLayout(Format(), hasNormalMap);	// only meshes with a normal map keep their tangents
+			data.vertexCount = (GLsizei)vertices.size();
+			data.minVertices = localMinVertices;
+			data.maxVertices = localMaxVertices;
+			data.textures = textures;
+			PackVertices(vertices, data.layout, data.vertexStorage);
+			data.SetIndices(indices);
+			return data;
 		}
 
-		std::vector<Texture> loadMaterialTextures(aiMaterial * mat, aiTextureType type, std::string typeName)
+		///<summary>
+		/// Build the simplified levels of detail of a mesh and add their indices after the full mesh's. Each level aims for
+		/// half the triangles of the one before, and the chain stops at the first level that saves less than a quarter.
+		///</summary>
+		std::vector<MeshLod> simplifyMesh(const std::vector<Vertex>& vertices, std::vector<GLuint>& indices)
+		{
+			std::vector<MeshLod> lods;
+			MeshLod full = { 0, (GLsizei)indices.size(), 0.0f };
+			lods.push_back(full);
+			if (vertices.empty() || indices.size() < 3)
+			{
+				return lods;
+			}
+
+			// How far a level may move the surface grows with the size of the mesh
+			glm::vec3 meshMin = vertices[0].Position;
+			glm::vec3 meshMax = vertices[0].Position;
+			for (const Vertex& vertex : vertices)
+			{
+				meshMin = glm::min(meshMin, vertex.Position);
+				meshMax = glm::max(meshMax, vertex.Position);
+			}
+			const float maxError = glm::length(meshMax - meshMin) * LOD_MAX_ERROR;
+
+			// Every level is simplified from the full mesh, so errors don't add up along the chain
+			const std::vector<GLuint> fullIndices = indices;
+			size_t previousCount = fullIndices.size();
+			for (int level = 1; level <= LodLevels(); level++)
+			{
+				size_t target = (fullIndices.size() / 3 >> level) * 3;
+				float error;
+				std::vector<GLuint> simplified = optimize::Simplify(vertices, fullIndices, target, maxError, error);
+				if (simplified.empty() || simplified.size() > previousCount * 3 / 4)
+				{
+					break;
+				}
+				if (Optimize())
+				{
+					optimize::OptimizeVertexCache(simplified, vertices.size());
+				}
+				// A coarser level never counts as closer to the full mesh, so the levels are picked in order
+				MeshLod lod = { (GLsizei)indices.size(), (GLsizei)simplified.size(), std::max(error, lods.back().error) };
+				lods.push_back(lod);
+				indices.insert(indices.end(), simplified.begin(), simplified.end());
+				previousCount = simplified.size();
+			}
+			return lods;
+		}
+
+		///<summary>
+		/// Add the textures of type used by a material to textures.
+		///</summary>
+		void materialTextures(aiMaterial * mat, aiTextureType type, std::string typeName, std::vector<TextureRef>& textures)
 		{
-			std::vector<Texture> textures;
 			for (unsigned int i = 0; i < mat->GetTextureCount(type); i++)
 			{
 				aiString str;
 				mat->GetTexture(type, i, &str);
 
-				// check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-				bool skip = false;
-				for (unsigned int j = 0; j < loadedTextures.size(); j++)
+				TextureRef ref;
+				ref.type = typeName;
+				ref.path = str.C_Str();
+				textures.push_back(ref);
+			}
+		}
+
+		///<summary>
+		/// Returns the texture for ref, the image is only loaded the first time a mesh of the model uses it.
+		///</summary>
+		Texture loadTexture(const TextureRef& ref)
+		{
+			// check if texture was loaded before and if so, skip loading a new texture
+			for (unsigned int j = 0; j < loadedTextures.size(); j++)
+			{
+				if (loadedTextures[j].path == ref.path)
 				{
-					if (std::strcmp(loadedTextures[j].path.data(), str.C_Str()) == 0)
-					{
-						textures.push_back(loadedTextures[j]);
-						skip = true; // texture was already loaded once into memory.
-						break;
-					}
-				}
-				if (!skip)	// the texture has already been loaded, no need to load the same image again.
-				{   
-					Texture texture;
-					texture.id = TextureFromFile(str.C_Str(), this->directory);
-					texture.type = typeName;
-					//std::cout << typeName; //The texture maps don't seem to have a specular type, possibly
-					texture.path = str.C_Str();
-					textures.push_back(texture);
-					loadedTextures.push_back(texture); 
+					// the texture has already been loaded, no need to load the same image again.
+					Texture texture = loadedTextures[j];
+					texture.type = ref.type;
+					return texture;
 				}
 			}
-			return textures;
+
+			Texture texture;
+			texture.id = TextureFromFile(ref.path.c_str(), this->directory, ref.type);
+			texture.type = ref.type;
+			texture.path = ref.path;
+			loadedTextures.push_back(texture);
+			return texture;
 		}
 
 		Material loadMaterial(aiMaterial* mat) {
@@ -599,44 +924,169 @@ namespace model {
 		}
 	};
 
+	class Model {
+	public:
+		// Public model data
+		std::shared_ptr<ModelAsset> asset;	// meshes and textures, shared with every other instance of the same file
+		glm::vec3 position = glm::vec3(0, 0, 0);
+		HitBox hitBox;
+
+		// Public functions
+
+		// Constructor
+		Model(std::string const& path)
+			: uid(newUID++)
+		{
+			// Get the shared meshes for the file, only loaded with ASSIMP the first time the file is used
+			asset = ModelAsset::Load(path);
+			hitBox = asset->hitBox;
+			animations.resize(asset->meshes.size());
+		}
+
+		int GetUid()
+		{
+			return uid;
+		}
+
+		// Precondition:	file is an audio file in wav format. Reference distance is the
+		//					radius the sound is played at full volume at
+		// Postcondition:	sound is played from this model's emitter in the source pool, which is only registered
+		//					the first time the model plays a sound
+		void playSound(const char* file, bool loop, float reference_distance) {
+			if (emitter < 0)
+			{
+				emitter = audio::sourcePool().addEmitter(position);
+			}
+			audio::sourcePool().stop(emitter);
+			if (soundBuffer != 0)
+			{
+				audio::releaseAudio(soundBuffer);
+			}
+			soundBuffer = audio::loadAudio(file);
+			audio::sourcePool().play(emitter, soundBuffer, loop, reference_distance);
+		}
+
+		///<summary>
+		/// Step the rotation animations of the model's meshes, called once per frame before any pass is drawn so the
+		/// animations move at the same speed however many passes draw the model.
+		///</summary>
+		void Animate()
+		{
+			for (MeshAnimation& animation : animations)
+			{
+				for (int step = 0; step < ANIMATION_STEPS_PER_FRAME; step++)
+				{
+					animation.Advance();
+				}
+			}
+		}
+
+		///<summary>
+		/// Returns the model transform of a mesh, with its rotation animation as it is this frame.
+		///</summary>
+		glm::mat4 MeshTransform(unsigned int mesh) const
+		{
+			return asset->meshes[mesh].Transform(position, animations[mesh]);
+		}
+
+		///<summary>
+		/// Move the model to a new position (x,y,z)
+		///</summary>
+		void MoveTo(glm::vec3 coordinates) 
+		{
+			position = position + coordinates;
+			hitBox.origin = hitBox.origin + coordinates;
+			moveSound();
+		}
+		void ShiftTo(glm::vec3 coordinates)
+		{
+			position = coordinates;
+			hitBox.origin = coordinates;
+			moveSound();
+		}
+
+		glm::vec3 getPosition()
+		{
+			return position ;
+			
+		}
+
+		///<summary>
+		/// Returns the appropriate terrain height to snap the model to at world (x, z)
+		///</summary>
+		float GetModelTerrainHeight(const terrain::Heightfield& heightfield, float x, float z)
+		{
+			return heightfield.sampleHeight(x, z) + this->hitBox.size.y;
+		}
+
+		///<summary>
+		/// Sets a Rotation animation loop on a specific mesh in the model, takes a meshName (corresponding to a value in the model.obj file -> blender mesh layer name)
+		/// takes a minimum/maximum rotation angle (before the loop reverses), takes an incrementing angle, and an axis to rotate about.
+		///</summary>
+		void SetRotationAnimationLoop(std::string meshName, float minRotation, float maxRotation, float angleOfRotation, glm::vec3 axisOfRotation) 
+		{
+			for (int i = 0; i < asset->meshes.size(); i++) 
+			{
+				if (meshName.compare(asset->meshes[i].meshName) == 0)
+				{
+					animations[i].SetRotationTransformLoop(minRotation, maxRotation, angleOfRotation, axisOfRotation);
+				}
+			}
+		}
+
+		///<summary>
+		/// Overload equals operator
+		///</summary>
+		bool Model::operator==(Model& obj2)
+		{
+			if (this->GetUid() == obj2.GetUid())
+				return true;
+			else
+				return false;
+		}
+
+	private:
+		// Private model data
+
+		// Increment unique identifers
+		static int newUID;
+
+		// Unique identifier for model
+		const int uid;
+
+		std::vector<MeshAnimation> animations;	// per instance animation state of each mesh in the asset
+		int emitter = -1;		// emitter in the source pool, -1 until the model plays a sound
+		GLuint soundBuffer = 0;	// shared buffer the sound plays from, released when another sound replaces it
+
+		///<summary>
+		/// Keep the emitter at the model, the source pool moves its source once a frame.
+		///</summary>
+		void moveSound()
+		{
+			if (emitter >= 0)
+			{
+				audio::sourcePool().setPosition(emitter, position);
+			}
+		}
+	};
+
 	// Initialise unique identifier incrementer
 	int Model::newUID = 0;
 
-	GLuint TextureFromFile(const char* path, const std::string& directory)
+	GLuint TextureFromFile(const char* path, const std::string& directory, const std::string& type)
 	{
 		std::string filename = std::string(path);
 		filename = directory + '/' + filename;
 
-		GLuint textureID;
-		glGenTextures(1, &textureID);
-
-		int width, height, nrComponents;
-		unsigned char* data = SOIL_load_image(filename.c_str(), &width, &height, &nrComponents, 0);
-		if (data)
+		// Shared with every other model that uses the image, its mip chain comes from the texture cache
+		GLuint textureID = utility::texture::load(filename, TextureOptions(type));
+		if (textureID != 0)
 		{
-			GLenum format = GL_RED;
-			if (nrComponents == 1)
-				format = GL_RED;
-			else if (nrComponents == 3)
-				format = GL_RGB;
-			else if (nrComponents == 4)
-				format = GL_RGBA;
-
-			glBindTexture(GL_TEXTURE_2D, textureID);
-			glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-			glGenerateMipmap(GL_TEXTURE_2D);
-
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 			glBindTexture(GL_TEXTURE_2D, 0);
-			SOIL_free_image_data(data);
-		}
-		else
-		{
-			std::cout << "(SOIL) Texture failed to load at path: " << path << std::endl;
-			SOIL_free_image_data(data);
 		}
 
 		return textureID;
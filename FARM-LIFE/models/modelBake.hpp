@@ -0,0 +1,412 @@
+/**
+ * Baked models: the meshes of a model file saved in the layout they are uploaded to the GPU in.
+ * The first time a model file is loaded it is parsed with ASSIMP and the result is written next to it as
+ * <file>.bake. Later loads map the bake into memory and hand its vertex and index data straight to OpenGL,
+ * so starting the game doesn't parse any OBJ or MTL files. A bake also holds each mesh's name, bounds and
+ * texture references and levels of detail. It is rebuilt when it is older than its model file, was written by
+ * another version or with another vertex format, optimisation or level of detail setting, or its tables point
+ * outside the file.
+ */
+
+#ifndef A1_MODEL_BAKE_HPP
+#define A1_MODEL_BAKE_HPP
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#include "models/vertexFormat.hpp"
+#include "util/mappedFile.hpp"
+
+namespace model {
+	// Texture used by a mesh, as named in the model's material
+	struct TextureRef {
+		std::string type;	// sampler type, texture_diffuse etc.
+		std::string path;	// relative to the model's directory
+	};
+
+	// A level of detail of a mesh, a range of its index buffer drawn over the same vertices
+	struct MeshLod {
+		GLsizei firstIndex;
+		GLsizei indexCount;
+		float error;		// furthest the simplified surface is from the full mesh, in model units
+	};
+
+	///<summary>
+	/// One mesh of a model ready to upload. The vertex and index data are held here when the mesh was just
+	/// built from ASSIMP, or point into a mapped bake when it was loaded from one. Indices are 16 bit when
+	/// there are few enough vertices, 32 bit otherwise. The indices of every level of detail are stored one
+	/// after the other, the full mesh first.
+	///</summary>
+	struct MeshData {
+		std::string name;
+		VertexLayout layout;
+		GLsizei vertexCount = 0;
+		GLsizei indexCount = 0;
+		GLsizei indexSize = sizeof(GLuint);	// bytes per index
+		glm::vec3 minVertices;
+		glm::vec3 maxVertices;
+		std::vector<TextureRef> textures;
+		std::vector<MeshLod> lods;
+
+		std::vector<unsigned char> vertexStorage;
+		std::vector<unsigned char> indexStorage;
+		const unsigned char* mappedVertices = nullptr;
+		const unsigned char* mappedIndices = nullptr;
+
+		const unsigned char* vertices() const
+		{
+			return mappedVertices != nullptr ? mappedVertices : vertexStorage.data();
+		}
+
+		const unsigned char* indices() const
+		{
+			return mappedIndices != nullptr ? mappedIndices : indexStorage.data();
+		}
+
+		GLenum indexType() const
+		{
+			return indexSize == sizeof(GLushort) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+		}
+
+		///<summary>
+		/// Store indices in 16 bits if every vertex can be addressed with them, otherwise in 32 bits.
+		///</summary>
+		void SetIndices(const std::vector<GLuint>& source)
+		{
+			indexCount = (GLsizei)source.size();
+			indexSize = vertexCount <= 0xFFFF ? sizeof(GLushort) : sizeof(GLuint);
+			indexStorage.resize(source.size() * indexSize);
+			for (size_t i = 0; i < source.size(); i++)
+			{
+				if (indexSize == sizeof(GLushort))
+				{
+					GLushort index = (GLushort)source[i];
+					memcpy(&indexStorage[i * indexSize], &index, sizeof(index));
+				}
+				else
+				{
+					memcpy(&indexStorage[i * indexSize], &source[i], sizeof(GLuint));
+				}
+			}
+		}
+	};
+
+	namespace bake {
+		const uint32_t MAGIC = 0x424D4C46;	// "FLMB"
+		const uint32_t VERSION = 3;
+		const size_t DATA_ALIGNMENT = 16;	// vertex and index blocks start on this boundary
+
+		// The file starts with a header and the table of meshes, then the texture table, the level of detail
+		// table, the strings and the data blocks. Offsets are from the start of the file.
+		struct FileHeader {
+			uint32_t magic;
+			uint32_t version;
+			uint32_t format;		// VertexFormat, optimisation and level of detail flags the meshes were built with
+			uint32_t meshCount;
+			float minVertices[3];	// bounds of the whole model
+			float maxVertices[3];
+		};
+
+		struct MeshRecord {
+			uint64_t vertexOffset;
+			uint64_t indexOffset;
+			uint32_t vertexCount;
+			uint32_t indexCount;
+			uint32_t indexSize;		// bytes per index
+			int32_t stride;			// VertexLayout of the vertices
+			int32_t normal;
+			int32_t texCoords;
+			int32_t tangent;
+			uint32_t nameOffset;
+			uint32_t nameLength;
+			uint32_t textureOffset;	// first TextureRecord of the mesh
+			uint32_t textureCount;
+			uint32_t lodOffset;		// first LodRecord of the mesh
+			uint32_t lodCount;
+			float minVertices[3];
+			float maxVertices[3];
+		};
+
+		struct TextureRecord {
+			uint32_t typeOffset;
+			uint32_t typeLength;
+			uint32_t pathOffset;
+			uint32_t pathLength;
+		};
+
+		struct LodRecord {
+			uint32_t firstIndex;
+			uint32_t indexCount;
+			float error;
+		};
+
+		inline uint32_t FormatFlags(const VertexFormat& format, bool optimized, int lodLevels)
+		{
+			return (format.packedNormals ? 1 : 0) | (format.halfTexCoords ? 2 : 0) | (format.tangents ? 4 : 0) | (optimized ? 8 : 0)
+				| ((uint32_t)lodLevels << 4);
+		}
+
+		// Precondition:	None
+		// Postcondition:	Returns true if the bake at bakePath exists and is at least as new as the model file
+		inline bool IsCurrent(const std::string& bakePath, const std::string& sourcePath)
+		{
+			struct stat bakeStatus;
+			struct stat sourceStatus;
+			if (stat(bakePath.c_str(), &bakeStatus) != 0)
+			{
+				return false;
+			}
+			// Without the model file the bake is all there is
+			return stat(sourcePath.c_str(), &sourceStatus) != 0 || bakeStatus.st_mtime >= sourceStatus.st_mtime;
+		}
+
+		// Precondition:	meshes hold their own vertex and index data, packed with format, optimised if optimized and
+		//					simplified up to lodLevels times
+		// Postcondition:	The meshes are written to path as a bake, returns false if the file couldn't be written
+		inline bool Write(const std::string& path, const VertexFormat& format, bool optimized, int lodLevels,
+						  const glm::vec3& minVertices, const glm::vec3& maxVertices, const std::vector<MeshData>& meshes)
+		{
+			// Every record is value initialised before it is filled in, so padding is written as zeros and the same
+			// meshes always give the same bake
+			std::vector<unsigned char> blob(sizeof(FileHeader) + meshes.size() * sizeof(MeshRecord));
+			std::vector<MeshRecord> records(meshes.size(), MeshRecord());
+			std::vector<TextureRecord> textures;
+			std::vector<LodRecord> lods;
+
+			auto append = [&blob](const void* data, size_t size) {
+				size_t offset = blob.size();
+				blob.insert(blob.end(), (const unsigned char*)data, (const unsigned char*)data + size);
+				return offset;
+			};
+			auto align = [&blob]() {
+				blob.resize((blob.size() + DATA_ALIGNMENT - 1) / DATA_ALIGNMENT * DATA_ALIGNMENT);
+			};
+
+			// Strings first, the texture table is counted up as it goes and written after
+			for (size_t i = 0; i < meshes.size(); i++)
+			{
+				const MeshData& mesh = meshes[i];
+				MeshRecord& record = records[i];
+				record.nameOffset = (uint32_t)append(mesh.name.data(), mesh.name.size());
+				record.nameLength = (uint32_t)mesh.name.size();
+				record.textureOffset = (uint32_t)textures.size();
+				record.textureCount = (uint32_t)mesh.textures.size();
+				for (const TextureRef& texture : mesh.textures)
+				{
+					TextureRecord textureRecord = {};
+					textureRecord.typeOffset = (uint32_t)append(texture.type.data(), texture.type.size());
+					textureRecord.typeLength = (uint32_t)texture.type.size();
+					textureRecord.pathOffset = (uint32_t)append(texture.path.data(), texture.path.size());
+					textureRecord.pathLength = (uint32_t)texture.path.size();
+					textures.push_back(textureRecord);
+				}
+				record.lodOffset = (uint32_t)lods.size();
+				record.lodCount = (uint32_t)mesh.lods.size();
+				for (const MeshLod& lod : mesh.lods)
+				{
+					LodRecord lodRecord = {};
+					lodRecord.firstIndex = (uint32_t)lod.firstIndex;
+					lodRecord.indexCount = (uint32_t)lod.indexCount;
+					lodRecord.error = lod.error;
+					lods.push_back(lodRecord);
+				}
+			}
+			align();
+			size_t textureTable = textures.empty() ? blob.size() : append(&textures[0], textures.size() * sizeof(TextureRecord));
+			align();
+			size_t lodTable = lods.empty() ? blob.size() : append(&lods[0], lods.size() * sizeof(LodRecord));
+
+			for (size_t i = 0; i < meshes.size(); i++)
+			{
+				const MeshData& mesh = meshes[i];
+				MeshRecord& record = records[i];
+				record.textureOffset = (uint32_t)(textureTable + record.textureOffset * sizeof(TextureRecord));
+				record.lodOffset = (uint32_t)(lodTable + record.lodOffset * sizeof(LodRecord));
+				align();
+				record.vertexOffset = append(mesh.vertices(), (size_t)mesh.vertexCount * mesh.layout.stride);
+				align();
+				record.indexOffset = append(mesh.indices(), (size_t)mesh.indexCount * mesh.indexSize);
+				record.vertexCount = (uint32_t)mesh.vertexCount;
+				record.indexCount = (uint32_t)mesh.indexCount;
+				record.indexSize = (uint32_t)mesh.indexSize;
+				record.stride = mesh.layout.stride;
+				record.normal = mesh.layout.normal;
+				record.texCoords = mesh.layout.texCoords;
+				record.tangent = mesh.layout.tangent;
+				for (int axis = 0; axis < 3; axis++)
+				{
+					record.minVertices[axis] = mesh.minVertices[axis];
+					record.maxVertices[axis] = mesh.maxVertices[axis];
+				}
+			}
+
+			FileHeader header = {};
+			header.magic = MAGIC;
+			header.version = VERSION;
+			header.format = FormatFlags(format, optimized, lodLevels);
+			header.meshCount = (uint32_t)meshes.size();
+			for (int axis = 0; axis < 3; axis++)
+			{
+				header.minVertices[axis] = minVertices[axis];
+				header.maxVertices[axis] = maxVertices[axis];
+			}
+			memcpy(&blob[0], &header, sizeof(header));
+			if (!records.empty())
+			{
+				memcpy(&blob[sizeof(FileHeader)], &records[0], records.size() * sizeof(MeshRecord));
+			}
+
+			std::ofstream file(path.c_str(), std::ios::binary | std::ios::trunc);
+			file.write((const char*)&blob[0], blob.size());
+			return file.good();
+		}
+
+		///<summary>
+		/// A bake mapped into memory. The meshes it returns point into the mapping, so they must be uploaded
+		/// before the reader is closed or destroyed.
+		///</summary>
+		class Reader {
+		public:
+			///<summary>
+			/// Map the bake at path and check it was built with format, optimized and lodLevels, and that every table
+			/// entry lies within the file. Returns false if it can't be used.
+			///</summary>
+			bool Open(const std::string& path, const VertexFormat& format, bool optimized, int lodLevels)
+			{
+				if (!file.open(path.c_str()) || file.size() < sizeof(FileHeader))
+				{
+					file.close();
+					return false;
+				}
+				const FileHeader& header = Header();
+				bool valid = header.magic == MAGIC && header.version == VERSION && header.format == FormatFlags(format, optimized, lodLevels)
+					&& Fits(sizeof(FileHeader), (uint64_t)header.meshCount * sizeof(MeshRecord));
+				for (uint32_t i = 0; valid && i < header.meshCount; i++)
+				{
+					const MeshRecord& record = Record(i);
+					valid = (record.indexSize == sizeof(GLushort) || record.indexSize == sizeof(GLuint)) && record.stride > 0
+						&& record.vertexOffset % DATA_ALIGNMENT == 0 && record.indexOffset % DATA_ALIGNMENT == 0
+						&& Fits(record.vertexOffset, (uint64_t)record.vertexCount * record.stride)
+						&& Fits(record.indexOffset, (uint64_t)record.indexCount * record.indexSize)
+						&& Fits(record.nameOffset, record.nameLength)
+						&& Fits(record.textureOffset, (uint64_t)record.textureCount * sizeof(TextureRecord))
+						&& Fits(record.lodOffset, (uint64_t)record.lodCount * sizeof(LodRecord));
+					for (uint32_t t = 0; valid && t < record.textureCount; t++)
+					{
+						const TextureRecord& texture = Texture(record, t);
+						valid = Fits(texture.typeOffset, texture.typeLength) && Fits(texture.pathOffset, texture.pathLength);
+					}
+					for (uint32_t l = 0; valid && l < record.lodCount; l++)
+					{
+						const LodRecord& lod = Lod(record, l);
+						valid = lod.firstIndex <= record.indexCount && lod.indexCount <= record.indexCount - lod.firstIndex;
+					}
+				}
+				if (!valid)
+				{
+					file.close();
+				}
+				return valid;
+			}
+
+			///<summary>
+			/// Unmap the bake, meshes returned by Mesh point into it so they must be uploaded first.
+			///</summary>
+			void Close()
+			{
+				file.close();
+			}
+
+			glm::vec3 MinVertices() const
+			{
+				return glm::vec3(Header().minVertices[0], Header().minVertices[1], Header().minVertices[2]);
+			}
+
+			glm::vec3 MaxVertices() const
+			{
+				return glm::vec3(Header().maxVertices[0], Header().maxVertices[1], Header().maxVertices[2]);
+			}
+
+			uint32_t MeshCount() const
+			{
+				return Header().meshCount;
+			}
+
+			///<summary>
+			/// The i'th mesh, its vertices and indices point into the mapped file.
+			///</summary>
+			MeshData Mesh(uint32_t i, const VertexFormat& format) const
+			{
+				const MeshRecord& record = Record(i);
+				MeshData mesh;
+				mesh.name = String(record.nameOffset, record.nameLength);
+				mesh.layout.format = format;
+				mesh.layout.format.tangents = record.tangent != -1;
+				mesh.layout.stride = record.stride;
+				mesh.layout.normal = record.normal;
+				mesh.layout.texCoords = record.texCoords;
+				mesh.layout.tangent = record.tangent;
+				mesh.vertexCount = (GLsizei)record.vertexCount;
+				mesh.indexCount = (GLsizei)record.indexCount;
+				mesh.indexSize = (GLsizei)record.indexSize;
+				mesh.minVertices = glm::vec3(record.minVertices[0], record.minVertices[1], record.minVertices[2]);
+				mesh.maxVertices = glm::vec3(record.maxVertices[0], record.maxVertices[1], record.maxVertices[2]);
+				for (uint32_t t = 0; t < record.textureCount; t++)
+				{
+					const TextureRecord& texture = Texture(record, t);
+					TextureRef ref;
+					ref.type = String(texture.typeOffset, texture.typeLength);
+					ref.path = String(texture.pathOffset, texture.pathLength);
+					mesh.textures.push_back(ref);
+				}
+				for (uint32_t l = 0; l < record.lodCount; l++)
+				{
+					const LodRecord& lod = Lod(record, l);
+					MeshLod meshLod = { (GLsizei)lod.firstIndex, (GLsizei)lod.indexCount, lod.error };
+					mesh.lods.push_back(meshLod);
+				}
+				mesh.mappedVertices = file.data() + record.vertexOffset;
+				mesh.mappedIndices = file.data() + record.indexOffset;
+				return mesh;
+			}
+
+		private:
+			utility::file::MappedFile file;
+
+			const FileHeader& Header() const
+			{
+				return *(const FileHeader*)file.data();
+			}
+
+			const MeshRecord& Record(uint32_t i) const
+			{
+				return ((const MeshRecord*)(file.data() + sizeof(FileHeader)))[i];
+			}
+
+			const TextureRecord& Texture(const MeshRecord& record, uint32_t t) const
+			{
+				return ((const TextureRecord*)(file.data() + record.textureOffset))[t];
+			}
+
+			const LodRecord& Lod(const MeshRecord& record, uint32_t l) const
+			{
+				return ((const LodRecord*)(file.data() + record.lodOffset))[l];
+			}
+
+			std::string String(uint32_t offset, uint32_t length) const
+			{
+				return std::string((const char*)file.data() + offset, length);
+			}
+
+			// True if size bytes from offset are inside the file
+			bool Fits(uint64_t offset, uint64_t size) const
+			{
+				return offset <= file.size() && size <= file.size() - offset;
+			}
+		};
+	}
+}
+
+#endif // A1_MODEL_BAKE_HPP
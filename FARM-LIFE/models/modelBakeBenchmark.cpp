@@ -0,0 +1,112 @@
+/**
+ * Benchmark of loading the farm's models from their bakes against importing them with ASSIMP. Run it from the game's
+ * directory after the game has run once, so every model has a bake. The import is only ASSIMP's ReadFile with the
+ * flags ModelAsset uses, so it is a lower bound on what loading a model cost before the bakes. The bake side is the
+ * whole load up to the upload: mapping the file, checking its tables, reading every mesh and touching each byte of
+ * the vertex and index data the way glBufferData copies it.
+ */
+
+#include "util/benchmarkPrelude.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "models/model.hpp"
+
+namespace
+{
+	const int RUNS = 5;
+
+	// The models main loads
+	const char* MODELS[] = { "models/StreetLight/StreetLightMetallicOrb.obj", "models/StreetLight/StreetLightPost.obj",
+		"models/barn/barn.obj", "models/tree/tree0/tree0.obj", "models/tree/tree1/tree1.obj", "models/tree/tree2/tree2.obj",
+		"models/tree/tree3/tree3.obj", "models/bucket/bucket.obj", "models/bucket/bucket2.obj", "models/fence/fence.obj",
+		"models/fence/fence2.obj", "models/trough/watertrough.obj", "models/cat/cat.obj", "models/giraffe/giraffe-split.obj",
+		"models/pig/pig.obj" };
+
+	// Returns the best time of loading every model in milliseconds, or a negative time if one of them failed
+	template <typename Load>
+	double timeLoads(const std::vector<std::string>& paths, Load load)
+	{
+		double best = 1e30;
+		for (int run = 0; run < RUNS; run++)
+		{
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			for (const std::string& path : paths)
+			{
+				if (!load(path))
+				{
+					return -1.0;
+				}
+			}
+			std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+			best = std::min(best, elapsed.count());
+		}
+		return best;
+	}
+}
+
+int main()
+{
+	// Only models with a bake matching the game's settings are compared
+	std::vector<std::string> paths;
+	for (const char* path : MODELS)
+	{
+		model::bake::Reader reader;
+		if (model::bake::IsCurrent(std::string(path) + ".bake", path) && reader.Open(std::string(path) + ".bake",
+			model::ModelAsset::Format(), model::ModelAsset::Optimize(), model::ModelAsset::LodLevels()))
+		{
+			paths.push_back(path);
+		}
+		else
+		{
+			std::printf("skipping %s, it has no current bake (run the game once first)\n", path);
+		}
+	}
+	if (paths.empty())
+	{
+		return 1;
+	}
+
+	// Sum bytes of the data so reading it can't be optimised away
+	volatile unsigned int checksum = 0;
+	double imported = timeLoads(paths, [](const std::string& path) {
+		Assimp::Importer importer;
+		const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+		return scene && !(scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE) && scene->mRootNode;
+	});
+	double baked = timeLoads(paths, [&checksum](const std::string& path) {
+		model::bake::Reader reader;
+		if (!reader.Open(path + ".bake", model::ModelAsset::Format(), model::ModelAsset::Optimize(), model::ModelAsset::LodLevels()))
+		{
+			return false;
+		}
+		unsigned int sum = 0;
+		for (uint32_t i = 0; i < reader.MeshCount(); i++)
+		{
+			model::MeshData mesh = reader.Mesh(i, model::ModelAsset::Format());
+			const unsigned char* vertices = mesh.vertices();
+			const unsigned char* indices = mesh.indices();
+			for (size_t b = 0; b < (size_t)mesh.vertexCount * mesh.layout.stride; b++)
+			{
+				sum += vertices[b];
+			}
+			for (size_t b = 0; b < (size_t)mesh.indexCount * mesh.indexSize; b++)
+			{
+				sum += indices[b];
+			}
+		}
+		checksum = checksum + sum;
+		return true;
+	});
+	if (imported < 0.0 || baked < 0.0)
+	{
+		std::printf("a model failed to load\n");
+		return 1;
+	}
+	std::printf("ASSIMP import: %8.2f ms for %zu models\n", imported, paths.size());
+	std::printf("bake load:     %8.2f ms for %zu models, %.0fx faster\n", baked, paths.size(), imported / baked);
+	return 0;
+}
@@ -0,0 +1,165 @@
+/**
+ * Draws a list of models with hardware instancing.
+ * Models that were loaded from the same file share an asset, so every mesh of the asset is queued once
+ * for all of those models and drawn by the render queue with glDrawElementsInstanced. The number of draw calls depends on the number
+ * of unique models in the scene, not on how many fences, trees or animals have been placed.
+ * Models that the pass can't see (outside the view, or on the clipped side of the water) are left out.
+ * Each instance draws the coarsest level of detail of each mesh whose error would cover less than LOD_SCREEN_ERROR
+ * of the screen from where the pass is viewed. Near the switch to a coarser level both levels are drawn with
+ * complementary dither patterns, so the change fades in rather than popping.
+ */
+
+#ifndef A1_MODEL_BATCH_HPP
+#define A1_MODEL_BATCH_HPP
+
+#include "models/model.hpp"
+#include "models/renderQueue.hpp"
+
+namespace model
+{
+	// Largest error a level of detail may show on screen, in normalised device units (1 is half the screen's height)
+	const float LOD_SCREEN_ERROR = 0.002f;
+	// The cross-fade to a coarser level starts when its error on screen is this many times LOD_SCREEN_ERROR
+	const float LOD_FADE_BAND = 1.5f;
+
+	class ModelBatch
+	{
+	public:
+		///<summary>
+		/// Whether models are drawn with their simplified levels of detail, rather than always in full.
+		///</summary>
+		static bool& LevelOfDetail()
+		{
+			static bool enabled = true;
+			return enabled;
+		}
+
+		///<summary>
+		/// Whether switching between levels of detail is dithered over a band of distances, rather than instant.
+		///</summary>
+		static bool& CrossFade()
+		{
+			static bool enabled = true;
+			return enabled;
+		}
+
+		///<summary>
+		/// Queue every visible model in models with the shader, one instanced draw per level of detail in use for each
+		/// mesh of each unique asset. The instance lists are kept between frames so queuing doesn't allocate once they have grown.
+		///</summary>
+		void Submit(RenderQueue& queue, const ModelShader& shader, const utility::frame::FrameContext& frame,
+					const std::vector<Model*>& models)
+		{
+			// Group the visible models by their shared asset
+			for (AssetGroup& group : groups)
+			{
+				group.instances.clear();
+			}
+			for (Model* model : models)
+			{
+				// The hitbox is doubled since animated meshes swing outside it and a shifted model's hitbox
+				// is centred on its position rather than its middle
+				glm::vec3 extent = glm::abs(model->hitBox.size) * 2.0f + glm::vec3(1.0f);
+				if (!frame.canSee(model->hitBox.origin - extent, model->hitBox.origin + extent))
+				{
+					continue;
+				}
+				findGroup(model->asset.get()).instances.push_back(model);
+			}
+
+			for (AssetGroup& group : groups)
+			{
+				if (group.instances.empty())
+				{
+					continue;
+				}
+
+				// Screen size of one model unit at each instance, closer for the near side of a large model
+				scales.clear();
+				for (Model* model : group.instances)
+				{
+					float distance = glm::length(model->hitBox.origin - frame.cameraPosition) - glm::length(model->hitBox.size);
+					scales.push_back(frame.projection[1][1] / std::max(distance, 1.0f));
+				}
+
+				for (unsigned int i = 0; i < group.asset->meshes.size(); i++)
+				{
+					Mesh& mesh = group.asset->meshes[i];
+					int lodCount = LevelOfDetail() ? (int)mesh.lods.size() : 1;
+					if ((int)lodInstances.size() < lodCount)
+					{
+						lodInstances.resize(lodCount);
+					}
+					for (int lod = 0; lod < lodCount; lod++)
+					{
+						lodInstances[lod].clear();
+					}
+
+					// Pack the transform of the mesh in each instance under its level of detail
+					for (size_t m = 0; m < group.instances.size(); m++)
+					{
+						Instance instance = { group.instances[m]->MeshTransform(i), 0.0f };
+						int lod = 0;
+						while (lod + 1 < lodCount && mesh.lods[lod + 1].error * scales[m] < LOD_SCREEN_ERROR)
+						{
+							lod++;
+						}
+
+						// Close to the next level, draw part of the pixels with each: fade is how far through the band it is
+						float nextError = lod + 1 < lodCount ? mesh.lods[lod + 1].error * scales[m] : 0.0f;
+						if (CrossFade() && lod + 1 < lodCount && nextError < LOD_SCREEN_ERROR * LOD_FADE_BAND)
+						{
+							float fade = (LOD_SCREEN_ERROR * LOD_FADE_BAND - nextError) / (LOD_SCREEN_ERROR * (LOD_FADE_BAND - 1.0f));
+							instance.fade = fade;
+							lodInstances[lod].push_back(instance);
+							instance.fade = fade - 1.0f;
+							lodInstances[lod + 1].push_back(instance);
+						}
+						else
+						{
+							lodInstances[lod].push_back(instance);
+						}
+					}
+
+					for (int lod = 0; lod < lodCount; lod++)
+					{
+						if (!lodInstances[lod].empty())
+						{
+							queue.Submit(shader, mesh, lod, lodInstances[lod].data(), (GLsizei)lodInstances[lod].size());
+						}
+					}
+				}
+			}
+		}
+
+	private:
+		// The models drawn with one asset, the asset is owned by the model cache for the life of the program
+		struct AssetGroup {
+			ModelAsset* asset;
+			std::vector<Model*> instances;
+		};
+
+		std::vector<AssetGroup> groups;
+		std::vector<float> scales;							// scratch screen size of a model unit at each instance of the group
+		std::vector<std::vector<Instance>> lodInstances;	// scratch instances of each level of detail of the mesh being queued
+
+		// Find the group for asset, a new group is only created the first time an asset is drawn
+		AssetGroup& findGroup(ModelAsset* asset)
+		{
+			for (AssetGroup& group : groups)
+			{
+				if (group.asset == asset)
+				{
+					return group;
+				}
+			}
+
+			AssetGroup group;
+			group.asset = asset;
+			groups.push_back(group);
+			return groups.back();
+		}
+	};
+}
+
+#endif // A1_MODEL_BATCH_HPP
@@ -7,6 +7,7 @@
 #define A1_PADDOCK_HPP
 
 #include <glm\gtx\string_cast.hpp>
+#include "models/hitBoxGrid.hpp"
 
 namespace model
 {
@@ -33,32 +34,30 @@ namespace model
 		}
 
 		///<summary>
-		/// Make program aware of fence node hitboxes
+		/// Make program aware of fence node hitboxes.
+		/// The gate doesn't block the camera, it is added as a trigger so it can be found when the camera is close.
 		///</summary>
-		void PushHitBoxes(std::vector<model::HitBox> &hitBoxes)
+		void PushHitBoxes(model::HitBoxGrid &hitBoxes)
 		{
 			for (model::Model* fenceNode : fenceNodes)
 			{
 				if (fenceNode == fenceNodes.front()) continue;
-				hitBoxes.push_back(fenceNode->hitBox);
+				hitBoxes.Insert(fenceNode->hitBox, fenceNode);
 			}
+			gateHitBox = hitBoxes.Insert(GateTrigger(), fenceNodes.front(), false);
 		}
 
 		///<summary>
 		/// Move paddock by addition of inputted offset.
 		/// Snap fence nodes to terrain.
 		///</summary>
-		void MovePaddock(glm::vec2 location
-					   , terrain::Terrain &terra
-		               , int cameraOffsetX
-					   , int cameraOffsetY
-		               , float terraYOffset)
+		void MovePaddock(glm::vec2 location, const terrain::Heightfield &heightfield)
 		{
 			this->origin = this->origin + location;
 			float modelHeightInWorld;
 			for (model::Model* fence : fenceNodes)
 			{
-				modelHeightInWorld = terra.getHeightAt(location.x + cameraOffsetX, location.y + cameraOffsetY) + terraYOffset + fence->hitBox.size.y;
+				modelHeightInWorld = heightfield.sampleHeight(location.x, location.y) + fence->hitBox.size.y;
 				fence->MoveTo(glm::vec3(location.x, modelHeightInWorld, location.y));
 			}
 		}
@@ -79,10 +78,39 @@ namespace model
 			return gateOpen;
 		}
 
+		///<summary>
+		/// Check if position is close enough to the gate to open or close it
+		///</summary>
+		bool InGateRange(glm::vec3 position)
+		{
+			model::Model* gate = GetGate();
+
+			float xBound, yBound, zBound;
+			if (gateOpen)
+			{
+				// Gate is currently open
+				xBound = 2 * gate->hitBox.size.z;
+				yBound = 2 * gate->hitBox.size.y;
+				zBound = 3 * gate->hitBox.size.z;
+			}
+			else
+			{
+				// Gate is currently closed
+				xBound = gate->hitBox.size.x;
+				yBound = 2 * gate->hitBox.size.y;
+				zBound = 2 * gate->hitBox.size.x;
+			}
+
+			// Check each axis for sufficient distance between the gate and the position
+			return abs(position.x - gate->position.x) < xBound
+				&& abs(position.y - gate->position.y) < yBound
+				&& abs(position.z - gate->position.z) < zBound;
+		}
+
 		///<summary>
 		/// Open gate if it is closed, and vice-versa
 		///</summary>
-		void ToggleGate(std::vector<model::Model*> &models)
+		void ToggleGate(std::vector<model::Model*> &models, model::HitBoxGrid &hitBoxes)
 		{
 			// Find gate pointer in models vector
 			int id = fenceNodes.front()->GetUid();
@@ -106,6 +134,7 @@ namespace model
 					gateOpen = !gateOpen;
 					// Set the fence in the models vector to the updated position
 					models.at(index) = gate;
+					hitBoxes.Update(gateHitBox, GateTrigger(), gate);
 				}
 				catch (const std::out_of_range & ex)
 				{
@@ -129,6 +158,21 @@ namespace model
 
 		bool gateOpen;
 		std::vector<model::Model*> fenceNodes;
+		int gateHitBox;		// handle of the gate trigger in the hitbox grid
+
+		///<summary>
+		/// The area around the gate that InGateRange can return true for, in either gate position
+		///</summary>
+		model::HitBox GateTrigger()
+		{
+			model::Model* gate = GetGate();
+			model::HitBox trigger;
+			trigger.origin = gate->position;
+			trigger.size = glm::vec3(std::max(2 * gate->hitBox.size.z, gate->hitBox.size.x)
+				, 2 * gate->hitBox.size.y
+				, std::max(3 * gate->hitBox.size.z, 2 * gate->hitBox.size.x));
+			return trigger;
+		}
 
 		///<summary>
 		/// Create fence nodes and position them, starting at the origin
@@ -0,0 +1,141 @@
+/**
+ * Collects the mesh draws of a render pass as packets and draws them sorted by a packed 64 bit key.
+ * The key puts the shader program in the highest bits, then the textures, then the vertex array, so after
+ * sorting the draws that share state are next to each other and each program, texture set and vertex array
+ * is bound once per run instead of once per mesh. Binds that are already in place are skipped. The material
+ * samplers use the same texture units in every model shader, so textures stay bound across a program change.
+ * The number of state changes and vertices processed in each pass is kept for the debug output.
+ */
+
+#ifndef A1_RENDER_QUEUE_HPP
+#define A1_RENDER_QUEUE_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include "models/model.hpp"
+
+namespace model
+{
+	class RenderQueue
+	{
+	public:
+		///<summary>
+		/// Counts of one pass's draws and the state changes made to draw them.
+		///</summary>
+		struct Stats {
+			int packets;			// instanced draw calls
+			int programChanges;
+			int textureChanges;		// texture sets bound, each one binds every texture of the mesh
+			int vaoChanges;
+			long long vertices;		// vertices processed, the index count of each draw times its instances
+		};
+
+		///<summary>
+		/// Empty the queue for a new pass. The packet and instance lists keep their memory, so once they have
+		/// grown to the size of the scene queuing doesn't allocate.
+		///</summary>
+		void Clear()
+		{
+			packets.clear();
+			instances.clear();
+		}
+
+		///<summary>
+		/// Queue count instances of level of detail lod of mesh drawn with shader. The instance data is copied,
+		/// the mesh and shader must live until Flush.
+		///</summary>
+		void Submit(const ModelShader& shader, Mesh& mesh, int lod, const Instance* meshInstances, GLsizei count)
+		{
+			DrawPacket packet;
+			packet.key = MakeKey(shader, mesh);
+			packet.shader = &shader;
+			packet.mesh = &mesh;
+			packet.lod = lod;
+			packet.first = (GLsizei)instances.size();
+			packet.count = count;
+			packets.push_back(packet);
+			instances.insert(instances.end(), meshInstances, meshInstances + count);
+		}
+
+		///<summary>
+		/// Sort the queued packets by key and draw them, only changing the program, textures and vertex array
+		/// between packets that differ. The queue is left full, call Clear before the next pass.
+		///</summary>
+		void Flush(const utility::frame::FrameContext& frame)
+		{
+			std::sort(packets.begin(), packets.end(), [](const DrawPacket& a, const DrawPacket& b) { return a.key < b.key; });
+
+			Stats& passStats = stats[(int)frame.pass];
+			passStats = Stats();
+			passStats.packets = (int)packets.size();
+
+			GLuint boundProgram = 0;
+			const Mesh* boundTextures = nullptr;	// mesh whose textures are bound
+			GLuint boundVao = 0;
+			for (const DrawPacket& packet : packets)
+			{
+				if (packet.shader->program != boundProgram)
+				{
+					packet.shader->Use(frame);
+					boundProgram = packet.shader->program;
+					passStats.programChanges++;
+				}
+				if (boundTextures == nullptr || !boundTextures->SameTextures(*packet.mesh))
+				{
+					packet.mesh->BindTextures();
+					boundTextures = packet.mesh;
+					passStats.textureChanges++;
+				}
+				if (packet.mesh->VAO != boundVao)
+				{
+					glBindVertexArray(packet.mesh->VAO);
+					boundVao = packet.mesh->VAO;
+					passStats.vaoChanges++;
+				}
+				packet.mesh->DrawInstances(&instances[packet.first], packet.count, packet.lod);
+				passStats.vertices += (long long)packet.mesh->lods[packet.lod].indexCount * packet.count;
+			}
+
+			// cleanup
+			glBindVertexArray(0);
+			glActiveTexture(GL_TEXTURE0);
+		}
+
+		///<summary>
+		/// Counts from the last Flush in pass.
+		///</summary>
+		Stats GetStats(utility::frame::Pass pass) const
+		{
+			return stats[(int)pass];
+		}
+
+	private:
+		// One instanced draw of a mesh's level of detail, its instances are instances[first, first + count)
+		struct DrawPacket {
+			uint64_t key;
+			const ModelShader* shader;
+			Mesh* mesh;
+			int lod;
+			GLsizei first;
+			GLsizei count;
+		};
+
+		std::vector<DrawPacket> packets;
+		std::vector<Instance> instances;	// instance data of every packet in the queue
+		Stats stats[3] = {};				// counts for each render pass
+
+		// Pack the state a packet needs into a sort key: 16 bits of program, 24 bits of texture and 24 bits of
+		// vertex array, most expensive to change first. The first texture stands in for the mesh's texture set,
+		// meshes of one asset share their textures so this keeps the sets together. OpenGL names are small
+		// integers that are reused, so masking them doesn't mix up the names of a scene this size.
+		static uint64_t MakeKey(const ModelShader& shader, const Mesh& mesh)
+		{
+			uint64_t program = shader.program & 0xFFFF;
+			uint64_t texture = mesh.textures.empty() ? 0 : mesh.textures[0].id & 0xFFFFFF;
+			uint64_t vao = mesh.VAO & 0xFFFFFF;
+			return (program << 48) | (texture << 24) | vao;
+		}
+	};
+}
+
+#endif // A1_RENDER_QUEUE_HPP
@@ -0,0 +1,122 @@
+/**
+ * Benchmark of binding a mesh's textures. No OpenGL context is made: the extension functions point at stubs that
+ * keep the uniforms in a hash map like a driver's symbol table, so this times the CPU side only. It compares the per
+ * draw work meshes used to do (numbering textures, building sampler names, looking up and setting the uniforms) with
+ * BindTextureUnits, which only binds each texture to the unit worked out when the mesh loaded.
+ */
+
+#include "util/benchmarkPrelude.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "models/model.hpp"
+
+namespace
+{
+	const int MESHES = 10000;
+	const int RUNS = 20;
+	const GLuint PROGRAM = 3;
+
+	// Stub driver state
+	std::unordered_map<std::string, GLint> uniforms;
+	volatile GLint lastUniform;
+	volatile GLenum lastUnit;
+
+	GLint GLAPIENTRY stubGetUniformLocation(GLuint, const GLchar* name)
+	{
+		std::unordered_map<std::string, GLint>::const_iterator uniform = uniforms.find(name);
+		return uniform == uniforms.end() ? -1 : uniform->second;
+	}
+
+	void GLAPIENTRY stubUniform1i(GLint location, GLint value)
+	{
+		lastUniform = location + value;
+	}
+
+	void GLAPIENTRY stubActiveTexture(GLenum unit)
+	{
+		lastUnit = unit;
+	}
+
+	// How a mesh bound its textures before the sampler units were fixed, every draw
+	void bindByName(const std::vector<model::Texture>& textures)
+	{
+		unsigned int diffuseNr = 1;
+		unsigned int specularNr = 1;
+		unsigned int normalNr = 1;
+		unsigned int heightNr = 1;
+		for (unsigned int i = 0; i < textures.size(); i++)
+		{
+			glActiveTexture(GL_TEXTURE0 + i);
+			std::string number;
+			std::string name = textures[i].type;
+			std::string mater = "material.";
+			if (name == "texture_diffuse")
+				number = std::to_string(diffuseNr++);
+			else if (name == "texture_specular")
+				number = std::to_string(specularNr++);
+			else if (name == "texture_normal")
+				number = std::to_string(normalNr++);
+			else if (name == "texture_height")
+				number = std::to_string(heightNr++);
+			glUniform1i(glGetUniformLocation(PROGRAM, (mater + name + number).c_str()), i);
+			glBindTexture(GL_TEXTURE_2D, textures[i].id);
+		}
+	}
+
+	// Returns the best time of a pass over every mesh in nanoseconds per mesh
+	template <typename Bind>
+	double timePasses(Bind bind)
+	{
+		double best = 1e30;
+		for (int run = 0; run < RUNS; run++)
+		{
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			for (int mesh = 0; mesh < MESHES; mesh++)
+			{
+				bind(mesh);
+			}
+			std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+			best = std::min(best, elapsed.count() / MESHES);
+		}
+		return best;
+	}
+}
+
+int main()
+{
+	__glewGetUniformLocation = stubGetUniformLocation;
+	__glewUniform1i = stubUniform1i;
+	__glewActiveTexture = stubActiveTexture;
+	const char* names[] = { "material.texture_diffuse1", "material.texture_specular1", "material.shininess", "view",
+							"projection", "clippingPlane" };
+	for (GLint i = 0; i < 6; i++)
+	{
+		uniforms[names[i]] = i;
+	}
+
+	// A diffuse texture on every mesh and a specular one on every third, like the farm's models
+	std::vector<std::vector<model::Texture>> textures(MESHES);
+	std::vector<std::vector<int>> units(MESHES);
+	for (int mesh = 0; mesh < MESHES; mesh++)
+	{
+		model::Texture diffuse = { (GLuint)(mesh % 50 + 1), "texture_diffuse", "" };
+		textures[mesh].push_back(diffuse);
+		if (mesh % 3 == 0)
+		{
+			model::Texture specular = { (GLuint)(mesh % 50 + 60), "texture_specular", "" };
+			textures[mesh].push_back(specular);
+		}
+		units[mesh] = model::TextureUnits(textures[mesh]);
+	}
+
+	double before = timePasses([&](int mesh) { bindByName(textures[mesh]); });
+	double after = timePasses([&](int mesh) { model::BindTextureUnits(textures[mesh], units[mesh]); });
+	std::printf("by name:      %7.1f ns per mesh, %5.2f ms per %d mesh pass\n", before, before * MESHES / 1e6, MESHES);
+	std::printf("fixed units:  %7.1f ns per mesh, %5.2f ms per %d mesh pass\n", after, after * MESHES / 1e6, MESHES);
+	return 0;
+}
@@ -0,0 +1,145 @@
+/**
+ * The vertex of a model mesh and the compact layout it is packed into for the GPU.
+ * Meshes keep full float vertices on the CPU. When a mesh is uploaded its vertices are packed: positions stay
+ * as three floats, normals and tangents become signed 10:10:10:2 integers, texture coordinates become half
+ * floats and the tangent is left out for meshes without a normal map. The bitangent is never stored, the sign
+ * in the tangent's w is enough for a shader to rebuild it as cross(normal, tangent.xyz) * tangent.w.
+ * Each packing can be turned off with a VertexFormat to compare against full floats.
+ */
+
+#ifndef A1_VERTEX_FORMAT_HPP
+#define A1_VERTEX_FORMAT_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "glm/glm.hpp"
+#include "glm/gtc/packing.hpp"
+
+namespace model {
+	// Data structure for the vertex attributes of a model
+	struct Vertex {
+		glm::vec3 Position;
+		glm::vec3 Normal;
+		glm::vec2 TexCoords;	// Texture coordinates
+		// tangent
+		glm::vec3 Tangent;
+		// bitangent
+		glm::vec3 Bitangent;
+	};
+
+	///<summary>
+	/// How each attribute of a mesh's vertices is stored in its vertex buffer.
+	///</summary>
+	struct VertexFormat {
+		bool packedNormals = true;	// normals and tangents as 10:10:10:2 rather than floats
+		bool halfTexCoords = true;	// texture coordinates as half floats rather than floats
+		bool tangents = true;		// store the tangent frame of meshes that have a normal map
+	};
+
+	///<summary>
+	/// Byte offset of each attribute in a packed vertex, tangent is -1 when the mesh doesn't store one.
+	///</summary>
+	struct VertexLayout {
+		VertexFormat format;
+		GLsizei stride;
+		GLsizei normal;
+		GLsizei texCoords;
+		GLsizei tangent;
+	};
+
+	///<summary>
+	/// Lay out the attributes of format one after the other. hasNormalMap says whether the mesh needs a tangent.
+	///</summary>
+	inline VertexLayout MakeVertexLayout(VertexFormat format, bool hasNormalMap)
+	{
+		format.tangents = format.tangents && hasNormalMap;
+		const GLsizei direction = format.packedNormals ? sizeof(GLuint) : 4 * sizeof(float);
+
+		VertexLayout layout;
+		layout.format = format;
+		layout.normal = 3 * sizeof(float);
+		layout.texCoords = layout.normal + direction;
+		layout.stride = layout.texCoords + (format.halfTexCoords ? sizeof(GLuint) : 2 * sizeof(float));
+		layout.tangent = -1;
+		if (format.tangents)
+		{
+			layout.tangent = layout.stride;
+			layout.stride += direction;
+		}
+		return layout;
+	}
+
+	///<summary>
+	/// Pack vertices into the layout, out is resized to hold them.
+	///</summary>
+	inline void PackVertices(const std::vector<Vertex>& vertices, const VertexLayout& layout, std::vector<unsigned char>& out)
+	{
+		out.resize(vertices.size() * layout.stride);
+		for (size_t i = 0; i < vertices.size(); i++)
+		{
+			const Vertex& vertex = vertices[i];
+			unsigned char* packed = &out[i * layout.stride];
+
+			// A direction goes in xyz, w is the bitangent's handedness for a tangent and unused for a normal
+			auto writeDirection = [&layout](unsigned char* destination, glm::vec3 direction, float w) {
+				if (layout.format.packedNormals)
+				{
+					GLuint value = glm::packSnorm3x10_1x2(glm::vec4(glm::clamp(direction, -1.0f, 1.0f), w));
+					memcpy(destination, &value, sizeof(value));
+				}
+				else
+				{
+					glm::vec4 value(direction, w);
+					memcpy(destination, &value, sizeof(value));
+				}
+			};
+
+			memcpy(packed, &vertex.Position, sizeof(vertex.Position));
+			writeDirection(packed + layout.normal, vertex.Normal, 0.0f);
+			if (layout.format.halfTexCoords)
+			{
+				GLuint value = glm::packHalf2x16(vertex.TexCoords);
+				memcpy(packed + layout.texCoords, &value, sizeof(value));
+			}
+			else
+			{
+				memcpy(packed + layout.texCoords, &vertex.TexCoords, sizeof(vertex.TexCoords));
+			}
+			if (layout.tangent != -1)
+			{
+				float handedness = glm::dot(glm::cross(vertex.Normal, vertex.Tangent), vertex.Bitangent) < 0.0f ? -1.0f : 1.0f;
+				writeDirection(packed + layout.tangent, vertex.Tangent, handedness);
+			}
+		}
+	}
+
+	///<summary>
+	/// Point the vertex attributes of the bound vertex array at the bound vertex buffer: position (0), normal (1),
+	/// texture coordinates (2) and the tangent with its handedness (3) if the layout has one.
+	///</summary>
+	inline void SetVertexAttributes(const VertexLayout& layout)
+	{
+		const GLenum directionType = layout.format.packedNormals ? GL_INT_2_10_10_10_REV : GL_FLOAT;
+		const GLboolean directionNormalized = layout.format.packedNormals ? GL_TRUE : GL_FALSE;
+
+		// vertex Positions
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, layout.stride, (void*)0);
+		// vertex normals
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 4, directionType, directionNormalized, layout.stride, (void*)(intptr_t)layout.normal);
+		// vertex texture coords
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(2, 2, layout.format.halfTexCoords ? GL_HALF_FLOAT : GL_FLOAT, GL_FALSE, layout.stride,
+			(void*)(intptr_t)layout.texCoords);
+		// vertex tangent and bitangent handedness
+		if (layout.tangent != -1)
+		{
+			glEnableVertexAttribArray(3);
+			glVertexAttribPointer(3, 4, directionType, directionNormalized, layout.stride, (void*)(intptr_t)layout.tangent);
+		}
+	}
+}
+
+#endif // A1_VERTEX_FORMAT_HPP
@@ -2,10 +2,24 @@
 
 out vec4 FragColor;
 
+flat in float Fade;
+
+// Screen door cross-fade between two levels of detail, a 4x4 ordered dither pattern. A fade f above 0 drops the
+// pixels whose threshold is below f and f - 1 drops the others, so the two levels fill in each other's gaps.
+const float DITHER[16] = float[](0.0, 8.0, 2.0, 10.0, 12.0, 4.0, 14.0, 6.0, 3.0, 11.0, 1.0, 9.0, 15.0, 7.0, 13.0, 5.0);
+
+bool Faded()
+{
+    float threshold = (DITHER[(int(gl_FragCoord.y) & 3) * 4 + (int(gl_FragCoord.x) & 3)] + 0.5) / 16.0;
+    return Fade > 0.0 ? threshold < Fade : (Fade < 0.0 && threshold >= 1.0 + Fade);
+}
 
 
 void main()
 {    
+    if (Faded())
+        discard;
+
     FragColor = vec4(1.0f, 0.96f, 0.9f, 1.0f);
 }
 
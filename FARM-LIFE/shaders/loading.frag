@@ -5,8 +5,18 @@ in vec2 TexCoords;
 out vec4 outColor;
 
 uniform sampler2D screen;
+uniform float progress;	// fraction of the scene loaded
+uniform float time;		// seconds since loading started
 
 void main()
 {
     outColor = texture(screen, TexCoords);
+
+    // Progress bar across the bottom of the screen, a band of light runs along the filled part while it loads
+    if (TexCoords.x > 0.1 && TexCoords.x < 0.9 && TexCoords.y > 0.92 && TexCoords.y < 0.94)
+    {
+        float along = (TexCoords.x - 0.1) / 0.8;
+        vec3 filled = vec3(0.95, 0.8, 0.3) * (0.8 + 0.2 * sin(along * 30.0 - time * 6.0));
+        outColor = vec4(along < progress ? filled : vec3(0.15), 1.0);
+    }
 }
\ No newline at end of file
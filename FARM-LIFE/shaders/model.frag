@@ -51,11 +51,25 @@ struct SpotLight {
 in vec3 FragPos;
 in vec3 Normal;
 in vec2 TexCoords;
+flat in float Fade;
 
-uniform vec3 viewPos;
-uniform DirLight dirLight;
-uniform PointLight pointLights[NR_POINT_LIGHTS];
-uniform SpotLight spotLight;
+// Screen door cross-fade between two levels of detail, a 4x4 ordered dither pattern. A fade f above 0 drops the
+// pixels whose threshold is below f and f - 1 drops the others, so the two levels fill in each other's gaps.
+const float DITHER[16] = float[](0.0, 8.0, 2.0, 10.0, 12.0, 4.0, 14.0, 6.0, 3.0, 11.0, 1.0, 9.0, 15.0, 7.0, 13.0, 5.0);
+
+bool Faded()
+{
+    float threshold = (DITHER[(int(gl_FragCoord.y) & 3) * 4 + (int(gl_FragCoord.x) & 3)] + 0.5) / 16.0;
+    return Fade > 0.0 ? threshold < Fade : (Fade < 0.0 && threshold >= 1.0 + Fade);
+}
+
+// Lights shared by every lit shader, written once per render pass (lights::LightBuffer)
+layout (std140) uniform Lights {
+    vec3 viewPos;
+    DirLight dirLight;
+    PointLight pointLights[NR_POINT_LIGHTS];
+    SpotLight spotLight;
+};
 uniform Material material;
 
 // function prototypes
@@ -65,6 +79,9 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
 
 void main()
 {    
+    if (Faded())
+        discard;
+
     // properties
     vec3 norm = normalize(Normal);
     vec3 viewDir = normalize(viewPos - FragPos);
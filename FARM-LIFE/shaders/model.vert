@@ -2,12 +2,15 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+layout (location = 5) in mat4 aModel;	// per instance model transform, uses locations 5 - 8
+layout (location = 9) in float aFade;	// per instance level of detail cross-fade
 
 out vec3 Normal;
 out vec3 FragPos;
 out vec2 TexCoords;
 
-uniform mat4 model;
+flat out float Fade;
+
 uniform mat4 view;
 uniform mat4 projection;
 
@@ -16,10 +19,13 @@ uniform vec4 clippingPlane;
 
 void main()
 {
+	mat4 model = aModel;
+
 	// Only draw if on the correct side of the clipping plane specified 
 	gl_ClipDistance[0] = dot(model * vec4(aPos, 1.0), clippingPlane);
     
 	gl_Position = projection * view *  model * vec4(aPos, 1.0f);
+	Fade = aFade;
     FragPos = vec3(model * vec4(aPos, 1.0f));
     Normal = mat3(transpose(inverse(model))) * aNormal;
     TexCoords = aTexCoords;
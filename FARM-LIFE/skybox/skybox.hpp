@@ -1,7 +1,12 @@
 #ifndef A1_SKYBOX_HPP
 #define A1_SKYBOX_HPP
 
+#include "util/textureCache.hpp"
+
 namespace skybox {
+	// The faces are only seen from far away and never minified much, so they are compressed without mipmaps
+	const utility::texture::Options FACE_MAP = { utility::texture::COLOUR, false, SOIL_LOAD_RGB };
+
 	// Functions to initialize and render the skybox cubemap.
 	class Skybox
 	{
@@ -17,6 +22,9 @@ namespace skybox {
 		{
 			// Load the shader program used by the skybox
 			shader = LoadShaders("skybox/shaders/skybox.vert", "skybox/shaders/skybox.frag");
+			viewLocation = glGetUniformLocation(shader, "view");
+			projectionLocation = glGetUniformLocation(shader, "projection");
+			timeLocation = glGetUniformLocation(shader, "currTime");
 
 			// Initialize the skybox vertices
 			initSkybox();
@@ -25,6 +33,18 @@ namespace skybox {
 			loadTextures();
 		}
 
+		///<summary>
+		/// Read the cube faces from their caches, or build them, with the job system's workers, so creating a Skybox
+		/// only uploads them
+		///</summary>
+		static void prefetchTextures(utility::jobs::JobSystem& jobs)
+		{
+			for (const std::string& face : faces())
+			{
+				utility::texture::prefetch(jobs, face, FACE_MAP);
+			}
+		}
+
 		///<summary>
 		/// Use the skybox shader program
 		///</summary>
@@ -44,18 +64,18 @@ namespace skybox {
 		///<summary>
 		/// Render the skybox, used in the main logic loop
 		///</summary>
-		void render(glm::mat4 view, glm::mat4 projection)
+		void render(const glm::mat4& view, const glm::mat4& projection, float programTime)
 		{
 			//setting up time
-			float time = -glfwGetTime() / 240;
+			float time = -programTime / 240;
 			time = (time - floor(time));
 			// view transforms
 			//glDepthFunc(GL_LESS);		// this didn't fix the skybox
 			glDepthFunc(GL_LEQUAL);  // change depth function so depth test passes when values are equal to depth buffer's content, won't draw skybox behind objects (optimization)
 			glUseProgram(shader);
-			glUniformMatrix4fv(glGetUniformLocation(shader, "view"), 1, GL_FALSE, &view[0][0]);
-			glUniformMatrix4fv(glGetUniformLocation(shader, "projection"), 1, GL_FALSE, &projection[0][0]);
-			glUniform1f(glGetUniformLocation(shader, "currTime"), time);
+			glUniformMatrix4fv(viewLocation, 1, GL_FALSE, &view[0][0]);
+			glUniformMatrix4fv(projectionLocation, 1, GL_FALSE, &projection[0][0]);
+			glUniform1f(timeLocation, time);
 			// render skybox cube
 			glBindVertexArray(vao);
 			glActiveTexture(GL_TEXTURE0);
@@ -69,6 +89,9 @@ namespace skybox {
 		// Private member data
 		GLuint vbo;
 		GLuint textureID;
+		GLint viewLocation;			// uniform locations, found once after the shader is linked
+		GLint projectionLocation;
+		GLint timeLocation;
 
 		// Private functions
 
@@ -132,11 +155,11 @@ namespace skybox {
 		}
 
 		///<summary>
-		/// Loads the cubemap textures, requires 6 texture images to map to each cube face.
+		/// The image of each cube face, in the order of the cubemap's faces.
 		///</summary>
-		void loadTextures()
+		static std::vector<std::string> faces()
 		{
-			std::vector<std::string> faces
+			return std::vector<std::string>
 			{
 				"skybox/textures/front.tga",
 				"skybox/textures/back.tga",
@@ -145,24 +168,14 @@ namespace skybox {
 				"skybox/textures/right.tga",
 				"skybox/textures/left.tga",
 			};
+		}
 
-			glGenTextures(1, &textureID);
-			glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
-
-			int width, height, nrComponents;
-			for (unsigned int i = 0; i < faces.size(); i++)
-			{
-				unsigned char* data = SOIL_load_image(faces[i].c_str(), &width, &height, &nrComponents, 0);
-				if (data)
-				{
-					glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-				}
-				else
-				{
-					std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
-				}
-				SOIL_free_image_data(data);
-			}
+		///<summary>
+		/// Loads the cubemap textures, requires 6 texture images to map to each cube face.
+		///</summary>
+		void loadTextures()
+		{
+			textureID = utility::texture::loadCubeMap(Skybox::faces(), FACE_MAP);
 			glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 			glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 			glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
@@ -13,6 +13,33 @@
 #include <string.h>
 #include <stdio.h>
 
+#ifdef _WIN32
+	#ifndef WIN32_LEAN_AND_MEAN
+		#define WIN32_LEAN_AND_MEAN
+	#endif
+	#include <windows.h>
+#else
+	#include <pthread.h>
+	#include <unistd.h>
+#endif
+
+/*	the SSE2 block compressors are built on every x86 compiler that
+	has the intrinsics, and picked at run time if the CPU has SSE2	*/
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+	#define DXT_SSE2	1
+	#include <emmintrin.h>
+	#ifdef _MSC_VER
+		#include <intrin.h>
+	#endif
+#else
+	#define DXT_SSE2	0
+#endif
+
+/*	the most threads an image is split between, and the fewest
+	rows of blocks worth starting a thread for	*/
+#define DXT_MAX_THREADS	32
+#define DXT_MIN_THREAD_ROWS	16
+
 /*	set this =1 if you want to use the covarince matrix method...
 	which is better than my method of using standard deviations
 	overall, except on the infintesimal chance that the power
@@ -37,6 +64,47 @@ void compress_DDS_color_block(
 void compress_DDS_alpha_block(
 				const unsigned char *const uncompressed,
 				unsigned char compressed[8] );
+#if DXT_SSE2
+/*
+	The same as the two above, using SSE2 for the sums,
+	projections and index selection.  The output is bit for
+	bit the same as theirs.
+*/
+void compress_DDS_color_block_SSE2(
+				int channels,
+				const unsigned char *const uncompressed,
+				unsigned char compressed[8] );
+void compress_DDS_alpha_block_SSE2(
+				const unsigned char *const uncompressed,
+				unsigned char compressed[8] );
+#endif
+/*
+	A range of rows of 4x4 blocks from an image, compressed
+	straight into their place in the whole compressed image.
+	Each range can be compressed by a different thread.
+*/
+typedef struct DXT_block_rows
+{
+	const unsigned char *uncompressed;
+	int width, height, channels;
+	int first_row, last_row;	/*	in blocks, last_row is one past the end	*/
+	int use_SSE2;
+	unsigned char *compressed;
+	void (*compress_rows)( const struct DXT_block_rows *rows );
+}
+DXT_block_rows;
+void compress_DXT1_block_rows( const DXT_block_rows *rows );
+void compress_DXT5_block_rows( const DXT_block_rows *rows );
+/*
+	Splits the rows of blocks of an image between threads
+	(threads == 0 uses one per core) and compresses them.
+*/
+void compress_DXT_threaded(
+				DXT_block_rows *image,
+				int threads );
+
+/*	1 lets the compressors use SSE2, 0 keeps them on the portable code	*/
+static int DXT_use_SIMD = 1;
 
 /********* Actual Exposed Functions *********/
 int
@@ -103,12 +171,23 @@ unsigned char* convert_image_to_DXT1(
 		int width, int height, int channels,
 		int *out_size )
 {
-	unsigned char *compressed;
-	int i, j, x, y;
-	unsigned char ublock[16*3];
-	unsigned char cblock[8];
-	int index = 0, chan_step = 1;
-	int block_count = 0;
+	return convert_image_to_DXT1_threaded( uncompressed, width, height, channels, out_size, 1 );
+}
+
+unsigned char* convert_image_to_DXT5(
+		const unsigned char *const uncompressed,
+		int width, int height, int channels,
+		int *out_size )
+{
+	return convert_image_to_DXT5_threaded( uncompressed, width, height, channels, out_size, 1 );
+}
+
+unsigned char* convert_image_to_DXT1_threaded(
+		const unsigned char *const uncompressed,
+		int width, int height, int channels,
+		int *out_size, int threads )
+{
+	DXT_block_rows image;
 	/*	error check	*/
 	*out_size = 0;
 	if( (width < 1) || (height < 1) ||
@@ -117,17 +196,182 @@ unsigned char* convert_image_to_DXT1(
 	{
 		return NULL;
 	}
+	/*	get the RAM for the compressed image
+		(8 bytes per 4x4 pixel block)	*/
+	*out_size = ((width+3) >> 2) * ((height+3) >> 2) * 8;
+	image.uncompressed = uncompressed;
+	image.width = width;
+	image.height = height;
+	image.channels = channels;
+	image.compressed = (unsigned char*)malloc( *out_size );
+	image.compress_rows = compress_DXT1_block_rows;
+	compress_DXT_threaded( &image, threads );
+	return image.compressed;
+}
+
+unsigned char* convert_image_to_DXT5_threaded(
+		const unsigned char *const uncompressed,
+		int width, int height, int channels,
+		int *out_size, int threads )
+{
+	DXT_block_rows image;
+	/*	error check	*/
+	*out_size = 0;
+	if( (width < 1) || (height < 1) ||
+		(NULL == uncompressed) ||
+		(channels < 1) || ( channels > 4) )
+	{
+		return NULL;
+	}
+	/*	get the RAM for the compressed image
+		(16 bytes per 4x4 pixel block)	*/
+	*out_size = ((width+3) >> 2) * ((height+3) >> 2) * 16;
+	image.uncompressed = uncompressed;
+	image.width = width;
+	image.height = height;
+	image.channels = channels;
+	image.compressed = (unsigned char*)malloc( *out_size );
+	image.compress_rows = compress_DXT5_block_rows;
+	compress_DXT_threaded( &image, threads );
+	return image.compressed;
+}
+
+void set_DXT_SIMD( int enabled )
+{
+	DXT_use_SIMD = enabled;
+}
+
+/********* Threading *********/
+int DXT_has_SSE2( void )
+{
+	#if DXT_SSE2 && defined(_MSC_VER) && defined(_M_IX86)
+	/*	32 bit Windows can still run on a CPU without it	*/
+	int info[4];
+	__cpuid( info, 1 );
+	return (info[3] >> 26) & 1;
+	#else
+	/*	always there on x64, and GCC only defines __SSE2__
+		when it is compiling for a CPU that has it	*/
+	return DXT_SSE2;
+	#endif
+}
+
+int DXT_core_count( void )
+{
+	#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo( &info );
+	return (int)info.dwNumberOfProcessors;
+	#else
+	long cores = sysconf( _SC_NPROCESSORS_ONLN );
+	return cores > 0 ? (int)cores : 1;
+	#endif
+}
+
+#ifdef _WIN32
+DWORD WINAPI DXT_thread_main( LPVOID rows )
+{
+	((const DXT_block_rows*)rows)->compress_rows( (const DXT_block_rows*)rows );
+	return 0;
+}
+#else
+void* DXT_thread_main( void *rows )
+{
+	((const DXT_block_rows*)rows)->compress_rows( (const DXT_block_rows*)rows );
+	return NULL;
+}
+#endif
+
+void compress_DXT_threaded(
+		DXT_block_rows *image,
+		int threads )
+{
+	DXT_block_rows parts[DXT_MAX_THREADS];
+	#ifdef _WIN32
+	HANDLE handles[DXT_MAX_THREADS];
+	#else
+	pthread_t handles[DXT_MAX_THREADS];
+	#endif
+	int started[DXT_MAX_THREADS];
+	int block_rows = (image->height+3) >> 2;
+	int i;
+	/*	decide how many threads are worth it	*/
+	if( threads < 1 )
+	{
+		threads = DXT_core_count();
+	}
+	if( threads > block_rows / DXT_MIN_THREAD_ROWS )
+	{
+		threads = block_rows / DXT_MIN_THREAD_ROWS;
+	}
+	if( threads > DXT_MAX_THREADS )
+	{
+		threads = DXT_MAX_THREADS;
+	}
+	if( threads < 1 )
+	{
+		threads = 1;
+	}
+	image->use_SSE2 = DXT_use_SIMD && DXT_has_SSE2();
+	/*	split the rows as evenly as they go, the first part stays on this thread	*/
+	for( i = 0; i < threads; ++i )
+	{
+		parts[i] = *image;
+		parts[i].first_row = block_rows * i / threads;
+		parts[i].last_row = block_rows * (i+1) / threads;
+		started[i] = 0;
+	}
+	for( i = 1; i < threads; ++i )
+	{
+		#ifdef _WIN32
+		handles[i] = CreateThread( NULL, 0, DXT_thread_main, &parts[i], 0, NULL );
+		started[i] = (handles[i] != NULL);
+		#else
+		started[i] = (pthread_create( &handles[i], NULL, DXT_thread_main, &parts[i] ) == 0);
+		#endif
+	}
+	image->compress_rows( &parts[0] );
+	for( i = 1; i < threads; ++i )
+	{
+		if( !started[i] )
+		{
+			/*	couldn't start it, so do its share here	*/
+			image->compress_rows( &parts[i] );
+			continue;
+		}
+		#ifdef _WIN32
+		WaitForSingleObject( handles[i], INFINITE );
+		CloseHandle( handles[i] );
+		#else
+		pthread_join( handles[i], NULL );
+		#endif
+	}
+}
+
+/********* Block Rows *********/
+void compress_DXT1_block_rows( const DXT_block_rows *rows )
+{
+	const unsigned char *const uncompressed = rows->uncompressed;
+	unsigned char *compressed = rows->compressed;
+	int width = rows->width, height = rows->height, channels = rows->channels;
+	int i, j, x, y;
+	unsigned char ublock[16*3];
+	unsigned char cblock[8];
+	int index, chan_step = 1;
+	int block_count = 0;
 	/*	for channels == 1 or 2, I do not step forward for R,G,B values	*/
 	if( channels < 3 )
 	{
 		chan_step = 0;
 	}
-	/*	get the RAM for the compressed image
-		(8 bytes per 4x4 pixel block)	*/
-	*out_size = ((width+3) >> 2) * ((height+3) >> 2) * 8;
-	compressed = (unsigned char*)malloc( *out_size );
+	/*	start at the first block of the first row	*/
+	index = rows->first_row * ((width+3) >> 2) * 8;
+	if( height > rows->last_row * 4 )
+	{
+		height = rows->last_row * 4;
+	}
 	/*	go through each block	*/
-	for( j = 0; j < height; j += 4 )
+	for( j = rows->first_row * 4; j < height; j += 4 )
 	{
 		for( i = 0; i < width; i += 4 )
 		{
@@ -168,7 +412,15 @@ unsigned char* convert_image_to_DXT1(
 			}
 			/*	compress the block	*/
 			++block_count;
-			compress_DDS_color_block( 3, ublock, cblock );
+			#if DXT_SSE2
+			if( rows->use_SSE2 )
+			{
+				compress_DDS_color_block_SSE2( 3, ublock, cblock );
+			} else
+			#endif
+			{
+				compress_DDS_color_block( 3, ublock, cblock );
+			}
 			/*	copy the data from the block into the main block	*/
 			for( x = 0; x < 8; ++x )
 			{
@@ -176,28 +428,18 @@ unsigned char* convert_image_to_DXT1(
 			}
 		}
 	}
-	return compressed;
 }
 
-unsigned char* convert_image_to_DXT5(
-		const unsigned char *const uncompressed,
-		int width, int height, int channels,
-		int *out_size )
+void compress_DXT5_block_rows( const DXT_block_rows *rows )
 {
-	unsigned char *compressed;
+	const unsigned char *const uncompressed = rows->uncompressed;
+	unsigned char *compressed = rows->compressed;
+	int width = rows->width, height = rows->height, channels = rows->channels;
 	int i, j, x, y;
 	unsigned char ublock[16*4];
 	unsigned char cblock[8];
-	int index = 0, chan_step = 1;
+	int index, chan_step = 1;
 	int block_count = 0, has_alpha;
-	/*	error check	*/
-	*out_size = 0;
-	if( (width < 1) || (height < 1) ||
-		(NULL == uncompressed) ||
-		(channels < 1) || ( channels > 4) )
-	{
-		return NULL;
-	}
 	/*	for channels == 1 or 2, I do not step forward for R,G,B vales	*/
 	if( channels < 3 )
 	{
@@ -205,12 +447,14 @@ unsigned char* convert_image_to_DXT5(
 	}
 	/*	# channels = 1 or 3 have no alpha, 2 & 4 do have alpha	*/
 	has_alpha = 1 - (channels & 1);
-	/*	get the RAM for the compressed image
-		(16 bytes per 4x4 pixel block)	*/
-	*out_size = ((width+3) >> 2) * ((height+3) >> 2) * 16;
-	compressed = (unsigned char*)malloc( *out_size );
+	/*	start at the first block of the first row	*/
+	index = rows->first_row * ((width+3) >> 2) * 16;
+	if( height > rows->last_row * 4 )
+	{
+		height = rows->last_row * 4;
+	}
 	/*	go through each block	*/
-	for( j = 0; j < height; j += 4 )
+	for( j = rows->first_row * 4; j < height; j += 4 )
 	{
 		for( i = 0; i < width; i += 4 )
 		{
@@ -255,7 +499,15 @@ unsigned char* convert_image_to_DXT5(
 				}
 			}
 			/*	now compress the alpha block	*/
-			compress_DDS_alpha_block( ublock, cblock );
+			#if DXT_SSE2
+			if( rows->use_SSE2 )
+			{
+				compress_DDS_alpha_block_SSE2( ublock, cblock );
+			} else
+			#endif
+			{
+				compress_DDS_alpha_block( ublock, cblock );
+			}
 			/*	copy the data from the compressed alpha block into the main buffer	*/
 			for( x = 0; x < 8; ++x )
 			{
@@ -263,7 +515,15 @@ unsigned char* convert_image_to_DXT5(
 			}
 			/*	then compress the color block	*/
 			++block_count;
-			compress_DDS_color_block( 4, ublock, cblock );
+			#if DXT_SSE2
+			if( rows->use_SSE2 )
+			{
+				compress_DDS_color_block_SSE2( 4, ublock, cblock );
+			} else
+			#endif
+			{
+				compress_DDS_color_block( 4, ublock, cblock );
+			}
 			/*	copy the data from the compressed color block into the main buffer	*/
 			for( x = 0; x < 8; ++x )
 			{
@@ -271,7 +531,6 @@ unsigned char* convert_image_to_DXT5(
 			}
 		}
 	}
-	return compressed;
 }
 
 /********* Helper Functions *********/
@@ -296,30 +555,45 @@ void rgb_888_from_565( unsigned int c, int *r, int *g, int *b )
 	*b = convert_bit_range( (c >> 00) & 31, 5, 8 );
 }
 
+void compute_color_line_from_sums(
+		const float sums[9],
+		float point[3], float direction[3] );
+
 void compute_color_line_STDEV(
 		const unsigned char *const uncompressed,
 		int channels,
 		float point[3], float direction[3] )
 {
-	const float inv_16 = 1.0f / 16.0f;
 	int i;
-	float sum_r = 0.0f, sum_g = 0.0f, sum_b = 0.0f;
-	float sum_rr = 0.0f, sum_gg = 0.0f, sum_bb = 0.0f;
-	float sum_rg = 0.0f, sum_rb = 0.0f, sum_gb = 0.0f;
+	/*	r, g, b, rr, gg, bb, rg, rb, gb	*/
+	float sums[9] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
 	/*	calculate all data needed for the covariance matrix
 		( to compare with _rygdxt code)	*/
 	for( i = 0; i < 16*channels; i += channels )
 	{
-		sum_r += uncompressed[i+0];
-		sum_rr += uncompressed[i+0] * uncompressed[i+0];
-		sum_g += uncompressed[i+1];
-		sum_gg += uncompressed[i+1] * uncompressed[i+1];
-		sum_b += uncompressed[i+2];
-		sum_bb += uncompressed[i+2] * uncompressed[i+2];
-		sum_rg += uncompressed[i+0] * uncompressed[i+1];
-		sum_rb += uncompressed[i+0] * uncompressed[i+2];
-		sum_gb += uncompressed[i+1] * uncompressed[i+2];
+		sums[0] += uncompressed[i+0];
+		sums[3] += uncompressed[i+0] * uncompressed[i+0];
+		sums[1] += uncompressed[i+1];
+		sums[4] += uncompressed[i+1] * uncompressed[i+1];
+		sums[2] += uncompressed[i+2];
+		sums[5] += uncompressed[i+2] * uncompressed[i+2];
+		sums[6] += uncompressed[i+0] * uncompressed[i+1];
+		sums[7] += uncompressed[i+0] * uncompressed[i+2];
+		sums[8] += uncompressed[i+1] * uncompressed[i+2];
 	}
+	compute_color_line_from_sums( sums, point, direction );
+}
+
+/*	the sums are all whole numbers below 2^24, so they are exact
+	in floats whichever order they were added in	*/
+void compute_color_line_from_sums(
+		const float sums[9],
+		float point[3], float direction[3] )
+{
+	const float inv_16 = 1.0f / 16.0f;
+	float sum_r = sums[0], sum_g = sums[1], sum_b = sums[2];
+	float sum_rr = sums[3], sum_gg = sums[4], sum_bb = sums[5];
+	float sum_rg = sums[6], sum_rb = sums[7], sum_gb = sums[8];
 	/*	convert the sums to averages	*/
 	sum_r *= inv_16;
 	sum_g *= inv_16;
@@ -408,19 +682,21 @@ void compute_color_line_STDEV(
 	#endif
 }
 
+void LSE_master_colors_from_line(
+		int *cmax, int *cmin,
+		const float sum_x[3], const float sum_x2[3],
+		float dot_min, float dot_max );
+
 void LSE_master_colors_max_min(
 		int *cmax, int *cmin,
 		int channels,
 		const unsigned char *const uncompressed )
 {
-	int i, j;
-	/*	the master colors	*/
-	int c0[3], c1[3];
+	int i;
 	/*	used for fitting the line	*/
 	float sum_x[] = { 0.0f, 0.0f, 0.0f };
 	float sum_x2[] = { 0.0f, 0.0f, 0.0f };
 	float dot_max = 1.0f, dot_min = -1.0f;
-	float vec_len2 = 0.0f;
 	float dot;
 	/*	error check	*/
 	if( (channels < 3) || (channels > 4) )
@@ -428,8 +704,6 @@ void LSE_master_colors_max_min(
 		return;
 	}
 	compute_color_line_STDEV( uncompressed, channels, sum_x, sum_x2 );
-	vec_len2 = 1.0f / ( 0.00001f +
-			sum_x2[0]*sum_x2[0] + sum_x2[1]*sum_x2[1] + sum_x2[2]*sum_x2[2] );
 	/*	finding the max and min vector values	*/
 	dot_max =
 			(
@@ -454,6 +728,23 @@ void LSE_master_colors_max_min(
 			dot_max = dot;
 		}
 	}
+	LSE_master_colors_from_line( cmax, cmin, sum_x, sum_x2, dot_min, dot_max );
+}
+
+/*	dot_min and dot_max are the ends of the block's colors
+	projected onto the (unscaled) line direction sum_x2	*/
+void LSE_master_colors_from_line(
+		int *cmax, int *cmin,
+		const float sum_x[3], const float sum_x2[3],
+		float dot_min, float dot_max )
+{
+	int i, j;
+	/*	the master colors	*/
+	int c0[3], c1[3];
+	float vec_len2 = 0.0f;
+	float dot;
+	vec_len2 = 1.0f / ( 0.00001f +
+			sum_x2[0]*sum_x2[0] + sum_x2[1]*sum_x2[1] + sum_x2[2]*sum_x2[2] );
 	/*	and the offset (from the average location)	*/
 	dot = sum_x2[0]*sum_x[0] + sum_x2[1]*sum_x[1] + sum_x2[2]*sum_x[2];
 	dot_min -= dot;
@@ -497,25 +788,22 @@ void LSE_master_colors_max_min(
 	}
 }
 
+/*	stores the master colors and zeroes the indices of a DXT1
+	block, and gives the scaled line between the two colors
+	and the offset of color 0 along it	*/
 void
-	compress_DDS_color_block
+	start_DDS_color_block
 	(
-		int channels,
-		const unsigned char *const uncompressed,
-		unsigned char compressed[8]
+		int enc_c0, int enc_c1,
+		unsigned char compressed[8],
+		float color_line[3],
+		float *dot_offset
 	)
 {
 	/*	variables	*/
 	int i;
-	int next_bit;
-	int enc_c0, enc_c1;
 	int c0[4], c1[4];
-	float color_line[] = { 0.0f, 0.0f, 0.0f, 0.0f };
-	float vec_len2 = 0.0f, dot_offset = 0.0f;
-	/*	stupid order	*/
-	int swizzle4[] = { 0, 2, 3, 1 };
-	/*	get the master colors	*/
-	LSE_master_colors_max_min( &enc_c0, &enc_c1, channels, uncompressed );
+	float vec_len2 = 0.0f;
 	/*	store the 565 color 0 and color 1	*/
 	compressed[0] = (enc_c0 >> 0) & 255;
 	compressed[1] = (enc_c0 >> 8) & 255;
@@ -545,7 +833,28 @@ void
 	color_line[1] *= vec_len2;
 	color_line[2] *= vec_len2;
 	/*	compute the offset (constant) portion of the dot product	*/
-	dot_offset = color_line[0]*c0[0] + color_line[1]*c0[1] + color_line[2]*c0[2];
+	*dot_offset = color_line[0]*c0[0] + color_line[1]*c0[1] + color_line[2]*c0[2];
+}
+
+void
+	compress_DDS_color_block
+	(
+		int channels,
+		const unsigned char *const uncompressed,
+		unsigned char compressed[8]
+	)
+{
+	/*	variables	*/
+	int i;
+	int next_bit;
+	int enc_c0, enc_c1;
+	float color_line[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	float dot_offset = 0.0f;
+	/*	stupid order	*/
+	int swizzle4[] = { 0, 2, 3, 1 };
+	/*	get the master colors	*/
+	LSE_master_colors_max_min( &enc_c0, &enc_c1, channels, uncompressed );
+	start_DDS_color_block( enc_c0, enc_c1, compressed, color_line, &dot_offset );
 	/*	store the rest of the bits	*/
 	next_bit = 8*4;
 	for( i = 0; i < 16; ++i )
@@ -630,3 +939,228 @@ void
 	}
 	/*	done compressing to DXT1	*/
 }
+
+#if DXT_SSE2
+/********* SSE2 Block Compressors *********/
+static int DXT_sum_epi32( __m128i v )
+{
+	v = _mm_add_epi32( v, _mm_shuffle_epi32( v, _MM_SHUFFLE( 1, 0, 3, 2 ) ) );
+	v = _mm_add_epi32( v, _mm_shuffle_epi32( v, _MM_SHUFFLE( 2, 3, 0, 1 ) ) );
+	return _mm_cvtsi128_si32( v );
+}
+
+static int DXT_sum_products( const __m128i a[2], const __m128i b[2] )
+{
+	return DXT_sum_epi32( _mm_add_epi32(
+			_mm_madd_epi16( a[0], b[0] ),
+			_mm_madd_epi16( a[1], b[1] ) ) );
+}
+
+static float DXT_min_ps( __m128 v )
+{
+	v = _mm_min_ps( v, _mm_shuffle_ps( v, v, _MM_SHUFFLE( 1, 0, 3, 2 ) ) );
+	v = _mm_min_ps( v, _mm_shuffle_ps( v, v, _MM_SHUFFLE( 2, 3, 0, 1 ) ) );
+	return _mm_cvtss_f32( v );
+}
+
+static float DXT_max_ps( __m128 v )
+{
+	v = _mm_max_ps( v, _mm_shuffle_ps( v, v, _MM_SHUFFLE( 1, 0, 3, 2 ) ) );
+	v = _mm_max_ps( v, _mm_shuffle_ps( v, v, _MM_SHUFFLE( 2, 3, 0, 1 ) ) );
+	return _mm_cvtss_f32( v );
+}
+
+void
+	compress_DDS_color_block_SSE2
+	(
+		int channels,
+		const unsigned char *const uncompressed,
+		unsigned char compressed[8]
+	)
+{
+	/*	variables	*/
+	int i;
+	int next_bit;
+	int enc_c0, enc_c1;
+	unsigned char planes[3][16];
+	unsigned int bits;
+	float sums[9];
+	float sum_x[3], sum_x2[3];
+	float color_line[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	float dot_offset = 0.0f;
+	const __m128i zero = _mm_setzero_si128();
+	/*	r, g and b as 2 x 8 shorts, and as 4 x 4 floats	*/
+	__m128i wide[3][2];
+	__m128 color[3][4];
+	__m128i bytes, value[4], high;
+	__m128 line[3], dot, dot_min, dot_max;
+	/*	split the block into planes of red, green and blue	*/
+	for( i = 0; i < 16; ++i )
+	{
+		planes[0][i] = uncompressed[i*channels+0];
+		planes[1][i] = uncompressed[i*channels+1];
+		planes[2][i] = uncompressed[i*channels+2];
+	}
+	for( i = 0; i < 3; ++i )
+	{
+		bytes = _mm_loadu_si128( (const __m128i*)planes[i] );
+		value[0] = _mm_sad_epu8( bytes, zero );
+		sums[i] = (float)( _mm_cvtsi128_si32( value[0] ) +
+				_mm_cvtsi128_si32( _mm_srli_si128( value[0], 8 ) ) );
+		wide[i][0] = _mm_unpacklo_epi8( bytes, zero );
+		wide[i][1] = _mm_unpackhi_epi8( bytes, zero );
+		color[i][0] = _mm_cvtepi32_ps( _mm_unpacklo_epi16( wide[i][0], zero ) );
+		color[i][1] = _mm_cvtepi32_ps( _mm_unpackhi_epi16( wide[i][0], zero ) );
+		color[i][2] = _mm_cvtepi32_ps( _mm_unpacklo_epi16( wide[i][1], zero ) );
+		color[i][3] = _mm_cvtepi32_ps( _mm_unpackhi_epi16( wide[i][1], zero ) );
+	}
+	/*	the rest of the covariance matrix	*/
+	sums[3] = (float)DXT_sum_products( wide[0], wide[0] );
+	sums[4] = (float)DXT_sum_products( wide[1], wide[1] );
+	sums[5] = (float)DXT_sum_products( wide[2], wide[2] );
+	sums[6] = (float)DXT_sum_products( wide[0], wide[1] );
+	sums[7] = (float)DXT_sum_products( wide[0], wide[2] );
+	sums[8] = (float)DXT_sum_products( wide[1], wide[2] );
+	compute_color_line_from_sums( sums, sum_x, sum_x2 );
+	/*	finding the max and min vector values, 4 colors at a time
+		(added in the same order as the portable code)	*/
+	for( i = 0; i < 3; ++i )
+	{
+		line[i] = _mm_set1_ps( sum_x2[i] );
+	}
+	dot_min = dot_max = _mm_add_ps( _mm_add_ps(
+			_mm_mul_ps( line[0], color[0][0] ),
+			_mm_mul_ps( line[1], color[1][0] ) ),
+			_mm_mul_ps( line[2], color[2][0] ) );
+	for( i = 1; i < 4; ++i )
+	{
+		dot = _mm_add_ps( _mm_add_ps(
+				_mm_mul_ps( line[0], color[0][i] ),
+				_mm_mul_ps( line[1], color[1][i] ) ),
+				_mm_mul_ps( line[2], color[2][i] ) );
+		dot_min = _mm_min_ps( dot_min, dot );
+		dot_max = _mm_max_ps( dot_max, dot );
+	}
+	LSE_master_colors_from_line( &enc_c0, &enc_c1, sum_x, sum_x2,
+			DXT_min_ps( dot_min ), DXT_max_ps( dot_max ) );
+	start_DDS_color_block( enc_c0, enc_c1, compressed, color_line, &dot_offset );
+	/*	place each color on the new line, and map it to [0,3]	*/
+	for( i = 0; i < 3; ++i )
+	{
+		line[i] = _mm_set1_ps( color_line[i] );
+	}
+	for( i = 0; i < 4; ++i )
+	{
+		dot = _mm_sub_ps( _mm_add_ps( _mm_add_ps(
+				_mm_mul_ps( line[0], color[0][i] ),
+				_mm_mul_ps( line[1], color[1][i] ) ),
+				_mm_mul_ps( line[2], color[2][i] ) ),
+				_mm_set1_ps( dot_offset ) );
+		value[i] = _mm_cvttps_epi32( _mm_add_ps(
+				_mm_mul_ps( dot, _mm_set1_ps( 3.0f ) ),
+				_mm_set1_ps( 0.5f ) ) );
+	}
+	/*	the saturating packs clamp below at 0, then clamp above at 3	*/
+	bytes = _mm_packus_epi16(
+			_mm_packs_epi32( value[0], value[1] ),
+			_mm_packs_epi32( value[2], value[3] ) );
+	bytes = _mm_min_epu8( bytes, _mm_set1_epi8( 3 ) );
+	/*	stupid order, { 0, 2, 3, 1 } is (high bit) | (low ^ high bit) << 1	*/
+	high = _mm_and_si128( _mm_srli_epi16( bytes, 1 ), _mm_set1_epi8( 1 ) );
+	bytes = _mm_xor_si128( _mm_and_si128( bytes, _mm_set1_epi8( 1 ) ), high );
+	bytes = _mm_or_si128( _mm_add_epi8( bytes, bytes ), high );
+	/*	pack the 2 bit values together, pairs into nibbles then
+		nibbles into the bytes of each 32 bit lane	*/
+	bytes = _mm_or_si128(
+			_mm_and_si128( bytes, _mm_set1_epi16( 0xFF ) ),
+			_mm_slli_epi16( _mm_srli_epi16( bytes, 8 ), 2 ) );
+	bytes = _mm_or_si128(
+			_mm_and_si128( bytes, _mm_set1_epi32( 0xFFFF ) ),
+			_mm_slli_epi32( _mm_srli_epi32( bytes, 16 ), 4 ) );
+	bytes = _mm_packus_epi16( _mm_packs_epi32( bytes, bytes ), zero );
+	/*	store the rest of the bits	*/
+	bits = (unsigned int)_mm_cvtsi128_si32( bytes );
+	for( next_bit = 4; next_bit < 8; ++next_bit )
+	{
+		compressed[next_bit] = (unsigned char)(bits >> (8 * (next_bit - 4)));
+	}
+	/*	done compressing to DXT1	*/
+}
+
+void
+	compress_DDS_alpha_block_SSE2
+	(
+		const unsigned char *const uncompressed,
+		unsigned char compressed[8]
+	)
+{
+	/*	variables	*/
+	int i;
+	int next_bit;
+	int a0, a1;
+	float scale_me;
+	unsigned char alphas[16];
+	int values[16];
+	const __m128i zero = _mm_setzero_si128();
+	__m128i bytes, limit, wide[2], base;
+	__m128 scale;
+	/*	stupid order	*/
+	int swizzle8[] = { 1, 7, 6, 5, 4, 3, 2, 0 };
+	for( i = 0; i < 16; ++i )
+	{
+		alphas[i] = uncompressed[i*4+3];
+	}
+	bytes = _mm_loadu_si128( (const __m128i*)alphas );
+	/*	get the alpha limits (a0 > a1)	*/
+	limit = _mm_max_epu8( bytes, _mm_srli_si128( bytes, 8 ) );
+	limit = _mm_max_epu8( limit, _mm_srli_si128( limit, 4 ) );
+	limit = _mm_max_epu8( limit, _mm_srli_si128( limit, 2 ) );
+	limit = _mm_max_epu8( limit, _mm_srli_si128( limit, 1 ) );
+	a0 = _mm_cvtsi128_si32( limit ) & 255;
+	limit = _mm_min_epu8( bytes, _mm_srli_si128( bytes, 8 ) );
+	limit = _mm_min_epu8( limit, _mm_srli_si128( limit, 4 ) );
+	limit = _mm_min_epu8( limit, _mm_srli_si128( limit, 2 ) );
+	limit = _mm_min_epu8( limit, _mm_srli_si128( limit, 1 ) );
+	a1 = _mm_cvtsi128_si32( limit ) & 255;
+	/*	store those limits, and zero the rest of the compressed dataset	*/
+	compressed[0] = a0;
+	compressed[1] = a1;
+	/*	zero out the compressed data	*/
+	compressed[2] = 0;
+	compressed[3] = 0;
+	compressed[4] = 0;
+	compressed[5] = 0;
+	compressed[6] = 0;
+	compressed[7] = 0;
+	/*	convert the alpha values to 3 bit numbers, 4 at a time	*/
+	scale_me = 7.9999f / (a0 - a1);
+	scale = _mm_set1_ps( scale_me );
+	base = _mm_set1_epi32( a1 );
+	wide[0] = _mm_unpacklo_epi8( bytes, zero );
+	wide[1] = _mm_unpackhi_epi8( bytes, zero );
+	for( i = 0; i < 2; ++i )
+	{
+		_mm_storeu_si128( (__m128i*)(values + i*8), _mm_cvttps_epi32( _mm_mul_ps(
+				_mm_cvtepi32_ps( _mm_sub_epi32( _mm_unpacklo_epi16( wide[i], zero ), base ) ),
+				scale ) ) );
+		_mm_storeu_si128( (__m128i*)(values + i*8 + 4), _mm_cvttps_epi32( _mm_mul_ps(
+				_mm_cvtepi32_ps( _mm_sub_epi32( _mm_unpackhi_epi16( wide[i], zero ), base ) ),
+				scale ) ) );
+	}
+	/*	store the all of the alpha values	*/
+	next_bit = 8*2;
+	for( i = 0; i < 16; ++i )
+	{
+		int svalue = swizzle8[ values[i]&7 ];
+		/*	OK, store this value, start with the 1st byte	*/
+		compressed[next_bit >> 3] |= svalue << (next_bit & 7);
+		if( (next_bit & 7) > 5 )
+		{
+			/*	spans 2 bytes, fill in the start of the 2nd byte	*/
+			compressed[1 + (next_bit >> 3)] |= svalue >> (8 - (next_bit & 7) );
+		}
+		next_bit += 3;
+	}
+	/*	done compressing to DXT5	*/
+}
+#endif
@@ -45,6 +45,38 @@ convert_image_to_DXT5
     int *out_size
 );
 
+/**
+	the same as convert_image_to_DXT1 and convert_image_to_DXT5, but the
+	rows of 4x4 blocks are split between threads (threads == 0 uses one
+	per core).  Small images use fewer threads, and the output is the same
+	as the single threaded versions.
+**/
+unsigned char*
+convert_image_to_DXT1_threaded
+(
+    const unsigned char *const uncompressed,
+    int width, int height, int channels,
+    int *out_size, int threads
+);
+
+unsigned char*
+convert_image_to_DXT5_threaded
+(
+    const unsigned char *const uncompressed,
+    int width, int height, int channels,
+    int *out_size, int threads
+);
+
+/**
+	1 (the default) lets the compressors use SSE2 when the CPU has it,
+	0 keeps them on the portable code.  Both give the same output.
+**/
+void
+set_DXT_SIMD
+(
+    int enabled
+);
+
 /**	A bunch of DirectDraw Surface structures and flags **/
 typedef struct
 {
@@ -1,5 +1,9 @@
 #include <string>
 #include <iostream>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
 
 #include <windows.h>
 #include <shellapi.h>
@@ -7,11 +11,144 @@
 #include <gl/glext.h>
 
 #include "SOIL.h"
+extern "C" {
+#include "image_DXT.h"
+}
 
 LRESULT CALLBACK WindowProc(HWND, UINT, WPARAM, LPARAM);
 void EnableOpenGL(HWND hwnd, HDC*, HGLRC*);
 void DisableOpenGL(HWND, HDC, HGLRC);
 
+//	a test image: smooth gradients with noisy and flat patches,
+//	so the compressor sees every kind of block
+std::vector<unsigned char> make_DXT_test_image( int width, int height, int channels, unsigned int seed )
+{
+	std::vector<unsigned char> pixels( width * height * channels );
+	srand( seed );
+	for( int y = 0; y < height; ++y )
+	{
+		for( int x = 0; x < width; ++x )
+		{
+			int patch = ((x >> 3) + (y >> 3) * 3 + seed) % 3;
+			for( int c = 0; c < channels; ++c )
+			{
+				int value = (x * 7 + y * 3 + c * 50) & 255;
+				if( patch == 1 )
+				{
+					value = rand() & 255;
+				} else if( patch == 2 )
+				{
+					value = 40 * c + 17;
+				}
+				pixels[(y * width + x) * channels + c] = (unsigned char)value;
+			}
+		}
+	}
+	return pixels;
+}
+
+//	compresses the image with the given settings,
+//	returns the blocks (empty if the compressor failed)
+std::vector<unsigned char> compress_DXT( const std::vector<unsigned char> &pixels,
+	int width, int height, int channels, bool DXT5, int simd, int threads )
+{
+	int size = 0;
+	unsigned char *blocks;
+	set_DXT_SIMD( simd );
+	if( threads < 0 )
+	{
+		//	the original single threaded entry points
+		blocks = DXT5 ?
+			convert_image_to_DXT5( &pixels[0], width, height, channels, &size ) :
+			convert_image_to_DXT1( &pixels[0], width, height, channels, &size );
+	} else
+	{
+		blocks = DXT5 ?
+			convert_image_to_DXT5_threaded( &pixels[0], width, height, channels, &size, threads ) :
+			convert_image_to_DXT1_threaded( &pixels[0], width, height, channels, &size, threads );
+	}
+	std::vector<unsigned char> result;
+	if( blocks != NULL )
+	{
+		result.assign( blocks, blocks + size );
+		free( blocks );
+	}
+	set_DXT_SIMD( 1 );
+	return result;
+}
+
+//	checks that SSE2 and threading give exactly the blocks the portable code gives
+//	on one thread, then times them.  Returns the number of mismatches
+int check_DXT()
+{
+	//	-1 is the single threaded entry point, 0 is a thread per core
+	const int thread_counts[] = { -1, 0, 1, 3, 7 };
+	int mismatches = 0;
+	int checked = 0;
+	for( int size = 1; size <= 257; ++size )
+	{
+		//	square, a row, a column and a long thin image of each size
+		const int shapes[4][2] = { { size, size }, { size, 1 }, { 1, size }, { size, 258 - size } };
+		for( int shape = 0; shape < 4; ++shape )
+		{
+			int width = shapes[shape][0];
+			int height = shapes[shape][1];
+			for( int channels = 1; channels <= 4; ++channels )
+			{
+				std::vector<unsigned char> pixels = make_DXT_test_image( width, height, channels, size * 16 + shape * 4 + channels );
+				for( int DXT5 = 0; DXT5 < 2; ++DXT5 )
+				{
+					std::vector<unsigned char> reference = compress_DXT( pixels, width, height, channels, DXT5 != 0, 0, -1 );
+					for( int simd = 0; simd < 2; ++simd )
+					{
+						for( int t = 0; t < 5; ++t )
+						{
+							std::vector<unsigned char> blocks = compress_DXT( pixels, width, height, channels, DXT5 != 0, simd, thread_counts[t] );
+							++checked;
+							if( reference.empty() || blocks != reference )
+							{
+								if( ++mismatches <= 10 )
+								{
+									std::cout << "DXT" << (DXT5 ? 5 : 1) << " mismatch: " << width << "x" << height << "x" << channels
+										<< ", SIMD " << simd << ", threads " << thread_counts[t] << std::endl;
+								}
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+	std::cout << checked << " compressions checked, " << mismatches << " mismatches" << std::endl;
+
+	//	timing on a texture sized image, best of a few runs
+	const int width = 1024, height = 1024, runs = 5;
+	for( int channels = 3; channels <= 4; ++channels )
+	{
+		std::vector<unsigned char> pixels = make_DXT_test_image( width, height, channels, 1 );
+		for( int simd = 0; simd < 2; ++simd )
+		{
+			for( int t = 1; t < 3; ++t )
+			{
+				double best = 1e30;
+				for( int run = 0; run < runs; ++run )
+				{
+					std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+					compress_DXT( pixels, width, height, channels, channels == 4, simd, thread_counts[t] );
+					std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+					if( elapsed.count() < best )
+					{
+						best = elapsed.count();
+					}
+				}
+				std::cout << "DXT" << (channels == 4 ? 5 : 1) << " " << width << "x" << height << ", SIMD " << simd
+					<< ", " << (thread_counts[t] == 0 ? "every core" : "1 thread") << ": " << best << " ms" << std::endl;
+			}
+		}
+	}
+	return mismatches;
+}
+
 int WINAPI WinMain(HINSTANCE hInstance,
                    HINSTANCE hPrevInstance,
                    LPSTR lpCmdLine,
@@ -25,6 +162,12 @@ int WINAPI WinMain(HINSTANCE hInstance,
     BOOL bQuit = FALSE;
     float theta = 0.0f;
 
+    //	"check_DXT" checks and times the DXT compressors instead of showing an image
+    if( std::string( lpCmdLine ) == "check_DXT" )
+    {
+    	return check_DXT() == 0 ? 0 : 1;
+    }
+
     // register window class
     wcex.cbSize = sizeof(WNDCLASSEX);
     wcex.style = CS_OWNDC;
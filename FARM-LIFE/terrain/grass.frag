@@ -50,10 +50,13 @@ struct SpotLight {
 
 #define NR_POINT_LIGHTS 4
 
-uniform vec3 viewPos;
-uniform DirLight dirLight;
-uniform PointLight pointLights[NR_POINT_LIGHTS];
-uniform SpotLight spotLight;
+// Lights shared by every lit shader, written once per render pass (lights::LightBuffer)
+layout (std140) uniform Lights {
+    vec3 viewPos;
+    DirLight dirLight;
+    PointLight pointLights[NR_POINT_LIGHTS];
+    SpotLight spotLight;
+};
 
 // function prototypes
 vec4 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, vec4 colTexture);
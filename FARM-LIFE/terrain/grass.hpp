@@ -0,0 +1,109 @@
+/* grass.hpp
+ * Places the blades of grass on the terrain once, when the terrain (or a streamed tile) is loaded.
+ * Grass only grows above the grass height on gentle slopes, and a hash of the position keeps one blade in five.
+ * Blades are stored chunk by chunk so the terrain can draw the blades of the chunks near the camera as instances
+ * of two crossed cards, instead of sending every terrain vertex through a geometry shader every pass.
+ */
+
+#ifndef ASSIGNMENT_GRASS_HPP
+#define ASSIGNMENT_GRASS_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "glm/glm.hpp"
+#include "util/gridMesh.hpp"
+
+namespace terrain
+{
+
+// Blades further than this from the camera aren't drawn
+const float GRASS_DISTANCE = 120.0f;
+
+// One blade of grass, the per instance data of the grass draw
+struct GrassBlade
+{
+	glm::vec4 position; // grid position of the root (x, height, z), w is the grass card texture
+	glm::vec4 normal;	// terrain normal at the root, w is how slowly the blade sways
+};
+
+// The blades that grow on one terrain chunk
+struct GrassBucket
+{
+	GLint first;   // first blade in the grass buffer
+	GLsizei count; // number of blades
+};
+
+// Corners of the two crossed cards drawn for every blade: x across the card, y up the card, z which card
+const float GRASS_CARD_CORNERS[] = {
+	-0.5f, 0.0f, 0.0f, 0.5f, 0.0f, 0.0f, -0.5f, 1.0f, 0.0f,
+	-0.5f, 1.0f, 0.0f, 0.5f, 0.0f, 0.0f, 0.5f, 1.0f, 0.0f,
+	-0.5f, 0.0f, 1.0f, 0.5f, 0.0f, 1.0f, -0.5f, 1.0f, 1.0f,
+	-0.5f, 1.0f, 1.0f, 0.5f, 0.0f, 1.0f, 0.5f, 1.0f, 1.0f};
+const int GRASS_CARD_VERTICES = 12;
+
+// Precondition:	None
+// Postcondition:	Returns a pseudo random number from a grid position, the same hash the grass shader used
+inline float grassHash(glm::vec2 co)
+{
+	float value = std::sin(glm::dot(co, glm::vec2(12.9898f, 78.233f))) * 43758.5453f;
+	return (value - std::floor(value)) * 103 + co.x + co.y;
+}
+
+// Precondition:	modulus > 0
+// Postcondition:	Returns the hash as an integer in [0, modulus), like mod() in GLSL
+inline int grassHash(glm::vec2 co, int modulus)
+{
+	int value = (int)grassHash(co);
+	return ((value % modulus) + modulus) % modulus;
+}
+
+// Precondition:	height(i, j) and normal(i, j) give the height and unit normal of grid vertex (i, j) of the layout,
+//					offset is added to the grid position of every blade
+// Postcondition:	Blades for every chunk of the layout are appended to blades, buckets[chunk] holds the chunk's range
+template <typename Height, typename Normal>
+void plantGrass(const utility::grid::GridLayout &layout, glm::ivec2 offset, float grassHeight, Height height, Normal normal,
+				std::vector<GrassBlade> &blades, std::vector<GrassBucket> &buckets)
+{
+	const float maxSlope = std::cos(3.1415926535897932f / 6); // no grass on slopes steeper than 30 degrees
+	buckets.resize(layout.tilesX * layout.tilesZ);
+	for (int cx = 0; cx < layout.tilesX; cx++)
+	{
+		for (int cz = 0; cz < layout.tilesZ; cz++)
+		{
+			GrassBucket &bucket = buckets[cx * layout.tilesZ + cz];
+			bucket.first = (GLint)blades.size();
+
+			// The last row and column of a chunk belong to the next chunk
+			for (int i = cx * layout.tileSize; i < std::min((cx + 1) * layout.tileSize, layout.resX); i++)
+			{
+				for (int j = cz * layout.tileSize; j < std::min((cz + 1) * layout.tileSize, layout.resZ); j++)
+				{
+					glm::vec2 position((float)(offset.x + i), (float)(offset.y + j));
+					int thin = (int)(grassHash(position * 10.0f) * 100);
+					if (((thin % 50) + 50) % 50 < 40)
+					{
+						continue; // thin the grass out
+					}
+
+					float rootHeight = height(i, j);
+					glm::vec3 rootNormal = normal(i, j);
+					if (rootHeight < grassHeight || rootNormal.y < maxSlope)
+					{
+						continue;
+					}
+
+					GrassBlade blade;
+					blade.position = glm::vec4(position.x, rootHeight, position.y, (float)grassHash(position, 4));
+					blade.normal = glm::vec4(rootNormal, (float)(grassHash(position * 20.0f, 15) + 5));
+					blades.push_back(blade);
+				}
+			}
+			bucket.count = (GLsizei)blades.size() - bucket.first;
+		}
+	}
+}
+
+} // namespace terrain
+
+#endif // ASSIGNMENT_GRASS_HPP
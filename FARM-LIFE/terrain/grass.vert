@@ -1,22 +1,101 @@
 #version 330
+#define M_PI 3.1415926535897932384626433832795
 
 // in variables
-in vec3 position;					// position of the vertex
+layout (location = 0) in vec3 corner;		// corner of a grass card: x across, y up, z which of the two cards
+layout (location = 1) in vec4 blade;		// per blade: grid position of the root, w is the grass card texture
+layout (location = 2) in vec4 bladeNormal;	// per blade: terrain normal at the root, w is how slowly the blade sways
 
+out vec2 texCoords;
+out vec3 normal;
+out vec3 fragPos;
+flat out int grassType;
 
-flat out vec2 positions; 
-
+// Transformation matrices
 uniform mat4 Hwm;					// model to world transform
 uniform mat4 Hvw;					// world to view transform
 uniform mat4 Hcv;					// view to clip transform
+
+// Other uniforms
 uniform float scale;				// scale the terrain
-// Textures
-uniform sampler2D normalMap;		// normal map texture for terrain, to determine slope
-uniform float resX;                   // resolution of the terrain X
-uniform float resZ; 
+uniform vec4 clippingPlane;			// clipping plane
+uniform float grassScale;
+uniform vec3 cameraPosition;		// camera position vector
+uniform float time;
+
+// http://www.neilmendoza.com/glsl-rotation-about-an-arbitrary-axis/
+mat4 rotationMatrix(vec3 axis, float angle)
+{
+    axis = normalize(axis);
+    float s = sin(angle);
+    float c = cos(angle);
+    float oc = 1.0 - c;
+    
+    return mat4(oc * axis.x * axis.x + c,           oc * axis.x * axis.y - axis.z * s,  oc * axis.z * axis.x + axis.y * s,  0.0,
+                oc * axis.x * axis.y + axis.z * s,  oc * axis.y * axis.y + c,           oc * axis.y * axis.z - axis.x * s,  0.0,
+                oc * axis.z * axis.x - axis.y * s,  oc * axis.y * axis.z + axis.x * s,  oc * axis.z * axis.z + c,           0.0,
+                0.0,                                0.0,                                0.0,                                1.0);
+}
 
 void main()
 {
-	gl_Position = vec4(position, 1.0);
-	positions = position.xz;
+    // Position of the root of the blade, the blades were placed and thinned out when the terrain was loaded
+    vec4 pointPosition = vec4(blade.xyz, 1.0);
+    normal = bladeNormal.xyz;
+    grassType = int(blade.w);
+
+    vec4 worldPosition = Hwm * vec4(pointPosition[0] * scale, pointPosition[1], pointPosition[2] * scale, 1.0);
+    fragPos = worldPosition.xyz;
+
+    // DETERMINE CLIPPING
+    // The whole blade is dropped if its root is behind the clipping plane. Blades in a nearby chunk can
+    // still be too far away. Dropped blades are moved outside the view.
+    float clip = dot(worldPosition, clippingPlane);
+    gl_ClipDistance[0] = 1;
+    if (clip < 0 || length(worldPosition.xyz - cameraPosition) > 120) {
+        gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+        texCoords = vec2(0.0);
+        return;
+    }
+
+    // Find the angle and axis to rotate around to align the grass card with the terrain
+    float angle = acos(clamp(dot(normal, vec3(0.0, 1.0, 0.0)), -1.0, 1.0));
+    vec3 axis = cross(normal, vec3(0.0, 1.0, 0.0));
+    mat4 upRotate = length(axis) > 0.0001 ? rotationMatrix(axis, -angle) : mat4(1.0);
+
+    mat4 Hcm = Hcv * Hvw * Hwm;
+    mat4 rotationAround = corner.z < 0.5 ? rotationMatrix(vec3(0.0, 1.0, 0.0), 0)
+                                         : rotationMatrix(vec3(0.0, 1.0, 0.0), (M_PI / 2) + (grassType / 6));
+
+    float windFactor = bladeNormal.w;
+
+    float angleTime = time / windFactor;
+
+    while (angleTime > M_PI / 3) {
+        angleTime -= M_PI / 3;
+    }
+
+    vec3 wavingVector;
+
+    if (int(mod((time / windFactor) / (M_PI / 3), 2)) == 0) {
+        wavingVector = vec3(-1.0, 0.0, 0.0);
+    }
+    else {
+        wavingVector = vec3(1.0, 0.0, 0.0);
+        angleTime -= M_PI / 3;
+    }
+
+    mat4 beginWave = rotationMatrix(vec3(1.0, 0.0, 0.0), M_PI / 6);
+
+    mat4 waving = rotationMatrix(wavingVector, angleTime);
+
+    // CREATE SQUARES
+    // Only the top of the card sways in the wind
+    vec4 cornerOffset = vec4(corner.x, corner.y, 0.0, 0.0) * grassScale;
+    if (corner.y > 0.5) {
+        cornerOffset = waving * beginWave * cornerOffset;
+    }
+    gl_Position = pointPosition + (rotationAround * upRotate * cornerOffset);
+    gl_Position = Hcm * vec4(gl_Position.x * scale, gl_Position.y, gl_Position.z * scale, 1.0);
+    texCoords = vec2(0.5 - corner.x, 1.0 - corner.y);
 }
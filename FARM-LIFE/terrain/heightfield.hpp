@@ -0,0 +1,177 @@
+/* heightfield.hpp
+ * Heights of the terrain grid held in one contiguous block, with queries in world coordinates.
+ * Heights are stored as floats, or quantized to 16 bits between the lowest and highest point to halve the memory.
+ * Queries between vertices are interpolated bilinearly, points off the edge of the grid use the nearest edge.
+ */
+
+#ifndef ASSIGNMENT_HEIGHTFIELD_HPP
+#define ASSIGNMENT_HEIGHTFIELD_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "glm/glm.hpp"
+
+namespace terrain
+{
+
+class Heightfield
+{
+public:
+	Heightfield()
+	{
+		resX = 0;
+		resZ = 0;
+		spacing = 1.0f;
+		origin = glm::vec2(0.0f);
+		yOffset = 0.0f;
+		quantized = false;
+		minHeight = 0.0f;
+		step = 0.0f;
+	}
+
+	// Precondition:	heights holds resX * resZ heights, row z of the grid starts at heights[z * resX]
+	//					spacing is the world distance between vertices, origin is the world (x, z) of vertex (0, 0)
+	// Postcondition:	The heights are copied into the field, quantized to 16 bits if quantize is true. If heights is empty
+	//					(the height map failed to load) the field is empty and the terrain is flat at yOffset_
+	Heightfield(int resX_, int resZ_, const std::vector<float> &heights, float spacing_, glm::vec2 origin_, float yOffset_,
+				bool quantize = false)
+	{
+		resX = resX_;
+		resZ = resZ_;
+		spacing = spacing_;
+		origin = origin_;
+		yOffset = yOffset_;
+		quantized = quantize;
+
+		if (heights.empty())
+		{
+			resX = 0;
+			resZ = 0;
+			minHeight = 0.0f;
+			step = 0.0f;
+			return;
+		}
+		minHeight = *std::min_element(heights.begin(), heights.end());
+		float maxHeight = *std::max_element(heights.begin(), heights.end());
+		step = (maxHeight - minHeight) / 65535.0f;
+
+		if (quantized)
+		{
+			samples16.resize(heights.size());
+			for (size_t i = 0; i < heights.size(); i++)
+			{
+				samples16[i] = (std::uint16_t)std::lround(step > 0.0f ? (heights[i] - minHeight) / step : 0.0f);
+			}
+		}
+		else
+		{
+			samples = heights;
+		}
+	}
+
+	// Precondition:	i is in [0, resX), j is in [0, resZ)
+	// Postcondition:	Returns the height of vertex (i, j) of the grid, without the y offset
+	float at(int i, int j) const
+	{
+		int index = j * resX + i;
+		return quantized ? minHeight + step * samples16[index] : samples[index];
+	}
+
+	// Precondition:	None
+	// Postcondition:	Returns the world height of the terrain at world (x, z)
+	float sampleHeight(float x, float z) const
+	{
+		if (quantized)
+		{
+			return bilinear(samples16.data(), minHeight, step, x, z);
+		}
+		return bilinear(samples.data(), 0.0f, 1.0f, x, z);
+	}
+
+	// Precondition:	None
+	// Postcondition:	Returns the unit surface normal of the terrain at world (x, z)
+	glm::vec3 sampleNormal(float x, float z) const
+	{
+		// Slope from the heights half a square either side
+		float d = spacing * 0.5f;
+		float dx = sampleHeight(x + d, z) - sampleHeight(x - d, z);
+		float dz = sampleHeight(x, z + d) - sampleHeight(x, z - d);
+		return glm::normalize(glm::vec3(-dx, 2.0f * d, -dz));
+	}
+
+	// Precondition:	points holds count world (x, z) positions, heights has room for count results
+	// Postcondition:	heights[n] is the world height at points[n]
+	void sampleHeights(const glm::vec2 *points, float *heights, size_t count) const
+	{
+		// Pick the storage once for the whole batch
+		if (quantized)
+		{
+			for (size_t n = 0; n < count; n++)
+			{
+				heights[n] = bilinear(samples16.data(), minHeight, step, points[n].x, points[n].y);
+			}
+		}
+		else
+		{
+			for (size_t n = 0; n < count; n++)
+			{
+				heights[n] = bilinear(samples.data(), 0.0f, 1.0f, points[n].x, points[n].y);
+			}
+		}
+	}
+
+	int getResX() const { return resX; }
+	int getResZ() const { return resZ; }
+	float getSpacing() const { return spacing; }
+
+	// Precondition:	None
+	// Postcondition:	Returns the number of bytes used by the heights
+	size_t memoryUsage() const
+	{
+		return samples.size() * sizeof(float) + samples16.size() * sizeof(std::uint16_t);
+	}
+
+private:
+	int resX;		   // number of vertices along x
+	int resZ;		   // number of vertices along z
+	float spacing;	   // world distance between neighbouring vertices
+	glm::vec2 origin;  // world (x, z) of vertex (0, 0)
+	float yOffset;	   // added to every height returned in world space
+
+	bool quantized;
+	std::vector<float> samples;			 // heights when not quantized, z major
+	std::vector<std::uint16_t> samples16; // quantized heights, height = minHeight + step * sample
+	float minHeight;
+	float step;
+
+	// Bilinear height at world (x, z) from samples where height = bias + sampleScale * sample, a field too small to
+	// interpolate is flat
+	template <typename Sample>
+	float bilinear(const Sample *data, float bias, float sampleScale, float x, float z) const
+	{
+		if (resX < 2 || resZ < 2)
+		{
+			return yOffset;
+		}
+
+		// Position in grid squares, clamped to the grid
+		float u = std::min(std::max((x - origin.x) / spacing, 0.0f), (float)(resX - 1));
+		float v = std::min(std::max((z - origin.y) / spacing, 0.0f), (float)(resZ - 1));
+		int i = std::min((int)u, resX - 2);
+		int j = std::min((int)v, resZ - 2);
+		float fu = u - i;
+		float fv = v - j;
+
+		// Interpolate along x on both rows, then along z
+		const Sample *row = data + j * resX + i;
+		float row0 = row[0] + (row[1] - (float)row[0]) * fu;
+		float row1 = row[resX] + (row[resX + 1] - (float)row[resX]) * fu;
+		return bias + sampleScale * (row0 + (row1 - row0) * fv) + yOffset;
+	}
+};
+
+} // namespace terrain
+
+#endif // ASSIGNMENT_HEIGHTFIELD_HPP
@@ -0,0 +1,114 @@
+/* heightfieldBenchmark.cpp
+ * Benchmark of Heightfield queries. Random points on a 1000 x 1000 map are queried with the float** lookup the terrain
+ * used before (one sample, truncated to the vertex), and with the Heightfield's bilinear queries on float and 16-bit
+ * storage, one at a time and in batches. It also reports the memory of each storage and the largest error quantization
+ * adds.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "terrain/heightfield.hpp"
+
+namespace
+{
+	const int RESOLUTION = 1000;
+	const int QUERIES = 10000000;
+	const float MAX_HEIGHT = 30.0f;
+	const float Y_OFFSET = -20.0f;
+
+	// Runs queries and prints how many it managed per second
+	template <typename Queries>
+	void timeQueries(const char *name, Queries queries)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		queries();
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		std::printf("%-28s %7.1f M queries/s\n", name, QUERIES / elapsed.count() / 1e6);
+	}
+}
+
+int main()
+{
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> height(0.0f, MAX_HEIGHT);
+	std::vector<float> heights(RESOLUTION * RESOLUTION);
+	for (float &h : heights)
+	{
+		h = height(random);
+	}
+
+	// The old layout, one array per column
+	float **columns = new float *[RESOLUTION];
+	for (int i = 0; i < RESOLUTION; i++)
+	{
+		columns[i] = new float[RESOLUTION];
+		for (int j = 0; j < RESOLUTION; j++)
+		{
+			columns[i][j] = heights[j * RESOLUTION + i];
+		}
+	}
+
+	const glm::vec2 origin(-RESOLUTION / 2.0f);
+	terrain::Heightfield exact(RESOLUTION, RESOLUTION, heights, 1.0f, origin, Y_OFFSET, false);
+	terrain::Heightfield quantized(RESOLUTION, RESOLUTION, heights, 1.0f, origin, Y_OFFSET, true);
+
+	std::uniform_real_distribution<float> position(origin.x, origin.x + RESOLUTION - 1);
+	std::vector<glm::vec2> points(QUERIES);
+	for (glm::vec2 &point : points)
+	{
+		point = glm::vec2(position(random), position(random));
+	}
+
+	// Sum the results so the queries can't be optimised away
+	std::vector<float> results(QUERIES);
+	float sum = 0.0f;
+	timeQueries("float** int truncation", [&]() {
+		for (const glm::vec2 &point : points)
+		{
+			sum += columns[(int)(point.x - origin.x)][(int)(point.y - origin.y)] + Y_OFFSET;
+		}
+	});
+	timeQueries("Heightfield float bilinear", [&]() {
+		for (const glm::vec2 &point : points)
+		{
+			sum += exact.sampleHeight(point.x, point.y);
+		}
+	});
+	timeQueries("Heightfield 16-bit bilinear", [&]() {
+		for (const glm::vec2 &point : points)
+		{
+			sum += quantized.sampleHeight(point.x, point.y);
+		}
+	});
+	timeQueries("Heightfield float batch", [&]() { exact.sampleHeights(&points[0], &results[0], QUERIES); });
+	sum += results[0];
+	timeQueries("Heightfield 16-bit batch", [&]() { quantized.sampleHeights(&points[0], &results[0], QUERIES); });
+	sum += results[0];
+
+	float error = 0.0f;
+	for (int n = 0; n < 100000; n++)
+	{
+		error = std::max(error, std::abs(exact.sampleHeight(points[n].x, points[n].y) - quantized.sampleHeight(points[n].x, points[n].y)));
+	}
+	std::printf("memory float %zu bytes, 16-bit %zu bytes, max quantization error %g (checksum %g)\n",
+				exact.memoryUsage(), quantized.memoryUsage(), error, sum);
+
+	// A height map that failed to load gives an empty field, which must be flat rather than crash
+	terrain::Heightfield empty(RESOLUTION, RESOLUTION, std::vector<float>(), 1.0f, origin, Y_OFFSET);
+	if (empty.sampleHeight(0.0f, 0.0f) != Y_OFFSET)
+	{
+		std::printf("empty height field is not flat\n");
+		return 1;
+	}
+
+	for (int i = 0; i < RESOLUTION; i++)
+	{
+		delete[] columns[i];
+	}
+	delete[] columns;
+	return 0;
+}
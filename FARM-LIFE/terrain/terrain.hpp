@@ -3,29 +3,48 @@
  * The Terrain is a mesh of triangles. It uses a BMP image to generate the height of the Terrain. 
  * The Terrain is drawn so that the camera is on top of the center of the Terrain. 
  * This Terrain is textured with lower vertices the rock texture, and the highest vertices the grass texture.
+ * With a stream radius the Terrain instead loads tiles around the camera as it moves (see tileStreamer.hpp),
+ * the height map then repeats in every direction.
  */
 
 #ifndef ASSIGNMENT_TERRAIN_HPP
 #define ASSIGNMENT_TERRAIN_HPP
 
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <memory>
+#include "audio/streamingSource.hpp"
 #include "lights/lights.hpp"
+#include "util/frame.hpp"
+#include "util/gridMesh.hpp"
+#include "util/imageCache.hpp"
+#include "util/textureCache.hpp"
+#include "terrain/grass.hpp"
+#include "terrain/heightfield.hpp"
+#include "terrain/tileStreamer.hpp"
 #undef main
 
 namespace terrain
 {
+// How the terrain's images are stored as textures, colour maps are compressed with their mip chains and the normal
+// maps are kept exact
+const utility::texture::Options COLOUR_MAP = { utility::texture::COLOUR, true, SOIL_LOAD_RGB };
+const utility::texture::Options DATA_MAP = { utility::texture::DATA, false, SOIL_LOAD_RGB };
+const utility::texture::Options GRASS_CARD_MAP = { utility::texture::COLOUR, true, SOIL_LOAD_RGBA };
 
 class Terrain
 {
 public:
-	// Terrain constructor
-	Terrain(int resX_ = 1000, int resZ_ = 1000, float scale_ = 0.5, int maxHeight_ = 30, float yOffset_ = -20.0f, float waterHeight_ = 12)
+	// Terrain constructor, the terrain is resX_ * scale_ world units wide along x and its depth along z follows the aspect
+	// of the height map. streamRadius_ is the number of tiles streamed in around the camera or 0 for a single height map
+	Terrain(int resX_ = 1000, float scale_ = 0.5, int maxHeight_ = 30, float yOffset_ = -20.0f, float waterHeight_ = 12,
+			int streamRadius_ = 0)
 	{
 		// Initialise parameters for terrain size and resolution
-		resX = resX_;
-		resZ = resZ_;
-		scale = scale_;
 		yOffset = yOffset_;
 		waterHeight = waterHeight_;
+		streamRadius = streamRadius_;
 
 		// Specify how many vertex attributes there are
 		int vertexAtt = 3;
@@ -33,183 +52,197 @@ public:
 		// Maximum height of the terrain
 		int maxHeight = maxHeight_;
 
-		// Initialize the terraVertices matrix - used to find height of terrain at coordinates
-		terraVertices = new float *[resX_];
-		for (int i = 0; i < resX_; i++)
-		{
-			terraVertices[i] = new float[resZ_];
-		}
-
 		// Specify height of where the grass starts
 		grassHeight = maxHeight / 1.7;
 
 		//----------------
 		// READ HEIGHT MAP
 		//----------------
-		const std::vector<float> *heights = readHeightMap("terrain/heightmap.bmp");
+		// The resolution comes from the height map, the scale is adjusted so the terrain still covers
+		// resX_ * scale_ world units along x whatever the size of the image, square pixels keep the z extent in proportion
+		std::vector<float> *heights = readHeightMap("terrain/heightmap.bmp");
+		scale = (resX_ * scale_) / resX;
+
+		// Heights used for the mesh and for finding the height of the terrain at a point
+		for (float &height : *heights)
+		{
+			height *= maxHeight;
+		}
+		glm::vec2 origin(-(resX * scale) / 2, -(resZ * scale) / 2);
+		heightfield = std::make_shared<Heightfield>(resX, resZ, *heights, scale, origin, yOffset);
+		delete heights;
 
 		//--------------------
 		// CREATE TERRAIN MESH
 		//--------------------
-		createMesh(vertexAtt, maxHeight, heights);
+		createMesh(vertexAtt);
 
 		//----------------------
 		// CREATE SHADER PROGRAM
 		//----------------------
 		shader = LoadShaders("terrain/terrain.vert", "terrain/terrain.frag");
 		grassShader = LoadShaders("terrain/grass.vert", "terrain/grass.frag");
-		AddGeometryShader(grassShader, "terrain/grass.geom");
 
 		//----------------
 		// CREATE TEXTURES
 		//----------------
 		loadTextures();
 
+		//-------------------------
+		// FIND AND SET UNIFORMS
+		//-------------------------
+		initUniforms();
+
 		//----------------------------
 		// LINK VERTEX DATA TO SHADERS
 		//----------------------------
 		GLint posAttrib = glGetAttribLocation(shader, "position");
-		glEnableVertexAttribArray(posAttrib);
-		glVertexAttribPointer(posAttrib, 3, GL_FLOAT, GL_FALSE,
-							  vertexAtt * sizeof(float), 0);
+		if (streamRadius > 0)
+		{
+			// Tiles have their own vertex arrays, the chunks are filled in as tiles arrive
+			streamer = new TileStreamer(heightfield, maxHeight, grassHeight, chunkSize, TILE_CHUNKS, streamRadius, ebo, posAttrib);
+			chunksX = chunksZ = (2 * streamRadius + 1) * TILE_CHUNKS;
+			chunks.resize(chunksX * chunksZ);
+			windowCentre = glm::ivec2(INT_MAX);
+		}
+		else
+		{
+			glEnableVertexAttribArray(posAttrib);
+			glVertexAttribPointer(posAttrib, 3, GL_FLOAT, GL_FALSE,
+								  vertexAtt * sizeof(float), 0);
+		}
+
+		//------------
+		// PLANT GRASS
+		//------------
+		createGrass();
 
-		// Initialise sound
-		sound = audio::Source();
-		sound.setLooping(true);
+		// The ambient sound is streamed once playSound is called
+		sound = nullptr;
 	}
 
 	// Destructor
 	~Terrain() {}
 
+	// Precondition:	None
+	// Postcondition:	The textures of the terrain are read from their caches, or built, by the job system's workers,
+	//					so creating a Terrain only uploads them. The normal map is also decoded to plant the grass
+	static void prefetchTextures(utility::jobs::JobSystem &jobs)
+	{
+		const char *colour[] = { "terrain/grass.png", "terrain/rock.png", "terrain/sand.png" };
+		const char *data[] = { "terrain/normalmap.png", "water/normalmap.png" };
+		const char *cards[] = { "terrain/grass/grasses-1.png", "terrain/grass/grasses-2.png", "terrain/grass/grasses-3.png",
+								"terrain/grass/grasses-4.png" };
+		for (const char *path : colour)
+		{
+			utility::texture::prefetch(jobs, path, COLOUR_MAP);
+		}
+		for (const char *path : data)
+		{
+			utility::texture::prefetch(jobs, path, DATA_MAP);
+		}
+		for (const char *path : cards)
+		{
+			utility::texture::prefetch(jobs, path, GRASS_CARD_MAP);
+		}
+		utility::image::prefetch(jobs, "terrain/normalmap.png", SOIL_LOAD_RGB);
+	}
+
 	// Precondition:	file is an audio file in wav format
-	// Postcondition:	sound is played from the source on this model
+	// Postcondition:	file is streamed on a loop from the terrain's ambient sound source
 	void playSound(const char *file)
 	{
-		GLuint buffer = audio::loadAudio(file);
-		sound.play(buffer);
+		delete sound;
+		sound = new audio::StreamingSource(file);
+		sound->setLooping(true);
+		sound->play();
 	}
 
 	// Precondition:	Terrain object has been constructed
 	// Postcondition:	Terrain is drawn
-	void draw(const glm::mat4 &Hvw, const glm::mat4 &Hcv, const glm::vec4 &clippingPlane, glm::vec3 cameraPosition, glm::vec3 lightPosition, glm::vec3 lightColour, float time, glm::vec3 Forward)
+	void draw(const utility::frame::FrameContext &frame, const glm::vec3 &lightPosition, const glm::vec3 &lightColour)
 	{
+		const glm::mat4 &Hvw = frame.view;
+		const glm::mat4 &Hcv = frame.projection;
+		const glm::vec4 &clippingPlane = frame.clippingPlane;
+		const glm::vec3 &cameraPosition = frame.cameraPosition;
+		const float time = frame.time;
+
 		//------------------------
 		// BIND SHADER AND BUFFERS
 		//------------------------
 		glUseProgram(shader);
-		glBindVertexArray(vao);
-		glBindBuffer(GL_ARRAY_BUFFER, vbo);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, tex[0]);
-		glUniform1i(glGetUniformLocation(shader, "texGrass"), 0);
-
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, tex[1]);
-		glUniform1i(glGetUniformLocation(shader, "texRock"), 1);
-
-		glActiveTexture(GL_TEXTURE2);
-		glBindTexture(GL_TEXTURE_2D, tex[2]);
-		glUniform1i(glGetUniformLocation(shader, "texSand"), 2);
-
-		glActiveTexture(GL_TEXTURE3);
-		glBindTexture(GL_TEXTURE_2D, tex[3]);
-		glUniform1i(glGetUniformLocation(shader, "normalMap"), 3);
-
-		glActiveTexture(GL_TEXTURE4);
-		glBindTexture(GL_TEXTURE_2D, tex[4]);
-		glUniform1i(glGetUniformLocation(shader, "waterNormalMap"), 4);
-
-		//--------------------------------
-		// SET CAMERA IN MIDDLE OF TERRAIN
-		//--------------------------------
-		glm::mat4 Hwm = glm::mat4(1.0f);
-		Hwm[3] = glm::vec4(-(resX * scale) / 2, yOffset, -(resZ * scale) / 2, 1.0);
-
-		glUniformMatrix4fv(glGetUniformLocation(shader, "Hvw"), 1, GL_FALSE, &Hvw[0][0]);
-		glUniformMatrix4fv(glGetUniformLocation(shader, "Hcv"), 1, GL_FALSE, &Hcv[0][0]);
-		glUniformMatrix4fv(glGetUniformLocation(shader, "Hwm"), 1, GL_FALSE, &Hwm[0][0]);
-
-		// Set uniforms
-		glUniform1f(glGetUniformLocation(shader, "scale"), scale);
-		glUniform1f(glGetUniformLocation(shader, "grassHeight"), grassHeight);
-		glUniform1f(glGetUniformLocation(shader, "resolutionX"), resX);
-		glUniform1f(glGetUniformLocation(shader, "resolutionZ"), resZ);
-		glUniform1f(glGetUniformLocation(shader, "time"), time);
-		glUniform1f(glGetUniformLocation(shader, "waterHeight"), waterHeight);
-
-		glUniform4f(glGetUniformLocation(shader, "clippingPlane"), clippingPlane[0], clippingPlane[1], clippingPlane[2], clippingPlane[3]);
+		if (streamer != nullptr)
+		{
+			updateTiles(cameraPosition);
+		}
 
-		//***************************************************************************************************************
-		lights::light lighting(shader);
-		shader = lighting.setup(cameraPosition, Forward);
-		//***************************************************************************************************************
+		// Texture units are assigned to the samplers once in initUniforms
+		for (int i = 0; i < 5; i++)
+		{
+			glActiveTexture(GL_TEXTURE0 + i);
+			glBindTexture(GL_TEXTURE_2D, tex[i]);
+		}
 
-		glUniform3f(glGetUniformLocation(shader, "cameraPosition"), cameraPosition[0], cameraPosition[1], cameraPosition[2]);
-		glUniform3f(glGetUniformLocation(shader, "lightPosition"), lightPosition[0], lightPosition[1], lightPosition[2]);
-		glUniform3f(glGetUniformLocation(shader, "lightColour"), lightColour[0], lightColour[1], lightColour[2]);
+		// Set the uniforms that change each pass, the lights come from the shared light buffer
+		glUniformMatrix4fv(uniforms.Hvw, 1, GL_FALSE, &Hvw[0][0]);
+		glUniformMatrix4fv(uniforms.Hcv, 1, GL_FALSE, &Hcv[0][0]);
+		glUniform1f(uniforms.time, time);
+		glUniform4fv(uniforms.clippingPlane, 1, &clippingPlane[0]);
+		glUniform3fv(uniforms.cameraPosition, 1, &cameraPosition[0]);
+		glUniform3fv(uniforms.lightPosition, 1, &lightPosition[0]);
+		glUniform3fv(uniforms.lightColour, 1, &lightColour[0]);
 
 		//-------------
 		// DRAW TERRAIN
 		//-------------
-		glDrawElements(GL_TRIANGLES, noVertices, GL_UNSIGNED_INT, 0);
+		// Pick the level of detail of every chunk from its distance to the camera
+		selectLevels(cameraPosition);
+
+		// Only draw the chunks inside the view and on the kept side of the water, each chunk draws its interior
+		// and four edges in one call
+		ChunkStats &stats = chunkStats[(int)frame.pass];
+		stats.drawn = 0;
+		stats.culled = 0;
+		stats.triangles = 0;
+		GLuint boundVao = 0;
+		for (int c = 0; c < (int)chunks.size(); c++)
+		{
+			const Chunk &chunk = chunks[c];
+			if (chunk.vao == 0)
+			{
+				continue; // tile still loading
+			}
+			if (!frame.canSee(chunk.min, chunk.max))
+			{
+				stats.culled++;
+				continue;
+			}
+			if (chunk.vao != boundVao)
+			{
+				glBindVertexArray(chunk.vao);
+				boundVao = chunk.vao;
+			}
+			stats.drawn++;
+			stats.triangles += drawChunk(c);
+		}
 
 		// Update sound position
-		sound.setPosition(cameraPosition);
+		if (sound != nullptr)
+		{
+			sound->setPosition(cameraPosition);
+		}
 
 		// ----------
 		// DRAW GRASS
 		//-----------
-		// Buffers and shader
-		glUseProgram(grassShader); // switch to the grass shader
-		glBindVertexArray(vao);
-		glBindBuffer(GL_ARRAY_BUFFER, vbo);
-
-		// Uniforms
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, grassTex[0]);
-		glUniform1i(glGetUniformLocation(grassShader, "normalMap"), 0);
-
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, grassTex[1]);
-		glUniform1i(glGetUniformLocation(grassShader, "grassTex1"), 1);
-
-		glActiveTexture(GL_TEXTURE2);
-		glBindTexture(GL_TEXTURE_2D, grassTex[2]);
-		glUniform1i(glGetUniformLocation(grassShader, "grassTex2"), 2);
-
-		glActiveTexture(GL_TEXTURE3);
-		glBindTexture(GL_TEXTURE_2D, grassTex[3]);
-		glUniform1i(glGetUniformLocation(grassShader, "grassTex3"), 3);
-
-		glActiveTexture(GL_TEXTURE4);
-		glBindTexture(GL_TEXTURE_2D, grassTex[4]);
-		glUniform1i(glGetUniformLocation(grassShader, "grassTex4"), 4);
-
-		glUniformMatrix4fv(glGetUniformLocation(grassShader, "Hvw"), 1, GL_FALSE, &Hvw[0][0]);
-		glUniformMatrix4fv(glGetUniformLocation(grassShader, "Hcv"), 1, GL_FALSE, &Hcv[0][0]);
-		glUniformMatrix4fv(glGetUniformLocation(grassShader, "Hwm"), 1, GL_FALSE, &Hwm[0][0]);
-
-
-		glUniform4f(glGetUniformLocation(grassShader, "clippingPlane"), clippingPlane[0], clippingPlane[1], clippingPlane[2], clippingPlane[3]);
-		glUniform1f(glGetUniformLocation(grassShader, "scale"), scale);
-		glUniform1f(glGetUniformLocation(grassShader, "resX"), resX);
-		glUniform1f(glGetUniformLocation(grassShader, "resZ"), resZ);
-		glUniform1f(glGetUniformLocation(grassShader, "grassHeight"), grassHeight);
-		glUniform1f(glGetUniformLocation(grassShader, "grassScale"), 5.0);
-		glUniform3f(glGetUniformLocation(grassShader, "cameraPosition"), cameraPosition[0], cameraPosition[1], cameraPosition[2]);
-
-		lights::light grassLights(grassShader);
-		grassShader = grassLights.setup(cameraPosition, Forward);
-
-		glUniform1f(glGetUniformLocation(grassShader, "time"), time);
+		// Grass is too small to notice in the water's reflection
+		stats.blades = 0;
+		if (frame.pass != utility::frame::Pass::REFLECTION)
+		{
+			stats.blades = drawGrass(frame);
+		}
 
-		// Draw grass
-		glEnable(GL_BLEND);
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-		glDrawArrays(GL_POINTS, 0, (resX * resZ)); // draw the points of the grass
-		glDisable(GL_BLEND);
 		// Unbind texture and vertex array
 		glBindVertexArray(0);
 		glActiveTexture(GL_TEXTURE0);
@@ -219,19 +252,79 @@ public:
 	// Postcondition:	Vertex array, textures and buffers deleted.
 	void cleanup()
 	{
+		if (streamer != nullptr)
+		{
+			streamer->stop();
+			delete streamer;
+			streamer = nullptr;
+		}
 		glDeleteBuffers(1, &vbo);
 		glDeleteBuffers(1, &ebo);
 		glDeleteVertexArrays(1, &vao);
-		glDeleteTextures(5, &tex[0]);
-		glDeleteTextures(5, &grassTex[0]);
-		sound.cleanup();
+		glDeleteBuffers(1, &grassVbo);
+		glDeleteBuffers(1, &grassCardVbo);
+		glDeleteVertexArrays(1, &grassVao);
+		for (GLuint texture : tex)
+		{
+			utility::texture::release(texture);
+		}
+		for (GLuint texture : grassTex)
+		{
+			utility::texture::release(texture);
+		}
+		delete sound;
+		sound = nullptr;
 	}
 
-	// Precondition:	x is in [0, resX], y is in [0, resZ]
-	// Postcondition:	Returns the terrain height at the given (x,y) coordinate
-	float getHeightAt(int x, int y)
+	// Number of terrain chunks drawn and culled, and triangles and grass blades drawn, in a render pass
+	struct ChunkStats
+	{
+		int drawn;
+		int culled;
+		int triangles;
+		int blades;
+	};
+
+	// Precondition:	The terrain has been drawn in pass
+	// Postcondition:	Returns the chunk counts from the last time the pass was drawn
+	ChunkStats getChunkStats(utility::frame::Pass pass)
 	{
-		return terraVertices[x][y];
+		return chunkStats[(int)pass];
+	}
+
+	// Precondition:	None
+	// Postcondition:	Level of detail is turned on or off, with it off every chunk is drawn at full resolution
+	void toggleLevelOfDetail()
+	{
+		levelOfDetail = !levelOfDetail;
+	}
+
+	// Precondition:	None
+	// Postcondition:	Returns the world height of the terrain at world (x, z), from the loaded tiles when streamed
+	float sampleHeight(float x, float z) const
+	{
+		if (streamer == nullptr)
+		{
+			return heightfield->sampleHeight(x, z);
+		}
+
+		// Interpolate between the four vertices around the point
+		float u = (x + (resX * scale) / 2) / scale;
+		float v = (z + (resZ * scale) / 2) / scale;
+		int i = (int)std::floor(u);
+		int j = (int)std::floor(v);
+		float fu = u - i;
+		float fv = v - j;
+		float row0 = streamer->heightAt(i, j) + (streamer->heightAt(i + 1, j) - streamer->heightAt(i, j)) * fu;
+		float row1 = streamer->heightAt(i, j + 1) + (streamer->heightAt(i + 1, j + 1) - streamer->heightAt(i, j + 1)) * fu;
+		return row0 + (row1 - row0) * fv + yOffset;
+	}
+
+	// Precondition:	None
+	// Postcondition:	Returns the heights of the main height map, in world coordinates
+	const Heightfield &getHeightfield() const
+	{
+		return *heightfield;
 	}
 
 private:
@@ -239,29 +332,427 @@ private:
 	GLuint shader;		// shader program
 	GLuint grassShader; // grass shader program
 	GLuint vao;			// vertex array object
-	GLuint vbo;			// vertex buffer object
+	GLuint vbo = 0;		// vertex buffer object, unused when the terrain is streamed
 	GLuint ebo;			// element buffer object
 	GLuint tex[5];		// textures
-	GLuint grassTex[5]; // grass textures
+	GLuint grassTex[4]; // grass card textures
 
 	// Store terrain size and resolution
-	float scale;		 // how much to scale terrain down, if terrain is resX by resZ
+	float scale;		 // world size of one square of the terrain grid
 	float yOffset;		 // how much to offset the terrain by in the y direction (from 0.0f)
 	int resX;			 // number of vertices wide (x-axis)
 	int resZ;			 // number of vertices long (z-axis)
-	int noVertices;		 // number of vertices to draw
+	int noVertices;		 // number of vertices in the vertex buffer
 	float waterHeight;   // height of the water
-	audio::Source sound; // source for the terrain ambient sound
+	audio::StreamingSource *sound; // source for the terrain ambient sound
 
-	// Store terrain (x,y,z) vector for height detection
-	float **terraVertices;
+	// Heights of the height map, shared with the tile streamer
+	std::shared_ptr<Heightfield> heightfield;
 
 	float grassHeight; // height that the grass starts to grow
 
-	// Precondition:	vertexAtt is number of vertex attributes, maxHeight is maximum height of terrain
-	//					heights is vector of all heights over mesh
+	// Grass is planted once when the terrain is loaded, each chunk draws the blades planted on it
+	GLuint grassVao;		// grass card corners and blade instance attributes
+	GLuint grassCardVbo;	// corners of the grass cards
+	GLuint grassVbo = 0;	// blades of the single height map, streamed tiles have their own
+
+	//---------------
+	// LEVEL OF DETAIL
+	//---------------
+	// The terrain is split into square chunks of chunkSize x chunkSize squares. Every chunk has its own block of
+	// (chunkSize + 1)^2 vertices, so the same index patterns can be shared by all chunks with a base vertex.
+	// A chunk at level l samples every 2^l th vertex (geomipmapping). The interior of the chunk and each of
+	// its four edges are separate patterns: an edge next to a chunk one level finer uses the finer step so
+	// the vertices on both sides of the seam match and no cracks appear. Levels of neighbouring chunks are
+	// kept within one of each other.
+
+	// A square block of the terrain
+	struct Chunk
+	{
+		GLuint vao;		  // vertex array holding the chunk, 0 while its tile is loading
+		GLint baseVertex; // first vertex of the chunk in the vertex buffer
+		glm::vec3 min;	  // world space bounding box
+		glm::vec3 max;
+		int level;		  // level of detail for the current pass
+		GLuint grassBuffer; // buffer holding the chunk's grass blades, 0 if it has none
+		GrassBucket grass;	// the chunk's blades within grassBuffer
+	};
+
+	// A range of the element buffer
+	struct Pattern
+	{
+		GLsizei first;	  // offset of the first index
+		GLsizei count;	  // number of indices
+	};
+
+	static const int MAX_LEVELS = 8;
+	int chunkSize;				   // number of squares along each side of a chunk, a power of two
+	int chunksX;				   // number of chunks along x
+	int chunksZ;				   // number of chunks along z
+	int levels;					   // number of levels of detail, level log2(chunkSize) - 1 is the coarsest
+	float lodDistance;			   // distance from the camera that full resolution is used for
+	bool levelOfDetail = true;	   // false draws every chunk at full resolution
+	std::vector<Chunk> chunks;
+	Pattern interior[MAX_LEVELS];  // interior of a chunk at each level
+	Pattern edges[MAX_LEVELS][4][2]; // each edge at each level, [level][side][0 = same step, 1 = finer neighbour]
+	ChunkStats chunkStats[3] = {}; // chunk counts for each render pass
+
+	//----------
+	// STREAMING
+	//----------
+	// A streamed terrain keeps chunks for a window of tiles centred on the camera's tile, the window moves
+	// with the camera and is refilled whenever a tile is loaded or dropped.
+	static const int TILE_CHUNKS = 4; // chunks along each side of a tile
+	TileStreamer *streamer = nullptr; // null for a single height map
+	int streamRadius;				  // tiles loaded in each direction around the camera
+	glm::ivec2 windowCentre;		  // tile at the centre of the chunk window
+
+	// Precondition:	The terrain is streamed, cameraPosition is the camera of the pass
+	// Postcondition:	Tiles around the camera are loaded and the chunk window is up to date
+	void updateTiles(const glm::vec3 &cameraPosition)
+	{
+		int tileSize = chunkSize * TILE_CHUNKS;
+		int i = (int)std::floor((cameraPosition.x + (resX * scale) / 2) / scale);
+		int j = (int)std::floor((cameraPosition.z + (resZ * scale) / 2) / scale);
+		glm::ivec2 centre(TileStreamer::floorDiv(i, tileSize), TileStreamer::floorDiv(j, tileSize));
+
+		bool changed = streamer->update(centre);
+		if (!changed && centre == windowCentre)
+		{
+			return;
+		}
+		windowCentre = centre;
+
+		// Refill the chunk window from the resident tiles
+		int chunkVertices = (chunkSize + 1) * (chunkSize + 1);
+		for (int cx = 0; cx < chunksX; cx++)
+		{
+			for (int cz = 0; cz < chunksZ; cz++)
+			{
+				// Tile holding the chunk, and the chunk's position within the tile
+				int tileX = centre.x - streamRadius + cx / TILE_CHUNKS;
+				int tileZ = centre.y - streamRadius + cz / TILE_CHUNKS;
+				int localX = cx % TILE_CHUNKS;
+				int localZ = cz % TILE_CHUNKS;
+				int startI = tileX * tileSize + localX * chunkSize;
+				int startJ = tileZ * tileSize + localZ * chunkSize;
+
+				Chunk &chunk = chunks[cx * chunksZ + cz];
+				const TileStreamer::Tile *tile = streamer->find(tileX, tileZ);
+				glm::vec2 heights = tile ? tile->chunkHeights[localX * TILE_CHUNKS + localZ] : glm::vec2(0.0f);
+				chunk.vao = tile ? streamer->vertexArray(*tile) : 0;
+				chunk.grassBuffer = tile ? streamer->grassBuffer(*tile) : 0;
+				chunk.grass = tile ? tile->grassBuckets[localX * TILE_CHUNKS + localZ] : GrassBucket{0, 0};
+				chunk.baseVertex = (localX * TILE_CHUNKS + localZ) * chunkVertices;
+				chunk.min = glm::vec3(startI * scale - (resX * scale) / 2, heights.x + yOffset, startJ * scale - (resZ * scale) / 2);
+				chunk.max = glm::vec3((startI + chunkSize) * scale - (resX * scale) / 2, heights.y + yOffset, (startJ + chunkSize) * scale - (resZ * scale) / 2);
+			}
+		}
+	}
+
+	// Precondition:	cameraPosition is the camera of the pass
+	// Postcondition:	Every chunk has a level, neighbouring chunks differ by at most one level
+	void selectLevels(const glm::vec3 &cameraPosition)
+	{
+		for (Chunk &chunk : chunks)
+		{
+			chunk.level = 0;
+			if (!levelOfDetail)
+			{
+				continue;
+			}
+
+			// Distance to the closest point of the chunk, each doubling of distance drops a level
+			glm::vec3 closest = glm::clamp(cameraPosition, chunk.min, chunk.max);
+			float distance = glm::length(closest - cameraPosition);
+			while (chunk.level < levels - 1 && distance >= lodDistance * (1 << chunk.level))
+			{
+				chunk.level++;
+			}
+		}
+
+		// A chunk can't be more than one level coarser than any of its neighbours
+		bool changed = levelOfDetail;
+		while (changed)
+		{
+			changed = false;
+			for (int cx = 0; cx < chunksX; cx++)
+			{
+				for (int cz = 0; cz < chunksZ; cz++)
+				{
+					int &level = chunks[cx * chunksZ + cz].level;
+					int finest = level;
+					if (cx > 0) finest = std::min(finest, chunks[(cx - 1) * chunksZ + cz].level);
+					if (cx < chunksX - 1) finest = std::min(finest, chunks[(cx + 1) * chunksZ + cz].level);
+					if (cz > 0) finest = std::min(finest, chunks[cx * chunksZ + cz - 1].level);
+					if (cz < chunksZ - 1) finest = std::min(finest, chunks[cx * chunksZ + cz + 1].level);
+					if (level > finest + 1)
+					{
+						level = finest + 1;
+						changed = true;
+					}
+				}
+			}
+		}
+	}
+
+	// Precondition:	selectLevels has been called for the pass
+	// Postcondition:	The chunk is drawn, returns the number of triangles drawn
+	int drawChunk(int c)
+	{
+		const Chunk &chunk = chunks[c];
+		int cx = c / chunksZ;
+		int cz = c % chunksZ;
+
+		// Levels of the neighbours on each side: -z, +x, +z, -x
+		int neighbours[4] = {
+			cz > 0 ? chunks[c - 1].level : chunk.level,
+			cx < chunksX - 1 ? chunks[c + chunksZ].level : chunk.level,
+			cz < chunksZ - 1 ? chunks[c + 1].level : chunk.level,
+			cx > 0 ? chunks[c - chunksZ].level : chunk.level};
+
+		GLsizei counts[5];
+		GLvoid *offsets[5];
+		GLint baseVertices[5];
+		counts[0] = interior[chunk.level].count;
+		offsets[0] = (void *)(interior[chunk.level].first * sizeof(GLushort));
+		for (int side = 0; side < 4; side++)
+		{
+			const Pattern &edge = edges[chunk.level][side][neighbours[side] < chunk.level ? 1 : 0];
+			counts[side + 1] = edge.count;
+			offsets[side + 1] = (void *)(edge.first * sizeof(GLushort));
+		}
+
+		int indices = 0;
+		for (int i = 0; i < 5; i++)
+		{
+			baseVertices[i] = chunk.baseVertex;
+			indices += counts[i];
+		}
+		glMultiDrawElementsBaseVertex(GL_TRIANGLES, counts, GL_UNSIGNED_SHORT, offsets, 5, baseVertices);
+		return indices / 3;
+	}
+
+	// Precondition:	a and b are (x, z) vertices of a chunk
+	// Postcondition:	Index of the vertex within the chunk's block of vertices, always fits in 16 bits
+	GLushort chunkVertex(int a, int b)
+	{
+		return (GLushort)(a * (chunkSize + 1) + b);
+	}
+
+	// Precondition:	(a, b) for each point are (x, z) vertices of a chunk
+	// Postcondition:	Triangle is added with the same winding as the rest of the terrain
+	void addTriangle(std::vector<GLushort> &triangles, glm::ivec2 p0, glm::ivec2 p1, glm::ivec2 p2)
+	{
+		int cross = (p1.x - p0.x) * (p2.y - p0.y) - (p1.y - p0.y) * (p2.x - p0.x);
+		if (cross == 0)
+		{
+			return; // skip degenerate triangles
+		}
+		if (cross < 0)
+		{
+			std::swap(p1, p2);
+		}
+		triangles.push_back(chunkVertex(p0.x, p0.y));
+		triangles.push_back(chunkVertex(p1.x, p1.y));
+		triangles.push_back(chunkVertex(p2.x, p2.y));
+	}
+
+	// Precondition:	step is the vertex spacing of the level, edgeStep is the spacing along the chunk edge
+	// Postcondition:	Triangles joining the edge on side to the inner ring of the level are added
+	void addEdge(std::vector<GLushort> &triangles, int side, int step, int edgeStep)
+	{
+		// Point t along the edge (depth 0) or along the inner ring (depth step) of the side
+		auto point = [this, side](int t, int depth) {
+			switch (side)
+			{
+			case 0:
+				return glm::ivec2(t, depth);
+			case 1:
+				return glm::ivec2(chunkSize - depth, t);
+			case 2:
+				return glm::ivec2(t, chunkSize - depth);
+			default:
+				return glm::ivec2(depth, t);
+			}
+		};
+
+		// Zip the two lines together, always advancing the one that is behind
+		int edge = 0;
+		int inner = step;
+		while (edge < chunkSize || inner < chunkSize - step)
+		{
+			if (inner >= chunkSize - step || (edge < chunkSize && edge + edgeStep <= inner + step))
+			{
+				addTriangle(triangles, point(edge, 0), point(edge + edgeStep, 0), point(inner, step));
+				edge += edgeStep;
+			}
+			else
+			{
+				addTriangle(triangles, point(edge, 0), point(inner + step, step), point(inner, step));
+				inner += step;
+			}
+		}
+	}
+
+	// Precondition:	The terrain has been drawn in the pass
+	// Postcondition:	The grass of the chunks near the camera is drawn, returns the number of blades drawn
+	int drawGrass(const utility::frame::FrameContext &frame)
+	{
+		const glm::mat4 &Hvw = frame.view;
+		const glm::mat4 &Hcv = frame.projection;
+		const glm::vec3 &cameraPosition = frame.cameraPosition;
+
+		// Buffers and shader
+		glUseProgram(grassShader); // switch to the grass shader
+
+		// Textures
+		for (int i = 0; i < 4; i++)
+		{
+			glActiveTexture(GL_TEXTURE1 + i);
+			glBindTexture(GL_TEXTURE_2D, grassTex[i]);
+		}
+
+		// Uniforms
+		glUniformMatrix4fv(grassUniforms.Hvw, 1, GL_FALSE, &Hvw[0][0]);
+		glUniformMatrix4fv(grassUniforms.Hcv, 1, GL_FALSE, &Hcv[0][0]);
+		glUniform4fv(grassUniforms.clippingPlane, 1, &frame.clippingPlane[0]);
+		glUniform3fv(grassUniforms.cameraPosition, 1, &cameraPosition[0]);
+		glUniform1f(grassUniforms.time, frame.time);
+
+		// Draw the blades of the chunks near the camera, two crossed cards per blade
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		glBindVertexArray(grassVao);
+		int blades = 0;
+		for (const Chunk &chunk : chunks)
+		{
+			if (chunk.grassBuffer == 0 || chunk.grass.count == 0)
+			{
+				continue;
+			}
+			glm::vec3 closest = glm::clamp(cameraPosition, chunk.min, chunk.max);
+			if (glm::length(closest - cameraPosition) > GRASS_DISTANCE || !frame.canSee(chunk.min, chunk.max))
+			{
+				continue;
+			}
+
+			// Point the instance attributes at the chunk's blades
+			const char *offset = (const char *)(chunk.grass.first * sizeof(GrassBlade));
+			glBindBuffer(GL_ARRAY_BUFFER, chunk.grassBuffer);
+			glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(GrassBlade), offset);
+			glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(GrassBlade), offset + sizeof(glm::vec4));
+			glDrawArraysInstanced(GL_TRIANGLES, 0, GRASS_CARD_VERTICES, chunk.grass.count);
+			blades += chunk.grass.count;
+		}
+		glDisable(GL_BLEND);
+		return blades;
+	}
+
+	// Precondition:	Chunk size and number of levels are set
+	// Postcondition:	Index patterns for every level are built and uploaded to the element buffer
+	void createPatterns()
+	{
+		std::vector<GLushort> triangles;
+		for (int level = 0; level < levels; level++)
+		{
+			int step = 1 << level;
+
+			// Interior squares, between the inner ring at step from each edge
+			interior[level].first = triangles.size();
+			for (int a = step; a < chunkSize - step; a += step)
+			{
+				for (int b = step; b < chunkSize - step; b += step)
+				{
+					addTriangle(triangles, glm::ivec2(a, b + step), glm::ivec2(a, b), glm::ivec2(a + step, b));
+					addTriangle(triangles, glm::ivec2(a + step, b), glm::ivec2(a + step, b + step), glm::ivec2(a, b + step));
+				}
+			}
+			interior[level].count = triangles.size() - interior[level].first;
+
+			// Edges, either at the same step or stitched to a neighbour one level finer
+			for (int side = 0; side < 4; side++)
+			{
+				for (int finer = 0; finer < 2; finer++)
+				{
+					int edgeStep = (finer && step > 1) ? step / 2 : step;
+					Pattern &edge = edges[level][side][finer];
+					edge.first = triangles.size();
+					addEdge(triangles, side, step, edgeStep);
+					edge.count = triangles.size() - edge.first;
+				}
+			}
+		}
+
+		glGenBuffers(1, &ebo);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, triangles.size() * sizeof(GLushort), &triangles.front(), GL_STATIC_DRAW);
+	}
+
+	// Locations of the uniforms that are set on every draw, found once after the shaders are linked
+	struct Uniforms
+	{
+		GLint Hvw;
+		GLint Hcv;
+		GLint time;
+		GLint clippingPlane;
+		GLint cameraPosition;
+		GLint lightPosition;
+		GLint lightColour;
+	};
+	Uniforms uniforms;		 // terrain shader uniforms
+	Uniforms grassUniforms;	 // grass shader uniforms
+
+	// Precondition:	Shader programs are linked
+	// Postcondition:	Uniform locations are stored, uniforms that never change (samplers, sizes,
+	//					model transform) are set and the shaders read from the shared light buffer
+	void initUniforms()
+	{
+		const char *names[] = {"Hvw", "Hcv", "time", "clippingPlane", "cameraPosition", "lightPosition", "lightColour"};
+		GLint *terrainLocations[] = {&uniforms.Hvw, &uniforms.Hcv, &uniforms.time, &uniforms.clippingPlane,
+									 &uniforms.cameraPosition, &uniforms.lightPosition, &uniforms.lightColour};
+		GLint *grassLocations[] = {&grassUniforms.Hvw, &grassUniforms.Hcv, &grassUniforms.time, &grassUniforms.clippingPlane,
+								   &grassUniforms.cameraPosition, &grassUniforms.lightPosition, &grassUniforms.lightColour};
+		for (int i = 0; i < 7; i++)
+		{
+			*terrainLocations[i] = glGetUniformLocation(shader, names[i]);
+			*grassLocations[i] = glGetUniformLocation(grassShader, names[i]);
+		}
+
+		// Set camera in middle of terrain
+		glm::mat4 Hwm = glm::mat4(1.0f);
+		Hwm[3] = glm::vec4(-(resX * scale) / 2, yOffset, -(resZ * scale) / 2, 1.0);
+
+		glUseProgram(shader);
+		glUniform1i(glGetUniformLocation(shader, "texGrass"), 0);
+		glUniform1i(glGetUniformLocation(shader, "texRock"), 1);
+		glUniform1i(glGetUniformLocation(shader, "texSand"), 2);
+		glUniform1i(glGetUniformLocation(shader, "normalMap"), 3);
+		glUniform1i(glGetUniformLocation(shader, "waterNormalMap"), 4);
+		glUniformMatrix4fv(glGetUniformLocation(shader, "Hwm"), 1, GL_FALSE, &Hwm[0][0]);
+		glUniform1f(glGetUniformLocation(shader, "scale"), scale);
+		glUniform1f(glGetUniformLocation(shader, "grassHeight"), grassHeight);
+		glUniform1f(glGetUniformLocation(shader, "resolutionX"), resX);
+		glUniform1f(glGetUniformLocation(shader, "resolutionZ"), resZ);
+		glUniform1f(glGetUniformLocation(shader, "waterHeight"), waterHeight);
+		lights::LightBuffer::bindShader(shader);
+
+		glUseProgram(grassShader);
+		glUniform1i(glGetUniformLocation(grassShader, "grassTex1"), 1);
+		glUniform1i(glGetUniformLocation(grassShader, "grassTex2"), 2);
+		glUniform1i(glGetUniformLocation(grassShader, "grassTex3"), 3);
+		glUniform1i(glGetUniformLocation(grassShader, "grassTex4"), 4);
+		glUniformMatrix4fv(glGetUniformLocation(grassShader, "Hwm"), 1, GL_FALSE, &Hwm[0][0]);
+		glUniform1f(glGetUniformLocation(grassShader, "scale"), scale);
+		glUniform1f(glGetUniformLocation(grassShader, "grassScale"), 5.0);
+		lights::LightBuffer::bindShader(grassShader);
+
+		glUseProgram(0);
+	}
+
+	// Precondition:	vertexAtt is number of vertex attributes, the heightfield has been loaded
 	// Postcondition:	Mesh is created and loaded into VAO, VBO, EBO
-	void createMesh(int vertexAtt, int maxHeight, const std::vector<float> *heights)
+	void createMesh(int vertexAtt)
 	{
 		//---------------------------
 		// BIND VERTEX ARRAY OBJECT
@@ -269,24 +760,70 @@ private:
 		glGenVertexArrays(1, &vao);
 		glBindVertexArray(vao);
 
+		//--------------
+		// SPLIT CHUNKS
+		//--------------
+		// Larger height maps use larger chunks so the number of chunks (and draw calls) stays about the same,
+		// streamed tiles always use the smallest chunks. Chunks stay small enough for 16 bit indices.
+		chunkSize = 64;
+		while (streamRadius == 0 && std::max(resX, resZ) / chunkSize > 16 && chunkSize * 2 <= utility::grid::MAX_TILE_SIZE)
+		{
+			chunkSize *= 2;
+		}
+		levels = 0;
+		while ((1 << (levels + 1)) < chunkSize && levels < MAX_LEVELS)
+		{
+			levels++;
+		}
+		lodDistance = chunkSize * scale;
+
+		// Streamed tiles build their own vertices, only the index patterns are shared
+		if (streamRadius > 0)
+		{
+			createPatterns();
+			return;
+		}
+		utility::grid::GridLayout layout = utility::grid::makeLayout(resX, resZ, chunkSize);
+		chunksX = layout.tilesX;
+		chunksZ = layout.tilesZ;
+
 		//----------------
 		// CREATE VERTICES
 		//----------------
-		float *vertices = new float[resX * resZ * vertexAtt]; // resolution multiplied by number of vertex attributes
-
-		// Loop over grid
-		for (int i = 0; i < resX; i++)
+		// Each chunk has its own block of vertices, chunks on the far edges repeat the last row and column
+		noVertices = layout.vertexCount();
+		std::vector<float> vertices(noVertices * vertexAtt);
+		const Heightfield &field = *heightfield;
+		utility::grid::buildPositions(layout, [&field](int i, int j) { return field.at(i, j); }, glm::ivec2(0), &vertices[0]);
+
+		// Bounding box of each chunk in world space, matching the model transform the shader applies
+		chunks.reserve(chunksX * chunksZ);
+		for (int cx = 0; cx < chunksX; cx++)
 		{
-			for (int j = 0; j < resZ; j++)
+			for (int cz = 0; cz < chunksZ; cz++)
 			{
-				float currentHeight = (heights->at(j * (resX) + i)) * maxHeight; // find the current height of the terrain at the x,z pos
-				// Position
-				vertices[(i * (resZ + resZ * (vertexAtt - 1))) + (j * vertexAtt) + 0] = (float)i;	  // X
-				vertices[(i * (resZ + resZ * (vertexAtt - 1))) + (j * vertexAtt) + 1] = currentHeight; // Y
-				vertices[(i * (resZ + resZ * (vertexAtt - 1))) + (j * vertexAtt) + 2] = (float)j;	  // Z
-
-				// Vertices to use in collisions etc.
-				terraVertices[i][j] = currentHeight;
+				int endX = std::min((cx + 1) * chunkSize, resX - 1);
+				int endZ = std::min((cz + 1) * chunkSize, resZ - 1);
+				float minHeight = field.at(cx * chunkSize, cz * chunkSize);
+				float maxHeight = minHeight;
+				for (int i = cx * chunkSize; i <= endX; i++)
+				{
+					for (int j = cz * chunkSize; j <= endZ; j++)
+					{
+						minHeight = std::min(minHeight, field.at(i, j));
+						maxHeight = std::max(maxHeight, field.at(i, j));
+					}
+				}
+
+				Chunk chunk;
+				chunk.vao = vao;
+				chunk.baseVertex = layout.baseVertex(cx, cz);
+				chunk.level = 0;
+				chunk.grassBuffer = 0;
+				chunk.grass = GrassBucket{0, 0};
+				chunk.min = glm::vec3(cx * chunkSize * scale - (resX * scale) / 2, minHeight + yOffset, cz * chunkSize * scale - (resZ * scale) / 2);
+				chunk.max = glm::vec3(endX * scale - (resX * scale) / 2, maxHeight + yOffset, endZ * scale - (resZ * scale) / 2);
+				chunks.push_back(chunk);
 			}
 		}
 
@@ -295,55 +832,77 @@ private:
 		//---------
 		glGenBuffers(1, &vbo);
 		glBindBuffer(GL_ARRAY_BUFFER, vbo);
-		glBufferData(GL_ARRAY_BUFFER, resX * resZ * vertexAtt * sizeof(float), &vertices[0], GL_STATIC_DRAW);
-		delete[] vertices; // free memory from vertices
+		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), &vertices[0], GL_STATIC_DRAW);
 
 		//-----------------
 		// CREATE TRIANGLES
 		//-----------------
-		std::vector<GLuint> *triangles = new std::vector<GLuint>(); // Vector that will store all the triangles
-
-		// Loop over grid except last row and column to get triangles
-		for (int i = 0; i < resX - 1; i++)
-		{
-			for (int j = 0; j < resZ - 1; j++)
-			{
-				// Add vertices of triangles (two triangles that make a square across and up to current vertex)
-
-				// FIRST TRIANGLE
-				triangles->push_back(((i * (resZ + resZ * (vertexAtt - 1))) + ((j + 1) * vertexAtt)) / vertexAtt); // bottom-left	(i, j + 1)
-				triangles->push_back(((i * (resZ + resZ * (vertexAtt - 1))) + (j * vertexAtt)) / vertexAtt);	   // top-left		(i, j)
-				triangles->push_back((((i + 1) * (resZ + resZ * (vertexAtt - 1))) + (j * vertexAtt)) / vertexAtt); // top-right	(i + 1, j)
+		createPatterns();
+	}
 
-				// SECOND TRIANGLE
-				triangles->push_back((((i + 1) * (resZ + resZ * (vertexAtt - 1))) + (j * vertexAtt)) / vertexAtt);		 // top-right	(i + 1, j)
-				triangles->push_back((((i + 1) * (resZ + resZ * (vertexAtt - 1))) + ((j + 1) * vertexAtt)) / vertexAtt); // bottom-right (i + 1, j + 1)
-				triangles->push_back(((i * (resZ + resZ * (vertexAtt - 1))) + ((j + 1) * vertexAtt)) / vertexAtt);		 // bottom-left	(i, j + 1)
+	// Precondition:	The chunks are created, the streamer is created if the terrain is streamed
+	// Postcondition:	The grass cards are created and, for a single height map, every chunk's blades are planted and uploaded.
+	//					Streamed tiles plant their own blades when they are loaded.
+	void createGrass()
+	{
+		glGenVertexArrays(1, &grassVao);
+		glBindVertexArray(grassVao);
+
+		// Corners of the cards, the same for every blade
+		glGenBuffers(1, &grassCardVbo);
+		glBindBuffer(GL_ARRAY_BUFFER, grassCardVbo);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(GRASS_CARD_CORNERS), GRASS_CARD_CORNERS, GL_STATIC_DRAW);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), 0);
+
+		// Blade position and normal advance once per card, their buffer is set for each chunk when drawing
+		glEnableVertexAttribArray(1);
+		glEnableVertexAttribArray(2);
+		glVertexAttribDivisor(1, 1);
+		glVertexAttribDivisor(2, 1);
+		glBindVertexArray(0);
 
-				// Set the number of vertices for drawing later
-				noVertices = triangles->size();
-			}
+		if (streamer != nullptr)
+		{
+			return;
 		}
 
-		//---------
-		// BIND EBO
-		//---------
-		glGenBuffers(1, &ebo);
-
-		// set elements to the triangles that were just made
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, triangles->size() * sizeof(float), &triangles->front(), GL_STATIC_DRAW);
+		// Normals come from the normal map the terrain is lit with, rows of the image run along z
+		int width, height;
+		unsigned char *image = utility::image::load("terrain/normalmap.png", &width, &height, 0, SOIL_LOAD_RGB);
+		auto normal = [this, image, width, height](int i, int j) {
+			const unsigned char *texel = image + ((j * height / resZ) * width + (i * width / resX)) * 3;
+			return glm::normalize(glm::vec3(texel[0] / 255.0f * 2 - 1, texel[2] / 255.0f, texel[1] / 255.0f * 2 - 1));
+		};
+		const Heightfield &field = *heightfield;
+		std::vector<GrassBlade> blades;
+		std::vector<GrassBucket> buckets;
+		plantGrass(utility::grid::makeLayout(resX, resZ, chunkSize), glm::ivec2(0), grassHeight,
+				   [&field](int i, int j) { return field.at(i, j); }, normal, blades, buckets);
+		SOIL_free_image_data(image);
+		if (blades.empty())
+		{
+			return;
+		}
 
-		std::vector<GLuint>().swap(*triangles); // free memory from triangles
+		glGenBuffers(1, &grassVbo);
+		glBindBuffer(GL_ARRAY_BUFFER, grassVbo);
+		glBufferData(GL_ARRAY_BUFFER, blades.size() * sizeof(GrassBlade), &blades[0], GL_STATIC_DRAW);
+		for (int c = 0; c < (int)chunks.size(); c++)
+		{
+			chunks[c].grassBuffer = grassVbo;
+			chunks[c].grass = buckets[c];
+		}
 	}
 
 	// Precondition:	heightMap is the path to a .BMP file which is the height map image to be loaded
-	//					heightMap is the same dimension as resX x resZ
-	// Postcondition:	returns a vector of heights for each vertex
-	const std::vector<float> *readHeightMap(const std::string heightMap)
+	// Postcondition:	returns a vector of heights for each vertex, resX and resZ are set to the size of the image
+	std::vector<float> *readHeightMap(const std::string heightMap)
 	{
 		// Load in the height map
 		SDL_Surface *img = SDL_LoadBMP(heightMap.c_str());
+		resX = img->w;
+		resZ = img->h;
 
 		// Make the vector to store the height of each vertex
 		std::vector<float> *heights = new std::vector<float>;
@@ -365,6 +924,8 @@ private:
 			}
 		}
 
+		SDL_FreeSurface(img);
+
 		// Return the vector of vertex heights
 		return heights;
 	}
@@ -373,61 +934,48 @@ private:
 	// Postcondition:	Terrain textures are created and bound for grass, rock and water.
 	void loadTextures()
 	{
-		int width, height;		   // Variables for the width and height of image being loaded
-		glGenTextures(5, &tex[0]); // Generate three texture names
 
 		//--------------------
 		// CREATE GRASS TEXTURE
 		//--------------------
 		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, tex[0]);
-		unsigned char *image = SOIL_load_image("terrain/grass.png", &width, &height, 0, SOIL_LOAD_RGB);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
+		tex[0] = utility::texture::load("terrain/grass.png", COLOUR_MAP);
 
 		// Set the parameters for the grass texture
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glGenerateMipmap(GL_TEXTURE_2D);
 
 		//--------------------
 		// CREATE ROCK TEXTURE
 		//--------------------
 		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, tex[1]);
-		image = SOIL_load_image("terrain/rock.png", &width, &height, 0, SOIL_LOAD_RGB);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
+		tex[1] = utility::texture::load("terrain/rock.png", COLOUR_MAP);
 
 		// Set the parameters for the rock texture
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glGenerateMipmap(GL_TEXTURE_2D);
 
 		//--------------------
 		// CREATE SAND TEXTURE
 		//--------------------
 		glActiveTexture(GL_TEXTURE2);
-		glBindTexture(GL_TEXTURE_2D, tex[2]);
-		image = SOIL_load_image("terrain/sand.png", &width, &height, 0, SOIL_LOAD_RGB);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
+		tex[2] = utility::texture::load("terrain/sand.png", COLOUR_MAP);
 
 		// Set the parameters for the rock texture
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glGenerateMipmap(GL_TEXTURE_2D);
 
 		//------------------
 		// CREATE NORMAL MAP
 		//------------------
 		glActiveTexture(GL_TEXTURE3);
-		glBindTexture(GL_TEXTURE_2D, tex[3]);
-		image = SOIL_load_image("terrain/normalmap.png", &width, &height, 0, SOIL_LOAD_RGB);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
+		tex[3] = utility::texture::load("terrain/normalmap.png", DATA_MAP);
 
 		// Set the parameters for the rock texture
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
@@ -439,9 +987,7 @@ private:
 		// CREATE WATER NORMAL MAP
 		//------------------------
 		glActiveTexture(GL_TEXTURE4);
-		glBindTexture(GL_TEXTURE_2D, tex[4]);
-		image = SOIL_load_image("water/normalmap.png", &width, &height, 0, SOIL_LOAD_RGB);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
+		tex[4] = utility::texture::load("water/normalmap.png", DATA_MAP);
 
 		// Set the parameters for the rock texture
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
@@ -453,72 +999,42 @@ private:
 		// GRASS TEXTURES
 		//---------------
 
-		glGenTextures(5, &grassTex[0]); // Generate texture
-
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, grassTex[0]);
-
-		image = SOIL_load_image("terrain/normalmap.png", &width, &height, 0, SOIL_LOAD_RGB);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
-
-		// Set the parameters for the normal texture
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
 		// GRASS CARD TEXTURES
 		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, grassTex[1]);
-
-		image = SOIL_load_image("terrain/grass/grasses-1.png", &width, &height, 0, SOIL_LOAD_RGBA);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
+		grassTex[0] = utility::texture::load("terrain/grass/grasses-1.png", GRASS_CARD_MAP);
 
 		// Set the parameters for the normal texture
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glGenerateMipmap(GL_TEXTURE_2D);
 
 		glActiveTexture(GL_TEXTURE2);
-		glBindTexture(GL_TEXTURE_2D, grassTex[2]);
-
-		image = SOIL_load_image("terrain/grass/grasses-2.png", &width, &height, 0, SOIL_LOAD_RGBA);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
+		grassTex[1] = utility::texture::load("terrain/grass/grasses-2.png", GRASS_CARD_MAP);
 
 		// Set the parameters for the normal texture
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glGenerateMipmap(GL_TEXTURE_2D);
 
 		glActiveTexture(GL_TEXTURE3);
-		glBindTexture(GL_TEXTURE_2D, grassTex[3]);
-
-		image = SOIL_load_image("terrain/grass/grasses-3.png", &width, &height, 0, SOIL_LOAD_RGBA);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
+		grassTex[2] = utility::texture::load("terrain/grass/grasses-3.png", GRASS_CARD_MAP);
 
 		// Set the parameters for the normal texture
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glGenerateMipmap(GL_TEXTURE_2D);
 
 		glActiveTexture(GL_TEXTURE4);
-		glBindTexture(GL_TEXTURE_2D, grassTex[4]);
-
-		image = SOIL_load_image("terrain/grass/grasses-4.png", &width, &height, 0, SOIL_LOAD_RGBA);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
+		grassTex[3] = utility::texture::load("terrain/grass/grasses-4.png", GRASS_CARD_MAP);
 
 		// Set the parameters for the normal texture
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glGenerateMipmap(GL_TEXTURE_2D);
 	}
 
 	// Precondition:	Vertices is populated, contains point (i,j), vertex attributes
@@ -0,0 +1,478 @@
+/* tileStreamer.hpp
+ * Loads tiles of terrain around the camera on a background thread so the world isn't limited to one height map.
+ * A tile is a square of tileChunks x tileChunks terrain chunks. Tiles come from terrain/tiles/heightmap_<x>_<z>.bmp
+ * when that file exists, otherwise from the main height map mirrored across its edges, which repeats without seams.
+ * Finished tiles are uploaded into a fixed pool of vertex buffers, so memory stays the same however far the
+ * camera goes: tiles more than one ring outside the load radius are dropped and their buffer is reused.
+ * Grass is planted on each tile as it is loaded and uploaded with it.
+ */
+
+#ifndef ASSIGNMENT_TILE_STREAMER_HPP
+#define ASSIGNMENT_TILE_STREAMER_HPP
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "util/gridMesh.hpp"
+#include "terrain/grass.hpp"
+#include "terrain/heightfield.hpp"
+
+namespace terrain
+{
+
+class TileStreamer
+{
+public:
+	// A loaded tile of terrain
+	struct Tile
+	{
+		int x;							  // tile coordinates, tile (0, 0) starts at the first vertex of the main height map
+		int z;
+		std::vector<float> heights;		  // (tileSize + 1)^2 heights, x major
+		std::vector<float> vertices;	  // chunk major vertex blocks, emptied once uploaded
+		std::vector<glm::vec2> chunkHeights; // lowest and highest point of each chunk, x major
+		std::vector<GrassBlade> blades;	  // grass blades, emptied once uploaded
+		std::vector<GrassBucket> grassBuckets; // blades of each chunk, x major
+		int slot;						  // vertex buffer the tile is uploaded to
+	};
+
+	// Precondition:	base is the main height map, ebo holds the chunk index patterns and posAttrib is the
+	//					position attribute of the terrain shaders
+	// Postcondition:	The vertex buffer pool is created and the loading thread is started
+	TileStreamer(std::shared_ptr<const Heightfield> base_, int maxHeight_, float grassHeight_, int chunkSize_, int tileChunks_,
+				 int radius_, GLuint ebo, GLint posAttrib)
+	{
+		base = base_;
+		resX = base->getResX();
+		resZ = base->getResZ();
+		maxHeight = maxHeight_;
+		grassHeight = grassHeight_;
+		chunkSize = chunkSize_;
+		tileChunks = tileChunks_;
+		tileSize = chunkSize * tileChunks;
+		radius = radius_;
+		stopping = false;
+
+		// Every tile within one ring of the load radius can be resident at once, so there is always a free slot
+		int slotCount = (2 * (radius + 1) + 1) * (2 * (radius + 1) + 1);
+		GLsizeiptr bytes = tileVertexCount() * 3 * sizeof(float);
+		for (int i = 0; i < slotCount; i++)
+		{
+			Slot slot;
+			glGenVertexArrays(1, &slot.vao);
+			glBindVertexArray(slot.vao);
+			glGenBuffers(1, &slot.vbo);
+			glBindBuffer(GL_ARRAY_BUFFER, slot.vbo);
+			glBufferData(GL_ARRAY_BUFFER, bytes, NULL, GL_STATIC_DRAW);
+			glEnableVertexAttribArray(posAttrib);
+			glVertexAttribPointer(posAttrib, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), 0);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+			glGenBuffers(1, &slot.grassVbo);
+			slots.push_back(slot);
+			freeSlots.push_back(i);
+		}
+		glBindVertexArray(0);
+
+		worker = std::thread(&TileStreamer::loadTiles, this);
+	}
+
+	~TileStreamer()
+	{
+		stop();
+	}
+
+	// Precondition:	centre is the tile under the camera, called from the thread that owns the GL context
+	// Postcondition:	Tiles around centre are requested, far tiles are dropped and a few finished tiles are uploaded.
+	//					Returns true if the set of resident tiles changed
+	bool update(glm::ivec2 centre)
+	{
+		bool changed = false;
+
+		// Drop the tiles that are too far away and reuse their buffers
+		for (auto it = resident.begin(); it != resident.end();)
+		{
+			if (distance(it->second->x, it->second->z, centre) > radius + 1)
+			{
+				freeSlots.push_back(it->second->slot);
+				it = resident.erase(it);
+				changed = true;
+			}
+			else
+			{
+				++it;
+			}
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			// Forget requests that are no longer needed, the loading thread skips them
+			for (auto it = wanted.begin(); it != wanted.end();)
+			{
+				if (distance(keyX(*it), keyZ(*it), centre) > radius + 1)
+				{
+					it = wanted.erase(it);
+				}
+				else
+				{
+					++it;
+				}
+			}
+
+			// Request the missing tiles, closest ring first
+			for (int ring = 0; ring <= radius; ring++)
+			{
+				for (int x = centre.x - ring; x <= centre.x + ring; x++)
+				{
+					for (int z = centre.y - ring; z <= centre.y + ring; z++)
+					{
+						std::int64_t key = tileKey(x, z);
+						if (distance(x, z, centre) != ring || resident.count(key) || wanted.count(key))
+						{
+							continue;
+						}
+						wanted.insert(key);
+						requests.push_back(glm::ivec2(x, z));
+					}
+				}
+			}
+
+			// Collect the tiles the loading thread has finished
+			while (!finished.empty())
+			{
+				ready.push_back(std::move(finished.front()));
+				finished.pop_front();
+			}
+		}
+		condition.notify_one();
+
+		// Upload a few tiles each frame so a burst of finished tiles doesn't stall a frame
+		for (int uploads = 0; uploads < MAX_UPLOADS && !ready.empty();)
+		{
+			std::unique_ptr<Tile> tile = std::move(ready.front());
+			ready.pop_front();
+			std::int64_t key = tileKey(tile->x, tile->z);
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				wanted.erase(key);
+			}
+			if (distance(tile->x, tile->z, centre) > radius + 1 || resident.count(key))
+			{
+				continue; // no longer needed, or loaded twice after being requested again
+			}
+
+			tile->slot = freeSlots.back();
+			freeSlots.pop_back();
+			upload(*tile);
+			resident[key] = std::move(tile);
+			changed = true;
+			uploads++;
+		}
+		return changed;
+	}
+
+	// Precondition:	None
+	// Postcondition:	Returns the resident tile at (x, z), or null if it isn't loaded
+	const Tile *find(int x, int z) const
+	{
+		auto it = resident.find(tileKey(x, z));
+		return it == resident.end() ? nullptr : it->second.get();
+	}
+
+	// Precondition:	tile is resident
+	// Postcondition:	Returns the vertex array the tile is drawn with
+	GLuint vertexArray(const Tile &tile) const
+	{
+		return slots[tile.slot].vao;
+	}
+
+	// Precondition:	tile is resident
+	// Postcondition:	Returns the buffer holding the tile's grass blades
+	GLuint grassBuffer(const Tile &tile) const
+	{
+		return slots[tile.slot].grassVbo;
+	}
+
+	// Precondition:	None
+	// Postcondition:	Calls visit(tile) for every resident tile
+	template <typename Visitor>
+	void forEachTile(Visitor visit) const
+	{
+		for (const auto &entry : resident)
+		{
+			visit(*entry.second);
+		}
+	}
+
+	// Precondition:	(i, j) is any vertex of the infinite terrain grid
+	// Postcondition:	Returns the height from the resident tile, or from the main height map if the tile isn't loaded
+	float heightAt(int i, int j) const
+	{
+		int x = floorDiv(i, tileSize);
+		int z = floorDiv(j, tileSize);
+		const Tile *tile = find(x, z);
+		if (tile == nullptr)
+		{
+			return baseHeight(i, j);
+		}
+		return tile->heights[(i - x * tileSize) * (tileSize + 1) + (j - z * tileSize)];
+	}
+
+	// Precondition:	None
+	// Postcondition:	Number of vertices in a tile's vertex buffer
+	int tileVertexCount() const
+	{
+		return tileChunks * tileChunks * (chunkSize + 1) * (chunkSize + 1);
+	}
+
+	// Precondition:	None
+	// Postcondition:	Returns a / b rounded towards negative infinity
+	static int floorDiv(int a, int b)
+	{
+		return (a >= 0 ? a : a - b + 1) / b;
+	}
+
+	// Precondition:	None
+	// Postcondition:	The loading thread is stopped and the vertex buffers are deleted
+	void stop()
+	{
+		if (!worker.joinable())
+		{
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		condition.notify_one();
+		worker.join();
+
+		for (Slot &slot : slots)
+		{
+			glDeleteBuffers(1, &slot.vbo);
+			glDeleteBuffers(1, &slot.grassVbo);
+			glDeleteVertexArrays(1, &slot.vao);
+		}
+		slots.clear();
+		resident.clear();
+	}
+
+private:
+	static const int MAX_UPLOADS = 2; // tiles uploaded per update
+
+	// A vertex buffer a tile can be uploaded to
+	struct Slot
+	{
+		GLuint vao;
+		GLuint vbo;
+		GLuint grassVbo;
+	};
+
+	// Main height map, the fallback for tiles without their own file
+	std::shared_ptr<const Heightfield> base;
+	int resX;
+	int resZ;
+	int maxHeight;
+	float grassHeight; // height that the grass starts to grow
+
+	int chunkSize;	// squares along a chunk
+	int tileChunks; // chunks along a tile
+	int tileSize;	// squares along a tile
+	int radius;		// tiles loaded in each direction around the camera
+
+	// Owned by the thread drawing the terrain
+	std::unordered_map<std::int64_t, std::unique_ptr<Tile>> resident;
+	std::deque<std::unique_ptr<Tile>> ready; // loaded, waiting to be uploaded
+	std::vector<Slot> slots;
+	std::vector<int> freeSlots;
+
+	// Shared with the loading thread, guarded by mutex
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::deque<glm::ivec2> requests;
+	std::unordered_set<std::int64_t> wanted; // requested tiles that haven't been uploaded yet
+	std::deque<std::unique_ptr<Tile>> finished;
+	bool stopping;
+	std::thread worker;
+
+	static std::int64_t tileKey(int x, int z)
+	{
+		return ((std::int64_t)x << 32) | (std::uint32_t)z;
+	}
+
+	static int keyX(std::int64_t key)
+	{
+		return (int)(key >> 32);
+	}
+
+	static int keyZ(std::int64_t key)
+	{
+		return (int)(std::uint32_t)key;
+	}
+
+	// Number of rings between tile (x, z) and centre
+	static int distance(int x, int z, glm::ivec2 centre)
+	{
+		return std::max(std::abs(x - centre.x), std::abs(z - centre.y));
+	}
+
+	// Height of the main height map at (i, j), mirrored at the edges so the pattern repeats without seams
+	float baseHeight(int i, int j) const
+	{
+		return base->at(mirror(i, resX), mirror(j, resZ));
+	}
+
+	static int mirror(int i, int res)
+	{
+		int period = 2 * (res - 1);
+		i = ((i % period) + period) % period;
+		return i < res ? i : period - i;
+	}
+
+	// Loading thread, loads requested tiles until stopped
+	void loadTiles()
+	{
+		while (true)
+		{
+			glm::ivec2 request;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				condition.wait(lock, [this] { return stopping || !requests.empty(); });
+				if (stopping)
+				{
+					return;
+				}
+				request = requests.front();
+				requests.pop_front();
+				if (!wanted.count(tileKey(request.x, request.y)))
+				{
+					continue; // camera moved away before the tile was loaded
+				}
+			}
+
+			std::unique_ptr<Tile> tile(new Tile());
+			tile->x = request.x;
+			tile->z = request.y;
+			loadTile(*tile);
+
+			std::lock_guard<std::mutex> lock(mutex);
+			finished.push_back(std::move(tile));
+		}
+	}
+
+	// Read the heights of the tile and build its vertex blocks, runs on the loading thread
+	void loadTile(Tile &tile)
+	{
+		int size = tileSize + 1;
+		tile.heights.resize(size * size);
+		if (!readTileFile(tile))
+		{
+			for (int a = 0; a < size; a++)
+			{
+				for (int b = 0; b < size; b++)
+				{
+					tile.heights[a * size + b] = baseHeight(tile.x * tileSize + a, tile.z * tileSize + b);
+				}
+			}
+		}
+
+		// Same layout as the single height map: a block of (chunkSize + 1)^2 vertices per chunk
+		utility::grid::GridLayout layout = utility::grid::makeLayout(size, size, chunkSize);
+		const std::vector<float> &heights = tile.heights;
+		tile.vertices.resize(layout.vertexCount() * 3);
+		utility::grid::buildPositions(layout, [&heights, size](int i, int j) { return heights[i * size + j]; },
+									  glm::ivec2(tile.x * tileSize, tile.z * tileSize), &tile.vertices[0]);
+
+		// Height range of each chunk, for culling
+		tile.chunkHeights.resize(tileChunks * tileChunks);
+		for (int cx = 0; cx < tileChunks; cx++)
+		{
+			for (int cz = 0; cz < tileChunks; cz++)
+			{
+				glm::vec2 &range = tile.chunkHeights[cx * tileChunks + cz];
+				range = glm::vec2(heights[(cx * chunkSize) * size + cz * chunkSize]);
+				for (int i = cx * chunkSize; i <= (cx + 1) * chunkSize; i++)
+				{
+					for (int j = cz * chunkSize; j <= (cz + 1) * chunkSize; j++)
+					{
+						range.x = std::min(range.x, heights[i * size + j]);
+						range.y = std::max(range.y, heights[i * size + j]);
+					}
+				}
+			}
+		}
+
+		// Grass, on the tile's own squares so neighbouring tiles don't plant the same blades twice.
+		// Normals are taken from the heights either side, clamped to the tile
+		float spacing = base->getSpacing();
+		auto normal = [&heights, size, spacing](int i, int j) {
+			float dx = heights[std::min(i + 1, size - 1) * size + j] - heights[std::max(i - 1, 0) * size + j];
+			float dz = heights[i * size + std::min(j + 1, size - 1)] - heights[i * size + std::max(j - 1, 0)];
+			return glm::normalize(glm::vec3(-dx, 2.0f * spacing, -dz));
+		};
+		plantGrass(utility::grid::makeLayout(tileSize, tileSize, chunkSize), glm::ivec2(tile.x * tileSize, tile.z * tileSize),
+				   grassHeight, [&heights, size](int i, int j) { return heights[i * size + j]; }, normal, tile.blades,
+				   tile.grassBuckets);
+	}
+
+	// Load terrain/tiles/heightmap_<x>_<z>.bmp if it exists, it must be (tileSize + 1) pixels square
+	bool readTileFile(Tile &tile)
+	{
+		std::string path = "terrain/tiles/heightmap_" + std::to_string(tile.x) + "_" + std::to_string(tile.z) + ".bmp";
+		SDL_Surface *img = SDL_LoadBMP(path.c_str());
+		if (img == NULL)
+		{
+			return false;
+		}
+
+		int size = tileSize + 1;
+		bool loaded = img->w == size && img->h == size && img->format->BytesPerPixel == 4;
+		if (loaded)
+		{
+			for (int row = 0; row < size; row++)
+			{
+				for (int column = 0; column < size; column++)
+				{
+					Uint32 pixel = ((Uint32 *)img->pixels)[row * img->pitch / 4 + column];
+					Uint8 r, g, b;
+					SDL_GetRGB(pixel, img->format, &r, &g, &b);
+					tile.heights[column * size + row] = ((float)r / 255.0) * maxHeight; // rows of the image run along z
+				}
+			}
+		}
+		SDL_FreeSurface(img);
+		return loaded;
+	}
+
+	// Copy a tile into its vertex buffer
+	void upload(Tile &tile)
+	{
+		GLsizeiptr bytes = tile.vertices.size() * sizeof(float);
+		glBindBuffer(GL_ARRAY_BUFFER, slots[tile.slot].vbo);
+		// Orphan the buffer first so the driver doesn't wait for draws that still use the old tile
+		glBufferData(GL_ARRAY_BUFFER, bytes, NULL, GL_STATIC_DRAW);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, &tile.vertices[0]);
+
+		// Blades are a different size for every tile, so the grass buffer is reallocated
+		glBindBuffer(GL_ARRAY_BUFFER, slots[tile.slot].grassVbo);
+		glBufferData(GL_ARRAY_BUFFER, tile.blades.size() * sizeof(GrassBlade), tile.blades.empty() ? NULL : &tile.blades[0],
+					 GL_STATIC_DRAW);
+
+		// Only the heights and grass ranges are kept on the CPU
+		std::vector<float>().swap(tile.vertices);
+		std::vector<GrassBlade>().swap(tile.blades);
+	}
+};
+
+} // namespace terrain
+
+#endif
@@ -21,10 +21,10 @@ namespace tree
 class Tree {
 public:
     //Tree constructor
-	Tree(const std::string map, terrain::Terrain terra)
+	Tree(const std::string map, const terrain::Heightfield &heightfield)
 	{
 		std::string placemap = map;
-		readPlaceMap(placemap, terra);
+		readPlaceMap(placemap, heightfield);
 	}
 	model::Model* placeTree(int i) {
 		return treeVect[i];
@@ -34,7 +34,7 @@ private:
     std::string placemap;
     std::vector<model::Model*> treeVect;
 
-    void readPlaceMap(std::string placemap, terrain::Terrain terrain){
+    void readPlaceMap(std::string placemap, const terrain::Heightfield &heightfield){
 		std::string treemodel;
         // Load in the height map
         SDL_Surface *img = SDL_LoadBMP(placemap.c_str());
@@ -80,8 +80,7 @@ private:
 						treemodel = "models/tree/tree2/tree2.obj";
 
 					model::Model* modeltree = new model::Model(treemodel);
-					//float modelHeightInWorld = modeltree->GetModelTerrainHeight(terrain, i-500, j - 500, 500, 500, -20.0f);
-                    modeltree->MoveTo(glm::vec3(i - 500, terrain.getHeightAt(i,j) - 20, j - 500));
+                    modeltree->MoveTo(glm::vec3(i - 500, heightfield.sampleHeight(i - 500, j - 500), j - 500));
                     treeVect.push_back(modeltree);
                 }
             }
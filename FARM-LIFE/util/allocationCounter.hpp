@@ -0,0 +1,75 @@
+/* allocationCounter.hpp
+ * Debug hook that counts heap allocations made by the program.
+ * Define FARMLIFE_COUNT_ALLOCATIONS to replace the global operator new with a counting version,
+ * the main loop then reports any frame where the render passes allocated memory.
+ * The FrameAllocationTest project builds util/frameAllocationTest.cpp with the hook, it renders every pass of a
+ * loaded scene without a window and fails if a frame allocates. Run it from this directory.
+ * Only include this from one source file of a program, the replacement operators must be defined exactly once.
+ */
+
+#ifndef UTILITY_ALLOCATION_COUNTER_HPP
+#define UTILITY_ALLOCATION_COUNTER_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+namespace utility {
+	namespace allocation {
+
+		// Number of allocations made since the program started
+		inline std::atomic<std::size_t>& counter()
+		{
+			static std::atomic<std::size_t> allocations(0);
+			return allocations;
+		}
+
+		// Returns the number of allocations made so far, always 0 if the hook isn't enabled
+		inline std::size_t count()
+		{
+			return counter().load(std::memory_order_relaxed);
+		}
+
+	}  // namespace allocation
+}  // namespace utility
+
+#ifdef FARMLIFE_COUNT_ALLOCATIONS
+
+void* operator new(std::size_t size)
+{
+	utility::allocation::counter().fetch_add(1, std::memory_order_relaxed);
+	void* memory = std::malloc(size == 0 ? 1 : size);
+	if (memory == nullptr)
+		throw std::bad_alloc();
+	return memory;
+}
+
+void* operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept
+{
+	std::free(memory);
+}
+
+#endif  // FARMLIFE_COUNT_ALLOCATIONS
+
+#endif  // UTILITY_ALLOCATION_COUNTER_HPP
@@ -0,0 +1,29 @@
+/* benchmarkPrelude.hpp
+ * The libraries main.cpp includes before the game's headers, which expect them. Benchmarks and tests that use the
+ * game's headers include this first. Each of them is its own console project under benchmarks/, built with the
+ * solution and sharing the game's include directories and libraries through benchmarks/Benchmark.props
+ */
+
+#ifndef UTILITY_BENCHMARK_PRELUDE_HPP
+#define UTILITY_BENCHMARK_PRELUDE_HPP
+
+#include <windows.h>
+#include <sdl.h>
+#include <SOIL.h>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include "glm/glm.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+#include "glm/gtc/type_ptr.hpp"
+#include "al.h"
+#include "alc.h"
+
+#include <iostream>
+#include <fstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <random>
+#include "util/mainUtil.hpp"
+
+#endif // UTILITY_BENCHMARK_PRELUDE_HPP
@@ -4,7 +4,7 @@
 #include <functional>
 #include <algorithm>
 #include <cmath>
-#include "models/model.hpp"
+#include "models/hitBoxGrid.hpp"
 
 namespace utility {
 	namespace camera {
@@ -167,7 +167,7 @@ namespace utility {
 
 			// Strafe left
 			// Moves the camera to the left if there are no collisions detected
-			void move_left(std::vector<model::HitBox> hitBoxes) {
+			void move_left(const model::HitBoxGrid& hitBoxes) {
 				// tempOrigin is the proposed next location of the camera, used to test for a collision on the next movement space
 				glm::vec3 tempOrigin = hitBox.origin - right * movement_sensitivity;
 				// if noClip is not set, detect a collision, otherwise ignore it and allow the camera to clip through things
@@ -188,7 +188,7 @@ namespace utility {
 
 			// Strafe right
 			// The opposite movement of left, a clone of the left function with a positive right direction
-			void move_right(std::vector<model::HitBox> hitBoxes) {
+			void move_right(const model::HitBoxGrid& hitBoxes) {
 				glm::vec3 tempOrigin = hitBox.origin + right * movement_sensitivity;
 				if (!noClip)
 				{
@@ -207,7 +207,7 @@ namespace utility {
 
 			// Move forward
 			// ------------
-			void move_forward(std::vector<model::HitBox> hitBoxes) {
+			void move_forward(const model::HitBoxGrid& hitBoxes) {
 				// Remove Y axis movement from the forward vector, this will keep the camera from taking flight!
 				glm::vec3 movementForward = glm::vec3(forward.x, 0.0f, forward.z);
 				glm::vec3 tempOrigin = hitBox.origin + movementForward * movement_sensitivity;
@@ -228,7 +228,7 @@ namespace utility {
 
 			// Move backward
 			// -------------
-			void move_backward(std::vector<model::HitBox> hitBoxes) {
+			void move_backward(const model::HitBoxGrid& hitBoxes) {
 				// Remove Y axis movement from the forward vector, this will keep the camera from taking flight!
 				glm::vec3 movementForward = glm::vec3(forward.x, 0.0f, forward.z);
 				glm::vec3 tempOrigin = hitBox.origin - movementForward * movement_sensitivity;
@@ -249,7 +249,7 @@ namespace utility {
 
 			// Move up
 			// -------
-			void move_up(std::vector<model::HitBox> hitBoxes) {
+			void move_up(const model::HitBoxGrid& hitBoxes) {
 				glm::vec3 tempOrigin = hitBox.origin + up * movement_sensitivity;
 				if (!collisionDetected(hitBoxes, tempOrigin, hitBox.size))
 				{
@@ -260,7 +260,7 @@ namespace utility {
 
 			// Move down
 			// ---------
-			void move_down(std::vector<model::HitBox> hitBoxes) {
+			void move_down(const model::HitBoxGrid& hitBoxes) {
 				glm::vec3 tempOrigin = hitBox.origin - up * movement_sensitivity;
 				if (!collisionDetected(hitBoxes, tempOrigin, hitBox.size))
 				{
@@ -374,22 +374,10 @@ namespace utility {
 
 			// Functions 
 			// Detect any collisions with the given camera position and a models hitbox
-			bool collisionDetected(std::vector<model::HitBox> hitBoxes, glm::vec3 cameraOrigin, glm::vec3 cameraSize)
+			bool collisionDetected(const model::HitBoxGrid& hitBoxes, glm::vec3 cameraOrigin, glm::vec3 cameraSize)
 			{
-				// Loop over the vector of hitboxes in the world
-				for (int i = 0; i < hitBoxes.size(); i++)
-				{
-					// Check each axis for overlap between the model hitbox and the camera hitbox
-					bool xCheck = abs(cameraOrigin.x - hitBoxes[i].origin.x) < cameraSize.x + hitBoxes[i].size.x;
-					bool yCheck = abs(cameraOrigin.y - hitBoxes[i].origin.y) < cameraSize.y + hitBoxes[i].size.y;
-					bool zCheck = abs(cameraOrigin.z - hitBoxes[i].origin.z) < cameraSize.z + hitBoxes[i].size.z;
-					if (xCheck && yCheck && zCheck) 
-					{
-						return true;
-					}
-					
-				}
-				return false;
+				// Only the hitboxes in the grid cells around the camera are tested
+				return hitBoxes.Collides(cameraOrigin, cameraSize);
 			}
 		};
 
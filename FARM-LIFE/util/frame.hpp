@@ -0,0 +1,57 @@
+/* frame.hpp
+ * Per frame (and per render pass) state that is shared by everything drawn in a pass.
+ * The context is built once before a pass and handed to each draw call by reference, so the
+ * camera transforms, clipping plane and lights are only calculated a single time.
+ */
+
+#ifndef UTILITY_FRAME_HPP
+#define UTILITY_FRAME_HPP
+
+#include "glm/glm.hpp"
+#include "lights/lights.hpp"
+#include "util/frustum.hpp"
+
+namespace utility {
+	namespace frame {
+
+		// The render passes that are drawn every frame
+		enum class Pass {
+			REFLECTION,		// scene above the water, drawn into the reflection frame buffer
+			REFRACTION,		// scene below the water, drawn into the refraction frame buffer
+			MAIN			// the scene drawn to the screen
+		};
+
+		// Immutable view of the frame for a single render pass
+		struct FrameContext {
+			const glm::mat4 view;				// world to view transform (Hvw)
+			const glm::mat4 projection;			// view to clip transform (Hcv)
+			const glm::mat4 skyboxView;			// view transform with the translation removed
+			const frustum::Frustum frustum;		// planes of the view volume, for culling
+			const glm::vec3 cameraPosition;
+			const glm::vec3 forward;			// camera view direction
+			const glm::vec4 clippingPlane;
+			const float time;					// program time when the frame started
+			const Pass pass;
+			const lights::LightSet& lightSet;	// lights shared by every pass in the frame
+
+			// Precondition:	min and max are the corners of a world space axis aligned box
+			// Postcondition:	Returns false if the box is outside the view, or completely on the side of the
+			//					clipping plane that is clipped away (above the water when refracting, below it when reflecting)
+			bool canSee(const glm::vec3& min, const glm::vec3& max) const
+			{
+				// Corner of the box furthest along the plane normal, a zero plane clips nothing
+				glm::vec3 corner(clippingPlane.x >= 0.0f ? max.x : min.x,
+								 clippingPlane.y >= 0.0f ? max.y : min.y,
+								 clippingPlane.z >= 0.0f ? max.z : min.z);
+				if (glm::dot(glm::vec3(clippingPlane), corner) + clippingPlane.w < 0.0f)
+				{
+					return false;
+				}
+				return frustum.intersects(min, max);
+			}
+		};
+
+	}  // namespace frame
+}  // namespace utility
+
+#endif  // UTILITY_FRAME_HPP
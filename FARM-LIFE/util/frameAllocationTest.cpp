@@ -0,0 +1,283 @@
+/* frameAllocationTest.cpp
+ * Test that rendering a frame doesn't allocate. No OpenGL context is made: the extension functions point at stubs that
+ * hand out names and pass every shader, and the OpenGL 1.1 functions do nothing without a context. A scene like the
+ * game's is loaded from the game's files and the camera turns a full circle while each pass is rendered, which sizes
+ * the batches and the queue for everything in view. During the next turn no pass may call operator new. Run it from
+ * the game's directory, it returns 1 if a pass allocated.
+ */
+
+#include "util/benchmarkPrelude.hpp"
+
+#ifndef FARMLIFE_COUNT_ALLOCATIONS
+#error frameAllocationTest counts allocations with the hook, define FARMLIFE_COUNT_ALLOCATIONS
+#endif
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "util/allocationCounter.hpp"
+#include "util/camera.hpp"
+#include "util/frame.hpp"
+#include "lights/lights.hpp"
+#include "terrain/terrain.hpp"
+#include "models/model.hpp"
+#include "models/modelBatch.hpp"
+#include "models/paddock/paddock.hpp"
+#include "skybox/skybox.hpp"
+#include "trees/tree.hpp"
+#include "util/scene.hpp"
+
+namespace
+{
+	const int TURN_FRAMES = 72;			 // frames of a full turn of the camera
+	const double TURN_STEP = 100.0;		 // mouse movement each frame, 5 degrees at the camera's sensitivity
+	const float WATER_HEIGHT = 30 / 2.5f; // the terrain and water main makes
+
+	// Stub driver state
+	GLuint lastName = 0;
+
+	void GLAPIENTRY stubGenNames(GLsizei n, GLuint* names)
+	{
+		for (GLsizei i = 0; i < n; i++)
+		{
+			names[i] = ++lastName;
+		}
+	}
+
+	GLuint GLAPIENTRY stubCreateProgram()
+	{
+		return ++lastName;
+	}
+
+	GLuint GLAPIENTRY stubCreateShader(GLenum)
+	{
+		return ++lastName;
+	}
+
+	// Every shader compiles and links, and has no log, attributes or uniforms to list
+	void GLAPIENTRY stubGetObjectiv(GLuint, GLenum pname, GLint* param)
+	{
+		*param = pname == GL_COMPILE_STATUS || pname == GL_LINK_STATUS ? GL_TRUE : 0;
+	}
+
+	void GLAPIENTRY stubGetInfoLog(GLuint, GLsizei bufSize, GLsizei* length, GLchar* infoLog)
+	{
+		if (length != NULL)
+		{
+			*length = 0;
+		}
+		if (bufSize > 0)
+		{
+			infoLog[0] = '\0';
+		}
+	}
+
+	void GLAPIENTRY stubGetActive(GLuint, GLuint, GLsizei maxLength, GLsizei* length, GLint* size, GLenum* type, GLchar* name)
+	{
+		stubGetInfoLog(0, maxLength, length, name);
+		*size = 0;
+		*type = GL_FLOAT;
+	}
+
+	GLint GLAPIENTRY stubGetLocation(GLuint, const GLchar*)
+	{
+		return 0;
+	}
+
+	GLuint GLAPIENTRY stubGetUniformBlockIndex(GLuint, const GLchar*)
+	{
+		return 0;
+	}
+
+	GLboolean GLAPIENTRY stubIsName(GLuint)
+	{
+		return GL_TRUE;
+	}
+
+	// Everything else is ignored
+	void GLAPIENTRY stubName(GLuint) {}
+	void GLAPIENTRY stubEnum(GLenum) {}
+	void GLAPIENTRY stubNameName(GLuint, GLuint) {}
+	void GLAPIENTRY stubNameNameName(GLuint, GLuint, GLuint) {}
+	void GLAPIENTRY stubBindBuffer(GLenum, GLuint) {}
+	void GLAPIENTRY stubBindBufferBase(GLenum, GLuint, GLuint) {}
+	void GLAPIENTRY stubBindFragDataLocation(GLuint, GLuint, const GLchar*) {}
+	void GLAPIENTRY stubDeleteNames(GLsizei, const GLuint*) {}
+	void GLAPIENTRY stubShaderSource(GLuint, GLsizei, const GLchar**, const GLint*) {}
+	void GLAPIENTRY stubBufferData(GLenum, GLsizeiptr, const GLvoid*, GLenum) {}
+	void GLAPIENTRY stubBufferSubData(GLenum, GLintptr, GLsizeiptr, const GLvoid*) {}
+	void GLAPIENTRY stubCompressedTexImage2D(GLenum, GLint, GLenum, GLsizei, GLsizei, GLint, GLsizei, const GLvoid*) {}
+	void GLAPIENTRY stubVertexAttribPointer(GLuint, GLint, GLenum, GLboolean, GLsizei, const GLvoid*) {}
+	void GLAPIENTRY stubDrawArraysInstanced(GLenum, GLint, GLsizei, GLsizei) {}
+	void GLAPIENTRY stubDrawElementsInstanced(GLenum, GLsizei, GLenum, const GLvoid*, GLsizei) {}
+	void GLAPIENTRY stubMultiDrawElementsBaseVertex(GLenum, GLsizei*, GLenum, GLvoid**, GLsizei, GLint*) {}
+	void GLAPIENTRY stubUniform1i(GLint, GLint) {}
+	void GLAPIENTRY stubUniform1f(GLint, GLfloat) {}
+	void GLAPIENTRY stubUniform3f(GLint, GLfloat, GLfloat, GLfloat) {}
+	void GLAPIENTRY stubUniform4f(GLint, GLfloat, GLfloat, GLfloat, GLfloat) {}
+	void GLAPIENTRY stubUniformfv(GLint, GLsizei, const GLfloat*) {}
+	void GLAPIENTRY stubUniformMatrix4fv(GLint, GLsizei, GLboolean, const GLfloat*) {}
+
+	// Precondition:	None
+	// Postcondition:	The extension functions the scene is loaded and drawn with point at the stubs
+	void stubExtensions()
+	{
+		__glewGenBuffers = stubGenNames;
+		__glewGenVertexArrays = stubGenNames;
+		__glewCreateProgram = stubCreateProgram;
+		__glewCreateShader = stubCreateShader;
+		__glewGetShaderiv = stubGetObjectiv;
+		__glewGetProgramiv = stubGetObjectiv;
+		__glewGetShaderInfoLog = stubGetInfoLog;
+		__glewGetProgramInfoLog = stubGetInfoLog;
+		__glewGetActiveAttrib = stubGetActive;
+		__glewGetActiveUniform = stubGetActive;
+		__glewGetAttribLocation = stubGetLocation;
+		__glewGetUniformLocation = stubGetLocation;
+		__glewGetUniformBlockIndex = stubGetUniformBlockIndex;
+		__glewIsBuffer = stubIsName;
+		__glewIsProgram = stubIsName;
+		__glewIsShader = stubIsName;
+		__glewIsVertexArray = stubIsName;
+		__glewActiveTexture = stubEnum;
+		__glewGenerateMipmap = stubEnum;
+		__glewBindVertexArray = stubName;
+		__glewCompileShader = stubName;
+		__glewDeleteProgram = stubName;
+		__glewDeleteShader = stubName;
+		__glewEnableVertexAttribArray = stubName;
+		__glewLinkProgram = stubName;
+		__glewUseProgram = stubName;
+		__glewAttachShader = stubNameName;
+		__glewVertexAttribDivisor = stubNameName;
+		__glewUniformBlockBinding = stubNameNameName;
+		__glewBindBuffer = stubBindBuffer;
+		__glewBindBufferBase = stubBindBufferBase;
+		__glewBindFragDataLocation = stubBindFragDataLocation;
+		__glewDeleteBuffers = stubDeleteNames;
+		__glewDeleteVertexArrays = stubDeleteNames;
+		__glewShaderSource = stubShaderSource;
+		__glewBufferData = stubBufferData;
+		__glewBufferSubData = stubBufferSubData;
+		__glewCompressedTexImage2D = stubCompressedTexImage2D;
+		__glewVertexAttribPointer = stubVertexAttribPointer;
+		__glewDrawArraysInstanced = stubDrawArraysInstanced;
+		__glewDrawElementsInstanced = stubDrawElementsInstanced;
+		__glewMultiDrawElementsBaseVertex = stubMultiDrawElementsBaseVertex;
+		__glewUniform1i = stubUniform1i;
+		__glewUniform1f = stubUniform1f;
+		__glewUniform3f = stubUniform3f;
+		__glewUniform4f = stubUniform4f;
+		__glewUniform3fv = stubUniformfv;
+		__glewUniform4fv = stubUniformfv;
+		__glewUniformMatrix4fv = stubUniformMatrix4fv;
+	}
+
+	// A model of the scene and where it stands on the terrain
+	struct Placement
+	{
+		const char* path;
+		float x;
+		float z;
+	};
+
+	// Some of each model main places, near where it places them
+	const Placement MODELS[] = { { "models/barn/barn.obj", 82, 110 }, { "models/bucket/bucket.obj", 89, 118 },
+		{ "models/bucket/bucket2.obj", 67, 144 }, { "models/trough/watertrough.obj", 101, 148 }, { "models/cat/cat.obj", 85, 145 },
+		{ "models/cat/cat.obj", 75, 160 }, { "models/giraffe/giraffe-split.obj", 35, 130 },
+		{ "models/giraffe/giraffe-split.obj", 15, 150 }, { "models/pig/pig.obj", 80, 190 }, { "models/pig/pig.obj", 85, 185 } };
+	const glm::vec2 STREET_LIGHTS[] = { glm::vec2(1, 2), glm::vec2(50, 80), glm::vec2(70, 145), glm::vec2(10, 50) };
+}
+
+int main()
+{
+	stubExtensions();
+
+	terrain::Terrain terra(1000, 1.0f, 30, -20.0f, WATER_HEIGHT, 0);
+	const terrain::Heightfield& heightfield = terra.getHeightfield();
+	skybox::Skybox skybox;
+
+	std::vector<model::Model*> models;
+	std::vector<model::Model*> streetLightModels;
+	for (const Placement& placement : MODELS)
+	{
+		model::Model* model = new model::Model(placement.path);
+		model->MoveTo(glm::vec3(placement.x, model->GetModelTerrainHeight(heightfield, placement.x, placement.z), placement.z));
+		if (std::strstr(placement.path, "giraffe") != NULL)
+		{
+			model->SetRotationAnimationLoop("Head_Plane.001", -0.5f, 0.5f, 0.01f, glm::vec3(0.0f, 1.0f, 0.0f));
+		}
+		models.push_back(model);
+	}
+	for (const glm::vec2& light : STREET_LIGHTS)
+	{
+		model::Model* orb = new model::Model("models/StreetLight/StreetLightMetallicOrb.obj");
+		orb->MoveTo(glm::vec3(light.x, heightfield.sampleHeight(light.x, light.y) + orb->hitBox.size.y - 1, light.y));
+		streetLightModels.push_back(orb);
+		model::Model* post = new model::Model("models/StreetLight/StreetLightPost.obj");
+		post->MoveTo(glm::vec3(light.x, heightfield.sampleHeight(light.x, light.y) + post->hitBox.size.y - 3, light.y));
+		models.push_back(post);
+	}
+	model::Paddock paddock(4, 3);
+	paddock.MovePaddock(glm::vec2(70, 140), heightfield);
+	paddock.PushModels(models);
+	tree::Tree trees("trees/placemap.bmp", heightfield);
+	for (int i = 0; i < 30; i++)
+	{
+		models.push_back(trees.placeTree(i));
+	}
+
+	model::ModelBatch modelBatch;
+	model::ModelBatch streetLightBatch;
+	model::RenderQueue renderQueue;
+	lights::LightBuffer lightBuffer;
+	Scene scene = { terra, skybox, models, streetLightModels, lightBuffer,
+		model::ModelShader(LoadShaders("shaders/model.vert", "shaders/model.frag")),
+		model::ModelShader(LoadShaders("shaders/SLmodel.vert", "shaders/SLmodel.frag")), modelBatch, streetLightBatch, renderQueue };
+
+	// Stand the camera above the terrain near the middle of the models
+	utility::camera::Camera camera(1200, 800, 0.1f, 1000.0f);
+	camera.move_y_position(terra.sampleHeight(camera.get_position().x, camera.get_position().z) + 5.0f);
+	camera.mouse_callback(NULL, 0.0, 0.0);
+
+	// Allocations made by each pass during the second turn
+	using utility::frame::Pass;
+	std::size_t allocations[3] = { 0, 0, 0 };
+	for (int frame = 0; frame < 2 * TURN_FRAMES; frame++)
+	{
+		camera.mouse_callback(NULL, frame * TURN_STEP, 0.0);
+		for (model::Model* model : models)
+		{
+			model->Animate();
+		}
+		for (model::Model* model : streetLightModels)
+		{
+			model->Animate();
+		}
+		const float time = frame / 60.0f;
+		const lights::LightSet lightSet = lights::computeLightSet(time);
+		const bool counted = frame >= TURN_FRAMES;
+
+		// The passes as main draws them with the camera above the water
+		float distance = 2 * (camera.get_position().y - WATER_HEIGHT);
+		camera.move_y_position(-distance);
+		camera.invert_pitch();
+		std::size_t before = utility::allocation::count();
+		render(scene, makeFrameContext(camera, glm::vec4(0, 1, 0, -WATER_HEIGHT), time, Pass::REFLECTION, lightSet));
+		allocations[0] += counted ? utility::allocation::count() - before : 0;
+		camera.move_y_position(distance);
+		camera.invert_pitch();
+
+		before = utility::allocation::count();
+		render(scene, makeFrameContext(camera, glm::vec4(0, -1, 0, WATER_HEIGHT), time, Pass::REFRACTION, lightSet));
+		allocations[1] += counted ? utility::allocation::count() - before : 0;
+
+		before = utility::allocation::count();
+		render(scene, makeFrameContext(camera, glm::vec4(0, 0, 0, 0), time, Pass::MAIN, lightSet));
+		allocations[2] += counted ? utility::allocation::count() - before : 0;
+	}
+
+	std::printf("allocations in %d frames: reflection %zu, refraction %zu, main %zu\n", TURN_FRAMES, allocations[0],
+				allocations[1], allocations[2]);
+	return allocations[0] + allocations[1] + allocations[2] == 0 ? 0 : 1;
+}
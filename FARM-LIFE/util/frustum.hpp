@@ -0,0 +1,67 @@
+/* frustum.hpp
+ * View frustum of a camera, used to skip drawing anything that can't be seen.
+ * The six planes are taken straight from the rows of the combined clip * view transform
+ * (Gribb and Hartmann, "Fast Extraction of Viewing Frustum Planes from the World-View-Projection Matrix").
+ */
+
+#ifndef UTILITY_FRUSTUM_HPP
+#define UTILITY_FRUSTUM_HPP
+
+#include "glm/glm.hpp"
+
+namespace utility {
+	namespace frustum {
+
+		class Frustum {
+		public:
+			// Precondition:	clipFromWorld is the camera's clip transform multiplied by its view transform
+			// Postcondition:	The frustum planes are stored in world space, normals pointing inside the frustum
+			explicit Frustum(const glm::mat4& clipFromWorld)
+			{
+				// glm matrices are column major, row r of the matrix is (m[0][r], m[1][r], m[2][r], m[3][r])
+				glm::vec4 rows[4];
+				for (int r = 0; r < 4; r++)
+				{
+					rows[r] = glm::vec4(clipFromWorld[0][r], clipFromWorld[1][r], clipFromWorld[2][r], clipFromWorld[3][r]);
+				}
+
+				planes[0] = rows[3] + rows[0];	// left
+				planes[1] = rows[3] - rows[0];	// right
+				planes[2] = rows[3] + rows[1];	// bottom
+				planes[3] = rows[3] - rows[1];	// top
+				planes[4] = rows[3] + rows[2];	// near
+				planes[5] = rows[3] - rows[2];	// far
+
+				for (int i = 0; i < 6; i++)
+				{
+					planes[i] /= glm::length(glm::vec3(planes[i]));
+				}
+			}
+
+			// Precondition:	min and max are the corners of a world space axis aligned box
+			// Postcondition:	Returns false only if the box is completely outside the frustum
+			bool intersects(const glm::vec3& min, const glm::vec3& max) const
+			{
+				for (int i = 0; i < 6; i++)
+				{
+					// Test the corner of the box that is furthest along the plane normal
+					const glm::vec4& plane = planes[i];
+					glm::vec3 corner(plane.x >= 0.0f ? max.x : min.x,
+									 plane.y >= 0.0f ? max.y : min.y,
+									 plane.z >= 0.0f ? max.z : min.z);
+					if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f)
+					{
+						return false;
+					}
+				}
+				return true;
+			}
+
+		private:
+			glm::vec4 planes[6];	// (normal, distance) of each plane
+		};
+
+	}  // namespace frustum
+}  // namespace utility
+
+#endif  // UTILITY_FRUSTUM_HPP
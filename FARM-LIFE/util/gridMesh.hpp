@@ -0,0 +1,120 @@
+/* gridMesh.hpp
+ * Builds the vertices and indices of a regular grid, shared by the terrain and the water.
+ * The grid is split into square tiles that each have their own block of (tileSize + 1)^2 vertices, so every tile
+ * is drawn with the same index pattern and a base vertex. Indices within a tile fit in 16 bits as long as the
+ * tile is at most 255 squares across. All sizes are known up front so nothing is grown while building.
+ */
+
+#ifndef UTILITY_GRID_MESH_HPP
+#define UTILITY_GRID_MESH_HPP
+
+#include <algorithm>
+#include <vector>
+#include "glm/glm.hpp"
+
+namespace utility {
+	namespace grid {
+
+		// Largest tile whose vertices can be addressed with 16 bit indices
+		const int MAX_TILE_SIZE = 255;
+
+		// How a grid of resX by resZ vertices is split into tiles
+		struct GridLayout {
+			int resX;		// vertices along x
+			int resZ;		// vertices along z
+			int tileSize;	// squares along each side of a tile
+			int tilesX;		// tiles along x
+			int tilesZ;		// tiles along z
+
+			// Number of vertices in the block of each tile
+			int tileVertices() const
+			{
+				return (tileSize + 1) * (tileSize + 1);
+			}
+
+			// Number of vertices in the whole grid
+			int vertexCount() const
+			{
+				return tilesX * tilesZ * tileVertices();
+			}
+
+			// First vertex of tile (tx, tz)
+			int baseVertex(int tx, int tz) const
+			{
+				return (tx * tilesZ + tz) * tileVertices();
+			}
+
+			// Index of vertex (a, b) of a tile within the tile's block
+			int localIndex(int a, int b) const
+			{
+				return a * (tileSize + 1) + b;
+			}
+		};
+
+		// Precondition:	resX, resZ >= 2, tileSize is in [1, MAX_TILE_SIZE]
+		// Postcondition:	Returns the layout covering the grid with the fewest tiles
+		inline GridLayout makeLayout(int resX, int resZ, int tileSize)
+		{
+			GridLayout layout;
+			layout.resX = resX;
+			layout.resZ = resZ;
+			layout.tileSize = tileSize;
+			layout.tilesX = (resX - 2) / tileSize + 1;
+			layout.tilesZ = (resZ - 2) / tileSize + 1;
+			return layout;
+		}
+
+		// Precondition:	positions has room for layout.vertexCount() * 3 floats, height(i, j) returns the height of vertex (i, j)
+		// Postcondition:	positions holds (x, height, z) for every vertex, tile by tile. x and z are grid coordinates plus offset,
+		//					tiles past the last row or column repeat it
+		template <typename Height>
+		void buildPositions(const GridLayout& layout, Height height, glm::ivec2 offset, float* positions)
+		{
+			for (int tx = 0; tx < layout.tilesX; tx++)
+			{
+				for (int tz = 0; tz < layout.tilesZ; tz++)
+				{
+					float* vertex = positions + layout.baseVertex(tx, tz) * 3;
+					for (int a = 0; a <= layout.tileSize; a++)
+					{
+						int i = std::min(tx * layout.tileSize + a, layout.resX - 1);
+						for (int b = 0; b <= layout.tileSize; b++)
+						{
+							int j = std::min(tz * layout.tileSize + b, layout.resZ - 1);
+							*vertex++ = (float)(offset.x + i);
+							*vertex++ = height(i, j);
+							*vertex++ = (float)(offset.y + j);
+						}
+					}
+				}
+			}
+		}
+
+		// Precondition:	step divides layout.tileSize
+		// Postcondition:	indices holds two triangles for every square of a tile, sampling every step th vertex
+		inline void buildTileIndices(const GridLayout& layout, int step, std::vector<GLushort>& indices)
+		{
+			int squares = layout.tileSize / step;
+			indices.clear();
+			indices.reserve(squares * squares * 6);
+			for (int a = 0; a < layout.tileSize; a += step)
+			{
+				for (int b = 0; b < layout.tileSize; b += step)
+				{
+					// FIRST TRIANGLE
+					indices.push_back((GLushort)layout.localIndex(a, b + step));		// bottom-left	(a, b + step)
+					indices.push_back((GLushort)layout.localIndex(a, b));				// top-left		(a, b)
+					indices.push_back((GLushort)layout.localIndex(a + step, b));		// top-right	(a + step, b)
+
+					// SECOND TRIANGLE
+					indices.push_back((GLushort)layout.localIndex(a + step, b));		// top-right	(a + step, b)
+					indices.push_back((GLushort)layout.localIndex(a + step, b + step));	// bottom-right	(a + step, b + step)
+					indices.push_back((GLushort)layout.localIndex(a, b + step));		// bottom-left	(a, b + step)
+				}
+			}
+		}
+
+	}  // namespace grid
+}  // namespace utility
+
+#endif  // UTILITY_GRID_MESH_HPP
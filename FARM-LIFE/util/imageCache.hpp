@@ -0,0 +1,100 @@
+/* imageCache.hpp
+ * Images decoded ahead of time, so the textures of the scene can be decoded by the job system's workers while
+ * the loading screen is drawn. load is a stand in for SOIL_load_image: it hands over an image that was prefetched
+ * with the same path and channels, or decodes the file itself if there isn't one. Each prefetched image is
+ * handed over once, and is freed with SOIL_free_image_data like any other.
+ */
+
+#ifndef UTILITY_IMAGE_CACHE_HPP
+#define UTILITY_IMAGE_CACHE_HPP
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include "util/jobSystem.hpp"
+
+namespace utility {
+	namespace image {
+
+		// A decoded image waiting to be loaded
+		struct Image {
+			unsigned char* data;
+			int width;
+			int height;
+			int channels;	// channels in the file, the data has forceChannels of them unless that was 0
+		};
+
+		typedef std::pair<std::string, int> ImageKey;	// path and the channels it was forced to
+
+		inline std::map<ImageKey, Image>& decoded()
+		{
+			static std::map<ImageKey, Image> images;
+			return images;
+		}
+
+		inline std::mutex& decodedMutex()
+		{
+			static std::mutex mutex;
+			return mutex;
+		}
+
+		// Precondition:	None
+		// Postcondition:	The image at path is decoded on this thread and kept for load, if it isn't already
+		inline void store(const std::string& path, int forceChannels)
+		{
+			ImageKey key(path, forceChannels);
+			{
+				std::lock_guard<std::mutex> lock(decodedMutex());
+				if (decoded().count(key) != 0)
+				{
+					return;
+				}
+			}
+			Image image;
+			image.data = SOIL_load_image(path.c_str(), &image.width, &image.height, &image.channels, forceChannels);
+			if (image.data == NULL)
+			{
+				return;	// load tries again and reports the error where the image is used
+			}
+			std::lock_guard<std::mutex> lock(decodedMutex());
+			if (!decoded().insert(std::make_pair(key, image)).second)
+			{
+				SOIL_free_image_data(image.data);
+			}
+		}
+
+		// Precondition:	None
+		// Postcondition:	The image at path is decoded by one of the workers and kept for load
+		inline void prefetch(jobs::JobSystem& jobs, const std::string& path, int forceChannels)
+		{
+			jobs.submit([path, forceChannels]() { store(path, forceChannels); });
+		}
+
+		// Precondition:	Takes the arguments of SOIL_load_image
+		// Postcondition:	Returns the prefetched image for path and forceChannels, or decodes it if it wasn't prefetched.
+		//					The caller frees the data with SOIL_free_image_data
+		inline unsigned char* load(const char* path, int* width, int* height, int* channels, int forceChannels)
+		{
+			{
+				std::lock_guard<std::mutex> lock(decodedMutex());
+				std::map<ImageKey, Image>::iterator it = decoded().find(ImageKey(path, forceChannels));
+				if (it != decoded().end())
+				{
+					Image image = it->second;
+					decoded().erase(it);
+					*width = image.width;
+					*height = image.height;
+					if (channels != NULL)
+					{
+						*channels = image.channels;
+					}
+					return image.data;
+				}
+			}
+			return SOIL_load_image(path, width, height, channels, forceChannels);
+		}
+	}
+}
+
+#endif // UTILITY_IMAGE_CACHE_HPP
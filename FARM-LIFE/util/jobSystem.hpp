@@ -0,0 +1,189 @@
+/* jobSystem.hpp
+ * A pool of worker threads for loading assets in the background. A job is split in two: the work runs on a
+ * worker and does everything that doesn't need OpenGL or OpenAL (reading files, decoding images and sounds,
+ * importing models), then its finish step is queued for the main thread, which owns the contexts, and does
+ * the uploads. The main thread runs finish steps a few at a time between frames, so it can keep drawing while
+ * the workers load.
+ */
+
+#ifndef UTILITY_JOB_SYSTEM_HPP
+#define UTILITY_JOB_SYSTEM_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace utility {
+	namespace jobs {
+
+		// Precondition:	None
+		// Postcondition:	Returns true on the workers of a JobSystem. Work that could split itself between the cores
+		//					should stay on one thread there, the other cores are running the other workers
+		inline bool& onWorkerThread()
+		{
+			static thread_local bool worker = false;
+			return worker;
+		}
+
+		class JobSystem {
+		public:
+			// Precondition:	None
+			// Postcondition:	workerCount threads are started, one less than the number of cores if it is 0
+			JobSystem(unsigned int workerCount = 0)
+			{
+				if (workerCount == 0)
+				{
+					workerCount = std::max(1u, std::thread::hardware_concurrency() - 1);
+				}
+				for (unsigned int i = 0; i < workerCount; i++)
+				{
+					workers.push_back(std::thread(&JobSystem::work, this));
+				}
+			}
+
+			// Precondition:	None
+			// Postcondition:	Jobs that haven't started are dropped, the workers finish the ones they are running and stop
+			~JobSystem()
+			{
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					stopping = true;
+					pending.clear();
+				}
+				condition.notify_all();
+				for (std::thread& worker : workers)
+				{
+					worker.join();
+				}
+			}
+
+			// Precondition:	work is safe to run on another thread, finish may use OpenGL and OpenAL
+			// Postcondition:	work is queued for a worker, finish is queued for the main thread once work has run
+			void submit(std::function<void()> work, std::function<void()> finish = std::function<void()>())
+			{
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					Job job = { work, finish };
+					pending.push_back(job);
+					submitted++;
+				}
+				condition.notify_one();
+			}
+
+			// Precondition:	Called on the main thread
+			// Postcondition:	Runs finish steps until there are none waiting or budget seconds have passed, at least one
+			//					runs if any are waiting. Returns true once every job submitted so far is done
+			bool drainMainThread(double budget)
+			{
+				auto start = std::chrono::steady_clock::now();
+				while (true)
+				{
+					std::function<void()> finish;
+					{
+						std::lock_guard<std::mutex> lock(mutex);
+						if (finishing.empty())
+						{
+							return done == submitted;
+						}
+						finish = finishing.front();
+						finishing.pop_front();
+					}
+					finish();
+					{
+						std::lock_guard<std::mutex> lock(mutex);
+						done++;
+					}
+					if (std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() > budget)
+					{
+						return isIdle();
+					}
+				}
+			}
+
+			// Precondition:	Called on the main thread
+			// Postcondition:	Blocks until every job submitted so far is done, running their finish steps
+			void finishAll()
+			{
+				while (!drainMainThread(1.0))
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					finished.wait(lock, [this]() { return !finishing.empty(); });
+				}
+			}
+
+			// Precondition:	None
+			// Postcondition:	Returns the fraction of the jobs submitted so far that are done, 1 if there are none
+			float progress()
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				return submitted == 0 ? 1.0f : (float)done / submitted;
+			}
+
+			// Precondition:	None
+			// Postcondition:	Returns the number of worker threads
+			size_t workerCount() const
+			{
+				return workers.size();
+			}
+
+		private:
+			struct Job {
+				std::function<void()> work;
+				std::function<void()> finish;
+			};
+
+			std::vector<std::thread> workers;
+			std::deque<Job> pending;						// waiting for a worker
+			std::deque<std::function<void()>> finishing;	// work done, waiting for the main thread
+			size_t submitted = 0;
+			size_t done = 0;
+			bool stopping = false;
+			std::mutex mutex;
+			std::condition_variable condition;	// a job was queued or the system is stopping
+			std::condition_variable finished;	// a finish step was queued for the main thread
+
+			// The workers can't be shared, so the system is not copyable
+			JobSystem(const JobSystem&);
+			JobSystem& operator=(const JobSystem&);
+
+			bool isIdle()
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				return done == submitted;
+			}
+
+			// Worker loop, runs jobs until the system is destroyed
+			void work()
+			{
+				onWorkerThread() = true;
+				while (true)
+				{
+					Job job;
+					{
+						std::unique_lock<std::mutex> lock(mutex);
+						condition.wait(lock, [this]() { return stopping || !pending.empty(); });
+						if (stopping)
+						{
+							return;
+						}
+						job = pending.front();
+						pending.pop_front();
+					}
+					job.work();
+					{
+						std::lock_guard<std::mutex> lock(mutex);
+						finishing.push_back(job.finish ? job.finish : std::function<void()>([]() {}));
+					}
+					finished.notify_one();
+				}
+			}
+		};
+	}
+}
+
+#endif // UTILITY_JOB_SYSTEM_HPP
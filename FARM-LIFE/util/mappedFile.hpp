@@ -0,0 +1,141 @@
+/* mappedFile.hpp
+ * A read only view of a whole file mapped into memory. The operating system pages the file in as it is read,
+ * so nothing is copied or parsed up front and the view can be handed straight to OpenGL.
+ */
+
+#ifndef UTILITY_MAPPED_FILE_HPP
+#define UTILITY_MAPPED_FILE_HPP
+
+#include <cstddef>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace utility {
+	namespace file {
+
+		class MappedFile {
+		public:
+			MappedFile() {}
+
+			// Precondition:	None
+			// Postcondition:	The mapping is released
+			~MappedFile()
+			{
+				close();
+			}
+
+			// Precondition:	None
+			// Postcondition:	Maps the file at path and returns true, or returns false if it can't be opened or is empty
+			bool open(const char* path)
+			{
+				close();
+#ifdef _WIN32
+				file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+				if (file == INVALID_HANDLE_VALUE)
+				{
+					return false;
+				}
+				LARGE_INTEGER fileSize;
+				if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+				{
+					close();
+					return false;
+				}
+				mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+				if (mapping == NULL)
+				{
+					close();
+					return false;
+				}
+				view = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+				length = (size_t)fileSize.QuadPart;
+#else
+				int descriptor = ::open(path, O_RDONLY);
+				if (descriptor == -1)
+				{
+					return false;
+				}
+				struct stat status;
+				if (fstat(descriptor, &status) != 0 || status.st_size == 0)
+				{
+					::close(descriptor);
+					return false;
+				}
+				void* mapped = mmap(NULL, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+				::close(descriptor);	// the mapping keeps the file open
+				view = mapped == MAP_FAILED ? nullptr : (const unsigned char*)mapped;
+				length = (size_t)status.st_size;
+#endif
+				if (view == nullptr)
+				{
+					close();
+					return false;
+				}
+				return true;
+			}
+
+			// Precondition:	None
+			// Postcondition:	The file is unmapped, data() is null
+			void close()
+			{
+#ifdef _WIN32
+				if (view != nullptr)
+				{
+					UnmapViewOfFile(view);
+				}
+				if (mapping != NULL)
+				{
+					CloseHandle(mapping);
+				}
+				if (file != INVALID_HANDLE_VALUE)
+				{
+					CloseHandle(file);
+				}
+				mapping = NULL;
+				file = INVALID_HANDLE_VALUE;
+#else
+				if (view != nullptr)
+				{
+					munmap((void*)view, length);
+				}
+#endif
+				view = nullptr;
+				length = 0;
+			}
+
+			// Precondition:	open returned true
+			// Postcondition:	Returns the first byte of the file
+			const unsigned char* data() const
+			{
+				return view;
+			}
+
+			// Precondition:	None
+			// Postcondition:	Returns the number of bytes mapped, 0 if no file is open
+			size_t size() const
+			{
+				return length;
+			}
+
+		private:
+			// The mapping can't be shared, so the file is not copyable
+			MappedFile(const MappedFile&);
+			MappedFile& operator=(const MappedFile&);
+
+#ifdef _WIN32
+			HANDLE file = INVALID_HANDLE_VALUE;
+			HANDLE mapping = NULL;
+#endif
+			const unsigned char* view = nullptr;
+			size_t length = 0;
+		};
+	}
+}
+
+#endif // UTILITY_MAPPED_FILE_HPP
@@ -0,0 +1,84 @@
+/* scene.hpp
+ * The scene drawn by each render pass and the pass itself. main.cpp builds one scene and renders it for the water's
+ * reflection and refraction and then for the screen. frameAllocationTest.cpp renders the same passes without a
+ * window to check they don't allocate.
+ */
+
+#ifndef UTILITY_SCENE_HPP
+#define UTILITY_SCENE_HPP
+
+#include <vector>
+#include "glm/glm.hpp"
+#include "util/camera.hpp"
+#include "util/frame.hpp"
+#include "lights/lights.hpp"
+#include "terrain/terrain.hpp"
+#include "models/model.hpp"
+#include "models/modelBatch.hpp"
+#include "skybox/skybox.hpp"
+
+// Everything that is drawn by a render pass, held by reference so a pass never copies the scene
+struct Scene {
+	terrain::Terrain& terrain;
+	skybox::Skybox& skybox;
+	std::vector<model::Model*>& models;
+	std::vector<model::Model*>& streetLightModels;
+	lights::LightBuffer& lightBuffer;
+	model::ModelShader modelShader;
+	model::ModelShader streetLightShader;
+	model::ModelBatch& modelBatch;			// instanced draws of the models
+	model::ModelBatch& streetLightBatch;	// instanced draws of the street light orbs
+	model::RenderQueue& renderQueue;		// model draws of the pass, sorted to share state
+};
+
+// Build the immutable context for a render pass from the current camera state
+inline utility::frame::FrameContext makeFrameContext(utility::camera::Camera& camera, const glm::vec4& clippingPlane, float time,
+	utility::frame::Pass pass, const lights::LightSet& lightSet)
+{
+	const glm::mat4 view = camera.get_view_transform();
+	const glm::mat4 projection = camera.get_clip_transform();
+	return utility::frame::FrameContext{
+		view,
+		projection,
+		glm::mat4(glm::mat3(view)),	// remove translation from the view matrix. Keeps the skybox centered on camera.
+		utility::frustum::Frustum(projection * view),
+		camera.get_position(),
+		camera.get_view_direction(),
+		clippingPlane,
+		time,
+		pass,
+		lightSet
+	};
+}
+
+// Precondition:	The frame buffer of the pass is bound
+// Postcondition:	The scene is drawn for the pass without allocating, once the first frames have sized the batches
+inline void render(Scene& scene, const utility::frame::FrameContext& frame)
+{
+	// Clear color buffer
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	// Lights for the pass, read by every lit shader
+	scene.lightBuffer.update(frame.lightSet, frame.cameraPosition, frame.forward);
+
+	// NOTE: Draw all other objects before the skybox
+
+	// Draw the models and the Street Orbs, queued together so meshes that share state are drawn together
+	glDepthFunc(GL_LESS);
+	scene.renderQueue.Clear();
+	scene.modelBatch.Submit(scene.renderQueue, scene.modelShader, frame, scene.models);
+	scene.streetLightBatch.Submit(scene.renderQueue, scene.streetLightShader, frame, scene.streetLightModels);
+	scene.renderQueue.Flush(frame);
+
+	// Render skybox last, disable clipping for skybox
+	glDisable(GL_CLIP_DISTANCE0);
+	scene.skybox.render(frame.skyboxView, frame.projection, frame.time);
+	glEnable(GL_CLIP_DISTANCE0);
+
+	//-------------
+	// DRAW TERRAIN
+	//-------------
+	scene.terrain.draw(frame, glm::vec3(0.0, 50, 0.0), glm::vec3(1.0, 1.0, 1.0));
+}
+
+#endif  // UTILITY_SCENE_HPP
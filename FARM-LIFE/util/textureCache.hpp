@@ -0,0 +1,573 @@
+/* textureCache.hpp
+ * Textures shared by path. The first time an image is loaded its mip chain is built on the CPU and, if it is a colour
+ * map, compressed with SOIL's DXT compressor (DXT1, or DXT5 if it has alpha). Data such as normal, du/dv and height
+ * maps are kept uncompressed so they lose nothing. The levels are written next to the image as a .dds named after the
+ * image and the options, and later loads map the .dds and upload its levels straight from the mapping, so the image
+ * isn't decoded again. A .dds is rebuilt when it is older than its image or doesn't match the options. Textures are
+ * kept by image and options, each is uploaded once however many objects use it, and is deleted when the last of them
+ * releases it.
+ */
+
+#ifndef UTILITY_TEXTURE_CACHE_HPP
+#define UTILITY_TEXTURE_CACHE_HPP
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#include "image_helper.h"
+#include "util/jobSystem.hpp"
+#include "util/mappedFile.hpp"
+extern "C" {
+#include "image_DXT.h"
+}
+
+namespace utility {
+	namespace texture {
+
+		// What a texture holds, which decides whether it can be compressed
+		enum Usage {
+			COLOUR,	// seen directly, compressed to DXT when the driver supports it
+			DATA	// read as numbers by a shader, kept uncompressed
+		};
+
+		// How an image is turned into a texture
+		struct Options {
+			Usage usage;
+			bool mipmaps;	// store the whole mip chain, otherwise only the image
+			int channels;	// SOIL_LOAD_RGB or SOIL_LOAD_RGBA, or SOIL_LOAD_AUTO to keep the file's channels
+		};
+
+		// A mip chain ready to upload, mapped from a .dds or built in memory
+		struct Levels {
+			struct Level {
+				const unsigned char* data;
+				size_t size;
+			};
+
+			GLenum format;	// GL_COMPRESSED_RGB_S3TC_DXT1_EXT, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, GL_RGB or GL_RGBA
+			int width;
+			int height;
+			std::vector<Level> levels;
+			file::MappedFile mapped;			// holds the levels when they came from a .dds
+			std::vector<unsigned char> memory;	// holds the levels when they were built
+
+			bool compressed() const
+			{
+				return format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT || format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+			}
+		};
+
+		// A texture and the number of loads that haven't released it
+		struct Cached {
+			GLuint texture;
+			int references;
+			size_t bytes;	// video memory the levels take
+		};
+
+		const unsigned int DDS_MAGIC = 0x20534444;	// "DDS "
+		const unsigned int FOURCC_DXT1 = 0x31545844;
+		const unsigned int FOURCC_DXT5 = 0x35545844;
+
+		// Precondition:	None
+		// Postcondition:	Returns the name the image at path is cached under with options. An image loaded with two
+		//					sets of options is two textures, each with its own .dds
+		inline std::string cacheKey(const std::string& path, const Options& options)
+		{
+			return path + (options.usage == DATA ? ".data" : ".colour") + (options.mipmaps ? ".mips." : ".")
+				+ std::to_string(options.channels);
+		}
+
+		// Textures on the GPU, by cache key. Only used on the thread that owns the GL context
+		inline std::map<std::string, Cached>& uploaded()
+		{
+			static std::map<std::string, Cached> textures;
+			return textures;
+		}
+
+		// Levels prepared by the job system's workers, waiting to be uploaded, by cache key
+		inline std::map<std::string, std::shared_ptr<Levels>>& prepared()
+		{
+			static std::map<std::string, std::shared_ptr<Levels>> levels;
+			return levels;
+		}
+
+		// Cache keys store has been called for, so two workers never build the same .dds
+		inline std::set<std::string>& queued()
+		{
+			static std::set<std::string> paths;
+			return paths;
+		}
+
+		inline std::mutex& preparedMutex()
+		{
+			static std::mutex mutex;
+			return mutex;
+		}
+
+		// Precondition:	None
+		// Postcondition:	Returns the number of bytes of one level of a width x height image in format
+		inline size_t levelSize(GLenum format, int width, int height)
+		{
+			switch (format)
+			{
+			case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+				return (size_t)((width + 3) / 4) * ((height + 3) / 4) * 8;
+			case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+				return (size_t)((width + 3) / 4) * ((height + 3) / 4) * 16;
+			case GL_RGBA:
+				return (size_t)width * height * 4;
+			default:
+				return (size_t)width * height * 3;
+			}
+		}
+
+		// Precondition:	None
+		// Postcondition:	Returns the number of levels in the mip chain of a width x height image, down to 1 x 1
+		inline int chainLength(int width, int height)
+		{
+			int count = 1;
+			while (width > 1 || height > 1)
+			{
+				width = std::max(width / 2, 1);
+				height = std::max(height / 2, 1);
+				count++;
+			}
+			return count;
+		}
+
+		// Precondition:	None
+		// Postcondition:	Returns true if levels has the format and mip chain options ask for. channels is only
+		//					checked if options force it
+		inline bool matches(const Levels& levels, const Options& options, bool compress)
+		{
+			int channels = levels.format == GL_RGB || levels.format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT ? 3 : 4;
+			int count = options.mipmaps ? chainLength(levels.width, levels.height) : 1;
+			return levels.compressed() == (compress && options.usage == COLOUR) && (int)levels.levels.size() == count
+				&& (options.channels == SOIL_LOAD_AUTO || options.channels == channels);
+		}
+
+		// Precondition:	None
+		// Postcondition:	Maps the .dds at cachePath into levels and returns true if it is a cache this file wrote
+		inline bool readCache(const std::string& cachePath, Levels& levels)
+		{
+			if (!levels.mapped.open(cachePath.c_str()) || levels.mapped.size() < sizeof(DDS_header))
+			{
+				return false;
+			}
+			DDS_header header;
+			memcpy(&header, levels.mapped.data(), sizeof(DDS_header));
+			if (header.dwMagic != DDS_MAGIC || header.dwSize != 124 || header.dwWidth == 0 || header.dwHeight == 0)
+			{
+				return false;
+			}
+			if (header.sPixelFormat.dwFlags & DDPF_FOURCC)
+			{
+				if (header.sPixelFormat.dwFourCC == FOURCC_DXT1)
+					levels.format = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+				else if (header.sPixelFormat.dwFourCC == FOURCC_DXT5)
+					levels.format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+				else
+					return false;
+			}
+			else if (header.sPixelFormat.dwRGBBitCount == 24 && header.sPixelFormat.dwRBitMask == 0xFF)
+			{
+				levels.format = GL_RGB;
+			}
+			else if (header.sPixelFormat.dwRGBBitCount == 32 && header.sPixelFormat.dwRBitMask == 0xFF)
+			{
+				levels.format = GL_RGBA;
+			}
+			else
+			{
+				return false;
+			}
+
+			levels.width = (int)header.dwWidth;
+			levels.height = (int)header.dwHeight;
+			int count = (header.dwFlags & DDSD_MIPMAPCOUNT) ? std::max((int)header.dwMipMapCount, 1) : 1;
+			if (count > chainLength(levels.width, levels.height))
+			{
+				return false;
+			}
+			size_t offset = sizeof(DDS_header);
+			int width = levels.width, height = levels.height;
+			for (int i = 0; i < count; i++)
+			{
+				Levels::Level level = { levels.mapped.data() + offset, levelSize(levels.format, width, height) };
+				offset += level.size;
+				if (offset > levels.mapped.size())
+				{
+					levels.levels.clear();
+					return false;
+				}
+				levels.levels.push_back(level);
+				width = std::max(width / 2, 1);
+				height = std::max(height / 2, 1);
+			}
+			return true;
+		}
+
+		// Precondition:	levels were built in memory
+		// Postcondition:	levels are written to cachePath as a .dds, returns false if the file couldn't be written
+		inline bool writeCache(const std::string& cachePath, const Levels& levels)
+		{
+			DDS_header header;
+			memset(&header, 0, sizeof(DDS_header));
+			header.dwMagic = DDS_MAGIC;
+			header.dwSize = 124;
+			header.dwFlags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT;
+			header.dwWidth = levels.width;
+			header.dwHeight = levels.height;
+			header.sPixelFormat.dwSize = 32;
+			header.sCaps.dwCaps1 = DDSCAPS_TEXTURE;
+			if (levels.compressed())
+			{
+				header.dwFlags |= DDSD_LINEARSIZE;
+				header.dwPitchOrLinearSize = (unsigned int)levels.levels[0].size;
+				header.sPixelFormat.dwFlags = DDPF_FOURCC;
+				header.sPixelFormat.dwFourCC = levels.format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT ? FOURCC_DXT1 : FOURCC_DXT5;
+			}
+			else
+			{
+				// Bytes are stored in R, G, B(, A) order, the masks say so
+				int channels = levels.format == GL_RGBA ? 4 : 3;
+				header.dwFlags |= DDSD_PITCH;
+				header.dwPitchOrLinearSize = levels.width * channels;
+				header.sPixelFormat.dwFlags = DDPF_RGB | (channels == 4 ? DDPF_ALPHAPIXELS : 0);
+				header.sPixelFormat.dwRGBBitCount = channels * 8;
+				header.sPixelFormat.dwRBitMask = 0x000000FF;
+				header.sPixelFormat.dwGBitMask = 0x0000FF00;
+				header.sPixelFormat.dwBBitMask = 0x00FF0000;
+				header.sPixelFormat.dwAlphaBitMask = channels == 4 ? 0xFF000000 : 0;
+			}
+			if (levels.levels.size() > 1)
+			{
+				header.dwFlags |= DDSD_MIPMAPCOUNT;
+				header.dwMipMapCount = (unsigned int)levels.levels.size();
+				header.sCaps.dwCaps1 |= DDSCAPS_COMPLEX | DDSCAPS_MIPMAP;
+			}
+
+			FILE* out = fopen(cachePath.c_str(), "wb");
+			if (out == NULL)
+			{
+				return false;
+			}
+			bool written = fwrite(&header, sizeof(DDS_header), 1, out) == 1
+				&& fwrite(&levels.memory[0], 1, levels.memory.size(), out) == levels.memory.size();
+			return fclose(out) == 0 && written;
+		}
+
+		// Precondition:	pixels is a decoded width x height image with channels channels
+		// Postcondition:	levels holds its mip chain, or just the image if options don't ask for mipmaps, compressed
+		//					if options and the driver allow it. Compressing uses up to threads threads, 0 for every core
+		inline void buildLevels(unsigned char* pixels, int width, int height, int channels, const Options& options,
+			bool compress, int threads, Levels& levels)
+		{
+			compress = compress && options.usage == COLOUR;
+			levels.width = width;
+			levels.height = height;
+			if (compress)
+			{
+				levels.format = (channels & 1) == 1 ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+			}
+			else
+			{
+				levels.format = channels == 4 || channels == 2 ? GL_RGBA : GL_RGB;
+			}
+
+			// Grey images are only kept as they are when they are compressed, which replicates the grey itself
+			std::vector<unsigned char> expanded;
+			if (!compress && channels < 3)
+			{
+				int outChannels = channels == 2 ? 4 : 3;
+				expanded.resize((size_t)width * height * outChannels);
+				for (size_t p = 0; p < (size_t)width * height; p++)
+				{
+					for (int c = 0; c < outChannels; c++)
+					{
+						expanded[p * outChannels + c] = pixels[p * channels + (c == 3 ? 1 : 0)];
+					}
+				}
+				pixels = &expanded[0];
+				channels = outChannels;
+			}
+
+			int count = options.mipmaps ? chainLength(width, height) : 1;
+			std::vector<size_t> offsets;
+			std::vector<unsigned char> level(pixels, pixels + (size_t)width * height * channels);
+			std::vector<unsigned char> smaller;
+			for (int i = 0; i < count; i++)
+			{
+				offsets.push_back(levels.memory.size());
+				if (compress)
+				{
+					// The compressor splits large levels between the threads and leaves small ones on this thread
+					int size = 0;
+					unsigned char* blocks = levels.format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+						? convert_image_to_DXT1_threaded(&level[0], width, height, channels, &size, threads)
+						: convert_image_to_DXT5_threaded(&level[0], width, height, channels, &size, threads);
+					levels.memory.insert(levels.memory.end(), blocks, blocks + size);
+					free(blocks);
+				}
+				else
+				{
+					levels.memory.insert(levels.memory.end(), level.begin(), level.end());
+				}
+
+				if (i + 1 < count)
+				{
+					int nextWidth = std::max(width / 2, 1);
+					int nextHeight = std::max(height / 2, 1);
+					smaller.resize((size_t)nextWidth * nextHeight * channels);
+					mipmap_image(&level[0], width, height, channels, &smaller[0], width > 1 ? 2 : 1, height > 1 ? 2 : 1);
+					level.swap(smaller);
+					width = nextWidth;
+					height = nextHeight;
+				}
+			}
+			offsets.push_back(levels.memory.size());
+			for (int i = 0; i < count; i++)
+			{
+				Levels::Level entry = { &levels.memory[offsets[i]], offsets[i + 1] - offsets[i] };
+				levels.levels.push_back(entry);
+			}
+		}
+
+		// Precondition:	None
+		// Postcondition:	Returns true if the .dds at cachePath exists and is at least as new as the image at path
+		inline bool isCurrent(const std::string& cachePath, const std::string& path)
+		{
+			struct stat cacheStatus;
+			struct stat imageStatus;
+			if (stat(cachePath.c_str(), &cacheStatus) != 0)
+			{
+				return false;
+			}
+			// Without the image the cache is all there is
+			return stat(path.c_str(), &imageStatus) != 0 || cacheStatus.st_mtime >= imageStatus.st_mtime;
+		}
+
+		// Precondition:	glewInit has been called. Doesn't use OpenGL so it can run on any thread
+		// Postcondition:	Returns the levels of the image at path from its .dds, building and writing the .dds first
+		//					if it is missing or out of date. Returns null if the image can't be loaded
+		inline std::shared_ptr<Levels> prepare(const std::string& path, const Options& options)
+		{
+			bool compress = GLEW_EXT_texture_compression_s3tc != 0;
+			std::string cachePath = cacheKey(path, options) + ".dds";
+			std::shared_ptr<Levels> levels = std::make_shared<Levels>();
+			if (isCurrent(cachePath, path) && readCache(cachePath, *levels) && matches(*levels, options, compress))
+			{
+				return levels;
+			}
+
+			levels = std::make_shared<Levels>();
+			int width, height, channels;
+			unsigned char* pixels = SOIL_load_image(path.c_str(), &width, &height, &channels, options.channels);
+			if (pixels == NULL)
+			{
+				std::cout << "(SOIL) Texture failed to load at path: " << path << std::endl;
+				return nullptr;
+			}
+			if (options.channels != SOIL_LOAD_AUTO)
+			{
+				channels = options.channels;
+			}
+			// A worker compresses on its own thread, the other cores are busy with the other workers
+			buildLevels(pixels, width, height, channels, options, compress, jobs::onWorkerThread() ? 1 : 0, *levels);
+			SOIL_free_image_data(pixels);
+			if (!writeCache(cachePath, *levels))
+			{
+				std::cout << "Could not write the texture cache " << cachePath << std::endl;
+			}
+			return levels;
+		}
+
+		// Precondition:	None
+		// Postcondition:	The image at path is prepared on this thread and kept for load, unless it already has been
+		inline void store(const std::string& path, const Options& options)
+		{
+			std::string key = cacheKey(path, options);
+			{
+				std::lock_guard<std::mutex> lock(preparedMutex());
+				if (!queued().insert(key).second)
+				{
+					return;
+				}
+			}
+			std::shared_ptr<Levels> levels = prepare(path, options);
+			if (levels == nullptr)
+			{
+				return;	// load tries again and reports the error where the texture is used
+			}
+			// Touch every page of a mapped cache so the upload doesn't wait on the disk
+			volatile unsigned char sum = 0;
+			for (const Levels::Level& level : levels->levels)
+			{
+				for (size_t i = 0; i < level.size; i += 4096)
+				{
+					sum += level.data[i];
+				}
+			}
+			std::lock_guard<std::mutex> lock(preparedMutex());
+			prepared()[key] = levels;
+		}
+
+		// Precondition:	None
+		// Postcondition:	The image at path is prepared by one of the workers and kept for load
+		inline void prefetch(jobs::JobSystem& jobs, const std::string& path, const Options& options)
+		{
+			jobs.submit([path, options]() { store(path, options); });
+		}
+
+		// Precondition:	None
+		// Postcondition:	Returns the levels prefetched for path with options, or prepares them on this thread
+		inline std::shared_ptr<Levels> takePrepared(const std::string& path, const Options& options)
+		{
+			std::string key = cacheKey(path, options);
+			{
+				std::lock_guard<std::mutex> lock(preparedMutex());
+				std::map<std::string, std::shared_ptr<Levels>>::iterator it = prepared().find(key);
+				if (it != prepared().end())
+				{
+					std::shared_ptr<Levels> levels = it->second;
+					prepared().erase(it);
+					queued().erase(key);
+					return levels;
+				}
+			}
+			return prepare(path, options);
+		}
+
+		// Precondition:	The texture to fill is bound to target's binding, target is GL_TEXTURE_2D or a cube face
+		// Postcondition:	levels are uploaded to target, returns the bytes they take
+		inline size_t upload(GLenum target, const Levels& levels)
+		{
+			size_t bytes = 0;
+			int width = levels.width, height = levels.height;
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 1);	// rows of small RGB levels aren't 4 byte aligned
+			for (size_t i = 0; i < levels.levels.size(); i++)
+			{
+				const Levels::Level& level = levels.levels[i];
+				if (levels.compressed())
+				{
+					glCompressedTexImage2D(target, (GLint)i, levels.format, width, height, 0, (GLsizei)level.size, level.data);
+				}
+				else
+				{
+					glTexImage2D(target, (GLint)i, levels.format, width, height, 0, levels.format, GL_UNSIGNED_BYTE, level.data);
+				}
+				bytes += level.size;
+				width = std::max(width / 2, 1);
+				height = std::max(height / 2, 1);
+			}
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+			return bytes;
+		}
+
+		// Precondition:	Called on the thread that owns the GL context
+		// Postcondition:	Returns the 2D texture of the image at path with options, loading it if nothing else has. The
+		//					texture is bound to GL_TEXTURE_2D on the active unit, and is kept until each load of it is
+		//					released. Returns 0 if the image can't be loaded
+		inline GLuint load(const std::string& path, const Options& options)
+		{
+			std::string key = cacheKey(path, options);
+			std::map<std::string, Cached>::iterator cached = uploaded().find(key);
+			if (cached != uploaded().end())
+			{
+				cached->second.references++;
+				glBindTexture(GL_TEXTURE_2D, cached->second.texture);
+				return cached->second.texture;
+			}
+
+			std::shared_ptr<Levels> levels = takePrepared(path, options);
+			if (levels == nullptr)
+			{
+				return 0;
+			}
+			Cached texture = { 0, 1, 0 };
+			glGenTextures(1, &texture.texture);
+			glBindTexture(GL_TEXTURE_2D, texture.texture);
+			texture.bytes = upload(GL_TEXTURE_2D, *levels);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)levels->levels.size() - 1);
+			uploaded()[key] = texture;
+			return texture.texture;
+		}
+
+		// Precondition:	Called on the thread that owns the GL context, faces are the images of the cube's faces in
+		//					the order of the GL_TEXTURE_CUBE_MAP_POSITIVE_X targets
+		// Postcondition:	Returns the cube map of the faces, loading it if nothing else has, bound to
+		//					GL_TEXTURE_CUBE_MAP. Faces that can't be loaded are left empty
+		inline GLuint loadCubeMap(const std::vector<std::string>& faces, const Options& options)
+		{
+			std::string key = "cube";
+			for (const std::string& face : faces)
+			{
+				key += ":" + cacheKey(face, options);
+			}
+			std::map<std::string, Cached>::iterator cached = uploaded().find(key);
+			if (cached != uploaded().end())
+			{
+				cached->second.references++;
+				glBindTexture(GL_TEXTURE_CUBE_MAP, cached->second.texture);
+				return cached->second.texture;
+			}
+
+			Cached texture = { 0, 1, 0 };
+			glGenTextures(1, &texture.texture);
+			glBindTexture(GL_TEXTURE_CUBE_MAP, texture.texture);
+			int levelCount = 1;
+			for (size_t i = 0; i < faces.size(); i++)
+			{
+				std::shared_ptr<Levels> levels = takePrepared(faces[i], options);
+				if (levels != nullptr)
+				{
+					texture.bytes += upload(GL_TEXTURE_CUBE_MAP_POSITIVE_X + (GLenum)i, *levels);
+					levelCount = (int)levels->levels.size();
+				}
+			}
+			glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+			uploaded()[key] = texture;
+			return texture.texture;
+		}
+
+		// Precondition:	texture was returned by load or loadCubeMap
+		// Postcondition:	The load is released, the texture is deleted once every load of it has been
+		inline void release(GLuint texture)
+		{
+			for (std::map<std::string, Cached>::iterator it = uploaded().begin(); it != uploaded().end(); ++it)
+			{
+				if (it->second.texture == texture)
+				{
+					if (--it->second.references <= 0)
+					{
+						glDeleteTextures(1, &it->second.texture);
+						uploaded().erase(it);
+					}
+					return;
+				}
+			}
+		}
+
+		// Precondition:	None
+		// Postcondition:	Returns the video memory taken by the textures that are loaded
+		inline size_t residentBytes()
+		{
+			size_t bytes = 0;
+			for (std::map<std::string, Cached>::const_iterator it = uploaded().begin(); it != uploaded().end(); ++it)
+			{
+				bytes += it->second.bytes;
+			}
+			return bytes;
+		}
+	}
+}
+
+#endif // UTILITY_TEXTURE_CACHE_HPP
@@ -1,27 +1,39 @@
 /* WaterFrameBuffers.hpp
  * Based on class by ThinMatrix on YouTube
  * Create and stores reflection, refraction and refraction depth textures for the water.
+ * The reflection is only redrawn when the camera moves or every few frames, otherwise the last one is reused.
+ * The reflection and refraction textures are a fraction of the window's size, the fraction shrinks when frames take
+ * longer than the frame budget and grows again when there is time to spare.
+ * In screen space mode the main pass is drawn into a scene texture instead, and the water reflects and refracts
+ * that texture so the reflection and refraction passes aren't drawn at all.
  */
 #ifndef ASSIGNMENT_WATER_FRAME_BUFFERS_HPP
 #define ASSIGNMENT_WATER_FRAME_BUFFERS_HPP
 
+#include <algorithm>
+
 namespace water {
 	
 	class WaterFrameBuffers {
 		public:
-			// Buffer Constructor
-			WaterFrameBuffers() {
+			// Buffer Constructor, screenWidth and screenHeight are the size of the window's framebuffer
+			WaterFrameBuffers(int screenWidth_ = 1200, int screenHeight_ = 800) {
+				screenWidth = screenWidth_;
+				screenHeight = screenHeight_;
+				targetWidth = std::max(1, (int)(screenWidth * resolutionScale));
+				targetHeight = std::max(1, (int)(screenHeight * resolutionScale));
+
 				// Create frame buffer and texture attachment for reflection
 				reflectionFrameBuffer = createFrameBuffer();
-		        reflectionTexture = createTextureAttachment(REFLECTION_WIDTH, REFLECTION_HEIGHT);
-		        reflectionDepthBuffer = createDepthBufferAttachment(REFLECTION_WIDTH, REFLECTION_HEIGHT);
-		        unbindCurrentFrameBuffer(1200, 800);
+		        reflectionTexture = createTextureAttachment(targetWidth, targetHeight);
+		        reflectionDepthBuffer = createDepthBufferAttachment(targetWidth, targetHeight);
+		        unbindCurrentFrameBuffer(screenWidth, screenHeight);
 
 				// Create frame buffer and texture attachments for refraction and depth
         		refractionFrameBuffer = createFrameBuffer();
-		        refractionTexture = createTextureAttachment(REFRACTION_WIDTH, REFRACTION_HEIGHT);
-		        refractionDepthTexture = createDepthTextureAttachment(REFRACTION_WIDTH, REFRACTION_HEIGHT);
-		        unbindCurrentFrameBuffer(1200, 800);
+		        refractionTexture = createTextureAttachment(targetWidth, targetHeight);
+		        refractionDepthTexture = createDepthTextureAttachment(targetWidth, targetHeight);
+		        unbindCurrentFrameBuffer(screenWidth, screenHeight);
 			}
 
 			// Destructor
@@ -35,20 +47,107 @@ namespace water {
 		        glDeleteFramebuffers(1, &refractionFrameBuffer);
 		        glDeleteTextures(1, &refractionTexture);
 		        glDeleteTextures(1, &refractionDepthTexture);
+				if (sceneFrameBuffer != 0) {
+					glDeleteFramebuffers(1, &sceneFrameBuffer);
+					glDeleteTextures(1, &sceneTexture);
+					glDeleteTextures(1, &sceneDepthTexture);
+					glDeleteVertexArrays(1, &copyVao);
+					glDeleteProgram(copyShader);
+				}
 		    }
 
+			// Precondition:	screenWidth and screenHeight are the current size of the window's framebuffer,
+			//					frameTime is how many seconds the last frame took, called once a frame
+			// Postcondition:	the resolution scale is adjusted to hold the frame budget and the textures are resized
+			//					if the window or the scale changed
+			void update(int screenWidth_, int screenHeight_, float frameTime) {
+				// Look at the average of a batch of frames so a single slow frame doesn't change the resolution
+				frameTimes += frameTime;
+				framesTimed++;
+				if (framesTimed == ADAPT_FRAMES) {
+					float average = frameTimes / framesTimed;
+					if (average > FRAME_BUDGET * 1.05f && resolutionScale > MIN_SCALE) {
+						resolutionScale -= SCALE_STEP;
+					}
+					else if (average < FRAME_BUDGET * 0.75f && resolutionScale < MAX_SCALE) {
+						resolutionScale += SCALE_STEP;
+					}
+					frameTimes = 0.0f;
+					framesTimed = 0;
+				}
+
+				if (screenWidth_ <= 0 || screenHeight_ <= 0) {
+					return; // minimised
+				}
+				if (screenWidth_ != screenWidth || screenHeight_ != screenHeight) {
+					screenWidth = screenWidth_;
+					screenHeight = screenHeight_;
+					if (sceneFrameBuffer != 0) {
+						resizeTextures(sceneTexture, sceneDepthTexture, screenWidth, screenHeight);
+					}
+				}
+
+				int width = std::max(1, (int)(screenWidth * resolutionScale));
+				int height = std::max(1, (int)(screenHeight * resolutionScale));
+				if (width != targetWidth || height != targetHeight) {
+					targetWidth = width;
+					targetHeight = height;
+					resizeTextures(reflectionTexture, 0, targetWidth, targetHeight);
+					glBindRenderbuffer(GL_RENDERBUFFER, reflectionDepthBuffer);
+					glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, targetWidth, targetHeight);
+					resizeTextures(refractionTexture, refractionDepthTexture, targetWidth, targetHeight);
+					// The old reflection is blank now
+					framesSinceReflection = REFLECTION_INTERVAL;
+				}
+			}
+
 			// Precondition: 
 			// Postcondition: 	reflection frame buffer is bound
 			void bindReflectionFrameBuffer() {
-		        bindFrameBuffer(reflectionFrameBuffer, REFLECTION_WIDTH, REFLECTION_HEIGHT);
+		        bindFrameBuffer(reflectionFrameBuffer, targetWidth, targetHeight);
 		    }
 
 			// Precondition:
 			// Postcondition:	refraction frame buffer is bound
 			void bindRefractionFrameBuffer() {
-		        bindFrameBuffer(refractionFrameBuffer, REFRACTION_WIDTH, REFRACTION_HEIGHT);
+		        bindFrameBuffer(refractionFrameBuffer, targetWidth, targetHeight);
 		    }
 
+			// Precondition:
+			// Postcondition:	scene frame buffer is bound, it is created the first time screen space water is used
+			void bindSceneFrameBuffer() {
+				if (sceneFrameBuffer == 0) {
+					createSceneFrameBuffer();
+				}
+				bindFrameBuffer(sceneFrameBuffer, screenWidth, screenHeight);
+			}
+
+			// Precondition:	the main pass has been drawn into the scene frame buffer
+			// Postcondition:	the default frame buffer is bound and holds the colour and depth of the scene, so the water
+			//					can be drawn over it while reading the scene textures
+			void presentScene() {
+				unbindCurrentFrameBuffer(screenWidth, screenHeight);
+
+				// A full screen triangle writes the colour and depth of every pixel. The copy shader doesn't write a
+				// clip distance, so the clipping plane the scene was drawn with must be off or the copy may be clipped
+				GLboolean clipping = glIsEnabled(GL_CLIP_DISTANCE0);
+				glDisable(GL_CLIP_DISTANCE0);
+				glDepthFunc(GL_ALWAYS);
+				glUseProgram(copyShader);
+				glActiveTexture(GL_TEXTURE0);
+				glBindTexture(GL_TEXTURE_2D, sceneTexture);
+				glActiveTexture(GL_TEXTURE1);
+				glBindTexture(GL_TEXTURE_2D, sceneDepthTexture);
+				glBindVertexArray(copyVao);
+				glDrawArrays(GL_TRIANGLES, 0, 3);
+				glBindVertexArray(0);
+				glActiveTexture(GL_TEXTURE0);
+				glDepthFunc(GL_LESS);
+				if (clipping) {
+					glEnable(GL_CLIP_DISTANCE0);
+				}
+			}
+
 			// Precondition:
 			// Postcondition:	default frame buffer is bound
 			void unbindCurrentFrameBuffer(GLuint SCREEN_WIDTH, GLuint SCREEN_HEIGHT) {
@@ -56,31 +155,81 @@ namespace water {
 		        glViewport(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
 		    }
 
+			// Precondition:	view is the main camera's view transform, called once a frame
+			// Postcondition:	returns true if the reflection should be redrawn this frame, which is when the camera
+			//					has moved or turned, or every REFLECTION_INTERVAL frames so animations still show
+			bool reflectionDue(const glm::mat4& view) {
+				framesSinceReflection++;
+				bool moved = false;
+				for (int i = 0; i < 4; i++) {
+					glm::vec4 change = glm::abs(view[i] - reflectionView[i]);
+					moved = moved || glm::max(glm::max(change.x, change.y), glm::max(change.z, change.w)) > 0.001f;
+				}
+				if (!moved && framesSinceReflection < REFLECTION_INTERVAL) {
+					return false;
+				}
+				framesSinceReflection = 0;
+				reflectionView = view;
+				return true;
+			}
+
 			// Precondition:	reflection texture has been created
 			// Postcondition:	returns reflection texture
-			GLuint getReflectionTexture() {
+			GLuint getReflectionTexture() const {
 		        return reflectionTexture;
 		    }
 
 			// Precondition:	refraction texture has been created
 			// Postcondition:	returns refraction texture
-			GLuint getRefractionTexture() {
+			GLuint getRefractionTexture() const {
 		        return refractionTexture;
 		    }
 
 			// Precondition:	refraction depth texture has been created
 			// Postcondition:	returns refraction depth texture
-			GLuint getRefractionDepthTexture() {
+			GLuint getRefractionDepthTexture() const {
 		        return refractionDepthTexture;
 		    }
+
+			// Precondition:	the scene frame buffer has been bound at least once
+			// Postcondition:	returns the colour of the main pass
+			GLuint getSceneTexture() const {
+				return sceneTexture;
+			}
+
+			// Precondition:	the scene frame buffer has been bound at least once
+			// Postcondition:	returns the depth of the main pass
+			GLuint getSceneDepthTexture() const {
+				return sceneDepthTexture;
+			}
+
+			// Precondition:
+			// Postcondition:	returns the fraction of the window's size the reflection and refraction are drawn at
+			float getResolutionScale() const {
+				return resolutionScale;
+			}
  
 		private:
-			// Resolution of reflection and refraction textures 
+			// Resolution of reflection and refraction textures as a fraction of the window
 			// Smaller resolution increases performance, larger looks more realistic
-			static constexpr int REFLECTION_WIDTH = 600;
-   			static constexpr int REFLECTION_HEIGHT = 400;
-	     	static constexpr int REFRACTION_WIDTH = 600;
-  			static constexpr int REFRACTION_HEIGHT = 400;
+			static constexpr float MIN_SCALE = 0.25f;
+			static constexpr float MAX_SCALE = 1.0f;
+			static constexpr float SCALE_STEP = 0.125f;
+			static constexpr float FRAME_BUDGET = 1.0f / 60.0f;	// seconds a frame should take
+			static constexpr int ADAPT_FRAMES = 30;				// frames averaged before the scale changes
+			float resolutionScale = 0.5f;
+			float frameTimes = 0.0f;
+			int framesTimed = 0;
+
+			int screenWidth;	// size of the window's framebuffer
+			int screenHeight;
+			int targetWidth;	// size of the reflection and refraction textures
+			int targetHeight;
+
+			// Frames a reflection is reused for while the camera is still
+			static constexpr int REFLECTION_INTERVAL = 4;
+			int framesSinceReflection = REFLECTION_INTERVAL;
+			glm::mat4 reflectionView = glm::mat4(0.0f);	// camera view the reflection was last drawn from
 	
 			// Store reflection objects
     		GLuint reflectionFrameBuffer;
@@ -92,6 +241,13 @@ namespace water {
 		    GLuint refractionTexture;
 		    GLuint refractionDepthTexture;
 
+			// Store the screen space objects, only created if screen space water is used
+			GLuint sceneFrameBuffer = 0;
+			GLuint sceneTexture = 0;
+			GLuint sceneDepthTexture = 0;
+			GLuint copyShader = 0;	// copies the scene to the default frame buffer
+			GLuint copyVao = 0;
+
 		    // Precondition: 
 		    // Postcondition: 	framebuffer is created
 		    GLuint createFrameBuffer() {
@@ -156,6 +312,48 @@ namespace water {
 		        return texture;
 		    }
 
+			// Precondition:	texture and depthTexture (if not 0) were made by createTextureAttachment and
+			//					createDepthTextureAttachment
+			// Postcondition:	the textures are given new storage of width by height, they keep their names so anything
+			//					holding them doesn't need to know
+			void resizeTextures(GLuint texture, GLuint depthTexture, int width, int height) {
+				glBindTexture(GL_TEXTURE_2D, texture);
+				glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, 0);
+				if (depthTexture != 0) {
+					glBindTexture(GL_TEXTURE_2D, depthTexture);
+					glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, 0);
+				}
+				glBindTexture(GL_TEXTURE_2D, 0);
+			}
+
+			// Precondition:
+			// Postcondition:	the scene frame buffer, its textures and the shader that copies it to the screen are created
+			void createSceneFrameBuffer() {
+				sceneFrameBuffer = createFrameBuffer();
+				sceneTexture = createTextureAttachment(screenWidth, screenHeight);
+				sceneDepthTexture = createDepthTextureAttachment(screenWidth, screenHeight);
+
+				// Reflected rays that leave the screen see its edge instead of wrapping around
+				glBindTexture(GL_TEXTURE_2D, sceneTexture);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+				glBindTexture(GL_TEXTURE_2D, sceneDepthTexture);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+				glBindTexture(GL_TEXTURE_2D, 0);
+				unbindCurrentFrameBuffer(screenWidth, screenHeight);
+
+				// The triangle's corners come from gl_VertexID, core profile still needs a vertex array bound
+				copyShader = LoadShaders("water/sceneCopy.vert", "water/sceneCopy.frag");
+				glUseProgram(copyShader);
+				glUniform1i(glGetUniformLocation(copyShader, "sceneTexture"), 0);
+				glUniform1i(glGetUniformLocation(copyShader, "sceneDepthTexture"), 1);
+				glUseProgram(0);
+				glGenVertexArrays(1, &copyVao);
+			}
+
 			// Precondition:
 			// Postcondition: 	binds the given frame buffer
 			void bindFrameBuffer(int frameBuffer, int width, int height) {
@@ -0,0 +1,18 @@
+#version 150
+
+// in variables
+in vec2 texCoords;					// texture coordinates of the scene
+
+// out variables
+out vec4 outColour;					// colour of the fragment
+
+// Textures
+uniform sampler2D sceneTexture;		// colour of the main pass
+uniform sampler2D sceneDepthTexture;	// depth of the main pass
+
+void main()
+{
+	// Copy the colour and depth so the water is depth tested against the scene
+	outColour = texture(sceneTexture, texCoords);
+	gl_FragDepth = texture(sceneDepthTexture, texCoords).r;
+}
\ No newline at end of file
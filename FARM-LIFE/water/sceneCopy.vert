@@ -0,0 +1,12 @@
+#version 150
+
+// out variables
+out vec2 texCoords;				// texture coordinates of the scene
+
+void main()
+{
+	// One triangle that covers the whole screen, corners from the vertex index
+	vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+	texCoords = corner;
+	gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+}
\ No newline at end of file
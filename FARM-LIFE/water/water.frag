@@ -5,6 +5,7 @@ in vec4 clipSpace;						// fragment position in clip space
 in vec2 texCoords;						// texture coordinates (x,y) of this fragment
 in vec3 toCameraVector;					// vector from fragment to camera
 in vec3 FragPos;						// Position of the Fragment
+in vec3 viewPosition;					// Position of the fragment in view space
 //in vec3 fromLightVector; 				// vector from fragment to light vector
 
 // out variables
@@ -24,11 +25,19 @@ uniform vec3 colour;					// colour to add blue tint
 uniform float near;						// near plane of program
 uniform float far;						// far plane of program
 uniform bool isCameraAbove;				// check if we need to do reflectivity or not
+uniform bool screenSpace;				// reflection and refraction textures are the main pass, reflect by ray marching
+uniform mat4 Hvw;						// world to view matrix
+uniform mat4 Hcv;						// view to clip matrix
 
 // Parameters for specular lighting
 const float shineDamper = 50.0;			// adjust shine
 const float reflectivity = 0.6;			// adjust reflectivity
 
+// Parameters for screen space reflections
+const int raySteps = 48;				// steps along the reflected ray
+const int refineSteps = 5;				// halvings of the step once the ray passes behind the scene
+const float firstStep = 0.5;			// length of the first step, each step is a little longer than the last
+
 struct DirLight {
     vec3 direction;
     vec3 ambient;
@@ -65,10 +74,60 @@ struct SpotLight {
 
 #define NR_POINT_LIGHTS 4
 
-uniform vec3 viewPos;
-uniform DirLight dirLight;
-uniform PointLight pointLights[NR_POINT_LIGHTS];
-uniform SpotLight spotLight;
+// Lights shared by every lit shader, written once per render pass (lights::LightBuffer)
+layout (std140) uniform Lights {
+    vec3 viewPos;
+    DirLight dirLight;
+    PointLight pointLights[NR_POINT_LIGHTS];
+    SpotLight spotLight;
+};
+
+// Distance from the camera of a depth from the depth map
+float linearDepth(float depth)
+{
+	return 2.0 * near * far / (far + near - (2.0 * depth - 1.0) * (far - near));
+}
+
+// Screen coordinates of a point in view space
+vec2 screenCoords(vec3 point)
+{
+	vec4 projected = Hcv * vec4(point, 1.0);
+	return ((projected.xy / projected.w) / 2.0) + 0.5;
+}
+
+// Reflect the view ray off the water and march it through the depth of the main pass until it passes behind
+// the scene. Rays that leave the screen use the last point on screen, which is usually sky at the top edge.
+vec4 screenSpaceReflection(vec3 surfaceNormal, vec2 startCoords)
+{
+	vec3 viewNormal = normalize(mat3(Hvw) * surfaceNormal);
+	vec3 rayDirection = normalize(reflect(normalize(viewPosition), viewNormal));
+	vec3 rayPosition = viewPosition;
+	vec2 coords = startCoords;
+	float stepLength = firstStep;
+
+	for (int i = 0; i < raySteps; i++) {
+		vec3 next = rayPosition + rayDirection * stepLength;
+		vec2 nextCoords = screenCoords(next);
+		if (next.z >= -near || any(lessThan(nextCoords, vec2(0.0))) || any(greaterThan(nextCoords, vec2(1.0)))) {
+			break;
+		}
+		rayPosition = next;
+		coords = nextCoords;
+
+		if (-rayPosition.z > linearDepth(texture(depthMap, coords).r)) {
+			// The ray is behind the scene, close in on where it crossed
+			for (int j = 0; j < refineSteps; j++) {
+				stepLength *= 0.5;
+				bool behind = -rayPosition.z > linearDepth(texture(depthMap, screenCoords(rayPosition)).r);
+				rayPosition += rayDirection * (behind ? -stepLength : stepLength);
+			}
+			coords = screenCoords(rayPosition);
+			break;
+		}
+		stepLength *= 1.1;
+	}
+	return texture(reflectionTexture, clamp(coords, 0.001, 0.999));
+}
 
 // function prototypes
 vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir);
@@ -231,6 +290,11 @@ void main()
 	vec3 normal = vec3(normalMapColour.r * 2.0 - 1.0, normalMapColour.b * 2, normalMapColour.g * 2.0 - 1.0);
 	normal = normalize(normal);
 
+	// Without a reflection pass the reflection is found in the main pass, rippled by a flattened normal
+	if (screenSpace && isCameraAbove) {
+		reflectColour = screenSpaceReflection(normalize(mix(vec3(0.0, 1.0, 0.0), normal, 0.1)), ndc);
+	}
+
 	//---------------------
 	// APPLY FRESNEL EFFECT
 	//---------------------
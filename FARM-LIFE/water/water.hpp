@@ -3,22 +3,28 @@
  * The water is reflective. It moves with small wave patterns and is distorted to create rippling effects.
  * The water uses the Fresnel effect for reflectivity. 
  * The water is more transparent in shallower areas.
+ * The reflection and refraction come from the water frame buffers, or from the main pass in screen space mode.
  */
 
 #ifndef ASSIGNMENT_WATER_HPP
 #define ASSIGNMENT_WATER_HPP
 
 #include <vector>
+#include "audio/streamingSource.hpp"
+#include "util/gridMesh.hpp"
+#include "util/textureCache.hpp"
 #include "WaterFrameBuffers.hpp"
 
 namespace water
 {
+// The water's images are read as numbers by its shader, so they are kept exact
+const utility::texture::Options DATA_MAP = { utility::texture::DATA, false, SOIL_LOAD_RGB };
 
 class Water
 {
 public:
 	// Water constructor
-	Water(int resX_, int resZ_, float scale_, float height_, water::WaterFrameBuffers fbos)
+	Water(int resX_, int resZ_, float scale_, float height_)
 	{
 		// Initialise parameters for water size and resolution
 		resX = resX_;
@@ -42,7 +48,12 @@ public:
 		//-------------
 		// SET TEXTURES
 		//-------------
-		loadTextures(fbos);
+		loadTextures();
+
+		//----------------------
+		// FIND AND SET UNIFORMS
+		//----------------------
+		initUniforms();
 
 		//-----------------------------------
 		// LINK VERTEX DATA TO SHADER PROGRAM
@@ -52,9 +63,8 @@ public:
 		glVertexAttribPointer(posAttrib, 3, GL_FLOAT, GL_FALSE,
 							  vertexAtt * sizeof(float), 0);
 
-		// Initialise sound
-		sound = audio::Source();
-		sound.setLooping(true);
+		// The sound is streamed once playSound is called
+		sound = nullptr;
 	}
 
 	// Destructor
@@ -67,27 +77,44 @@ public:
 		glDeleteBuffers(1, &vbo);
 		glDeleteBuffers(1, &ebo);
 		glDeleteVertexArrays(1, &vao);
-		glDeleteTextures(6, &tex[0]);
-		sound.cleanup();
+		for (GLuint texture : tex)
+		{
+			utility::texture::release(texture);
+		}
+		delete sound;
+		sound = nullptr;
+	}
+
+	// Precondition:	None
+	// Postcondition:	The textures of the water are read from their caches, or built, by the job system's workers,
+	//					so creating Water only uploads them
+	static void prefetchTextures(utility::jobs::JobSystem& jobs)
+	{
+		utility::texture::prefetch(jobs, "water/dudvmap.png", DATA_MAP);
+		utility::texture::prefetch(jobs, "water/normalmap.png", DATA_MAP);
+		utility::texture::prefetch(jobs, "terrain/heightmap.bmp", DATA_MAP);
 	}
 
 	// Precondition:	file is an audio file in wav format
-	// Postcondition:	sound is played from the source on this model
+	// Postcondition:	file is streamed on a loop from the water's sound source
 	void playSound(const char *file)
 	{
-		GLuint buffer = audio::loadAudio(file);
-		sound.play(buffer);
+		delete sound;
+		sound = new audio::StreamingSource(file);
+		sound->setLooping(true);
+		sound->play();
 	}
 
-	// Precondition:	Water object has been constructed
+	// Precondition:	Water object has been constructed, in screen space mode the main pass was drawn into the
+	//					scene frame buffer of fbos, otherwise the reflection and refraction were drawn
 	// Postcondition:	Water is drawn
-	void draw(const glm::mat4& Hvw, const glm::mat4& Hcv, const glm::vec3& camPos, float time, glm::vec3 lightPosition, glm::vec3 lightColour, bool isCameraAbove, glm::vec3 Forward)
+	void draw(const utility::frame::FrameContext& frame, const glm::vec3& lightPosition, const glm::vec3& lightColour, bool isCameraAbove,
+			  const water::WaterFrameBuffers& fbos, bool screenSpace)
 	{
-		// Initalise variables needed for drawing the water
-		float waveHeight = 0.5;
-		glm::vec3 colour = glm::vec3(0.0f, 0.467f, 0.745f);
-		float NEAR_PLANE = 0.1f;
-		float FAR_PLANE = 1000.0f;
+		const glm::mat4& Hvw = frame.view;
+		const glm::mat4& Hcv = frame.projection;
+		const glm::vec3& camPos = frame.cameraPosition;
+		const float time = frame.time;
 
 		//------------------------
 		// BIND SHADER AND BUFFERS
@@ -97,56 +124,30 @@ public:
 		glBindBuffer(GL_ARRAY_BUFFER, vbo);
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
 
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, tex[0]);
-		glUniform1i(glGetUniformLocation(shader, "refractionTexture"), 0);
-
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, tex[1]);
-		glUniform1i(glGetUniformLocation(shader, "reflectionTexture"), 1);
-
-		glActiveTexture(GL_TEXTURE2);
-		glBindTexture(GL_TEXTURE_2D, tex[2]);
-		glUniform1i(glGetUniformLocation(shader, "dudvMap"), 2);
-
-		glActiveTexture(GL_TEXTURE3);
-		glBindTexture(GL_TEXTURE_2D, tex[3]);
-		glUniform1i(glGetUniformLocation(shader, "normalMap"), 3);
-
-		glActiveTexture(GL_TEXTURE4);
-		glBindTexture(GL_TEXTURE_2D, tex[4]);
-		glUniform1i(glGetUniformLocation(shader, "depthMap"), 4);
-		glActiveTexture(GL_TEXTURE5);
-		glBindTexture(GL_TEXTURE_2D, tex[5]);
-		glUniform1i(glGetUniformLocation(shader, "terrainHeight"), 5);
-
-		//--------------------------------
-		// SET CAMERA IN MIDDLE OF WATER
-		//--------------------------------
-		glm::mat4 Hwm = glm::mat4(1.0f);
-		Hwm[3] = glm::vec4(-(resX * scale) / 2, -20.0, -(resZ * scale) / 2, 1.0);
-
-		glUniformMatrix4fv(glGetUniformLocation(shader, "Hvw"), 1, GL_FALSE, &Hvw[0][0]);
-		glUniformMatrix4fv(glGetUniformLocation(shader, "Hcv"), 1, GL_FALSE, &Hcv[0][0]);
-		glUniformMatrix4fv(glGetUniformLocation(shader, "Hwm"), 1, GL_FALSE, &Hwm[0][0]);
-		glUniform3f(glGetUniformLocation(shader, "cameraPosition"), camPos[0], camPos[1], camPos[2]);
-
-		// Set uniforms
-		glUniform1f(glGetUniformLocation(shader, "scale"), scale);
-		glUniform3f(glGetUniformLocation(shader, "colour"), colour[0], colour[1], colour[2]);
-		glUniform1f(glGetUniformLocation(shader, "time"), time);
-		glUniform1f(glGetUniformLocation(shader, "waveHeight"), waveHeight);
-		glUniform1f(glGetUniformLocation(shader, "near"), NEAR_PLANE);
-		glUniform1f(glGetUniformLocation(shader, "far"), FAR_PLANE);
-		glUniform1i(glGetUniformLocation(shader, "isCameraAbove"), isCameraAbove ? 1 : 0);
-
-		glUniform1f(glGetUniformLocation(shader, "terraMaxHeight"), height * 2.5);
-		// Set light uniforms
-		glUniform3f(glGetUniformLocation(shader, "lightColour"), lightColour[0], lightColour[1], lightColour[2]);
-		glUniform3f(glGetUniformLocation(shader, "lightPosition"), lightPosition[0], lightPosition[1], lightPosition[2]);
+		// Texture units are assigned to the samplers once in initUniforms. The frame buffer textures are bound
+		// each draw since screen space mode swaps them for the scene
+		GLuint textures[6] = {
+			screenSpace ? fbos.getSceneTexture() : fbos.getRefractionTexture(),
+			screenSpace ? fbos.getSceneTexture() : fbos.getReflectionTexture(),
+			tex[0],
+			tex[1],
+			screenSpace ? fbos.getSceneDepthTexture() : fbos.getRefractionDepthTexture(),
+			tex[2]};
+		for (int i = 0; i < 6; i++)
+		{
+			glActiveTexture(GL_TEXTURE0 + i);
+			glBindTexture(GL_TEXTURE_2D, textures[i]);
+		}
 
-		lights::light lighting(shader);
-		shader = lighting.setup(camPos, Forward);
+		// Set the uniforms that change each draw, the lights come from the shared light buffer
+		glUniformMatrix4fv(uniforms.Hvw, 1, GL_FALSE, &Hvw[0][0]);
+		glUniformMatrix4fv(uniforms.Hcv, 1, GL_FALSE, &Hcv[0][0]);
+		glUniform3fv(uniforms.cameraPosition, 1, &camPos[0]);
+		glUniform1f(uniforms.time, time);
+		glUniform1i(uniforms.isCameraAbove, isCameraAbove ? 1 : 0);
+		glUniform1i(uniforms.screenSpace, screenSpace ? 1 : 0);
+		glUniform3fv(uniforms.lightColour, 1, &lightColour[0]);
+		glUniform3fv(uniforms.lightPosition, 1, &lightPosition[0]);
 
 		//-----------
 		// DRAW WATER
@@ -155,11 +156,15 @@ public:
 		glEnable(GL_BLEND);
 		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-		// Draw the elements
-		glDrawElements(GL_TRIANGLES, noVertices, GL_UNSIGNED_INT, 0);
+		// Draw the elements, every tile uses the same indices from its own block of vertices
+		glMultiDrawElementsBaseVertex(GL_TRIANGLES, &tileCounts[0], GL_UNSIGNED_SHORT, &tileOffsets[0],
+									  (GLsizei)tileCounts.size(), &tileBaseVertices[0]);
 
 		// Update source location
-		sound.setPosition(camPos);
+		if (sound != nullptr)
+		{
+			sound->setPosition(camPos);
+		}
 	}
 	
 	// Precondition:	Has a height value
@@ -170,20 +175,83 @@ public:
 	}
 	
 	private:
+		static const int TILE_SIZE = 128; // squares along each side of a tile of the water grid
+
 		// Store shader program and buffers
 		GLuint shader;		// shader program
 		GLuint vao;			// vertex array object
 		GLuint vbo;			// vertex buffer object
 		GLuint ebo;			// element buffer object
-		GLuint tex[6];		// textures
+		GLuint tex[3];		// du/dv map, normal map and terrain height textures
 		
 		// Store terrain size and resolution
 		float scale;		// how much to scale water, if water is resX by resZ
 		int resX;			// number of vertices wide (x-axis)
 		int resZ;			// number of vertices long (z-axis)
-		int noVertices;		// number of vertices to draw
+		int noVertices;		// number of indices in each tile
         float height;       // height of the water
-		audio::Source sound;		// sound source
+		audio::StreamingSource *sound;	// sound source, streamed from its file
+
+		// Draw parameters for each tile of the grid
+		std::vector<GLsizei> tileCounts;
+		std::vector<GLvoid*> tileOffsets;
+		std::vector<GLint> tileBaseVertices;
+
+		// Locations of the uniforms that are set on every draw, found once after the shader is linked
+		struct Uniforms
+		{
+			GLint Hvw;
+			GLint Hcv;
+			GLint cameraPosition;
+			GLint time;
+			GLint isCameraAbove;
+			GLint screenSpace;
+			GLint lightColour;
+			GLint lightPosition;
+		} uniforms;
+
+	// Precondition:	Shader program is linked
+	// Postcondition:	Uniform locations are stored, uniforms that never change (samplers, sizes,
+	//					model transform) are set and the shader reads from the shared light buffer
+	void initUniforms()
+	{
+		// Initalise variables needed for drawing the water
+		float waveHeight = 0.5;
+		glm::vec3 colour = glm::vec3(0.0f, 0.467f, 0.745f);
+		float NEAR_PLANE = 0.1f;
+		float FAR_PLANE = 1000.0f;
+
+		uniforms.Hvw = glGetUniformLocation(shader, "Hvw");
+		uniforms.Hcv = glGetUniformLocation(shader, "Hcv");
+		uniforms.cameraPosition = glGetUniformLocation(shader, "cameraPosition");
+		uniforms.time = glGetUniformLocation(shader, "time");
+		uniforms.isCameraAbove = glGetUniformLocation(shader, "isCameraAbove");
+		uniforms.screenSpace = glGetUniformLocation(shader, "screenSpace");
+		uniforms.lightColour = glGetUniformLocation(shader, "lightColour");
+		uniforms.lightPosition = glGetUniformLocation(shader, "lightPosition");
+
+		// Set camera in middle of water
+		glm::mat4 Hwm = glm::mat4(1.0f);
+		Hwm[3] = glm::vec4(-(resX * scale) / 2, -20.0, -(resZ * scale) / 2, 1.0);
+
+		glUseProgram(shader);
+		glUniform1i(glGetUniformLocation(shader, "refractionTexture"), 0);
+		glUniform1i(glGetUniformLocation(shader, "reflectionTexture"), 1);
+		glUniform1i(glGetUniformLocation(shader, "dudvMap"), 2);
+		glUniform1i(glGetUniformLocation(shader, "normalMap"), 3);
+		glUniform1i(glGetUniformLocation(shader, "depthMap"), 4);
+		glUniform1i(glGetUniformLocation(shader, "terrainHeight"), 5);
+		glUniformMatrix4fv(glGetUniformLocation(shader, "Hwm"), 1, GL_FALSE, &Hwm[0][0]);
+		glUniform1f(glGetUniformLocation(shader, "scale"), scale);
+		glUniform3f(glGetUniformLocation(shader, "colour"), colour[0], colour[1], colour[2]);
+		glUniform1f(glGetUniformLocation(shader, "waveHeight"), waveHeight);
+		glUniform1f(glGetUniformLocation(shader, "near"), NEAR_PLANE);
+		glUniform1f(glGetUniformLocation(shader, "far"), FAR_PLANE);
+		glUniform1f(glGetUniformLocation(shader, "terraMaxHeight"), height * 2.5);
+		lights::LightBuffer::bindShader(shader);
+
+		glUseProgram(0);
+	}
 
 	// Precondition:	vertexAtt is number of vertex attributes, height is height of the water
 	// Postcondition:	Mesh is created and loaded into VAO, VBO, EBO
@@ -198,52 +266,32 @@ public:
 		//----------------
 		// CREATE VERTICES
 		//----------------
-		float *vertices = new float[1000 * 1000 * 3]; // resolution multiplied by number of vertex attributes
-
-		// Loop over grid
-		for (int i = 0; i < resX; i++)
-		{
-			for (int j = 0; j < resZ; j++)
-			{
-				// Position
-				vertices[(i * (resZ + resZ * (vertexAtt - 1))) + (j * vertexAtt) + 0] = (float)i; // X
-				vertices[(i * (resZ + resZ * (vertexAtt - 1))) + (j * vertexAtt) + 1] = height;   // Y
-				vertices[(i * (resZ + resZ * (vertexAtt - 1))) + (j * vertexAtt) + 2] = (float)j; // Z
-			}
-		}
+		// The grid is split into tiles that share one set of 16 bit indices
+		utility::grid::GridLayout layout = utility::grid::makeLayout(resX, resZ, TILE_SIZE);
+		std::vector<float> vertices(layout.vertexCount() * vertexAtt);
+		utility::grid::buildPositions(layout, [height](int, int) { return height; }, glm::ivec2(0), &vertices[0]);
 
 		//---------
 		// BIND VBO
 		//---------
 		glGenBuffers(1, &vbo);
 		glBindBuffer(GL_ARRAY_BUFFER, vbo);
-		glBufferData(GL_ARRAY_BUFFER, resX * resZ * vertexAtt * sizeof(float), &vertices[0], GL_STATIC_DRAW);
-		delete[] vertices; // free memory from vertices
+		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), &vertices[0], GL_STATIC_DRAW);
 
 		//-----------------
 		// CREATE TRIANGLES
 		//-----------------
-		std::vector<GLuint> *triangles = new std::vector<GLuint>(); // Vector that will store all the triangles
+		std::vector<GLushort> triangles;
+		utility::grid::buildTileIndices(layout, 1, triangles);
+		noVertices = triangles.size();
 
-		// Loop over grid except last row and column to get triangles
-		for (int i = 0; i < resX - 1; i++)
+		for (int tx = 0; tx < layout.tilesX; tx++)
 		{
-			for (int j = 0; j < resZ - 1; j++)
+			for (int tz = 0; tz < layout.tilesZ; tz++)
 			{
-				// Add vertices of triangles (two triangles that make a square across and up to current vertex)
-
-				// FIRST TRIANGLE
-				triangles->push_back(((i * (resZ + resZ * (vertexAtt - 1))) + ((j + 1) * vertexAtt)) / vertexAtt); // bottom-left	(i, j + 1)
-				triangles->push_back(((i * (resZ + resZ * (vertexAtt - 1))) + (j * vertexAtt)) / vertexAtt);	   // top-left		(i, j)
-				triangles->push_back((((i + 1) * (resZ + resZ * (vertexAtt - 1))) + (j * vertexAtt)) / vertexAtt); // top-right	(i + 1, j)
-
-				// SECOND TRIANGLE
-				triangles->push_back((((i + 1) * (resZ + resZ * (vertexAtt - 1))) + (j * vertexAtt)) / vertexAtt);		 // top-right	(i + 1, j)
-				triangles->push_back((((i + 1) * (resZ + resZ * (vertexAtt - 1))) + ((j + 1) * vertexAtt)) / vertexAtt); // bottom-right (i + 1, j + 1)
-				triangles->push_back(((i * (resZ + resZ * (vertexAtt - 1))) + ((j + 1) * vertexAtt)) / vertexAtt);		 // bottom-left	(i, j + 1)
-
-				// Set the number of vertices for drawing later
-				noVertices = triangles->size();
+				tileCounts.push_back(noVertices);
+				tileOffsets.push_back(0);
+				tileBaseVertices.push_back(layout.baseVertex(tx, tz));
 			}
 		}
 
@@ -254,41 +302,19 @@ public:
 
 		// set elements to the triangles that were just made
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, triangles->size() * sizeof(float), &triangles->front(), GL_STATIC_DRAW);
-
-		std::vector<GLuint>().swap(*triangles); // free memory from triangles
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, triangles.size() * sizeof(GLushort), &triangles.front(), GL_STATIC_DRAW);
 	}
 
-		// Precondition: 	fbos is populated with textures
-		// Postcondition: 	Generates and binds textures for reflection, refraction,
-		// 					du/dv map, normal map, and depth map.
-	void loadTextures(water::WaterFrameBuffers fbos) {
-			// Initialise textures
-			int width, height; 			// variables for the width and height of image being loaded
-			glGenTextures(6, &tex[0]);	// requires 5 textures
-
-		//-------------------
-		// REFRACTION TEXTURE
-		//-------------------
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, tex[0]);
-		tex[0] = fbos.getRefractionTexture();
-
-		//-------------------
-		// REFLECTION TEXTURE
-		//-------------------
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, tex[1]);
-		tex[1] = fbos.getReflectionTexture();
+		// Precondition: 	None
+		// Postcondition: 	Loads and binds textures for the du/dv map, normal map and terrain height, sharing any the
+		//					terrain has loaded. The reflection, refraction and depth textures belong to the water frame buffers
+	void loadTextures() {
 
 		//------------------
 		// DU/DV MAP TEXTURE
 		//------------------
 		glActiveTexture(GL_TEXTURE2);
-		glBindTexture(GL_TEXTURE_2D, tex[2]);
-		unsigned char *image = SOIL_load_image("water/dudvmap.png", &width, &height, 0, SOIL_LOAD_RGB);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB,
-					 GL_UNSIGNED_BYTE, image);
+		tex[0] = utility::texture::load("water/dudvmap.png", DATA_MAP);
 
 		// Set the parameters for the du/dv map
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
@@ -300,10 +326,7 @@ public:
 		// NORMAL MAP TEXTURE
 		//-------------------
 		glActiveTexture(GL_TEXTURE3);
-		glBindTexture(GL_TEXTURE_2D, tex[3]);
-		unsigned char *image1 = SOIL_load_image("water/normalmap.png", &width, &height, 0, SOIL_LOAD_RGB);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB,
-					 GL_UNSIGNED_BYTE, image1);
+		tex[1] = utility::texture::load("water/normalmap.png", DATA_MAP);
 
 		// Set the parameters for the normal map
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
@@ -311,21 +334,11 @@ public:
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-			//--------------
-			// DEPTH TEXTURE
-			//--------------
-			glActiveTexture(GL_TEXTURE4);
-			glBindTexture(GL_TEXTURE_2D, tex[4]);
-			tex[4] = fbos.getRefractionDepthTexture();
-
 			//---------------
 			// TERRAIN HEIGHT
 			//---------------
 			glActiveTexture(GL_TEXTURE5);
-			glBindTexture(GL_TEXTURE_2D, tex[5]);
-			unsigned char *image2 = SOIL_load_image("terrain/heightmap.bmp", &width, &height, 0, SOIL_LOAD_RGB);
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB,
-						 GL_UNSIGNED_BYTE, image2);
+			tex[2] = utility::texture::load("terrain/heightmap.bmp", DATA_MAP);
 			// Set the parameters for the height map
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
@@ -8,6 +8,7 @@ out vec4 clipSpace;				// position of vertex in clip space
 out vec2 texCoords;				// texture coordinates for du/dv and normal map
 out vec3 toCameraVector;		// vector from vertex to camera
 out vec3 FragPos;				// Fragment Position
+out vec3 viewPosition;			// position of the vertex in view space
 //out vec3 fromLightVector;		// vector from vertex to light
 
 // Transformation matrices
@@ -53,6 +54,7 @@ void main()
 	toCameraVector = cameraPosition - worldPos.xyz;
 
 	FragPos = worldPos.xyz;
+	viewPosition = (Hvw * worldPos).xyz;
 
 	// Get vertex to light vector
 	//fromLightVector = worldPos.xyz - lightPosition;